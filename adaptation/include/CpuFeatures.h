@@ -0,0 +1,71 @@
+/*
+ *  $Id$
+ *
+ *  Nova 3D Engine - A portable object oriented, scene graph based, 
+ *  lightweight real-time 3D software rendering framework. 
+ *  Copyright (C) 2001-2009 Matti Dahlbom
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Contact: Matti Dahlbom <matti at 777-team dot org>
+ */
+
+
+#ifndef __CPUFEATURES_H
+#define __CPUFEATURES_H
+
+// FILE INFO
+// This file defines the platform independent interface for finding out
+// which instruction set extensions the processor supports. The 
+// implementation is platform dependent.
+
+#include "NovaTypes.h"
+
+namespace nova3d {
+
+/**
+ * Instruction set levels the engine has kernels for, in ascending order;
+ * every level includes the ones below it.
+ */
+enum CpuLevel
+    {
+	CpuLevelScalar,
+	CpuLevelSse2,
+	CpuLevelSse41,
+	CpuLevelAvx2,
+	CpuLevelAvx512,
+	CpuLevelCount
+    };
+
+/**
+ * Returns the highest level supported by both the processor and the 
+ * operating system.<p />
+ */
+NOVA_IMPORT CpuLevel DetectCpuLevel();
+
+/**
+ * Returns the level requested by the user for benchmarking, or 
+ * CpuLevelCount if none was requested. On Linux the level is read from
+ * the NOVA_CPU_LEVEL environment variable, one of "scalar", "sse2", 
+ * "sse41", "avx2" and "avx512".<p />
+ */
+NOVA_IMPORT CpuLevel GetRequestedCpuLevel();
+
+/** Returns the name of the given level. */
+NOVA_IMPORT const char* GetCpuLevelName( CpuLevel level );
+
+}; // namespace
+
+#endif
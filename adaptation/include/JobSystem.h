@@ -0,0 +1,213 @@
+/*
+ *  $Id$
+ *
+ *  Nova 3D Engine - A portable object oriented, scene graph based, 
+ *  lightweight real-time 3D software rendering framework. 
+ *  Copyright (C) 2001-2009 Matti Dahlbom
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Contact: Matti Dahlbom <matti at 777-team dot org>
+ */
+
+
+#ifndef __JOBSYSTEM_H
+#define __JOBSYSTEM_H
+
+// FILE INFO
+// This file defines the platform independent interface for running work
+// in parallel on a pool of worker threads. The implementation is platform
+// dependent; platforms without threads run the jobs in the calling thread.
+
+#include "NovaTypes.h"
+
+namespace nova3d {
+
+// maximum number of threads in the pool, including the calling thread
+const int JobSystemMaxThreads = 16;
+
+// lets Start() use one thread per online processor
+const int JobSystemAutoThreads = 0;
+
+// maximum number of jobs that may wait for a single job
+const int JobMaxDependents = 8;
+
+/**
+ * A unit of work for the job system.<p />
+ *
+ * Dependencies are declared with JobSystem::AddDependency() before 
+ * either of the jobs is submitted. A submitted job is run once all of 
+ * its dependencies have been run; the dependencies are cleared when the
+ * job completes, so a job object may be submitted again afterwards.<p />
+ *
+ * @author Matti Dahlbom
+ * @version $Revision$
+ */
+class Job
+{
+    friend class JobSystem;
+
+ public: // Constructors and destructor
+    NOVA_IMPORT Job();
+    NOVA_IMPORT virtual ~Job();
+
+ public: // New methods
+    /** Performs the work. Called from an arbitrary thread. */
+    virtual void Run() = 0;
+
+    /** Returns true once the job has been run after it was submitted. */
+    inline bool IsDone() const;
+
+ private: // Data
+    // number of unfinished dependencies plus one for the submission
+    volatile int_32 m_pending;
+
+    // set when the job has completed
+    volatile int_32 m_done;
+
+    // jobs waiting for this one
+    Job* m_dependents[JobMaxDependents];
+    int m_numDependents;
+};
+
+/**
+ * Body of a parallel loop. Execute() is called concurrently for 
+ * disjoint subranges of the loop.<p />
+ *
+ * @author Matti Dahlbom
+ * @version $Revision$
+ */
+class ParallelForBody
+{
+ public: // Constructors and destructor
+    virtual ~ParallelForBody() {};
+
+ public: // New methods
+    /** Processes the indices from begin up to but not including end. */
+    virtual void Execute( int begin, int end ) = 0;
+};
+
+// platform specific state of the job system
+struct JobSystemData;
+
+/**
+ * A pool of worker threads shared by the whole engine.<p />
+ *
+ * Every thread has a queue of its own. New jobs are pushed to the queue
+ * of the submitting thread, which takes them back in last in, first out 
+ * order while they are still warm in its cache; idle threads steal the
+ * oldest jobs from the other queues. A thread waiting for a job runs 
+ * queued jobs in the meantime, so jobs may wait for other jobs.<p />
+ *
+ * Until Start() is called, and on platforms without threads, jobs are
+ * run in the submitting thread.<p />
+ *
+ * @author Matti Dahlbom
+ * @version $Revision$
+ */
+class JobSystem
+{
+    friend struct JobSystemData;
+
+ private: // Constructors and destructor
+    JobSystem();
+    ~JobSystem();
+
+ public: // New methods (Public API)
+    /** Returns the job system shared by the engine. */
+    NOVA_IMPORT static JobSystem& Instance();
+
+    /**
+     * Starts the worker threads. The thread calling this method is the 
+     * first thread of the pool and should be the one that renders.<p />
+     *
+     * @param numThreads number of threads including the calling thread,
+     *                   or JobSystemAutoThreads for one per processor
+     * @param pinThreads whether to bind each worker to a processor of 
+     *                   its own where the platform supports it
+     * @return Nova error code or NovaErrNone if successful
+     */
+    NOVA_IMPORT int Start( int numThreads = JobSystemAutoThreads, 
+                           bool pinThreads = false );
+
+    /** 
+     * Stops the worker threads. No jobs may be pending.
+     */
+    NOVA_IMPORT void Stop();
+
+    /** Returns the number of threads running jobs, at least 1. */
+    inline int GetNumThreads() const;
+
+    /**
+     * Makes <code>job</code> wait until <code>dependency</code> has 
+     * been run. Neither job may be submitted yet.<p />
+     *
+     * @return NovaErrNone or NovaErrOverflow if <code>dependency</code>
+     *         already has JobMaxDependents dependents
+     */
+    NOVA_IMPORT int AddDependency( Job& job, Job& dependency );
+
+    /** 
+     * Submits a job for running. The job object must stay valid until 
+     * it is done.
+     */
+    NOVA_IMPORT void Submit( Job& job );
+
+    /**
+     * Returns once the submitted job is done, running other jobs 
+     * while waiting.
+     */
+    NOVA_IMPORT void Wait( Job& job );
+
+    /**
+     * Runs <code>body</code> over the index range [begin, end) split into
+     * chunks of <code>grainSize</code> indices, and returns once all of 
+     * the range has been processed. The calling thread takes part.<p />
+     */
+    NOVA_IMPORT void ParallelFor( int begin, int end, int grainSize, 
+                                  ParallelForBody& body );
+
+ private: // New methods
+    /** Runs the job and releases the jobs waiting for it. */
+    void Execute( Job& job );
+
+    /** Queues a job whose dependencies have all been run. */
+    void Enqueue( Job& job );
+
+    /** Runs queued jobs in a worker thread until the pool is stopped. */
+    void WorkerLoop( int threadIndex );
+
+ private: // Data
+    JobSystemData* m_data;
+    int m_numThreads;
+};
+
+///////////////////////////////////////////////////
+// inline method definitions
+///////////////////////////////////////////////////
+
+bool Job::IsDone() const
+{
+    return (m_done != 0);
+}
+
+int JobSystem::GetNumThreads() const
+{
+    return m_numThreads;
+}
+
+}; // namespace
+
+#endif
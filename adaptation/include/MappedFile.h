@@ -0,0 +1,98 @@
+/*
+ *  $Id$
+ *
+ *  Nova 3D Engine - A portable object oriented, scene graph based, 
+ *  lightweight real-time 3D software rendering framework. 
+ *  Copyright (C) 2001-2009 Matti Dahlbom
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Contact: Matti Dahlbom <matti at 777-team dot org>
+ */
+
+#ifndef __MAPPEDFILE_H
+#define __MAPPEDFILE_H
+
+// FILE INFO
+// This file defines the platform independent interface for read-only 
+// access to a whole file in memory. The implementation is platform 
+// dependent.
+
+#include "NovaTypes.h"
+
+namespace nova3d {
+
+/**
+ * Provides the contents of a file as a read-only block of memory. Where 
+ * the platform supports it the file is memory mapped, so the pages are 
+ * only read in when they are touched; otherwise the file is read into a 
+ * heap buffer.<p />
+ *
+ * @author Matti Dahlbom
+ * @version $Revision$
+ */
+class MappedFile
+{
+ public: // Constructors and destructor
+    NOVA_IMPORT MappedFile();
+    NOVA_IMPORT ~MappedFile();
+
+ public: // New methods (Public API)
+    /**
+     * Opens the given file and makes its contents available through 
+     * <code>GetData()</code>.<p />
+     *
+     * @param fileName name of the file to open
+     * @return Nova error code or NovaErrNone if successful
+     */
+    NOVA_IMPORT int Open( const char* fileName );
+
+    /** 
+     * Releases the file contents. Any pointers to the data become
+     * invalid.
+     */
+    NOVA_IMPORT void Close();
+
+    /** Returns the file contents, or NULL if no file is open. */
+    inline const uint_8* GetData() const;
+
+    /** Returns the size of the file contents in bytes. */
+    inline uint_32 GetSize() const;
+
+ private: // Data
+    // file contents
+    uint_8* m_data;
+
+    // size of the contents
+    uint_32 m_size;
+};
+
+///////////////////////////////////////////////////
+// inline method definitions
+///////////////////////////////////////////////////
+
+const uint_8* MappedFile::GetData() const
+{
+    return m_data;
+}
+
+uint_32 MappedFile::GetSize() const
+{
+    return m_size;
+}
+
+}; // namespace
+
+#endif
@@ -45,6 +45,8 @@
 // basic types
 typedef TInt32 int_32;
 typedef TUint32 uint_32;
+typedef TInt16 int_16;
+typedef TUint16 uint_16;
 typedef TInt8 int_8;
 typedef TUint8 uint_8;
 typedef TReal real_64;
@@ -69,6 +71,8 @@ typedef TInt64 uint_64; // guess there is no native unsigned one
 // basic types
 typedef int int_32;
 typedef unsigned int uint_32;
+typedef short int_16;
+typedef unsigned short uint_16;
 typedef char int_8;
 typedef unsigned char uint_8;
 typedef double real_64;
@@ -88,5 +92,8 @@ typedef unsigned long long uint_64;
 // largest uint_32 possible
 const uint_32 MaxUint32 =0xffffffffu;
 
+// largest int_32 possible
+const int_32 MaxInt32 = 0x7fffffff;
+
 #endif
 
@@ -0,0 +1,129 @@
+/*
+ *  $Id$
+ *
+ *  Nova 3D Engine - A portable object oriented, scene graph based, 
+ *  lightweight real-time 3D software rendering framework. 
+ *  Copyright (C) 2001-2009 Matti Dahlbom
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Contact: Matti Dahlbom <matti at 777-team dot org>
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__i386__) || defined(__x86_64__)
+#include <cpuid.h>
+#endif
+
+#include "CpuFeatures.h"
+
+namespace nova3d {
+
+static const char* const cpuLevelNames[CpuLevelCount] = 
+{
+    "scalar", "sse2", "sse41", "avx2", "avx512"
+};
+
+#if defined(__i386__) || defined(__x86_64__)
+
+// returns the register state enabled by the operating system
+static uint_32 ReadEnabledState()
+{
+    uint_32 eax, edx;
+    __asm__ __volatile__ ( "xgetbv" : "=a" (eax), "=d" (edx) : "c" (0) );
+
+    return eax;
+}
+
+NOVA_EXPORT CpuLevel DetectCpuLevel()
+{
+    unsigned int eax, ebx, ecx, edx;
+    if ( !__get_cpuid( 1, &eax, &ebx, &ecx, &edx ) || 
+         ((edx & bit_SSE2) == 0) )
+    {
+        return CpuLevelScalar;
+    }
+    if ( (ecx & bit_SSE4_1) == 0 )
+    {
+        return CpuLevelSse2;
+    }
+
+    // the wider registers are only usable if the operating system saves 
+    // them on context switches
+    if ( ((ecx & bit_OSXSAVE) == 0) || ((ecx & bit_AVX) == 0) )
+    {
+        return CpuLevelSse41;
+    }
+    uint_32 state = ReadEnabledState();
+    if ( (state & 0x6) != 0x6 )
+    {
+        // xmm and ymm state
+        return CpuLevelSse41;
+    }
+
+    if ( __get_cpuid_max( 0, NULL ) < 7 )
+    {
+        return CpuLevelSse41;
+    }
+    __cpuid_count( 7, 0, eax, ebx, ecx, edx );
+    if ( (ebx & bit_AVX2) == 0 )
+    {
+        return CpuLevelSse41;
+    }
+    if ( ((ebx & bit_AVX512F) == 0) || ((state & 0xe6) != 0xe6) )
+    {
+        // opmask and zmm state
+        return CpuLevelAvx2;
+    }
+
+    return CpuLevelAvx512;
+}
+
+#else
+
+NOVA_EXPORT CpuLevel DetectCpuLevel()
+{
+    return CpuLevelScalar;
+}
+
+#endif
+
+NOVA_EXPORT CpuLevel GetRequestedCpuLevel()
+{
+    const char* name = getenv( "NOVA_CPU_LEVEL" );
+    if ( name != NULL )
+    {
+        for ( int i = 0; i < CpuLevelCount; i++ )
+        {
+            if ( strcmp( name, cpuLevelNames[i] ) == 0 )
+            {
+                return (CpuLevel)i;
+            }
+        }
+    }
+
+    return CpuLevelCount;
+}
+
+NOVA_EXPORT const char* GetCpuLevelName( CpuLevel level )
+{
+    return ((level >= CpuLevelScalar) && (level < CpuLevelCount)) ?
+        cpuLevelNames[level] : "unknown";
+}
+
+}; // namespace
@@ -0,0 +1,502 @@
+/*
+ *  $Id$
+ *
+ *  Nova 3D Engine - A portable object oriented, scene graph based, 
+ *  lightweight real-time 3D software rendering framework. 
+ *  Copyright (C) 2001-2009 Matti Dahlbom
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Contact: Matti Dahlbom <matti at 777-team dot org>
+ */
+
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "JobSystem.h"
+#include "NovaErrors.h"
+
+namespace nova3d {
+
+// capacity of each thread's job queue; must be a power of 2
+const int JobQueueSize = 256;
+
+// a thread's job queue. The owner thread pushes and pops at the bottom, 
+// other threads steal from the top.
+struct JobQueue
+{
+    pthread_mutex_t m_lock;
+    Job* m_jobs[JobQueueSize];
+    int m_top;
+    int m_bottom;
+};
+
+// arguments of a worker thread
+struct WorkerStart
+{
+    JobSystem* m_system;
+    int m_index;
+};
+
+struct JobSystemData
+{
+    JobQueue m_queues[JobSystemMaxThreads];
+    pthread_t m_threads[JobSystemMaxThreads];
+    WorkerStart m_starts[JobSystemMaxThreads];
+
+    // thread indices pointed to by the thread specific key
+    int m_threadIndices[JobSystemMaxThreads];
+    pthread_key_t m_threadKey;
+
+    // idle workers wait on the condition while no jobs are queued
+    pthread_mutex_t m_sleepLock;
+    pthread_cond_t m_wakeUp;
+    volatile int_32 m_numQueued;
+    volatile int_32 m_numSleeping;
+    volatile int_32 m_stopping;
+
+    JobSystem* m_system;
+
+    // entry point of the worker threads
+    static void* WorkerMain( void* arg );
+};
+
+// job running the chunks of a parallel loop
+class ParallelForJob : public Job
+{
+ public:
+    void Run()
+    {
+        for ( ;; ) 
+        {
+            int chunk = __sync_fetch_and_add( m_nextChunk, 1 );
+            int begin = m_begin + chunk * m_grainSize;
+            if ( (chunk >= m_numChunks) || (begin >= m_end) )
+            {
+                return;
+            }
+            int end = begin + m_grainSize;
+            m_body->Execute( begin, (end < m_end) ? end : m_end );
+        }
+    }
+
+ public:
+    ParallelForBody* m_body;
+    volatile int_32* m_nextChunk;
+    int m_numChunks;
+    int m_begin;
+    int m_end;
+    int m_grainSize;
+};
+
+// reads a counter updated by other threads
+inline int_32 AtomicRead( volatile int_32* value )
+{
+    return __sync_fetch_and_add( value, 0 );
+}
+
+// returns the index of the calling thread's queue; threads outside the 
+// pool share the queue of the thread that started it
+static int CurrentThreadIndex( JobSystemData* data )
+{
+    int* index = (int*)pthread_getspecific( data->m_threadKey );
+    return (index != NULL) ? *index : 0;
+}
+
+// takes a job from the bottom of the own queue or from the top of another 
+// thread's queue
+static Job* TakeJob( JobSystemData* data, int numThreads, int threadIndex )
+{
+    if ( AtomicRead( &data->m_numQueued ) == 0 ) 
+    {
+        return NULL;
+    }
+
+    for ( int i = 0; i < numThreads; i++ )
+    {
+        int index = (threadIndex + i) % numThreads;
+        JobQueue& queue = data->m_queues[index];
+        Job* job = NULL;
+
+        pthread_mutex_lock( &queue.m_lock );
+        if ( queue.m_bottom != queue.m_top )
+        {
+            if ( i == 0 )
+            {
+                queue.m_bottom--;
+                job = queue.m_jobs[queue.m_bottom & (JobQueueSize - 1)];
+            }
+            else
+            {
+                job = queue.m_jobs[queue.m_top & (JobQueueSize - 1)];
+                queue.m_top++;
+            }
+        }
+        if ( job != NULL )
+        {
+            __sync_fetch_and_sub( &data->m_numQueued, 1 );
+        }
+        pthread_mutex_unlock( &queue.m_lock );
+
+        if ( job != NULL )
+        {
+            return job;
+        }
+    }
+
+    return NULL;
+}
+
+void* JobSystemData::WorkerMain( void* arg )
+{
+    WorkerStart* start = (WorkerStart*)arg;
+    start->m_system->WorkerLoop( start->m_index );
+
+    return NULL;
+}
+
+NOVA_EXPORT Job::Job()
+    : m_pending( 1 ),
+      m_done( 0 ),
+      m_numDependents( 0 )
+{
+}
+
+NOVA_EXPORT Job::~Job()
+{
+}
+
+JobSystem::JobSystem()
+    : m_data( NULL ),
+      m_numThreads( 1 )
+{
+}
+
+JobSystem::~JobSystem()
+{
+    Stop();
+}
+
+NOVA_EXPORT JobSystem& JobSystem::Instance()
+{
+    static JobSystem instance;
+    return instance;
+}
+
+NOVA_EXPORT int JobSystem::Start( int numThreads, bool pinThreads )
+{
+    if ( m_data != NULL )
+    {
+        return NovaErrAlreadyInitialized;
+    }
+
+    int numProcessors = (int)sysconf( _SC_NPROCESSORS_ONLN );
+    if ( numProcessors < 1 )
+    {
+        numProcessors = 1;
+    }
+    if ( numThreads == JobSystemAutoThreads )
+    {
+        numThreads = numProcessors;
+    }
+    if ( (numThreads < 1) || (numThreads > JobSystemMaxThreads) )
+    {
+        return NovaErrInvalidArgument;
+    }
+    if ( numThreads == 1 )
+    {
+        // nothing to run in parallel
+        return NovaErrNone;
+    }
+
+    JobSystemData* data = (JobSystemData*)malloc( sizeof(JobSystemData) );
+    if ( data == NULL )
+    {
+        return NovaErrNoMemory;
+    }
+    if ( pthread_key_create( &data->m_threadKey, NULL ) != 0 )
+    {
+        free( data );
+        return NovaErrNoMemory;
+    }
+
+    for ( int i = 0; i < JobSystemMaxThreads; i++ )
+    {
+        pthread_mutex_init( &data->m_queues[i].m_lock, NULL );
+        data->m_queues[i].m_top = 0;
+        data->m_queues[i].m_bottom = 0;
+        data->m_threadIndices[i] = i;
+    }
+    pthread_mutex_init( &data->m_sleepLock, NULL );
+    pthread_cond_init( &data->m_wakeUp, NULL );
+    data->m_numQueued = 0;
+    data->m_numSleeping = 0;
+    data->m_stopping = 0;
+    data->m_system = this;
+
+    m_data = data;
+    m_numThreads = numThreads;
+    pthread_setspecific( data->m_threadKey, &data->m_threadIndices[0] );
+
+    // the calling thread is thread 0; start the rest
+    for ( int i = 1; i < numThreads; i++ )
+    {
+        data->m_starts[i].m_system = this;
+        data->m_starts[i].m_index = i;
+        if ( pthread_create( &data->m_threads[i], NULL, 
+                             JobSystemData::WorkerMain, 
+                             &data->m_starts[i] ) != 0 )
+        {
+            // run with the threads created so far
+            m_numThreads = i;
+            break;
+        }
+
+        if ( pinThreads )
+        {
+            cpu_set_t cpus;
+            CPU_ZERO( &cpus );
+            CPU_SET( i % numProcessors, &cpus );
+            pthread_setaffinity_np( data->m_threads[i], sizeof(cpus), &cpus );
+        }
+    }
+
+    if ( m_numThreads == 1 )
+    {
+        Stop();
+        return NovaErrNoMemory;
+    }
+
+    return NovaErrNone;
+}
+
+NOVA_EXPORT void JobSystem::Stop()
+{
+    JobSystemData* data = m_data;
+    if ( data == NULL )
+    {
+        return;
+    }
+
+    pthread_mutex_lock( &data->m_sleepLock );
+    data->m_stopping = 1;
+    pthread_cond_broadcast( &data->m_wakeUp );
+    pthread_mutex_unlock( &data->m_sleepLock );
+
+    for ( int i = 1; i < m_numThreads; i++ )
+    {
+        pthread_join( data->m_threads[i], NULL );
+    }
+
+    m_data = NULL;
+    m_numThreads = 1;
+
+    pthread_setspecific( data->m_threadKey, NULL );
+    pthread_key_delete( data->m_threadKey );
+    for ( int i = 0; i < JobSystemMaxThreads; i++ )
+    {
+        pthread_mutex_destroy( &data->m_queues[i].m_lock );
+    }
+    pthread_mutex_destroy( &data->m_sleepLock );
+    pthread_cond_destroy( &data->m_wakeUp );
+    free( data );
+}
+
+NOVA_EXPORT int JobSystem::AddDependency( Job& job, Job& dependency )
+{
+    if ( dependency.m_numDependents >= JobMaxDependents )
+    {
+        return NovaErrOverflow;
+    }
+
+    dependency.m_dependents[dependency.m_numDependents++] = &job;
+    job.m_pending++;
+
+    return NovaErrNone;
+}
+
+NOVA_EXPORT void JobSystem::Submit( Job& job )
+{
+    job.m_done = 0;
+
+    // the job is queued by whoever drops the pending count to zero: 
+    // either this submission or the last dependency to finish
+    if ( __sync_sub_and_fetch( &job.m_pending, 1 ) == 0 )
+    {
+        Enqueue( job );
+    }
+}
+
+NOVA_EXPORT void JobSystem::Wait( Job& job )
+{
+    JobSystemData* data = m_data;
+    if ( data == NULL )
+    {
+        return;
+    }
+
+    int threadIndex = CurrentThreadIndex( data );
+    while ( AtomicRead( &job.m_done ) == 0 )
+    {
+        Job* other = TakeJob( data, m_numThreads, threadIndex );
+        if ( other != NULL )
+        {
+            Execute( *other );
+        }
+        else
+        {
+            sched_yield();
+        }
+    }
+}
+
+NOVA_EXPORT void JobSystem::ParallelFor( int begin, int end, int grainSize, 
+                                         ParallelForBody& body )
+{
+    if ( grainSize < 1 )
+    {
+        grainSize = 1;
+    }
+    if ( begin >= end )
+    {
+        return;
+    }
+
+    int numChunks = (end - begin + grainSize - 1) / grainSize;
+    if ( (m_numThreads == 1) || (numChunks == 1) )
+    {
+        body.Execute( begin, end );
+        return;
+    }
+
+    // one job per thread; the jobs take chunks until the range is done
+    // so that uneven chunks balance out
+    int numJobs = (numChunks < m_numThreads) ? numChunks : m_numThreads;
+    volatile int_32 nextChunk = 0;
+    ParallelForJob jobs[JobSystemMaxThreads];
+
+    for ( int i = 0; i < numJobs; i++ )
+    {
+        jobs[i].m_body = &body;
+        jobs[i].m_nextChunk = &nextChunk;
+        jobs[i].m_numChunks = numChunks;
+        jobs[i].m_begin = begin;
+        jobs[i].m_end = end;
+        jobs[i].m_grainSize = grainSize;
+    }
+    for ( int i = 1; i < numJobs; i++ )
+    {
+        Submit( jobs[i] );
+    }
+
+    jobs[0].Run();
+
+    for ( int i = 1; i < numJobs; i++ )
+    {
+        Wait( jobs[i] );
+    }
+}
+
+void JobSystem::Execute( Job& job )
+{
+    job.Run();
+
+    // release the jobs waiting for this one
+    int numDependents = job.m_numDependents;
+    job.m_numDependents = 0;
+    for ( int i = 0; i < numDependents; i++ )
+    {
+        Job* dependent = job.m_dependents[i];
+        if ( __sync_sub_and_fetch( &dependent->m_pending, 1 ) == 0 )
+        {
+            Enqueue( *dependent );
+        }
+    }
+
+    // ready for submitting again; the job may be released by its waiter 
+    // as soon as it is marked done
+    job.m_pending = 1;
+    __sync_fetch_and_add( &job.m_done, 1 );
+}
+
+void JobSystem::Enqueue( Job& job )
+{
+    JobSystemData* data = m_data;
+    if ( data == NULL )
+    {
+        Execute( job );
+        return;
+    }
+
+    JobQueue& queue = data->m_queues[CurrentThreadIndex( data )];
+    bool queued = false;
+
+    pthread_mutex_lock( &queue.m_lock );
+    if ( (queue.m_bottom - queue.m_top) < JobQueueSize )
+    {
+        queue.m_jobs[queue.m_bottom & (JobQueueSize - 1)] = &job;
+        queue.m_bottom++;
+        __sync_fetch_and_add( &data->m_numQueued, 1 );
+        queued = true;
+    }
+    pthread_mutex_unlock( &queue.m_lock );
+
+    if ( !queued )
+    {
+        // the queue is full; run the job right away
+        Execute( job );
+        return;
+    }
+
+    if ( AtomicRead( &data->m_numSleeping ) > 0 )
+    {
+        pthread_mutex_lock( &data->m_sleepLock );
+        pthread_cond_signal( &data->m_wakeUp );
+        pthread_mutex_unlock( &data->m_sleepLock );
+    }
+}
+
+void JobSystem::WorkerLoop( int threadIndex )
+{
+    JobSystemData* data = m_data;
+    pthread_setspecific( data->m_threadKey, 
+                         &data->m_threadIndices[threadIndex] );
+
+    while ( data->m_stopping == 0 )
+    {
+        Job* job = TakeJob( data, m_numThreads, threadIndex );
+        if ( job != NULL )
+        {
+            Execute( *job );
+            continue;
+        }
+
+        // nothing to do; sleep until a job is queued
+        pthread_mutex_lock( &data->m_sleepLock );
+        __sync_fetch_and_add( &data->m_numSleeping, 1 );
+        while ( (AtomicRead( &data->m_numQueued ) == 0) && 
+                (data->m_stopping == 0) )
+        {
+            pthread_cond_wait( &data->m_wakeUp, &data->m_sleepLock );
+        }
+        __sync_fetch_and_sub( &data->m_numSleeping, 1 );
+        pthread_mutex_unlock( &data->m_sleepLock );
+    }
+}
+
+}; // namespace
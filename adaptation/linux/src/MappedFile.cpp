@@ -0,0 +1,91 @@
+/*
+ *  $Id$
+ *
+ *  Nova 3D Engine - A portable object oriented, scene graph based, 
+ *  lightweight real-time 3D software rendering framework. 
+ *  Copyright (C) 2001-2009 Matti Dahlbom
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Contact: Matti Dahlbom <matti at 777-team dot org>
+ */
+
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "MappedFile.h"
+#include "NovaErrors.h"
+
+namespace nova3d {
+
+NOVA_EXPORT MappedFile::MappedFile()
+    : m_data( NULL ),
+      m_size( 0 )
+{
+}
+
+NOVA_EXPORT MappedFile::~MappedFile()
+{
+    Close();
+}
+
+NOVA_EXPORT int MappedFile::Open( const char* fileName )
+{
+    if ( m_data != NULL )
+    {
+        return NovaErrAlreadyInitialized;
+    }
+
+    int fd = open( fileName, O_RDONLY );
+    if ( fd < 0 )
+    {
+        return NovaErrNotFound;
+    }
+
+    struct stat info;
+    if ( (fstat( fd, &info ) != 0) || (info.st_size <= 0) )
+    {
+        close( fd );
+        return NovaErrNotFound;
+    }
+
+    // the mapping stays valid after the descriptor is closed
+    void* data = mmap( NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if ( data == MAP_FAILED )
+    {
+        return NovaErrNoMemory;
+    }
+
+    m_data = (uint_8*)data;
+    m_size = (uint_32)info.st_size;
+
+    return NovaErrNone;
+}
+
+NOVA_EXPORT void MappedFile::Close()
+{
+    if ( m_data != NULL )
+    {
+        munmap( m_data, m_size );
+        m_data = NULL;
+        m_size = 0;
+    }
+}
+
+}; // namespace
@@ -0,0 +1,142 @@
+/*
+ *  $Id$
+ *
+ *  Nova 3D Engine - A portable object oriented, scene graph based, 
+ *  lightweight real-time 3D software rendering framework. 
+ *  Copyright (C) 2001-2009 Matti Dahlbom
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Contact: Matti Dahlbom <matti at 777-team dot org>
+ */
+
+
+#include "JobSystem.h"
+#include "NovaErrors.h"
+
+namespace nova3d {
+
+// Symbian applications are single threaded by design; the jobs are run 
+// in the submitting thread as soon as their dependencies have been run.
+
+NOVA_EXPORT Job::Job()
+    : m_pending( 1 ),
+      m_done( 0 ),
+      m_numDependents( 0 )
+    {
+    }
+
+NOVA_EXPORT Job::~Job()
+    {
+    }
+
+JobSystem::JobSystem()
+    : m_data( NULL ),
+      m_numThreads( 1 )
+    {
+    }
+
+JobSystem::~JobSystem()
+    {
+    }
+
+NOVA_EXPORT JobSystem& JobSystem::Instance()
+    {
+    static JobSystem instance;
+    return instance;
+    }
+
+NOVA_EXPORT int JobSystem::Start( int numThreads, bool /*pinThreads*/ )
+    {
+    if ( (numThreads < JobSystemAutoThreads) || 
+         (numThreads > JobSystemMaxThreads) )
+        {
+        return NovaErrInvalidArgument;
+        }
+
+    return NovaErrNone;
+    }
+
+NOVA_EXPORT void JobSystem::Stop()
+    {
+    }
+
+NOVA_EXPORT int JobSystem::AddDependency( Job& job, Job& dependency )
+    {
+    if ( dependency.m_numDependents >= JobMaxDependents )
+        {
+        return NovaErrOverflow;
+        }
+
+    dependency.m_dependents[dependency.m_numDependents++] = &job;
+    job.m_pending++;
+
+    return NovaErrNone;
+    }
+
+NOVA_EXPORT void JobSystem::Submit( Job& job )
+    {
+    job.m_done = 0;
+    if ( --job.m_pending == 0 )
+        {
+        Enqueue( job );
+        }
+    }
+
+NOVA_EXPORT void JobSystem::Wait( Job& /*job*/ )
+    {
+    // the job has been run already unless it waits for a dependency 
+    // that was never submitted
+    }
+
+NOVA_EXPORT void JobSystem::ParallelFor( int begin, int end, 
+                                         int /*grainSize*/, 
+                                         ParallelForBody& body )
+    {
+    if ( begin < end )
+        {
+        body.Execute( begin, end );
+        }
+    }
+
+void JobSystem::Execute( Job& job )
+    {
+    job.Run();
+
+    int numDependents = job.m_numDependents;
+    job.m_numDependents = 0;
+    job.m_pending = 1;
+    job.m_done = 1;
+
+    for ( int i = 0; i < numDependents; i++ )
+        {
+        Job* dependent = job.m_dependents[i];
+        if ( --dependent->m_pending == 0 )
+            {
+            Enqueue( *dependent );
+            }
+        }
+    }
+
+void JobSystem::Enqueue( Job& job )
+    {
+    Execute( job );
+    }
+
+void JobSystem::WorkerLoop( int /*threadIndex*/ )
+    {
+    }
+
+}; // namespace
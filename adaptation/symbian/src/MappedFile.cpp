@@ -0,0 +1,109 @@
+/*
+ *  $Id$
+ *
+ *  Nova 3D Engine - A portable object oriented, scene graph based, 
+ *  lightweight real-time 3D software rendering framework. 
+ *  Copyright (C) 2001-2009 Matti Dahlbom
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Contact: Matti Dahlbom <matti at 777-team dot org>
+ */
+
+#include <e32base.h>
+#include <f32file.h>
+
+#include "MappedFile.h"
+#include "NovaErrors.h"
+
+namespace nova3d {
+
+NOVA_EXPORT MappedFile::MappedFile()
+    : m_data( NULL ),
+      m_size( 0 )
+    {
+    }
+
+NOVA_EXPORT MappedFile::~MappedFile()
+    {
+    Close();
+    }
+
+// Symbian has no memory mapped files; the file is read into the heap
+NOVA_EXPORT int MappedFile::Open( const char* fileName )
+    {
+    if ( m_data != NULL )
+        {
+        return NovaErrAlreadyInitialized;
+        }
+
+    RFs fs;
+    if ( fs.Connect() != KErrNone )
+        {
+        return NovaErrNotFound;
+        }
+
+    TFileName name;
+    name.Copy( TPtrC8( (const TUint8*)fileName ) );
+
+    RFile file;
+    if ( file.Open( fs, name, EFileRead | EFileShareReadersOnly ) != KErrNone )
+        {
+        fs.Close();
+        return NovaErrNotFound;
+        }
+
+    TInt size = 0;
+    if ( (file.Size( size ) != KErrNone) || (size <= 0) )
+        {
+        file.Close();
+        fs.Close();
+        return NovaErrNotFound;
+        }
+
+    // heap cells are word aligned, which the data read from the file needs
+    m_data = (uint_8*)User::Alloc( size );
+    if ( m_data == NULL )
+        {
+        file.Close();
+        fs.Close();
+        return NovaErrNoMemory;
+        }
+
+    TPtr8 ptr( m_data, size );
+    TInt err = file.Read( ptr, size );
+    file.Close();
+    fs.Close();
+
+    if ( (err != KErrNone) || (ptr.Length() != size) )
+        {
+        User::Free( m_data );
+        m_data = NULL;
+        return NovaErrUnderrun;
+        }
+
+    m_size = (uint_32)size;
+
+    return NovaErrNone;
+    }
+
+NOVA_EXPORT void MappedFile::Close()
+    {
+    User::Free( m_data );
+    m_data = NULL;
+    m_size = 0;
+    }
+
+}; // namespace
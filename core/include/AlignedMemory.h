@@ -0,0 +1,79 @@
+/*
+ *  $Id$
+ *
+ *  Nova 3D Engine - A portable object oriented, scene graph based, 
+ *  lightweight real-time 3D software rendering framework. 
+ *  Copyright (C) 2001-2009 Matti Dahlbom
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Contact: Matti Dahlbom <matti at 777-team dot org>
+ */
+
+
+#ifndef __ALIGNEDMEMORY_H
+#define __ALIGNEDMEMORY_H
+
+#include <stddef.h>
+#include <stdlib.h>
+
+namespace nova3d {
+
+// size of a cache line; attribute arrays are aligned to this
+const size_t CacheLineSize = 64;
+
+/**
+ * Rounds the given size up to the next multiple of alignment, which 
+ * must be a power of two.<p />
+ */
+inline size_t AlignSize( size_t size, size_t alignment = CacheLineSize )
+{
+    return (size + alignment - 1) & ~(alignment - 1);
+}
+
+/**
+ * Allocates a block of memory aligned to the given power of two 
+ * alignment. The block must be released with AlignedFree().<p />
+ *
+ * @return pointer to the aligned block or NULL if out of memory
+ */
+inline void* AlignedMalloc( size_t size, size_t alignment = CacheLineSize )
+{
+    // over-allocate and store the original pointer just before the 
+    // aligned block
+    void* p = malloc( size + alignment + sizeof(void*) );
+    if ( p == NULL )
+    {
+	return NULL;
+    }
+
+    size_t address = AlignSize( (size_t)p + sizeof(void*), alignment );
+    ((void**)address)[-1] = p;
+
+    return (void*)address;
+}
+
+/** Releases a block allocated with AlignedMalloc(). NULL is allowed. */
+inline void AlignedFree( void* p )
+{
+    if ( p != NULL )
+    {
+	free( ((void**)p)[-1] );
+    }
+}
+
+}; // namespace
+
+#endif
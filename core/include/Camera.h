@@ -31,10 +31,12 @@
 
 #include "NovaTypes.h"
 #include "Display.h"
+#include "FrameArena.h"
 #include "Frustum.h"
 #include "Node.h"
 #include "VectorMath.h"
 #include "Lights.h"
+#include "OcclusionBuffer.h"
 #include "Renderer.h"
 
 namespace nova3d {
@@ -43,6 +45,7 @@ namespace nova3d {
 class CameraNode;
 class Shape;
 class ShapeNode;
+class ShapeGeometryBody;
 
 /**
  * Represents a 'camera' used for rendering. Each camera has a "canvas" 
@@ -77,6 +80,20 @@ class Camera
     /** Notifies the camera that the rendering canvas was updated. */
     NOVA_IMPORT void RenderingCanvasUpdated();
 
+    /**
+     * Selects how the camera rasterizes the polygons. The default, 
+     * Renderer::RasterizerScanline, walks the polygon edges; 
+     * Renderer::RasterizerHalfSpace tests blocks of pixels against the 
+     * edges. The two round the polygon edges differently, so switching 
+     * changes the pixels along the edges. On a single thread the 
+     * half-space rasterizer is slower; see examples/linux/RasterBench.
+     * <p />
+     */
+    NOVA_IMPORT void SetRasterizer( Renderer::Rasterizer rasterizer );
+
+    /** Returns the rasterizer used by the camera. */
+    inline Renderer::Rasterizer GetRasterizer() const;
+
     /** Sets the pointer to the node that contains this camera. */
     void SetNode( CameraNode* node );
         
@@ -85,7 +102,59 @@ class Camera
      * writes the location into the given vector.
      */
     bool GetLookAt( Vector& location );
+
+    /**
+     * Returns the arena holding the per-frame data of this camera. It can
+     * be used to query the memory used by the last frame and the high 
+     * water mark over all frames.<p />
+     */
+    inline const FrameArena& GetFrameArena() const;
+
+    /** 
+     * Returns the number of shapes skipped in the last frame for being 
+     * hidden behind occluders (see Shape::SetOccluder()).
+     */
+    inline int GetNumOccludedShapes() const;
         
+ private: // Types
+    /** A run of visible faces produced from one shape. */
+    struct VisibleFaceRun
+    {
+	ScreenPolygon* m_faces;
+	int m_count;
+	VisibleFaceRun* m_next;
+    };
+
+    /** A shape that is at least partly inside the view frustum. */
+    struct VisibleShape
+    {
+	ShapeNode* m_shapeNode;
+
+	// camera position in the object space of the shape
+	Vector m_cameraObjectSpacePos;
+
+	// object position and inverse rotation for lighting
+	Vector m_objectPos;
+	Matrix m_inverseObjectMatrix;
+
+	// the point lights reaching the shape and the directional lights in
+	// its object space and the scratch space for lighting it; allocated
+	// from the frame arena for illuminated shapes only
+	PointLightInstance* m_lights;
+	int m_numLights;
+	DirectionalLightInstance* m_directionalLights;
+	int m_numDirectionalLights;
+	int_32* m_lightingBuffer;
+    };
+
+    /** Which of the shape nodes ProcessShapeNodes() processes. */
+    enum ShapeNodeSelection
+    {
+	ShapeNodesAll,
+	ShapeNodesOccluders,
+	ShapeNodesOccludees
+    };
+
  private: // New methods
     /**
      * Finds the largest of three z values to be used for depth sorting
@@ -94,26 +163,74 @@ class Camera
     inline int_32 SelectZsortValue( int_32 z1, int_32 z2, int_32 z3 );
     
     /**
-     * Quicksorts visible faces to back-to-front order by their zsort_values.
-     *
-     * The sorted face list is pointed to by m_visibleFaces.
+     * Sorts the visible face keys in m_visibleFaceKeys to back-to-front 
+     * order with a radix sort. Only the keys are moved.
      */
-    void DepthSort( int_32 left, int_32 right );
+    int DepthSort();
         
     /**
      * Process a polygon list; clip each polygon and add visible 
      * polygon sections to the visible face list. Then perform perspective
      * projection for the visible polygons and apply backface culling.
+     * The visible faces are allocated from the frame arena.
      */
-    void ProcessPolygonList( Shape& shape );
+    int ProcessPolygonList( Shape& shape );
         
-    /** Processes a visual shape (object) node for rendering. */
-    void ProcessShapeNode( ShapeNode& shapeNode,
+    /** Indicates whether any of the shapes in the scene is an occluder. */
+    bool HasOccluders() const;
+
+    /**
+     * Prepares the selected shape nodes and processes the visible ones in
+     * batches with ProcessVisibleShapes().
+     */
+    int ProcessShapeNodes( ShapeNodeSelection selection, 
+			   Vector& cameraPos, 
+			   Matrix& inverseCameraMatrix,
+			   VisibleShape* visibleShapes );
+
+    /** 
+     * Transforms a visual shape (object) node by the scene graph and 
+     * tests it against the view frustum and the occlusion buffer. 
+     * Returns false if the shape is not visible.
+     */
+    bool PrepareShapeNode( ShapeNode& shapeNode,
 			   Vector& cameraPos, 
-			   Matrix& inverseCameraMatrix );
+			   Matrix& inverseCameraMatrix,
+			   VisibleShape& visibleShape );
+
+    /**
+     * Processes the prepared shapes for rendering. The backface removal,
+     * transformation and lighting of the shapes are run in parallel on 
+     * the job system; polygon processing is done in order.
+     */
+    int ProcessVisibleShapes( VisibleShape* visibleShapes, int count );
+
+    /** 
+     * Removes the back faces of a prepared shape, transforms it to 
+     * the camera space and lights it if it is illuminated.
+     */
+    void TransformVisibleShape( VisibleShape& visibleShape ) const;
+
+    /**
+     * Takes the world space positions of the point lights in the scene 
+     * into m_worldLights and the directions of the directional lights 
+     * into m_worldDirectionalLights for the frame.
+     */
+    int CaptureLights();
+
+    /**
+     * Collects the visible faces of all the runs into the sort key array
+     * m_visibleFaceKeys, allocated from the frame arena.
+     */
+    int BuildVisibleFaceKeys();
         
     /**
-     * Performs perspective projection for a clipped polygon.
+     * Performs perspective projection for a clipped polygon. The 
+     * polygon is added to the list of visible faces unless its screen 
+     * bounding box is completely outside the rendering canvas. Polygons 
+     * completely inside the canvas are flagged 
+     * <code>ScreenPolygonInsideCanvas</code> so that the renderer can 
+     * skip 2D clipping for them.<p />
      *
      * ##TODO## Do this better; this way each vertex gets projected 
      * multiple times. Use some kind of a cache?
@@ -121,7 +238,8 @@ class Camera
     void PerspectiveProject( ScreenPolygon& polygon, 
 			     int_32 x1, int_32 y1, int_32 z1,
 			     int_32 x2, int_32 y2, int_32 z2,
-			     int_32 x3, int_32 y3, int_32 z3 );
+			     int_32 x3, int_32 y3, int_32 z3,
+			     uint_32 polyFlags );
     
     /** Clips an edge against the near clip plane */
     void NearClipEdge( int& count, 
@@ -134,9 +252,12 @@ class Camera
 		       int valueBBuffer[], 
 		       int valueCBuffer[] );
 
-    /** Applies scene lighting to a shape. */
-    void ApplyLightingToShape( Shape& shape, Vector& objectPos, 
-			       Matrix& inverseObjectMatrix );
+    /** 
+     * Transforms the point lights reaching a prepared shape and the 
+     * directional lights to its object space and allocates the scratch 
+     * space for lighting it.
+     */
+    int PrepareShapeLighting( VisibleShape& visibleShape );
 
     /** Calculates environment mapping texture coefficients */
     void EnvironmentMapFace( Shape& shape, int polygonIndex, 
@@ -145,16 +266,6 @@ class Camera
 			     int_32& u1, int_32& v1,
 			     int_32& u2, int_32& v2 );
 
-    /**
-     * Makes sure there is enough space in the visible face buffer for 
-     * every possible visible polygon. This method is called by the 
-     * scene graph every time it is set live.<p />
-     *
-     * @param numPolygon number of polygons in all the shapes in the 
-     * whole scene graph
-     */
-    int CheckVisibleFaceBuffer( int numPolygons );
-
     /** Notifies the camera that the scene graph it belongs to was detached. */
     void SceneGraphDetached();
         
@@ -174,17 +285,24 @@ class Camera
     // pointer to the scene graph node that contains this camera
     CameraNode* m_cameraNode;    
 
-    // number of allocated instances in the visible face buffer
-    int m_maxVisibleFaces;
+    // holds all the data produced while rendering a frame; reset at the
+    // start of every Render()
+    FrameArena m_frameArena;
 
     // number of visible faces in use
     int m_numVisibleFaces;
 
-    // the visible face buffer
-    ScreenPolygon* m_visibleFaceBuffer;
+    // runs of visible faces, one per processed shape, in processing order.
+    // allocated from the frame arena
+    VisibleFaceRun* m_firstFaceRun;
+    VisibleFaceRun* m_lastFaceRun;
 
-    // list of visible faces in use. this is needed for faster sorting!
-    ScreenPolygon** m_visibleFaceList;
+    // the next free face in the run of the shape being processed
+    ScreenPolygon* m_nextFace;
+
+    // depth sort keys of the visible faces; only these are moved while 
+    // sorting. allocated from the frame arena
+    ScreenPolygonKey* m_visibleFaceKeys;
 
     // FOV (field-of-vision) value
     real_64 m_fov;
@@ -196,6 +314,14 @@ class Camera
     // the view frustum (used for 3D clipping)
     Frustum m_frustum;
 
+    // depths of the occluders of the frame and whether the shapes are 
+    // tested against them
+    OcclusionBuffer m_occlusionBuffer;
+    bool m_isOcclusionCulling;
+
+    // number of shapes found hidden by the occluders in the last frame
+    int m_numOccludedShapes;
+
     // look-at point
     Vector m_lookAtTarget;
     bool m_isLookingAt;
@@ -217,15 +343,38 @@ class Camera
     // pointer to the list of light nodes in the current live scene graph.
     // Not owned!
     const List<LightNode*>* m_lightNodeList;
+
+    // the point lights of the scene in world space, taken at the start of
+    // the frame. allocated from the frame arena
+    PointLightInstance* m_worldLights;
+    int m_numWorldLights;
+    DirectionalLightInstance* m_worldDirectionalLights;
+    int m_numWorldDirectionalLights;
         
     // friend declarations
     friend class RootNode;
+    friend class ShapeGeometryBody;
 };
 
 /////////////////////////////////////////
 // inline method definitions
 /////////////////////////////////////////
 
+const FrameArena& Camera::GetFrameArena() const
+{
+    return m_frameArena;
+}
+
+int Camera::GetNumOccludedShapes() const
+{
+    return m_numOccludedShapes;
+}
+
+Renderer::Rasterizer Camera::GetRasterizer() const
+{
+    return m_renderer.GetRasterizer();
+}
+
 int_32 Camera::SelectZsortValue( int_32 z1, int_32 z2, int_32 z3 )
 {
     // this code selects the largest z
@@ -112,6 +112,10 @@ struct ScreenVertex
     };
 };
 
+// screen polygon flag set by the camera when the polygon lies entirely 
+// inside the rendering canvas and thus can be drawn without 2D clipping
+const uint_16 ScreenPolygonInsideCanvas = 0x8000;
+
 /**
  * Represents a transformed, projected and clipped, visible 
  * triangular polygon face.
@@ -121,15 +125,31 @@ struct ScreenPolygon
     ScreenVertex m_v1;
     ScreenVertex m_v2;
     ScreenVertex m_v3;
-    int_32 m_zSortValue;
 
     // these are copied directly from the Shape.
     Texture* m_texture; 
 
     // these are copied directly from the Shape. the constants are
-    // defined in Shape.h
-    uint_32 m_polygonFlags; 
-    
+    // defined in Shape.h and all fit in 16 bits. the camera adds 
+    // ScreenPolygonInsideCanvas
+    uint_16 m_polygonFlags; 
+
+    // mip level of m_texture used to render the polygon
+    uint_16 m_mipLevel;
+};
+
+/**
+ * Depth sorting entry for a visible polygon. The entries are kept in an 
+ * array of their own, apart from the polygons, so that sorting only moves
+ * these small entries around.
+ */
+struct ScreenPolygonKey
+{
+    // the polygon's largest z, inverted so that sorting the keys to 
+    // ascending order gives the back-to-front drawing order
+    uint_32 m_depthKey;
+
+    ScreenPolygon* m_polygon;
 };
 
 // util macros to pack three 8-bit color components (r,g,b) into 
@@ -180,6 +200,47 @@ NOVA_IMPORT void ScaleColor( NovaPixelFormat pixelFormat,
 			     int_32& red, int_32& green, int_32& blue, 
 			     int_32 scaler );
 
+// maximum intensity for ModulateColor(); 1.0
+const uint_32 MaxModulateIntensity = 256;
+
+/**
+ * The component masks of a pixel format for ModulateColor(). The red 
+ * component is moved up by m_redShift bits next to the blue one, so that
+ * both products fit in one multiplication with 8 spare bits above each.
+ */
+struct ModulateMasks
+{
+    uint_32 m_redMask;
+    uint_32 m_greenMask;
+    uint_32 m_blueMask;
+    uint_32 m_redShift;
+};
+
+/**
+ * Returns the masks used by ModulateColor() for the given pixel format.
+ */
+NOVA_IMPORT void GetModulateMasks( NovaPixelFormat pixelFormat, 
+				   ModulateMasks& masks );
+
+/**
+ * Multiplies all the components of a packed color by an intensity of 
+ * 0..MaxModulateIntensity using two multiplications. The masks are 
+ * obtained with GetModulateMasks().<p />
+ */
+inline uint_32 ModulateColor( uint_32 color, uint_32 intensity, 
+			      const ModulateMasks& masks )
+{
+    uint_32 red_mask = masks.m_redMask << masks.m_redShift;
+    uint_32 red_blue = ((color & masks.m_redMask) << masks.m_redShift) | 
+	(color & masks.m_blueMask);
+    red_blue = ((red_blue * intensity) >> 8) & (red_mask | masks.m_blueMask);
+    uint_32 green = 
+	(((color & masks.m_greenMask) * intensity) >> 8) & masks.m_greenMask;
+
+    return ((red_blue & red_mask) >> masks.m_redShift) | 
+	(red_blue & masks.m_blueMask) | green;
+}
+
 }; // namespace
 
 #endif
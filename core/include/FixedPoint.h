@@ -55,6 +55,7 @@ inline void Swap32( int_32& a, int_32& b )
 }
 
 #define MAX(a,b) ((a)>(b)?(a):(b))
+#define MIN(a,b) ((a)<(b)?(a):(b))
 #ifndef M_PI
 #define M_PI       3.14159265358979323846
 #endif
@@ -0,0 +1,166 @@
+/*
+ *  $Id$
+ *
+ *  Nova 3D Engine - A portable object oriented, scene graph based, 
+ *  lightweight real-time 3D software rendering framework. 
+ *  Copyright (C) 2001-2009 Matti Dahlbom
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Contact: Matti Dahlbom <matti at 777-team dot org>
+ */
+
+
+#ifndef __FRAMEARENA_H
+#define __FRAMEARENA_H
+
+#include <stddef.h>
+
+#include "NovaTypes.h"
+
+namespace nova3d {
+
+// default size of the first arena block in bytes
+const size_t FrameArenaDefaultSize = 64 * 1024;
+
+// alignment of every allocation in bytes
+const size_t FrameArenaAlignment = 8;
+
+/**
+ * A bump allocator for data that lives for a single rendered frame.<p />
+ *
+ * Allocations are carved sequentially out of large blocks and are never 
+ * freed individually; Reset() releases everything at once at the start
+ * of the next frame. When a frame does not fit in the current block a new
+ * block is chained in, and on the following Reset() the blocks are merged
+ * into one that is large enough for the biggest frame so far. The memory
+ * used therefore follows the amount of data actually produced per frame.<p />
+ *
+ * @author Matti Dahlbom
+ * @version $Revision$
+ */
+class FrameArena 
+{
+ public: // Constructors and destructor
+    NOVA_IMPORT FrameArena( size_t initialSize = FrameArenaDefaultSize );
+    NOVA_IMPORT ~FrameArena();
+
+ public: // New methods
+    /**
+     * Allocates <code>size</code> bytes, aligned to FrameArenaAlignment.
+     * The memory is valid until the next Reset().<p />
+     *
+     * @return pointer to the memory or NULL if out of memory
+     */
+    NOVA_IMPORT void* Allocate( size_t size );
+
+    /**
+     * Allocates an uninitialized array of <code>count</code> elements.<p />
+     */
+    template <class T> inline T* AllocateArray( int count );
+
+    /**
+     * Gives back the unused tail of the most recent allocation so that
+     * the next allocation continues from <code>end</code>. Does nothing if 
+     * <code>end</code> does not point inside the current block.<p />
+     */
+    NOVA_IMPORT void Trim( const void* end );
+
+    /**
+     * Releases all the allocations. Blocks chained in during the previous
+     * frame are merged into a single block.<p />
+     */
+    NOVA_IMPORT void Reset();
+
+    /** Returns the number of bytes allocated since the last Reset(). */
+    inline size_t GetUsed() const;
+
+    /** Returns the largest number of bytes ever in use at once. */
+    inline size_t GetHighWaterMark() const;
+
+    /** Returns the number of bytes currently reserved from the heap. */
+    inline size_t GetCapacity() const;
+
+ private: // Types
+    struct Block
+    {
+	Block* m_next;
+	size_t m_size;
+	size_t m_used;
+    };
+
+ private: // New methods
+    /** Returns the size of the block header, padded for alignment. */
+    inline static size_t HeaderSize();
+
+    /** Returns the first usable byte of the given block. */
+    inline static uint_8* BlockData( Block* block );
+
+    /** Allocates a new block with room for at least size bytes. */
+    Block* NewBlock( size_t size );
+
+    /** Frees all the blocks. */
+    void FreeBlocks();
+
+ private: // Data
+    // the block currently allocated from; older blocks follow m_next
+    Block* m_block;
+
+    // bytes allocated in the previous blocks of this frame
+    size_t m_previousUsed;
+
+    size_t m_capacity;
+    size_t m_highWaterMark;
+    size_t m_initialSize;
+};
+
+/////////////////////////////////////////
+// inline method definitions
+/////////////////////////////////////////
+
+template <class T> T* FrameArena::AllocateArray( int count )
+{
+    return (T*)Allocate( count * sizeof(T) );
+}
+
+size_t FrameArena::GetUsed() const
+{
+    return m_previousUsed + ((m_block != NULL) ? m_block->m_used : 0);
+}
+
+size_t FrameArena::GetHighWaterMark() const
+{
+    return m_highWaterMark;
+}
+
+size_t FrameArena::GetCapacity() const
+{
+    return m_capacity;
+}
+
+size_t FrameArena::HeaderSize()
+{
+    return (sizeof(Block) + FrameArenaAlignment - 1) & 
+	~(FrameArenaAlignment - 1);
+}
+
+uint_8* FrameArena::BlockData( Block* block )
+{
+    return (uint_8*)block + HeaderSize();
+}
+
+}; // namespace
+
+#endif
@@ -74,6 +74,12 @@ class Frustum
      */
     int_32 EvaluateClipping( const BoundingSphere& aBoundingSphere );
 
+    /**
+     * Evaluates the clipping planes for the given axis aligned bounding 
+     * box like <code>EvaluateClipping()</code> does for bounding spheres.
+     */
+    int_32 EvaluateClipping( const BoundingBox& boundingBox );
+
     /**
      * Clips a polygon defined by the given 3 vertices. Texture 
      * coordinates and lighting intensities are clipped as well.
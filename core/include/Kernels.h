@@ -0,0 +1,259 @@
+/*
+ *  $Id$
+ *
+ *  Nova 3D Engine - A portable object oriented, scene graph based, 
+ *  lightweight real-time 3D software rendering framework. 
+ *  Copyright (C) 2001-2009 Matti Dahlbom
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Contact: Matti Dahlbom <matti at 777-team dot org>
+ */
+
+
+#ifndef __KERNELS_H
+#define __KERNELS_H
+
+// FILE INFO
+// This file declares the inner loop kernels that have implementations
+// for several instruction set levels, and the table through which the 
+// implementation chosen at startup is called.
+
+#include "NovaTypes.h"
+#include "CpuFeatures.h"
+#include "VectorMath.h"
+#include "Shape.h"
+
+namespace nova3d {
+
+/**
+ * Transforms the vectors for which the corresponding vertex info has 
+ * VertexInfoVisible set with the given matrix; the other destination 
+ * vectors are left untouched. If vertexInfos is NULL all the vectors are
+ * transformed. With translate set to false only the rotational part of
+ * the matrix is applied.
+ */
+typedef void (*TransformVectorsFunc)( const Matrix& matrix, 
+				      const Vector* src, Vector* dst, 
+				      const uint_32* vertexInfos, int count,
+				      bool translate );
+
+/**
+ * Fills a span of 888 pixels interpolating the fixed point color 
+ * components by the given slopes.
+ */
+typedef void (*GouraudSpan888Func)( uint_32* dst, int count,
+				    int_32 red, int_32 green, int_32 blue,
+				    int_32 redSlope, int_32 greenSlope, 
+				    int_32 blueSlope );
+
+/**
+ * Calculates the diffuse intensity of a point light at the given 
+ * (vertex, normal) pairs, without attenuation. The intensity is the 
+ * cosine of the angle between the normal and the direction to the 
+ * light, clamped to 0, and the distance to the light is returned for 
+ * attenuating it. Vertices at the light receive no light.
+ */
+typedef void (*PointLightFunc)( const Vector& lightPos, 
+				const Vector* coords, const Vector* normals,
+				const uint_32* vertexIndices, 
+				const uint_32* normalIndices, int count,
+				int_32* intensities, int_32* distances );
+
+/**
+ * Calculates the diffuse intensity of a directional light for the given
+ * normals as the dot product of the normal and the direction towards 
+ * the light, clamped to 0.
+ */
+typedef void (*DirectionalLightFunc)( const Vector& towardsLight, 
+				      const Vector* normals,
+				      const uint_32* normalIndices, 
+				      int count, int_32* intensities );
+
+/**
+ * Screen space data of a batch of textured triangles for the triangle 
+ * setup, in structure of arrays layout. The vertices of each triangle are
+ * ordered by their y coordinates as by SelectVertexOrder().
+ */
+struct TriangleSetupBatch
+{
+    static const int MaxTriangles = 64;
+
+    // input vertex values, indexed by [vertex][triangle]. the setup 
+    // replaces z, u and v with the perspective correct 1/z, u/z and v/z 
+    // as by CalculateInverses(); z must be at least 1.0
+    int_32 m_x[3][MaxTriangles];
+    int_32 m_y[3][MaxTriangles];
+    int_32 m_z[3][MaxTriangles];
+    int_32 m_u[3][MaxTriangles];
+    int_32 m_v[3][MaxTriangles];
+    int_32 m_intensity[3][MaxTriangles];
+
+    // input mip level of each triangle
+    int_32 m_mipLevel[MaxTriangles];
+
+    // output gradients along the scanline, as by 
+    // CalculatePolygonGradients() for the perspective correct values
+    int_32 m_dudx[MaxTriangles];
+    int_32 m_dvdx[MaxTriangles];
+    int_32 m_dzdx[MaxTriangles];
+    int_32 m_didx[MaxTriangles];
+
+    // output MaxUint32 / height of the edges v1-v3, v1-v2 and v2-v3, 
+    // indexed by [edge][triangle]; 0 for edges with no height
+    int_32 m_inverseHeights[3][MaxTriangles];
+};
+
+/**
+ * Calculates the perspective correct vertex values, the gradients and the
+ * inverse edge heights of the triangles [begin, end) in the batch. All 
+ * the levels produce identical results.
+ */
+typedef void (*TriangleSetupFunc)( TriangleSetupBatch& batch, 
+				   int begin, int end );
+
+/** Width and height of the pixel blocks of the half-space rasterizer. */
+const int HalfSpaceBlockSize = 8;
+
+/**
+ * Tests the pixels of a HalfSpaceBlockSize square block against the 
+ * three edge functions of a triangle. The edge values are given at the 
+ * top left pixel of the block together with their steps per pixel in x 
+ * and y; a pixel is covered when all three values are at least 0. 
+ * Writes the covered pixels of each row of the block as a bit mask, the 
+ * leftmost pixel in the lowest bit.
+ */
+typedef void (*BlockCoverageFunc)( const int_32* edgeValues, 
+				   const int_32* edgeStepsX, 
+				   const int_32* edgeStepsY, 
+				   uint_8* rowMasks );
+
+/** The kernels of one instruction set level. */
+struct KernelTable
+{
+    CpuLevel m_level;
+    TransformVectorsFunc m_transformVectors;
+    GouraudSpan888Func m_gouraudSpan888;
+    PointLightFunc m_pointLight;
+    DirectionalLightFunc m_directionalLight;
+    TriangleSetupFunc m_triangleSetup;
+    BlockCoverageFunc m_blockCoverage;
+};
+
+/**
+ * Returns the kernels to use. The kernels are selected once when the 
+ * library is loaded: the highest level supported by the processor, or 
+ * the level requested with GetRequestedCpuLevel() if it is lower.<p />
+ */
+NOVA_IMPORT const KernelTable& GetKernels();
+
+/**
+ * Switches to the kernels of the given level, for example for 
+ * benchmarking. Must not be called while the job system is running work
+ * that uses the kernels.<p />
+ *
+ * @return NovaErrNone, or NovaErrNotFound if the level is not supported
+ *         by the processor or the build
+ */
+NOVA_IMPORT int SelectKernels( CpuLevel level );
+
+// the portable kernels; the other levels use them for the elements left 
+// over from their vector width
+void TransformVectorsScalar( const Matrix& matrix, 
+			     const Vector* src, Vector* dst, 
+			     const uint_32* vertexInfos, int count,
+			     bool translate );
+void GouraudSpan888Scalar( uint_32* dst, int count,
+			   int_32 red, int_32 green, int_32 blue,
+			   int_32 redSlope, int_32 greenSlope, 
+			   int_32 blueSlope );
+void PointLightScalar( const Vector& lightPos, 
+		       const Vector* coords, const Vector* normals,
+		       const uint_32* vertexIndices, 
+		       const uint_32* normalIndices, int count,
+		       int_32* intensities, int_32* distances );
+void DirectionalLightScalar( const Vector& towardsLight, 
+			     const Vector* normals,
+			     const uint_32* normalIndices, 
+			     int count, int_32* intensities );
+void TriangleSetupScalar( TriangleSetupBatch& batch, int begin, int end );
+void BlockCoverageScalar( const int_32* edgeValues, 
+			  const int_32* edgeStepsX, 
+			  const int_32* edgeStepsY, 
+			  uint_8* rowMasks );
+
+/**
+ * Indicates whether any of the given vertex infos has VertexInfoVisible
+ * set, or vertexInfos is NULL. The vector kernels skip the blocks with 
+ * no visible vectors.
+ */
+inline bool AnyVisible( const uint_32* vertexInfos, int count );
+
+/**
+ * Stores vectors held in separate x, y and z arrays to the packed 
+ * destination, skipping those that are not visible.
+ */
+inline void StoreVisibleVectors( Vector* dst, const int_32* x, 
+				 const int_32* y, const int_32* z, 
+				 const uint_32* vertexInfos, int count );
+
+// fill the table with the kernels of each level; return false if the level 
+// was not built in
+bool GetScalarKernels( KernelTable& table );
+bool GetSse2Kernels( KernelTable& table );
+bool GetSse41Kernels( KernelTable& table );
+bool GetAvx2Kernels( KernelTable& table );
+bool GetAvx512Kernels( KernelTable& table );
+
+/////////////////////////////////////////
+// inline function definitions
+/////////////////////////////////////////
+
+bool AnyVisible( const uint_32* vertexInfos, int count )
+{
+    if ( vertexInfos == NULL )
+    {
+	return true;
+    }
+
+    uint_32 infos = 0;
+    for ( int i = 0; i < count; i++ )
+    {
+	infos |= vertexInfos[i];
+    }
+
+    return ((infos & VertexInfoVisible) != 0);
+}
+
+void StoreVisibleVectors( Vector* dst, const int_32* x, const int_32* y, 
+			  const int_32* z, const uint_32* vertexInfos, 
+			  int count )
+{
+    int_32* d = (int_32*)dst;
+    for ( int i = 0; i < count; i++, d += 3 )
+    {
+	if ( (vertexInfos == NULL) || 
+	     ((vertexInfos[i] & VertexInfoVisible) != 0) )
+	{
+	    d[0] = x[i];
+	    d[1] = y[i];
+	    d[2] = z[i];
+	}
+    }
+}
+
+}; // namespace
+
+#endif
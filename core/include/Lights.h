@@ -34,6 +34,18 @@
 
 namespace nova3d {
 
+/** Number of steps in a point light's attenuation table. */
+const int PointLightTableSize = 1024;
+
+/** 
+ * Attenuation below which a point light is considered to have no effect;
+ * this is one step of an 8 bit color component. 
+ */
+const real_64 PointLightCutoff = 1.0 / 256.0;
+
+/** Radius of a point light whose effect does not end at any distance. */
+const int_32 PointLightUnbounded = 0x7fffffff;
+
 // forward declarations
 //class LightNode;
 
@@ -49,7 +61,8 @@ class Light
     enum Type
     {
 	TypeAmbient, 
-	TypePoint
+	TypePoint,
+	TypeDirectional
     };
 
  public: // Constructors and destructor
@@ -124,6 +137,10 @@ class PointLight : public Light
      *
      * All the arguments must greater than or equal to zero. 
      * The default values are 0.0, 0.0, 1.0, respectively.<p />
+     *
+     * The attenuation is clamped to 1.0 and it is taken to be zero beyond 
+     * the distance where it drops below PointLightCutoff, see 
+     * GetRadius().<p />
      */
     NOVA_IMPORT int SetAttenuation( real_64 att0, real_64 att1, 
 				    real_64 att2 );
@@ -140,34 +157,147 @@ class PointLight : public Light
     inline bool IsAttenuated() const; 
 
     /**
-     * Calculates the light intensity as the function of the distance.<P>
+     * Returns a number that changes whenever the attenuation settings of
+     * the light change. Used to tell whether lighting calculated earlier
+     * is still valid.
+     */
+    inline uint_32 GetVersion() const;
+
+    /**
+     * Calculates the light intensity as the function of the distance.
+     * The attenuation is interpolated from a table calculated in 
+     * SetAttenuation().<P>
      *
      * @param distance as fixed point
      * @return attenuation factor as fixed point
      */
     inline int_32 CalculateAttenuationFactor( int_32 distance ) const;
 
-    /** Returns the position of the light source */
-    inline Vector& GetPosition();
+    /**
+     * Returns the distance beyond which the attenuated light has no 
+     * effect, as fixed point. PointLightUnbounded if the light reaches 
+     * farther than can be represented.
+     */
+    inline int_32 GetRadius() const;
+
+    /**
+     * Checks whether the light reaches the given bounding sphere. Lights 
+     * that are not attenuated reach everything.<p />
+     *
+     * @param lightPosition the light position in the coordinate system 
+     *        of the sphere
+     * @param sphere the bounding sphere; a negative radius means unknown
+     */
+    NOVA_IMPORT bool Reaches( const Vector& lightPosition, 
+			      const BoundingSphere& sphere ) const;
+
+    /** 
+     * Returns the position of the light source relative to the light 
+     * node holding it.
+     */
+    inline const Vector& GetPosition() const;
         
-    /** Sets the position of this point light */
+    /** 
+     * Sets the position of this point light relative to the light node 
+     * holding it. The default is the origin of the node.
+     */
     inline void SetPosition( const Vector& position );
         
+ private: // New methods
+    void UpdateAttenuationTable();
+
  private: // Data
     // whether this light is attenuated
     bool m_isAttenuated;
 
+    // incremented when the attenuation settings change
+    uint_32 m_version;
+
     // attenuation coefficients as fixed point values
     int_32 m_att0;
     int_32 m_att1;
     int_32 m_att2;
 
-    // light position in the coordinate system it was last transformed to.
-    // the position is extracted from the light node's light matrix every
-    // time it gets transformed
+    // distance where the attenuation drops below PointLightCutoff
+    int_32 m_radius;
+
+    // table steps per unit of distance as fixed point
+    int_32 m_tableScale;
+
+    // attenuation at evenly spaced distances from 0 to m_radius
+    int_32 m_attenuationTable[PointLightTableSize + 1];
+
+    // light position relative to its light node. the renderer never 
+    // modifies the light; it works on PointLightInstances instead
+    Vector m_position;
+};
+
+/**
+ * A point light with its position in a given coordinate system, such as 
+ * world space or the object space of a shape. The renderer takes these 
+ * once per frame so that the shared lights are only read while 
+ * rendering.<p />
+ */
+struct PointLightInstance
+{
+    /** The light */
+    const PointLight* m_light;
+
+    /** Position of the light in the coordinate system */
     Vector m_position;
 };
 
+/**
+ * Directional light is a light source infinitely far away, such as the 
+ * sun: its light arrives from the same direction everywhere in the scene
+ * and is not attenuated. Lighting with it takes one dot product per 
+ * vertex normal, which makes it much cheaper than a distant point 
+ * light.<p />
+ *
+ * @author Matti Dahlbom
+ * @version $Name:  $, $Revision: 17 $
+ */
+class DirectionalLight : public Light
+{
+ public: // Constructors and destructor
+    NOVA_IMPORT DirectionalLight();
+    NOVA_IMPORT virtual ~DirectionalLight();
+
+ public: // new methods (public API)
+    /** 
+     * Returns the unit vector along which the light travels, relative to 
+     * the light node holding it.
+     */
+    inline const Vector& GetDirection() const;
+
+    /** 
+     * Sets the direction in which the light travels relative to the light
+     * node holding it, so that the node's rotations turn the light. The 
+     * direction is normalized. The default is (0, -1, 0), ie. straight 
+     * down.<p />
+     *
+     * @return NovaErrNone, or NovaErrInvalidArgument for a null vector
+     */
+    NOVA_IMPORT int SetDirection( const Vector& direction );
+
+ private: // Data
+    // unit vector along which the light travels
+    Vector m_direction;
+};
+
+/**
+ * A directional light with its direction in a given coordinate system, 
+ * like PointLightInstance.<p />
+ */
+struct DirectionalLightInstance
+{
+    /** The light */
+    const DirectionalLight* m_light;
+
+    /** Unit vector along which the light travels in the coordinate system */
+    Vector m_direction;
+};
+
 // inline method definitions
 // Light inline method definitions
 Light::Type Light::GetType() const
@@ -187,7 +317,7 @@ real_64 AmbientLight::IntensityReal() const
 }
 
 // PointLight inline method definitions
-Vector& PointLight::GetPosition()
+const Vector& PointLight::GetPosition() const
 {
     return m_position;
 }
@@ -200,6 +330,7 @@ void PointLight::SetPosition( const Vector& position )
 void PointLight::SetAttenuated( bool attenuated )
 {
     m_isAttenuated = attenuated;
+    m_version++;
 }
 
 bool PointLight::IsAttenuated() const
@@ -207,10 +338,40 @@ bool PointLight::IsAttenuated() const
     return m_isAttenuated;
 }
 
+uint_32 PointLight::GetVersion() const
+{
+    return m_version;
+}
+
 int_32 PointLight::CalculateAttenuationFactor( int_32 distance ) const
 {
-    //##TODO##
-    return 0;
+    // position in the table with a 16 bit fraction
+    int_64 position = ((int_64)distance * m_tableScale) >> FixedPointPrec;
+    int index = (int)(position >> FixedPointPrec);
+    if ( (distance < 0) || (position >= 
+			     ((int_64)PointLightTableSize << FixedPointPrec)) )
+    {
+        return 0;
+    }
+
+    // interpolate linearly between the neighbouring entries
+    int_32 fraction = (int_32)position & (FixedPointOne - 1);
+    int_32 att = m_attenuationTable[index];
+    int_32 nextAtt = m_attenuationTable[index + 1];
+
+    return att + (int_32)(((int_64)(nextAtt - att) * fraction) >> 
+			  FixedPointPrec);
+}
+
+int_32 PointLight::GetRadius() const
+{
+    return m_radius;
+}
+
+// DirectionalLight inline method definitions
+const Vector& DirectionalLight::GetDirection() const
+{
+    return m_direction;
 }
 
 }; // namespace
@@ -221,9 +221,16 @@ class ShapeNode : public Node
     inline const Matrix& GetObjectMatrix() const;
 
     /**
-     * Returns the bounding sphere for the shape.
+     * Returns the bounding sphere for the shape, transformed by the 
+     * object matrix.
      */
-    void GetBoundingSphere( BoundingSphere& boundingSpehere );
+    void GetBoundingSphere( BoundingSphere& boundingSphere ) const;
+
+    /**
+     * Returns an axis aligned bounding box enclosing the shape's bounding 
+     * box transformed by the object matrix.
+     */
+    void GetBoundingBox( BoundingBox& boundingBox ) const;
         
  private: // Data
     // shape this node relates to
@@ -282,15 +289,23 @@ class LightNode : public Node
     /** Returns the Light associated with this node */
     inline Light& GetLight() const;
         
-    /** Transforms this node by the scene graph */
-    void TransformBySceneGraph();
+    /** 
+     * Calculates the world space position of a positioned light by 
+     * transforming its position by the scene graph. Neither the node nor
+     * the light is modified.
+     */
+    void CalculateWorldPosition( Vector& position );
+
+    /** 
+     * Calculates the world space direction of a directional light by 
+     * rotating its direction by the scene graph. Neither the node nor 
+     * the light is modified.
+     */
+    void CalculateWorldDirection( Vector& direction );
         
  private: // Data
     // the Light associated with this node
     Light& m_light;
-        
-    // the Light Matrix 
-    Matrix m_lightMatrix;
 };
 
 /////////////////////////////////////////
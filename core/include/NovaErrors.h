@@ -47,6 +47,7 @@ const int NovaErrAlreadyInitialized = -11;
 const int NovaErrTextureTooLarge = -12;
 const int NovaErrInvalidPixelFormat = -13;
 const int NovaErrNoVertexNormals = -14;
+const int NovaErrInvalidFormat = -15;
 
 // indicates the texture dimensions werent powers of 2
 const int NovaErrTextureDimensionInvalid = -13; 
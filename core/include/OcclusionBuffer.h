@@ -0,0 +1,120 @@
+/*
+ *  $Id$
+ *
+ *  Nova 3D Engine - A portable object oriented, scene graph based, 
+ *  lightweight real-time 3D software rendering framework. 
+ *  Copyright (C) 2001-2009 Matti Dahlbom
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Contact: Matti Dahlbom <matti at 777-team dot org>
+ */
+
+#ifndef __OCCLUSIONBUFFER_H
+#define __OCCLUSIONBUFFER_H
+
+// FILE INFO
+// This file describes the coarse depth buffer used for rejecting shapes
+// hidden behind occluders.
+
+#include "NovaTypes.h"
+#include "Display.h"
+#include "FrameArena.h"
+#include "VectorMath.h"
+
+namespace nova3d {
+
+// width and height of a cell of the finest occlusion buffer level in pixels
+const int OcclusionCellSize = 8;
+
+// maximum number of levels in the occlusion buffer pyramid
+const int OcclusionMaxLevels = 16;
+
+/**
+ * A low resolution depth pyramid of the occluders in view. The finest
+ * level holds, for each cell of OcclusionCellSize x OcclusionCellSize
+ * pixels, the farthest depth at which the cell is fully covered by an
+ * occluder polygon. Each coarser level holds the farthest depth of the
+ * 2x2 cells below it, so that a shape of any size on the screen is tested
+ * against a handful of cells.<p />
+ *
+ * The buffer is conservative: a cell only partly covered by each of the
+ * occluder polygons stays empty, and a shape is only reported occluded if
+ * its nearest point is behind every cell its projection touches.<p />
+ *
+ * @author Matti Dahlbom
+ * @version $Revision$
+ */
+class OcclusionBuffer
+{
+ public: // Constructors and destructor
+    OcclusionBuffer();
+    ~OcclusionBuffer();
+
+ public: // New methods
+    /**
+     * Empties the buffer for a new frame. The levels are allocated from
+     * the frame arena, so the buffer must be cleared again after the
+     * arena has been reset.<p />
+     *
+     * @param canvas the canvas the occluders are projected on
+     * @param perspectiveFactor the perspective factor of the camera
+     * @param frameArena the arena to allocate the levels from
+     * @return NovaErrNone or NovaErrNoMemory
+     */
+    int Clear( const RenderingCanvas& canvas, int_32 perspectiveFactor,
+	       FrameArena& frameArena );
+
+    /**
+     * Adds a projected occluder polygon to the finest level. The vertex
+     * depths must still be camera space z values.
+     */
+    void AddOccluder( const ScreenPolygon& polygon );
+
+    /** Builds the coarser levels after all the occluders were added. */
+    void BuildPyramid();
+
+    /**
+     * Indicates whether the given camera space bounding sphere is hidden
+     * behind the occluders.
+     */
+    bool IsOccluded( const BoundingSphere& boundingSphere ) const;
+
+ private: // Types
+    struct Level
+    {
+	// depths as fixed point camera space z; row after row
+	int_32* m_depths;
+	int m_width;
+	int m_height;
+    };
+
+ private: // Data
+    Level m_levels[OcclusionMaxLevels];
+    int m_numLevels;
+
+    // screen area covered by the finest level and the projection
+    int_32 m_left;
+    int_32 m_top;
+    int_32 m_right;
+    int_32 m_bottom;
+    int_32 m_centerX;
+    int_32 m_centerY;
+    int_32 m_perspectiveFactor;
+};
+
+}; // namespace
+
+#endif
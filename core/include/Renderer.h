@@ -26,6 +26,7 @@
 #define __RENDERER_H
 
 #include "Display.h"
+#include "Kernels.h"
 
 namespace nova3d {
 
@@ -37,22 +38,126 @@ namespace nova3d {
  */
 class Renderer 
 {
+ public: // public enums
+    /** Ways of rasterizing the triangles */
+    enum Rasterizer
+    {
+	// walks the triangle edges one scanline at a time. the edges are 
+	// stepped from the vertices without a subpixel prestep, and the 
+	// spans are rounded by the span functions
+	RasterizerScanline,
+
+	// tests HalfSpaceBlockSize square pixel blocks against the edge 
+	// functions of the triangle. a pixel is drawn when its integer 
+	// position is inside the triangle, or exactly on a right edge or a 
+	// flat bottom edge, with the vertices snapped to 1/16 pixels. the 
+	// pixels along the edges therefore differ from RasterizerScanline
+	RasterizerHalfSpace
+    };
+
  public: // Constructors and destructor
     Renderer( RenderingCanvas& canvas );
 
  public: // New methods
+    /** Selects the rasterizer used by the Draw*Triangle() methods */
+    inline void SetRasterizer( Rasterizer rasterizer );
+
+    /** Returns the rasterizer used by the Draw*Triangle() methods */
+    inline Rasterizer GetRasterizer() const;
+
+    /**
+     * Prepares the textured polygons among the given faces for drawing: 
+     * selects their mip levels, calculates the perspective correct 
+     * vertex values, orders the vertices by y and sets up the gradients 
+     * and edge inverses, several polygons at a time. At most 
+     * <code>TriangleSetupBatch::MaxTriangles</code> faces are set up. 
+     * The gradients and edge inverses are kept in the renderer until the
+     * next call, so the textured faces must be drawn before setting up 
+     * the next faces.
+     */
+    void SetupTriangles( const ScreenPolygonKey* faces, int count );
+
     /** Renders a nontextured, vertex colored polygon */
     void DrawTriangle( ScreenPolygon* face );
 
-    /** Renders a textured polygon */
-    void DrawTexturedTriangle( ScreenPolygon* face );
+    /** 
+     * Renders a textured polygon. <code>setupIndex</code> is the index of
+     * the face among the textured faces of the last 
+     * <code>SetupTriangles()</code> call.
+     */
+    void DrawTexturedTriangle( ScreenPolygon* face, int setupIndex );
+
+    /** Renders a lighted, textured polygon; see DrawTexturedTriangle() */
+    void DrawLightedTexturedTriangle( ScreenPolygon* face, int setupIndex );
+
+ private: // Types
+    /** Edge functions and bounds of a triangle for the half-space path. */
+    struct HalfSpaceTriangle
+    {
+	// edge function values at the top left pixel of the bounds, biased
+	// by the fill convention so that the covered pixels have values of 
+	// at least 0, and their steps per pixel
+	int_64 m_edgeValues[3];
+	int_32 m_edgeStepsX[3];
+	int_32 m_edgeStepsY[3];
 
-    /** Renders a lighted, textured polygon */
-    void DrawLightedTexturedTriangle( ScreenPolygon* face );
+	// pixel bounds of the triangle clipped to the canvas, inclusive
+	int_32 m_left;
+	int_32 m_top;
+	int_32 m_right;
+	int_32 m_bottom;
+
+	// vertex deltas to the third vertex for the attribute planes, the 
+	// inverse of their cross product scaled to pixels and the offset of
+	// the top left pixel of the bounds from the third vertex in pixels
+	real_64 m_dx13;
+	real_64 m_dx23;
+	real_64 m_dy13;
+	real_64 m_dy23;
+	real_64 m_inverseArea;
+	real_64 m_originX;
+	real_64 m_originY;
+    };
+
+    /** A vertex attribute interpolated linearly over a triangle. */
+    struct HalfSpacePlane
+    {
+	// value at the top left pixel of the bounds and steps per pixel
+	int_32 m_origin;
+	int_32 m_dx;
+	int_32 m_dy;
+    };
 
  private: // New methods
     int_32 DivLookup( int_32 fixedDivider );
 
+    // half-space versions of the Draw*Triangle() methods
+    void DrawHalfSpaceTriangle( ScreenPolygon* face );
+    void DrawHalfSpaceTexturedTriangle( ScreenPolygon* face );
+    void DrawHalfSpaceLightedTexturedTriangle( ScreenPolygon* face );
+
+    // sets up the edge functions of the face; returns false if it covers 
+    // no pixels of the canvas
+    bool SetupHalfSpace( const ScreenPolygon* face, 
+			 HalfSpaceTriangle& triangle );
+
+    // sets up the plane of a vertex attribute with the given values at 
+    // m_v1, m_v2 and m_v3 of the face
+    void SetupPlane( const HalfSpaceTriangle& triangle, 
+		     int_32 value1, int_32 value2, int_32 value3, 
+		     HalfSpacePlane& plane );
+
+    // returns the value of the plane at the given pixel offset from the 
+    // top left pixel of the bounds
+    static int_32 PlaneValue( const HalfSpacePlane& plane, 
+			      int_32 x, int_32 y );
+
+    // finds the covered span of each pixel row of the row of blocks 
+    // starting at y. the spans are [left, right); empty rows have 
+    // left >= right. returns the number of rows
+    int ScanHalfSpaceBlockRow( const HalfSpaceTriangle& triangle, int_32 y, 
+			       int_32* spanLeft, int_32* spanRight );
+
     void DrawGouraudSpan( int_32 x1, int_32 x2, 
 			  int_32 red1, int_32 green1, 
 			  int_32 blue1, 
@@ -64,23 +169,90 @@ class Renderer
 			   int_32 leftZ,
 			   int_32 dudx, int_32 dvdx, int_32 dzdx,
 			   uint_32 scanlinePtr, 
-			   Texture* texture );
+			   Texture* texture, int mipLevel );
     void DrawLightedTexturedSpan( int_32 leftX, int_32 rightX, 
 				  int_32 leftU, int_32 leftV, 
 				  int_32 leftZ, int_32 intensityLeft, 
 				  int_32 dudx, int_32 dvdx, int_32 dzdx,
 				  int_32 didx,
 				  uint_32 scanlinePtr, 
-				  Texture* texture );
+				  Texture* texture, int mipLevel );
+
+    // span functions for polygons flagged ScreenPolygonInsideCanvas; 
+    // these skip the canvas clipping altogether
+    void DrawUnclippedGouraudSpan( int_32 x1, int_32 x2, 
+				   int_32 red1, int_32 green1, 
+				   int_32 blue1, 
+				   int_32 red2, int_32 green2, 
+				   int_32 blue2, 
+				   uint_32* basePtr );
+    void DrawUnclippedTexturedSpan( int_32 leftX, int_32 rightX, 
+				    int_32 leftU, int_32 leftV, 
+				    int_32 leftZ,
+				    int_32 dudx, int_32 dvdx, int_32 dzdx,
+				    uint_32 scanlinePtr, 
+				    Texture* texture, int mipLevel );
+    void DrawUnclippedLightedTexturedSpan( int_32 leftX, int_32 rightX, 
+					   int_32 leftU, int_32 leftV, 
+					   int_32 leftZ, int_32 intensityLeft, 
+					   int_32 dudx, int_32 dvdx, 
+					   int_32 dzdx, int_32 didx,
+					   uint_32 scanlinePtr, 
+					   Texture* texture, int mipLevel );
+
+    // span inner loops shared by the clipped and unclipped paths
+    void FillGouraudSpan( uint_32* ptr, int_32 len, 
+			  int_32 red, int_32 green, int_32 blue, 
+			  int_32 redSlope, int_32 greenSlope, 
+			  int_32 blueSlope );
+    void FillTexturedSpan( uint_32* p, int_32 len, 
+			   int_32 u, int_32 v, int_32 z,
+			   int_32 dudx, int_32 dvdx, int_32 dzdx,
+			   Texture* texture, int mipLevel );
+    void FillLightedTexturedSpan( uint_32* p, int_32 len, 
+				  int_32 u, int_32 v, int_32 z, 
+				  int_32 intensity, 
+				  int_32 dudx, int_32 dvdx, int_32 dzdx,
+				  int_32 didx, 
+				  Texture* texture, int mipLevel );
 
  private: // Data
     // reference to the rendering canvas to draw to
     RenderingCanvas& m_canvas;
 
+    // span kernels for the processor
+    const KernelTable& m_kernels;
+
+    // structure of arrays buffer for the triangle setup; holds the 
+    // gradients and edge inverses of the textured faces being drawn
+    TriangleSetupBatch m_setupBatch;
+
+    // rasterizer used by the Draw*Triangle() methods
+    Rasterizer m_rasterizer;
+
     // fixed point division lookup table
     int_32 m_fixedDivLookup[65536];
+
+    // the covered span [left, right) of each block row mask of the 
+    // half-space rasterizer
+    int_16 m_maskSpanLeft[256];
+    int_16 m_maskSpanRight[256];
 };
 
+/////////////////////////////////////////
+// inline method definitions
+/////////////////////////////////////////
+
+void Renderer::SetRasterizer( Rasterizer rasterizer )
+{
+    m_rasterizer = rasterizer;
+}
+
+Renderer::Rasterizer Renderer::GetRasterizer() const
+{
+    return m_rasterizer;
+}
+
 }; // namespace
 
 #endif
@@ -37,9 +37,11 @@
 namespace nova3d {
 
 // forward declarations
-class LightNode;
 class Vector;
 class AmbientLight;
+class Light;
+struct PointLightInstance;
+struct DirectionalLightInstance;
 
 // polygon info flag masks
 const uint_32 PolygonInfoTextureFilterMask = 0x0007; // 0000 0000 0000 0111
@@ -50,6 +52,30 @@ const uint_32 PolygonInfoVisible = 0x0020; // 0000 0000 0010 0000
 // vertex info flag masks
 const uint_32 VertexInfoVisible = 0x0020; // 0000 0000 0010 0000
 
+/**
+ * Preprocessed shape data for <code>Shape::CreateFromExternalData()</code>.
+ * The optional lists are NULL when not present. The list sizes are the 
+ * same as those of the corresponding Shape members.<p />
+ */
+struct ShapeData
+{
+    int m_numCoordinates;
+    int m_numPolygons;
+    int m_numVertexNormals;
+    bool m_isIlluminated;
+    BoundingSphere m_boundingSphere;
+    BoundingBox m_boundingBox;
+    const Vector* m_coordinates;
+    const uint_32* m_vertices;
+    const PlaneEquation* m_planeEquations;
+    const uint_32* m_polygonInfos; // optional; copied
+    const uint_32* m_vertexColors; // optional
+    const int_32* m_textureCoordinates; // optional
+    const Vector* m_vertexNormals; // optional
+    const uint_32* m_vertexNormalIndices; // optional
+    const int_32* m_lightingIntensities; // optional; copied, makes prelit
+};
+
 /**
  * Represents a renderable mesh object constructed of polygons.<p />
  *
@@ -65,6 +91,26 @@ class Shape
  public: // New methods (Public API)
     NOVA_IMPORT int CreateGeometry( int numCoordinates, int numPolygons,
 				    real_64* coordinates, uint_32* vertices );
+
+    /**
+     * Creates the geometry from coordinates that are already in fixed 
+     * point, avoiding the conversion from real_64. The data is copied.
+     */
+    NOVA_IMPORT int CreateGeometry( int numCoordinates, int numPolygons,
+				    const Vector* coordinates, 
+				    const uint_32* vertices );
+
+    /**
+     * Creates the shape on top of preprocessed data, such as data mapped 
+     * from an asset file. The coordinates, polygons, plane equations, 
+     * colors, texture coordinates and vertex normals are used in place 
+     * without copying and must stay valid and unchanged for the lifetime
+     * of the shape; only the per-frame buffers are allocated. The methods
+     * that would modify the data return NovaErrAlreadyInitialized 
+     * (<code>Center()</code> and <code>AlignOnXZPlane()</code> do 
+     * nothing).<p />
+     */
+    NOVA_IMPORT int CreateFromExternalData( const ShapeData& data );
         
     /** Sets the polygons to the Shape. */
     //        NOVA_IMPORT int SetPolygons( int numPolygons, 
@@ -176,6 +222,15 @@ class Shape
     /** Returns the bounding sphere radius */
     inline int_32 GetBoundingSphereRadius() const;
 
+    /** 
+     * Returns the bounding sphere in object space. The radius is -1 if 
+     * the bounding volumes have not been calculated.
+     */
+    inline const BoundingSphere& GetBoundingSphere() const;
+
+    /** Returns the axis aligned bounding box in object space. */
+    inline const BoundingBox& GetBoundingBox() const;
+
     /** 
      * Aligns the shape's coordinates so that the shape's bottom is set 
      * at the XZ plane (lowest Y = 0).<P>
@@ -227,17 +282,68 @@ class Shape
     NOVA_IMPORT void SetIlluminated( bool isIlluminated );
 
     /**
-     * Calculates the bounding sphere radius for the shape. This is 
-     * a <b>very</b> heavy operation and should not be called unless 
-     * changes to the coordinate data are applied. Note that this method
-     * is called automatically by 
-     * <code>PolygonEngine::SetSceneGraph()</code>
-     * so it is rarely necessary to call it from the client code.
+     * Calculates the lighting of every polygon of the shape once and 
+     * makes the shape prelit: from then on it is rendered with the stored
+     * intensities and no lighting is calculated for it while rendering. 
+     * Meant for shapes that stay put relative to the lights. The shape is
+     * made illuminated.<p />
+     *
+     * @param ambientLight the ambient light
+     * @param lights the point lights with their positions in the shape's
+     *        object space
+     * @param numLights number of lights
+     * @param directionalLights the directional lights with their 
+     *        directions in the shape's object space
+     * @param numDirectionalLights number of directional lights
+     * @return NovaErrNone, or NovaErrNoVertexNormals if the shape has no 
+     *         vertex normals
+     */
+    NOVA_IMPORT int BakeLighting( 
+	const AmbientLight& ambientLight, 
+	const PointLightInstance* lights, int numLights,
+	const DirectionalLightInstance* directionalLights = NULL, 
+	int numDirectionalLights = 0 );
+
+    /**
+     * Sets lighting intensities calculated earlier, such as ones read 
+     * from an asset file, and makes the shape prelit and illuminated.<p />
+     *
+     * @param intensities 3 intensities per polygon as fixed point, in 
+     *        the order of the polygon vertices
+     */
+    NOVA_IMPORT int SetPrelitIntensities( const int_32* intensities );
+
+    /** Makes the shape be lit while rendering again. */
+    NOVA_IMPORT void ClearPrelit();
+
+    /** Indicates whether the shape is rendered with stored intensities. */
+    inline bool IsPrelit() const;
+
+    /**
+     * Sets whether this shape is an occluder. The occluders are processed
+     * before the other shapes and drawn into the camera's occlusion 
+     * buffer, and the shapes whose bounding spheres are hidden behind them
+     * are skipped. Large shapes near the viewer, like walls, make good 
+     * occluders. By default, the shape is NOT an occluder.
      */
-    NOVA_IMPORT void CalculateBoundingSphereRadius();
+    NOVA_IMPORT void SetOccluder( bool isOccluder );
+
+    /** Indicates whether the shape is an occluder. */
+    inline bool IsOccluder() const;
+
+    /**
+     * Calculates the bounding sphere and the axis aligned bounding box 
+     * of the shape. The sphere is fitted around the coordinates with 
+     * Ritter's algorithm, so it is centered on the mesh rather than on 
+     * the object space origin. This is called automatically whenever the
+     * coordinates are created or moved by the shape itself; call it after
+     * modifying the coordinates by other means. It also makes the shape 
+     * be relit on the next frame.
+     */
+    NOVA_IMPORT void CalculateBoundingVolumes();
 
     /** Returns the shape's coordinates and their count. */
-    inline const Vector* GetCoords( int_32 count ) const;
+    inline const Vector* GetCoords( int_32& count ) const;
         
     /** Returns the polygon info bitmasks for each polygon in shape. */
     inline const uint_32* GetPolygonInfo() const;
@@ -251,7 +357,11 @@ class Shape
     /** Returns vertex normals for each vertex in the shape. */
     inline const Vector* GetVertexNormals( int_32& count ) const;
         
-    /** Returns transformed vertex normals for each vertex in the shape. */
+    /** 
+     * Returns transformed vertex normals for each vertex in the shape. 
+     * Only the normals of the visible environment mapped polygons are 
+     * transformed.
+     */
     inline const Vector* GetTransformedVertexNormals( int_32& count ) const;
         
     /** Returns vertex normal indices for the shape - 3 per polygon. */
@@ -282,18 +392,45 @@ class Shape
      * light sources, f(d)i = the attenuation of i:th 
      * point light source given distance d between the light source
      * and a vertex, and Ipi = the intensity of the i:th point light 
-     * source.<p />
+     * source. A directional light adds the cosine of the angle between 
+     * the vertex normal and the direction towards it, unattenuated.<p />
      * 
-     * The results are written to m_lightingIntensities. This is done
-     * every frame.
+     * The lights are evaluated once per unique (vertex, vertex normal) 
+     * pair used by the visible polygons and the results are added to the
+     * polygon corners facing each light. The results are written to 
+     * m_lightingIntensities. This is done every frame.<p />
+     *
+     * The intensities are reused when the lights are the same as the last
+     * time, with the same positions and directions in object space. 
+     * When that happens 
+     * for the first time all the polygons are lit, so that the intensities
+     * stay valid however the camera moves until the lights do.<p />
+     *
+     * @param lights the point lights with their positions in the shape's
+     * object space
+     * @param numLights number of lights
+     * @param directionalLights the directional lights with their 
+     * directions in the shape's object space
+     * @param numDirectionalLights number of directional lights
+     * @param lightingBuffer scratch space for GetLightingBufferSize() 
+     * values
      */
     void ApplyLighting( const AmbientLight& ambientLight, 
-			const List<LightNode*>& lightNodeList );
+			const PointLightInstance* lights, int numLights,
+			const DirectionalLightInstance* directionalLights,
+			int numDirectionalLights, int_32* lightingBuffer );
+
+    /** 
+     * Returns the number of values needed for the scratch space passed 
+     * to ApplyLighting(). 
+     */
+    inline int GetLightingBufferSize() const;
 
     /**
-     * Transforms all coordinates and [if needed] vertex normals  by the
-     * given transform. In practice this means object space -> camera space
-     * transformation. This is done every frame.
+     * Transforms the visible coordinates and the vertex normals of the 
+     * visible environment mapped polygons by the given transform. In practice 
+     * this means object space -> camera space transformation. This is 
+     * done every frame.
      */
     void TransformAll( const Matrix& transform );
 
@@ -303,15 +440,33 @@ class Shape
  private: // New methods
     /** Calculates the plane equation for the specified polygon */
     void CalculatePlaneEquation( int polygonIndex );
+    void CoordinatesMoved();
         
-    int AllocateVertexList();
-    int AllocateColorList();
-    int AllocateCoordinateList();
-    int AllocateTextureList();
-    int AllocateTextureCoordinateList();
-    int AllocateLightingIntensities();
+    int AllocateGeometry( int numCoordinates, int numPolygons );
+    int AllocateFrameBuffers();
+    void InitializePolygons( const uint_32* vertices );
+    int AllocateTextureBlock();
     void DeallocateAll();
     void DeallocateVertexNormals();
+    int CreateLitVertices();
+    bool IsLightingUnchanged( 
+	int_32 ambientIntensity, 
+	const PointLightInstance* lights, int numLights,
+	const DirectionalLightInstance* directionalLights, 
+	int numDirectionalLights ) const;
+    int StoreLightingState( 
+	int_32 ambientIntensity, 
+	const PointLightInstance* lights, int numLights,
+	const DirectionalLightInstance* directionalLights, 
+	int numDirectionalLights );
+    void CalculateLighting( 
+	int_32 ambientIntensity, 
+	const PointLightInstance* lights, int numLights,
+	const DirectionalLightInstance* directionalLights, 
+	int numDirectionalLights, int_32* lightingBuffer, bool allPolygons );
+    void AddLightToCorners( const int_32* intensities, 
+			    const uint_32* slots, const Vector& lightPos,
+			    bool isDirectional, uint_32 visibleMask );
         
  protected: // Data
     // number of coordinates in the coordinate list 
@@ -357,6 +512,14 @@ class Shape
     // transformed vertex normals (in camera space)
     Vector* m_transformedVertexNormals;
 
+    // VertexInfoVisible for the normals of the visible environment mapped
+    // polygons, which are the only ones transformed; set by BackfaceCull()
+    uint_32* m_normalInfos;
+
+    // whether any visible polygon is environment mapped; set by 
+    // BackfaceCull()
+    bool m_hasVisibleEnvMapping;
+
     // vertex normal indices. there are 3 values / triangle, one for 
     // each vertex of a polygon. the index are used to address vectors 
     // in m_vertexNormals
@@ -366,13 +529,15 @@ class Shape
     bool m_isIlluminated;
     
     // lighting intensities (3 per polygon) at vertices as fixed point. 
-    // These are dynamically calculated every frame
+    // These are dynamically calculated every frame unless the shape is 
+    // prelit
     int_32* m_lightingIntensities;
 
-    // Distance cache for lighting. This is used to store distances 
-    // between vertices and point lights to avoid calculating them 
-    // more than once
-    int_32* m_distanceCache;
+    // whether m_lightingIntensities hold baked lighting
+    bool m_isPrelit;
+
+    // whether the shape is drawn into the occlusion buffer
+    bool m_isOccluder;
         
  private: // Data
     // polygon plane equations (size: m_numPolygons)
@@ -383,9 +548,55 @@ class Shape
         
     // vertex info flags (size: m_numCoordinates)
     uint_32* m_vertexInfos;
+
+    // the unique (vertex, vertex normal) pairs found at the polygon 
+    // corners. lighting is calculated once per pair and then added to 
+    // every corner sharing it.
+    int m_numLitVertices;
+    uint_32* m_litVertexIndices;
+    uint_32* m_litNormalIndices;
+
+    // index of the lit vertex of each polygon corner (3 per polygon)
+    uint_32* m_cornerLitVertices;
+
+    // which polygons m_lightingIntensities were calculated for
+    enum LightingCoverage
+    {
+	LightingNone,
+	LightingVisible,
+	LightingAll
+    };
+    LightingCoverage m_lightingCoverage;
+
+    // a light as it was when the intensities were calculated. 
+    // m_position holds the direction of a directional light.
+    struct LightingState
+    {
+	const Light* m_light;
+	uint_32 m_version;
+	Vector m_position;
+    };
+
+    // the lighting m_lightingIntensities were calculated with
+    int_32 m_lightingAmbient;
+    List<LightingState> m_lightingStates;
         
-    // bounding sphere radius
-    int_32 m_boundingSphereRadius;
+    // bounding volumes in object space
+    BoundingSphere m_boundingSphere;
+    BoundingBox m_boundingBox;
+
+    // the attribute arrays are carved out of these cache line aligned 
+    // blocks. the geometry block holds the arrays sized by the geometry
+    // (or only the per-frame buffers for external data), the others hold
+    // the vertex normals, the lit vertices and the textures with their 
+    // coordinates.
+    void* m_geometryBlock;
+    void* m_normalBlock;
+    void* m_litVertexBlock;
+    void* m_textureBlock;
+
+    // whether the geometry lists point to data not owned by the shape
+    bool m_externalData;
 };
 
 ///////////////////////////////////////////////////
@@ -394,7 +605,17 @@ class Shape
 
 int_32 Shape::GetBoundingSphereRadius() const
 {
-    return m_boundingSphereRadius;
+    return m_boundingSphere.m_radius;
+}
+
+const BoundingSphere& Shape::GetBoundingSphere() const
+{
+    return m_boundingSphere;
+}
+
+const BoundingBox& Shape::GetBoundingBox() const
+{
+    return m_boundingBox;
 }
 
 Texture** Shape::GetTextures() const
@@ -438,7 +659,7 @@ const uint_32* Shape::GetVertexColors() const
     return m_vertexColors;
 }
 
-const Vector* Shape::GetCoords( int_32 count ) const
+const Vector* Shape::GetCoords( int_32& count ) const
 {
     count = m_numCoordinates;
     return m_coordinates;
@@ -471,6 +692,16 @@ bool Shape::IsIlluminated() const
     return m_isIlluminated;
 }
 
+bool Shape::IsPrelit() const
+{
+    return m_isPrelit;
+}
+
+bool Shape::IsOccluder() const
+{
+    return m_isOccluder;
+}
+
 int_32* Shape::GetLightingIntensities() const
 {
     return m_lightingIntensities;
@@ -481,6 +712,13 @@ const PlaneEquation* Shape::GetPlaneEquations() const
     return m_planeEquations;
 }
 
+int Shape::GetLightingBufferSize() const
+{
+    // per lit vertex: its slot among the visible ones, and per visible 
+    // lit vertex: the vertex and normal indices, intensity and distance
+    return 5 * m_numLitVertices;
+}
+
 }; // namespace
 
 #endif
@@ -28,6 +28,8 @@
 // FILE INFO
 // This file describes the class used to contain textures.
 
+#include <stdlib.h>
+
 #include "NovaTypes.h"
 #include "Display.h"
 
@@ -48,6 +50,9 @@ class Texture
     // number of entries per palette
     static const int NumPaletteEntries = 256;
 
+    // maximum number of levels in the mip chain (1024 -> 1)
+    static const int MaxMipLevels = 11;
+
     // texture filter mode (NOTE: must not change these values!)
     enum FilterMode
     {
@@ -55,6 +60,58 @@ class Texture
         EFilterBilinear = 0x01
     };
 
+    /**
+     * Memory layout of the texture data. With the linear layout the texels
+     * are stored row by row. The swizzled layouts keep texels that are 
+     * close to each other in both u and v close in memory, so that the 
+     * cost of the texel fetches does not depend on the direction the 
+     * texture is walked in: ELayoutTiled stores the texture in 
+     * 8x8 texel tiles (64 bytes each) and ELayoutMorton in Z-order.
+     */
+    enum MemoryLayout
+    {
+        ELayoutLinear = 0x00,
+        ELayoutTiled = 0x01,
+        ELayoutMorton = 0x02
+    };
+
+    // tile side for ELayoutTiled is 1 << TileSidePower texels
+    static const int TileSidePower = 3;
+
+    /**
+     * Lighting mode of the texture. ELightingPalettes uses an array of 
+     * precalculated palettes, one per intensity level (see 
+     * CreateLinearPalettes()). ELightingModulate keeps the single palette
+     * and multiplies the palette color by the intensity per pixel (see 
+     * CreateModulatedLighting()).
+     */
+    enum LightingMode
+    {
+        ELightingPalettes = 0x00,
+        ELightingModulate = 0x01
+    };
+
+    /** 
+     * Describes a single level of the texture's mip chain. Level 0 is 
+     * the texture itself; each following level halves the dimensions
+     * of the previous one. All the levels share the texture's palette(s).
+     */
+    struct MipLevel
+    {
+        uint_8* m_data;
+        int m_width;
+        int m_height;
+        uint_32 m_shift;
+        uint_32 m_umask;
+        uint_32 m_vmask;
+
+        // texel offset tables for the swizzled layouts, indexed by the 
+        // masked u and v; the offset of a texel is the sum of the two. 
+        // NULL for the linear layout.
+        uint_32* m_uOffsets;
+        uint_32* m_vOffsets;
+    };
+
  public: // Constructors and destructor
     NOVA_IMPORT Texture();
     NOVA_IMPORT ~Texture();
@@ -66,10 +123,14 @@ class Texture
      * returns. The texture data must be organized
      * in memory linearly from left to right, top to bottom. The data
      * values are indices to the palette.<p />
+     *
+     * The texture stores the data in the given memory layout. Both the 
+     * texture dimensions must be powers of 2 for the swizzled layouts.<p />
      */
     NOVA_IMPORT int Create( NovaPixelFormat pixelFormat, 
 			    int width, int height,
-			    uint_32* palette, uint_8* data );
+			    uint_32* palette, uint_8* data,
+			    MemoryLayout layout = ELayoutLinear );
 
     NOVA_IMPORT int CreateLinearPalettes( real_64 gain = 1.0 );
         
@@ -85,6 +146,53 @@ class Texture
      * @param aGain gain value. default is 1.0
      */
     //        NOVA_IMPORT int CreateLinearPalettes( real_64 aGain = 1.0 );
+
+    /**
+     * Sets the texture up for lighting by modulating the palette colors 
+     * with the intensity per pixel, instead of creating the palette array 
+     * with <code>CreateLinearPalettes()</code>. Only the one palette is
+     * kept in memory, which is a fraction of the size of the palette 
+     * array. The intensity is limited to 1.0.<p />
+     *
+     * @return NovaErrAlreadyInitialized if the palette array has already 
+     *         been created
+     */
+    NOVA_IMPORT int CreateModulatedLighting();
+
+    /**
+     * Creates the texture on top of preprocessed data, such as data 
+     * mapped from an asset file. No copies are made: the palette(s) and 
+     * the texel data are used in place and must stay valid and unchanged 
+     * for the lifetime of the texture. The data holds all the mip levels
+     * one after another, each in the given memory layout. The palettes, 
+     * the mip chain and the lighting mode cannot be changed 
+     * afterwards.<p />
+     *
+     * @param numPalettes number of palettes; 1 or the count that
+     *                    <code>CreateLinearPalettes()</code> produces
+     * @param numMipLevels number of mip levels in the data, at least 1
+     * @param dataSize size of the data, for validation
+     * @return Nova error code or NovaErrNone if successful
+     */
+    NOVA_IMPORT int CreateFromExternalData( NovaPixelFormat pixelFormat,
+                                            int width, int height,
+                                            MemoryLayout layout,
+                                            LightingMode lightingMode,
+                                            int numPalettes,
+                                            const uint_32* palettes,
+                                            int numMipLevels,
+                                            const uint_8* data,
+                                            uint_32 dataSize );
+
+    /**
+     * Creates the mip chain for the texture, down to a single texel. 
+     * Each texel of a level is chosen from the corresponding 2x2 texel 
+     * block of the previous level as the one closest to the block's 
+     * average color, so that the levels can share the palette(s). 
+     * Both the texture dimensions must be powers of 2. Calling 
+     * <code>Create()</code> again discards the mip chain.<p />
+     */
+    NOVA_IMPORT int CreateMipmaps();
   
     /** Returns the width of the texture. */
     inline int GetWidth() const;
@@ -103,22 +211,57 @@ class Texture
     inline uint_32 GetVMask() const;
     inline int GetNumPalettes() const;
     inline NovaPixelFormat GetPixelFormat() const;
+    inline MemoryLayout GetMemoryLayout() const;
+    inline LightingMode GetLightingMode() const;
+
+    /** Returns the number of mip levels; 1 if no mip chain was created. */
+    inline int GetNumMipLevels() const;
+
+    /** Returns the given level of the mip chain. */
+    inline const MipLevel& GetMipLevel( int level ) const;
+
+    /** 
+     * Returns the offset of the texel (u,v) in the data of the given level,
+     * taking into account the memory layout. The coordinates wrap around.
+     */
+    static inline uint_32 GetTexelOffset( const MipLevel& level, 
+                                          int_32 u, int_32 v );
 
     /**
      * Returns the texture palette(s). In case of multiple palette(s), the 
-     * first palette should be the one with most lighting and the last with
-     * the least lighting.<P>
+     * first palette is the one with the least lighting and the last with
+     * the most lighting.<P>
      *
      * There are <code>GetNumPalettes() * KNumPaletteEntries</code> palette
      * entries in the array.<P>
      */
     inline uint_32* GetPalette() const;
 
-    /** Returns texture pixel data, as 8-bit indexes to the palette */
+    /** 
+     * Returns texture pixel data, as 8-bit indexes to the palette. The
+     * data is in the texture's memory layout.
+     */
     inline uint_8* GetData() const;
 
-    /** Scales an intensity value to the texture's palette range */
+    /** 
+     * Scales an intensity value to the texture's palette range, or to 
+     * 0..MaxModulateIntensity for ELightingModulate 
+     */
     void ScaleIntensity( int_32& intensity ) const;
+
+ private: // New methods
+    // validates the dimensions and sets up the masks
+    int SetDimensions( int width, int height, MemoryLayout layout );
+
+    // sets up the level descriptions; levels >0 are stored in mipData
+    void SetupMipLevels( int numLevels, uint_8* mipData );
+
+    // returns the length of the full mip chain and the memory needed 
+    // for the levels after the first one
+    int CountMipLevels( size_t& mipDataSize ) const;
+
+    // (re)creates the texel offset tables for the first numLevels levels
+    int CreateOffsetTables( int numLevels );
         
  private: // Data
     int m_width;
@@ -134,9 +277,23 @@ class Texture
     int m_numPalettes;
     int m_numPalettesShift;
     uint_32* m_palette;
+    LightingMode m_lightingMode;
 
     // indexed texture data
     uint_8* m_data;
+
+    // mip chain. the first level refers to m_data, the data for the rest
+    // of the levels is held in a single allocation, m_mipData.
+    int m_numMipLevels;
+    MipLevel m_mipLevels[MaxMipLevels];
+    uint_8* m_mipData;
+
+    // memory layout of the data and the offset tables of all the levels
+    MemoryLayout m_layout;
+    uint_32* m_offsetData;
+
+    // whether m_palette and m_data point to data not owned by the texture
+    bool m_externalData;
 };
 
 ///////////////////////////////////////////////////
@@ -188,6 +345,37 @@ NovaPixelFormat Texture::GetPixelFormat() const
     return m_pixelFormat;
 }
 
+int Texture::GetNumMipLevels() const
+{
+    return m_numMipLevels;
+}
+
+const Texture::MipLevel& Texture::GetMipLevel( int level ) const
+{
+    return m_mipLevels[level];
+}
+
+Texture::MemoryLayout Texture::GetMemoryLayout() const
+{
+    return m_layout;
+}
+
+Texture::LightingMode Texture::GetLightingMode() const
+{
+    return m_lightingMode;
+}
+
+uint_32 Texture::GetTexelOffset( const MipLevel& level, int_32 u, int_32 v )
+{
+    if ( level.m_uOffsets == NULL ) 
+    {
+        return (u & level.m_umask) + ((v & level.m_vmask) << level.m_shift);
+    }
+
+    return level.m_uOffsets[u & level.m_umask] + 
+        level.m_vOffsets[v & level.m_vmask];
+}
+
 }; // namespace
 
 #endif
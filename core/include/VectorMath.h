@@ -154,6 +154,18 @@ struct BoundingSphere
     int_32 m_radius;
 };
 
+/**
+ * Represents an axis aligned bounding box.<p />
+ */
+struct BoundingBox
+{
+    /** Smallest coordinates of the box */
+    Vector m_min;
+
+    /** Largest coordinates of the box */
+    Vector m_max;
+};
+
 // dimension of the matrix
 const int MatrixDim = 4;
 
@@ -266,6 +278,12 @@ class Matrix
 				  const Vector& v2, 
 				  const Vector& v3 );
 
+    /** 
+     * Returns the matrix elements in row-major order, MatrixDim elements
+     * per row.
+     */
+    inline const int_32* GetFixedData() const;
+
     inline void PrintToStdout() const;
 
  private: // Data
@@ -401,6 +419,11 @@ void Vector::PrintToStdout() const
 }
 
 // inline method definitions for Matrix
+const int_32* Matrix::GetFixedData() const
+{
+    return &m_data[0][0];
+}
+
 void Matrix::PrintToStdout() const
 {
     for ( int i = 0; i < MatrixDim; i++ )
@@ -428,6 +451,11 @@ bool PlaneEquation::IsOutside( const Vector& point ) const
     return ( d < m_fixedD );
 }
 
+int_32 PlaneEquation::DistanceFromPlaneFixed( const Vector& point ) const
+{
+    return m_normal.DotProductFixed( point ) + m_fixedD;
+}
+
 }; // namespace
 
 #endif
@@ -23,10 +23,12 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
 #include "Camera.h"
 #include "Display.h"
+#include "JobSystem.h"
 #include "NovaErrors.h"
 #include "RenderingUtils.h"
 #include "Shape.h"
@@ -34,21 +36,57 @@
 
 namespace nova3d {
 
+// margin in pixels by which the renderer's edge interpolation may exceed
+// a polygon's screen bounding box
+const int_32 ScreenGuardMargin = 2;
+
+// removes the back faces and transforms ranges of prepared shapes on the
+// job system
+class ShapeGeometryBody : public ParallelForBody
+{
+ public:
+    ShapeGeometryBody( const Camera& camera, 
+                       Camera::VisibleShape* visibleShapes )
+        : m_camera( camera ),
+          m_visibleShapes( visibleShapes )
+    {
+    }
+
+    void Execute( int begin, int end )
+    {
+        for ( int i = begin; i < end; i++ )
+        {
+            m_camera.TransformVisibleShape( m_visibleShapes[i] );
+        }
+    }
+
+ private:
+    const Camera& m_camera;
+    Camera::VisibleShape* m_visibleShapes;
+};
+
 NOVA_EXPORT Camera::Camera( RenderingCanvas& renderingCanvas )
     : m_renderer( renderingCanvas ),
       m_cameraNode( NULL ), 
-      m_maxVisibleFaces( 0 ), 
       m_numVisibleFaces( 0 ),
-      m_visibleFaceBuffer( NULL ),
-      m_visibleFaceList( NULL ),
+      m_firstFaceRun( NULL ),
+      m_lastFaceRun( NULL ),
+      m_nextFace( NULL ),
+      m_visibleFaceKeys( NULL ),
       m_fov( 0.0 ),
       m_perspectiveFactor( 0 ),
+      m_isOcclusionCulling( false ),
+      m_numOccludedShapes( 0 ),
       m_isLookingAt( false ),
       m_canvas( renderingCanvas ),
       m_nearClippingDepth( ::RealToFixed( MinimumNearClippingDepth ) ),
       m_shapeNodeList( NULL ),
       m_ambientLight( NULL ),
-      m_lightNodeList( NULL )
+      m_lightNodeList( NULL ),
+      m_worldLights( NULL ),
+      m_numWorldLights( 0 ),
+      m_worldDirectionalLights( NULL ),
+      m_numWorldDirectionalLights( 0 )
 {
     SetFov( DefaultFov );
 }
@@ -56,8 +94,6 @@ NOVA_EXPORT Camera::Camera( RenderingCanvas& renderingCanvas )
 NOVA_EXPORT Camera::~Camera()
 {
     m_shapeNodeList = NULL; // not owned, must not delete
-    free( m_visibleFaceList );
-    free( m_visibleFaceBuffer );
 }
 
 NOVA_EXPORT int Camera::SetFov( real_64 fov )
@@ -85,33 +121,22 @@ void Camera::SceneGraphDetached()
     delete m_ambientLight;
     m_ambientLight = NULL;
 
-    m_maxVisibleFaces = -1;
-    free( m_visibleFaceList );
-    m_visibleFaceList = NULL;
-    free( m_visibleFaceBuffer );
-    m_visibleFaceBuffer = NULL;
+    // forget the last frame
+    m_frameArena.Reset();
+    m_numVisibleFaces = 0;
+    m_firstFaceRun = NULL;
+    m_lastFaceRun = NULL;
+    m_worldLights = NULL;
+    m_numWorldLights = 0;
+    m_worldDirectionalLights = NULL;
+    m_numWorldDirectionalLights = 0;
+    m_visibleFaceKeys = NULL;
 }
 
 void Camera::SetShapeNodeList( const List<ShapeNode*>* shapeNodeList )
 {
     LOG_DEBUG("Camera::SetShapeNodeList()");
     m_shapeNodeList = shapeNodeList;
-
-    // calculate total number of polygons in the list of shapes 
-    int totalPolygons = 0;
-
-    ShapeNode* shapeNode;
-    for ( int i = 0; i < m_shapeNodeList->Count(); i++ )
-    {
-	if ( m_shapeNodeList->Get( i, shapeNode ) == NovaErrNone )
-	{
-	    totalPolygons += shapeNode->GetShape().GetNumPolygons();
-	}
-    }
-
-    // check that the visible face list buffer is large enough
-    CheckVisibleFaceBuffer( totalPolygons );
-    LOG_DEBUG("Camera::SetShapeNodeList() done.");
 }
 
 void Camera::SetLightNodeList( const List<LightNode*>* lightNodeList )
@@ -155,8 +180,18 @@ void Camera::SetAmbientLight( const AmbientLight* ambientLight )
 
 NOVA_EXPORT int Camera::Render()
 {
-    // reset number of visible faces to 0
+    // release the data of the previous frame
+    m_frameArena.Reset();
     m_numVisibleFaces = 0;
+    m_firstFaceRun = NULL;
+    m_lastFaceRun = NULL;
+
+    // take the light positions for this frame
+    int ret = CaptureLights();
+    if ( ret != NovaErrNone )
+    {
+        return ret;
+    }
 
     // transform camera 
     m_cameraNode->TransformBySceneGraph();
@@ -171,38 +206,88 @@ NOVA_EXPORT int Camera::Render()
     Matrix inverseCameraMatrix( m_cameraNode->GetCameraMatrix() );
     inverseCameraMatrix.InvertTransformation();
 
-    // process each shape node
-    for ( int i = 0; i < m_shapeNodeList->Count(); i++ ) 
+    // prepare the shapes in view and process them in batches. With 
+    // occluders in the scene, they are processed first and drawn into the 
+    // occlusion buffer, and the other shapes are tested against it.
+    int numShapeNodes = m_shapeNodeList->Count();
+    VisibleShape* visibleShapes = 
+        m_frameArena.AllocateArray<VisibleShape>( numShapeNodes );
+    if ( (visibleShapes == NULL) && (numShapeNodes > 0) )
     {
-        ShapeNode* shapeNode;
-        if ( m_shapeNodeList->Get( i, shapeNode ) == NovaErrNone )
-	{
-            ProcessShapeNode( *shapeNode, cameraPos, inverseCameraMatrix );
-	}
+        return NovaErrNoMemory;
     }
 
-    //LOG_DEBUG_F("visfaces = %d", m_numVisibleFaces);
+    m_isOcclusionCulling = false;
+    m_numOccludedShapes = 0;
+    if ( HasOccluders() )
+    {
+        ret = m_occlusionBuffer.Clear( m_canvas, m_perspectiveFactor, 
+                                       m_frameArena );
+        if ( ret == NovaErrNone )
+        {
+            ret = ProcessShapeNodes( ShapeNodesOccluders, cameraPos, 
+                                     inverseCameraMatrix, visibleShapes );
+        }
+        if ( ret != NovaErrNone )
+        {
+            return ret;
+        }
 
-    // initialize visible object pointer list for sorting
-    ScreenPolygon** face = m_visibleFaceList;
+        // all the faces so far are the occluders'
+        for ( const VisibleFaceRun* run = m_firstFaceRun; run != NULL; 
+              run = run->m_next )
+        {
+            for ( int i = 0; i < run->m_count; i++ )
+            {
+                m_occlusionBuffer.AddOccluder( run->m_faces[i] );
+            }
+        }
+        m_occlusionBuffer.BuildPyramid();
+        m_isOcclusionCulling = true;
 
-    for ( int i = 0; i < m_numVisibleFaces; i++ ) 
+        ret = ProcessShapeNodes( ShapeNodesOccludees, cameraPos, 
+                                 inverseCameraMatrix, visibleShapes );
+    }
+    else
     {
-        *face++ = &m_visibleFaceBuffer[i];
+        ret = ProcessShapeNodes( ShapeNodesAll, cameraPos, 
+                                 inverseCameraMatrix, visibleShapes );
+    }
+    if ( ret != NovaErrNone )
+    {
+        return ret;
     }
 
-    // quicksort all visible polygons to back-to-front order 
-    if ( m_numVisibleFaces > 0 ) 
+    //LOG_DEBUG_F("visfaces = %d", m_numVisibleFaces);
+
+    // collect the sort keys of the visible polygons and sort them to 
+    // back-to-front order
+    ret = BuildVisibleFaceKeys();
+    if ( ret == NovaErrNone )
+    {
+        ret = DepthSort();
+    }
+    if ( ret != NovaErrNone )
     {
-        DepthSort( 0, m_numVisibleFaces - 1 );
+        return ret;
     }
 
     // draws all transformed, clipped, projected and sorted polygons on the 
-    // camera's canvas
-    ScreenPolygon** visibleFace = m_visibleFaceList;
+    // camera's canvas. the textured polygons are set up a batch at a time
+    // just before drawing them, and drawn by their index in the batch
+    const ScreenPolygonKey* visibleFace = m_visibleFaceKeys;
+    int setupIndex = 0;
     for ( int i = 0; i < m_numVisibleFaces; i++ ) 
     {
-        ScreenPolygon* polygon = *visibleFace++;
+        if ( (i % TriangleSetupBatch::MaxTriangles) == 0 )
+        {
+            m_renderer.SetupTriangles( 
+                visibleFace, MIN( m_numVisibleFaces - i, 
+                                  TriangleSetupBatch::MaxTriangles ) );
+            setupIndex = 0;
+        }
+
+        ScreenPolygon* polygon = (visibleFace++)->m_polygon;
 
         if ( polygon->m_texture == NULL ) 
 	{
@@ -211,21 +296,16 @@ NOVA_EXPORT int Camera::Render()
 	} 
         else 
 	{
-            // polygon has texture; calculate 1/z, u/z, v/z for texture 
-	    // mapping for all vertices
-            nova3d::CalculateInverses( polygon->m_v1 );
-            nova3d::CalculateInverses( polygon->m_v2 );
-            nova3d::CalculateInverses( polygon->m_v3 );
-
             // select renderer based on whether polygon is to 
 	    // illuminated or not
 	    if ( polygon->m_polygonFlags & PolygonInfoIlluminated ) 
 	    {
-		m_renderer.DrawLightedTexturedTriangle( polygon );
+		m_renderer.DrawLightedTexturedTriangle( polygon, 
+							setupIndex++ );
 	    } 
 	    else 
 	    {
-		m_renderer.DrawTexturedTriangle( polygon );
+		m_renderer.DrawTexturedTriangle( polygon, setupIndex++ );
 	    }
 	}
     }
@@ -263,92 +343,94 @@ NOVA_EXPORT void Camera::RenderingCanvasUpdated()
     }
 }
 
-// The implementation is a QuickSort
-void Camera::DepthSort( int_32 left, int_32 right )
+NOVA_EXPORT void Camera::SetRasterizer( Renderer::Rasterizer rasterizer )
 {
-    int_32 qleft = left;
-    int_32 qright = right;
-    int_32 qpivot = 
-        (*(m_visibleFaceList + ((qleft + qright) >> 1)))->m_zSortValue;
-
-    do {
-	while( ((*(m_visibleFaceList + qleft))->m_zSortValue > qpivot) && 
-	       (qleft < right) ) 
+    m_renderer.SetRasterizer( rasterizer );
+}
+
+// The implementation is a stable 8-bit LSD radix sort on the depth keys
+int Camera::DepthSort()
+{
+    if ( m_numVisibleFaces < 2 )
+    {
+        return NovaErrNone;
+    }
+
+    ScreenPolygonKey* buffer = 
+        m_frameArena.AllocateArray<ScreenPolygonKey>( m_numVisibleFaces );
+    if ( buffer == NULL )
+    {
+        return NovaErrNoMemory;
+    }
+
+    // least significant digit first radix sort, 8 bits per pass. the sort
+    // is stable so each pass keeps the order of the previous ones.
+    ScreenPolygonKey* src = m_visibleFaceKeys;
+    ScreenPolygonKey* dst = buffer;
+    for ( int shift = 0; shift < 32; shift += 8 )
+    {
+        int counts[256];
+        memset( counts, 0, sizeof(counts) );
+        for ( int i = 0; i < m_numVisibleFaces; i++ )
 	{
-	    qleft++;
+            counts[(src[i].m_depthKey >> shift) & 0xff]++;
 	}
-        
-	while( (qpivot > (*(m_visibleFaceList + qright))->m_zSortValue) && 
-	       (qright > left) ) 
+
+        // skip the pass if all the keys have the same digit; this is 
+        // common for the high bits
+        if ( counts[(src[0].m_depthKey >> shift) & 0xff] == 
+             m_numVisibleFaces )
 	{
-	    qright--;
+            continue;
 	}
-	
-	if ( qleft <= qright ) 
+
+        // turn the counts into starting offsets
+        int offset = 0;
+        for ( int i = 0; i < 256; i++ )
 	{
-	    // swap elements 
-	    ScreenPolygon *tmp = *(m_visibleFaceList + qright);
-	    *(m_visibleFaceList + qright) = *(m_visibleFaceList + qleft);
-	    *(m_visibleFaceList + qleft) = tmp;
-	    qleft++;
-	    qright--;
+            int count = counts[i];
+            counts[i] = offset;
+            offset += count;
 	}
-    } while( qleft <= qright );
-    
-    // recursively sort left side
-    if ( left < qright ) 
-    {
-	DepthSort( left, qright );
-    }
 
-    // recursively sort right side
-    if ( qleft < right ) 
-    {
-	DepthSort( qleft, right );
+        for ( int i = 0; i < m_numVisibleFaces; i++ )
+	{
+            dst[counts[(src[i].m_depthKey >> shift) & 0xff]++] = src[i];
+	}
+
+        ScreenPolygonKey* tmp = src;
+        src = dst;
+        dst = tmp;
     }
+
+    m_visibleFaceKeys = src;
+
+    return NovaErrNone;
 }
 
-int Camera::CheckVisibleFaceBuffer( int numPolygons )
+int Camera::BuildVisibleFaceKeys()
 {
-    LOG_DEBUG_F("Camera::CheckVisibleFaceBuffer() = %d", numPolygons);
-
-    // maximum number of visible polygons is two times the amount of
-    // polygons in the whole scene due to the clipping.
-    int maxVisiblePolygons = numPolygons * 2;
-
-    // check that the visible faces buffer is large enough.
-    // if not, make it larger. if it is larger than required,
-    // make it smaller to reduce memory consumption.
-    if ( m_maxVisibleFaces != maxVisiblePolygons ) 
-    {
-        // delete current allocations
-        free( m_visibleFaceList );
-        m_visibleFaceList = NULL;
-        free( m_visibleFaceBuffer );
-        m_visibleFaceBuffer = NULL;
-	
-        // save new max amount of screen polygons
-        m_maxVisibleFaces = maxVisiblePolygons;
-
-        // reallocate
-        size_t bufferSize = m_maxVisibleFaces * sizeof(ScreenPolygon);
-        m_visibleFaceBuffer = (ScreenPolygon*)malloc( bufferSize );
-        if ( m_visibleFaceBuffer == NULL )
-	{
-            return NovaErrNoMemory;
-	}
+    m_visibleFaceKeys = 
+	m_frameArena.AllocateArray<ScreenPolygonKey>( m_numVisibleFaces );
+    if ( (m_visibleFaceKeys == NULL) && (m_numVisibleFaces > 0) )
+    {
+        return NovaErrNoMemory;
+    }
 
-        size_t listSize = m_maxVisibleFaces * sizeof(ScreenPolygon*);
-        m_visibleFaceList = (ScreenPolygon**)malloc( listSize );
-        if ( m_visibleFaceList == NULL )
+    ScreenPolygonKey* key = m_visibleFaceKeys;
+    for ( VisibleFaceRun* run = m_firstFaceRun; run != NULL; 
+          run = run->m_next )
+    {
+        ScreenPolygon* face = run->m_faces;
+        for ( int i = 0; i < run->m_count; i++, face++, key++ )
 	{
-            free( m_visibleFaceBuffer );
-            m_visibleFaceBuffer = NULL;
-            return NovaErrNoMemory;
+            // the largest z of the face is its depth; invert it so that 
+            // the farthest face gets the smallest key
+            key->m_depthKey = ~(uint_32)SelectZsortValue( face->m_v1.m_z, 
+                                                          face->m_v2.m_z, 
+                                                          face->m_v3.m_z );
+            key->m_polygon = face;
 	}
-
-        // clear the buffer entries to all zeros
-        memset( m_visibleFaceBuffer, 0, bufferSize );
     }
 
     return NovaErrNone;
@@ -471,7 +553,7 @@ void Camera::EnvironmentMapFace( Shape& shape, int polygonIndex,
     v2 = (int_32)(normal_v2->GetFixedY() * halfTexHeight + halfTexHeightFixed);
 }
 
-void Camera::ProcessPolygonList( Shape& shape )
+int Camera::ProcessPolygonList( Shape& shape )
 {
     //##TODO## break this down to (inline) methods
 
@@ -493,6 +575,32 @@ void Camera::ProcessPolygonList( Shape& shape )
     const int_32* texCoord = shape.GetTextureCoordinates();
     const uint_32* polyInfo = shape.GetPolygonInfo();
     const int_32* lightIntensity = shape.GetLightingIntensities();
+
+    // count the polygons that survived backface culling; near clipping
+    // can split each of them into at most two faces
+    int numVisiblePolygons = 0;
+    for ( int i = 0; i < numPolygons; i++ ) 
+    {
+        if ( (polyInfo[i] & PolygonInfoVisible) != 0 )
+	{
+            numVisiblePolygons++;
+	}
+    }
+
+    if ( numVisiblePolygons == 0 )
+    {
+        return NovaErrNone;
+    }
+
+    // allocate the worst case amount of faces; the unused tail is given
+    // back to the arena afterwards
+    ScreenPolygon* faces = 
+	m_frameArena.AllocateArray<ScreenPolygon>( 2 * numVisiblePolygons );
+    if ( faces == NULL )
+    {
+        return NovaErrNoMemory;
+    }
+    m_nextFace = faces;
     
     // process all polygons adding all visible ones to the visible list
     for( int i = 0; i < numPolygons; i++ ) 
@@ -618,16 +726,14 @@ void Camera::ProcessPolygonList( Shape& shape )
             if ( count >= 3 ) 
 	    {
                 // one or more triangles; the first is defined by points 0,1,2 
-                ScreenPolygon* face = &(m_visibleFaceBuffer[m_numVisibleFaces]);
-                face->m_zSortValue = 
-		    SelectZsortValue( z_buffer[0], z_buffer[1], z_buffer[2] );
+                ScreenPolygon* face = m_nextFace;
                 
                 PerspectiveProject(*face, 
                                    x_buffer[0], y_buffer[0], z_buffer[0],
                                    x_buffer[1], y_buffer[1], z_buffer[1],
-                                   x_buffer[2], y_buffer[2], z_buffer[2]);
+                                   x_buffer[2], y_buffer[2], z_buffer[2],
+                                   polyFlags);
 
-                face->m_polygonFlags = polyFlags;
                 face->m_texture = texture;
 
                 if ( texture != NULL ) 
@@ -664,17 +770,14 @@ void Camera::ProcessPolygonList( Shape& shape )
                 if ( count == 4 ) 
 		{
                     // yes - add the another too; it is defined by points 0,2,3
-                    ScreenPolygon* face = 
-			&(m_visibleFaceBuffer[m_numVisibleFaces]);
-                    face->m_zSortValue = 
-			SelectZsortValue(z_buffer[0], z_buffer[2], z_buffer[3]);
+                    ScreenPolygon* face = m_nextFace;
 
                     PerspectiveProject(*face, 
                                        x_buffer[0], y_buffer[0], z_buffer[0],
                                        x_buffer[2], y_buffer[2], z_buffer[2],
-                                       x_buffer[3], y_buffer[3], z_buffer[3]);
+                                       x_buffer[3], y_buffer[3], z_buffer[3],
+                                       polyFlags);
 
-                    face->m_polygonFlags = polyFlags;
                     face->m_texture = texture;
 
                     if ( texture != NULL ) 
@@ -712,12 +815,11 @@ void Camera::ProcessPolygonList( Shape& shape )
 	else 
 	{
             // no near clipping needed
-            ScreenPolygon* face = &(m_visibleFaceBuffer[m_numVisibleFaces]);
-            face->m_zSortValue = SelectZsortValue( z1, z2, z3 );
+            ScreenPolygon* face = m_nextFace;
 
-            PerspectiveProject( *face, x1, y1, z1, x2, y2, z2, x3, y3, z3 );
+            PerspectiveProject( *face, x1, y1, z1, x2, y2, z2, x3, y3, z3,
+                                polyFlags );
             
-            face->m_polygonFlags = polyFlags;
             face->m_texture = texture;
 
             if ( texture != NULL ) 
@@ -748,20 +850,133 @@ void Camera::ProcessPolygonList( Shape& shape )
             }
         }
     }
-    
+
+    // give back the faces that were not needed and record the run
+    int numFaces = m_nextFace - faces;
+    m_frameArena.Trim( m_nextFace );
+    if ( numFaces == 0 )
+    {
+        return NovaErrNone;
+    }
+
+    VisibleFaceRun* run = m_frameArena.AllocateArray<VisibleFaceRun>( 1 );
+    if ( run == NULL )
+    {
+        return NovaErrNoMemory;
+    }
+    run->m_faces = faces;
+    run->m_count = numFaces;
+    run->m_next = NULL;
+    if ( m_lastFaceRun != NULL )
+    {
+        m_lastFaceRun->m_next = run;
+    }
+    else
+    {
+        m_firstFaceRun = run;
+    }
+    m_lastFaceRun = run;
+
+    return NovaErrNone;
+}
+
+bool Camera::HasOccluders() const
+{
+    ShapeNode* const* shapeNode = m_shapeNodeList->Begin();
+    ShapeNode* const* shapeNodeEnd = m_shapeNodeList->End();
+    for ( ; shapeNode != shapeNodeEnd; shapeNode++ ) 
+    {
+        if ( (*shapeNode)->GetShape().IsOccluder() )
+        {
+            return true;
+        }
+    }
+
+    return false;
 }
 
-void Camera::ProcessShapeNode( ShapeNode& shapeNode,
+// The transformed geometry is stored in the shape, so a shape used by 
+// several nodes starts a new batch each time it is met again.
+int Camera::ProcessShapeNodes( ShapeNodeSelection selection, 
                                Vector& cameraPos, 
-                               Matrix& inverseCameraMatrix )
+                               Matrix& inverseCameraMatrix,
+                               VisibleShape* visibleShapes )
 {
-    //    LOG_DEBUG("Camera::ProcessShapeNode()");
+    int numVisibleShapes = 0;
+
+    ShapeNode* const* shapeNode = m_shapeNodeList->Begin();
+    ShapeNode* const* shapeNodeEnd = m_shapeNodeList->End();
+    for ( ; shapeNode != shapeNodeEnd; shapeNode++ ) 
+    {
+        const Shape* shape = &(*shapeNode)->GetShape();
+        if ( ((selection == ShapeNodesOccluders) && !shape->IsOccluder()) ||
+             ((selection == ShapeNodesOccludees) && shape->IsOccluder()) )
+        {
+            continue;
+        }
+
+        for ( int i = 0; i < numVisibleShapes; i++ )
+        {
+            if ( &visibleShapes[i].m_shapeNode->GetShape() == shape )
+            {
+                int ret = ProcessVisibleShapes( visibleShapes, 
+                                                numVisibleShapes );
+                if ( ret != NovaErrNone )
+                {
+                    return ret;
+                }
+                numVisibleShapes = 0;
+                break;
+            }
+        }
+
+        if ( PrepareShapeNode( **shapeNode, cameraPos, inverseCameraMatrix,
+                               visibleShapes[numVisibleShapes] ) )
+        {
+            numVisibleShapes++;
+        }
+    }
+
+    return ProcessVisibleShapes( visibleShapes, numVisibleShapes );
+}
 
+bool Camera::PrepareShapeNode( ShapeNode& shapeNode,
+                               Vector& cameraPos, 
+                               Matrix& inverseCameraMatrix,
+                               VisibleShape& visibleShape )
+{
     Shape& shape = shapeNode.GetShape();
     
     // transform the shape
     shapeNode.TransformBySceneGraph();
 
+    // skip the shape altogether if its bounding sphere is completely 
+    // outside the view frustum
+    if ( shape.GetBoundingSphereRadius() >= 0 )
+    {
+        Matrix cameraSpaceMatrix( shapeNode.GetObjectMatrix() );
+        cameraSpaceMatrix.MultiplyAndSet( cameraSpaceMatrix, 
+                                          inverseCameraMatrix );
+
+        BoundingSphere boundingSphere;
+        boundingSphere.m_location.TransformAndSet( 
+            cameraSpaceMatrix, shape.GetBoundingSphere().m_location );
+        boundingSphere.m_radius = shape.GetBoundingSphereRadius();
+        if ( (m_frustum.EvaluateClipping( boundingSphere ) & 
+              FrustumOutsideMask) != 0 )
+        {
+            return false;
+        }
+
+        // or hidden behind the occluders
+        if ( m_isOcclusionCulling && 
+             m_occlusionBuffer.IsOccluded( boundingSphere ) )
+        {
+            m_numOccludedShapes++;
+            return false;
+        }
+    }
+
     // transform camera position to object space using the inverse 
     // object transformation
     const Matrix& objectMatrix = shapeNode.GetObjectMatrix();
@@ -776,33 +991,89 @@ void Camera::ProcessShapeNode( ShapeNode& shapeNode,
     cameraObjectSpacePos.TransformAndSet( inverseObjectMatrix, 
                                           cameraObjectSpacePos );
 
-    // perform backface removal in object space
-    shape.BackfaceCull( cameraObjectSpacePos );
-
-    // if the shape is to receive lighting, apply it
-    if ( shape.IsIlluminated() ) 
-    {
-        ApplyLightingToShape( shape, objectPos, inverseObjectMatrix );
-    }
+    visibleShape.m_shapeNode = &shapeNode;
+    visibleShape.m_cameraObjectSpacePos.Set( cameraObjectSpacePos );
+    visibleShape.m_objectPos.Set( objectPos );
+    visibleShape.m_inverseObjectMatrix.Set( inverseObjectMatrix );
+    visibleShape.m_lights = NULL;
+    visibleShape.m_numLights = 0;
+    visibleShape.m_directionalLights = NULL;
+    visibleShape.m_numDirectionalLights = 0;
+    visibleShape.m_lightingBuffer = NULL;
 
     // transform the object matrix by the inverse camera transformation
     // to bring it to the camera space
     shapeNode.TransformByCamera( inverseCameraMatrix );
 
+    return true;
+}
+
+void Camera::TransformVisibleShape( VisibleShape& visibleShape ) const
+{
+    ShapeNode& shapeNode = *visibleShape.m_shapeNode;
+    Shape& shape = shapeNode.GetShape();
+
+    // perform backface removal in object space
+    shape.BackfaceCull( visibleShape.m_cameraObjectSpacePos );
+
     // transform all geometry in the shape with the combined transform
     // object space -> camera space
     shape.TransformAll( shapeNode.GetObjectMatrix() );
 
-    // process all polygons: each polygon of the shape is near clipped,
-    // perspective transformed and all the visible polygons are added
-    // to the list of visible polygons
-    ProcessPolygonList( shape );
+    // if the shape is to receive lighting, apply it
+    if ( visibleShape.m_lightingBuffer != NULL ) 
+    {
+        shape.ApplyLighting( *m_ambientLight, visibleShape.m_lights, 
+                             visibleShape.m_numLights, 
+                             visibleShape.m_directionalLights,
+                             visibleShape.m_numDirectionalLights,
+                             visibleShape.m_lightingBuffer );
+    }
+}
+
+int Camera::ProcessVisibleShapes( VisibleShape* visibleShapes, int count )
+{
+    // the lights and the scratch space are taken from the frame arena 
+    // before going parallel. prelit shapes keep their stored lighting.
+    for ( int i = 0; i < count; i++ )
+    {
+        const Shape& shape = visibleShapes[i].m_shapeNode->GetShape();
+        if ( shape.IsIlluminated() && !shape.IsPrelit() )
+        {
+            int ret = PrepareShapeLighting( visibleShapes[i] );
+            if ( ret != NovaErrNone )
+            {
+                return ret;
+            }
+        }
+    }
+
+    // the shapes only touch their own data and read the lights
+    ShapeGeometryBody body( *this, visibleShapes );
+    JobSystem::Instance().ParallelFor( 0, count, 1, body );
+
+    for ( int i = 0; i < count; i++ )
+    {
+        Shape& shape = visibleShapes[i].m_shapeNode->GetShape();
+
+        // process all polygons: each polygon of the shape is near clipped,
+        // perspective transformed and all the visible polygons are added
+        // to the list of visible polygons
+        int ret = ProcessPolygonList( shape );
+        if ( ret != NovaErrNone )
+        {
+            return ret;
+        }
+    }
+
+    return NovaErrNone;
 }
 
 void Camera::PerspectiveProject( ScreenPolygon& polygon, 
                                  int_32 x1, int_32 y1, int_32 z1,
                                  int_32 x2, int_32 y2, int_32 z2,
-                                 int_32 x3, int_32 y3, int_32 z3 )
+                                 int_32 x3, int_32 y3, int_32 z3,
+                                 uint_32 polyFlags )
 {
     int_32 proj_x1, proj_y1, proj_x2, proj_y2, proj_x3, proj_y3;
     int_32 inv_z;
@@ -837,7 +1108,43 @@ void Camera::PerspectiveProject( ScreenPolygon& polygon,
     polygon.m_v3.m_y = proj_y3 + centery;
     polygon.m_v3.m_z = z3;
 
+    // screen bounding box of the polygon
+    int_32 min_x = MIN( polygon.m_v1.m_x, 
+                        MIN( polygon.m_v2.m_x, polygon.m_v3.m_x ) );
+    int_32 max_x = MAX( polygon.m_v1.m_x, 
+                        MAX( polygon.m_v2.m_x, polygon.m_v3.m_x ) );
+    int_32 min_y = MIN( polygon.m_v1.m_y, 
+                        MIN( polygon.m_v2.m_y, polygon.m_v3.m_y ) );
+    int_32 max_y = MAX( polygon.m_v1.m_y, 
+                        MAX( polygon.m_v2.m_y, polygon.m_v3.m_y ) );
+
+    // reject the polygon if it would not cover any pixels on the canvas;
+    // this includes polygons crossing no scanline at all, as the renderer 
+    // draws the scanlines [ceil(min_y), ceil(max_y)). the edge 
+    // interpolation may stray slightly outside the bounding box 
+    // horizontally, hence the guard margin
+    int_32 margin = ScreenGuardMargin << FixedPointPrec;
+    if ( (::CeilFixed( min_y ) == ::CeilFixed( max_y )) || 
+         (max_y <= (m_canvas.m_top << FixedPointPrec)) || 
+         (min_y > ((m_canvas.m_bottom - 1) << FixedPointPrec)) ||
+         (max_x < ((m_canvas.m_left << FixedPointPrec) - margin)) || 
+         (min_x > ((m_canvas.m_right << FixedPointPrec) + margin)) )
+    {
+        return;
+    }
+
+    // polygons well inside the canvas need no 2D clipping in the renderer
+    if ( (min_y >= (m_canvas.m_top << FixedPointPrec)) && 
+         (max_y <= (m_canvas.m_bottom << FixedPointPrec)) && 
+         (min_x >= ((m_canvas.m_left << FixedPointPrec) + margin)) && 
+         (max_x <= ((m_canvas.m_right << FixedPointPrec) - margin)) )
+    {
+        polyFlags |= ScreenPolygonInsideCanvas;
+    }
+    polygon.m_polygonFlags = (uint_16)polyFlags;
+
     // mark this face added to the list of visible faces
+    m_nextFace++;
     m_numVisibleFaces++;
 }
 
@@ -859,32 +1166,98 @@ bool Camera::GetLookAt( Vector& location )
     }
 }
 
-void Camera::ApplyLightingToShape( Shape& shape, Vector& objectPos, 
-                                   Matrix& inverseObjectMatrix )
+int Camera::CaptureLights()
 {
-    // transform all lights to the shape's object space
-    for ( int i = 0; i < m_lightNodeList->Count(); i++ )
+    m_numWorldLights = 0;
+    m_numWorldDirectionalLights = 0;
+    m_worldLights = 
+        m_frameArena.AllocateArray<PointLightInstance>( 
+            m_lightNodeList->Count() );
+    m_worldDirectionalLights = 
+        m_frameArena.AllocateArray<DirectionalLightInstance>( 
+            m_lightNodeList->Count() );
+    if ( (m_worldLights == NULL) || (m_worldDirectionalLights == NULL) )
     {
-	LightNode* lightNode;
-	if ( m_lightNodeList->Get( i, lightNode ) != NovaErrNone )
-	{
-	    // could not fetch a light node at this index
-	    continue;
-	}
+        return NovaErrNoMemory;
+    }
 
-	Light& light = lightNode->GetLight();
+    LightNode* const* lightNode = m_lightNodeList->Begin();
+    LightNode* const* lightNodeEnd = m_lightNodeList->End();
+    for ( ; lightNode != lightNodeEnd; lightNode++ )
+    {
+	const Light& light = (*lightNode)->GetLight();
         if ( light.GetType() == Light::TypePoint )
 	{
-            PointLight& pointLight = 
-		static_cast<PointLight&>(light);
-            Vector lightObjectSpacePos( pointLight.GetPosition(), objectPos );
-            lightObjectSpacePos.TransformAndSet( inverseObjectMatrix, 
-                                                 lightObjectSpacePos );
-            pointLight.SetPosition( lightObjectSpacePos );
-	}            
+            PointLightInstance& worldLight = m_worldLights[m_numWorldLights++];
+            worldLight.m_light = static_cast<const PointLight*>(&light);
+            (*lightNode)->CalculateWorldPosition( worldLight.m_position );
+	}
+        else if ( light.GetType() == Light::TypeDirectional )
+	{
+            DirectionalLightInstance& worldLight = 
+                m_worldDirectionalLights[m_numWorldDirectionalLights++];
+            worldLight.m_light = static_cast<const DirectionalLight*>(&light);
+            (*lightNode)->CalculateWorldDirection( worldLight.m_direction );
+	}
     }
-    
-    shape.ApplyLighting( *m_ambientLight, *m_lightNodeList );
+
+    return NovaErrNone;
+}
+
+int Camera::PrepareShapeLighting( VisibleShape& visibleShape )
+{
+    Shape& shape = visibleShape.m_shapeNode->GetShape();
+
+    PointLightInstance* lights = 
+        m_frameArena.AllocateArray<PointLightInstance>( m_numWorldLights );
+    DirectionalLightInstance* directionalLights = 
+        m_frameArena.AllocateArray<DirectionalLightInstance>( 
+            m_numWorldDirectionalLights );
+    int_32* lightingBuffer = 
+	m_frameArena.AllocateArray<int_32>( shape.GetLightingBufferSize() );
+    if ( (lights == NULL) || (directionalLights == NULL) || 
+         (lightingBuffer == NULL) )
+    {
+        return NovaErrNoMemory;
+    }
+
+    // transform the lights to the shape's object space and keep the ones
+    // that reach the shape's bounding sphere
+    int numLights = 0;
+    for ( int i = 0; i < m_numWorldLights; i++ )
+    {
+        const PointLightInstance& worldLight = m_worldLights[i];
+        PointLightInstance& light = lights[numLights];
+
+        light.m_light = worldLight.m_light;
+        light.m_position.SubstractAndSet( worldLight.m_position, 
+                                          visibleShape.m_objectPos );
+        light.m_position.TransformAndSet( visibleShape.m_inverseObjectMatrix, 
+                                          light.m_position );
+        if ( light.m_light->Reaches( light.m_position, 
+                                     shape.GetBoundingSphere() ) )
+        {
+            numLights++;
+        }
+    }
+
+    // the directional lights reach everything; only their direction is 
+    // turned to the object space
+    for ( int i = 0; i < m_numWorldDirectionalLights; i++ )
+    {
+        directionalLights[i].m_light = m_worldDirectionalLights[i].m_light;
+        directionalLights[i].m_direction.RotateAndSet( 
+            visibleShape.m_inverseObjectMatrix, 
+            m_worldDirectionalLights[i].m_direction );
+    }
+
+    visibleShape.m_lights = lights;
+    visibleShape.m_numLights = numLights;
+    visibleShape.m_directionalLights = directionalLights;
+    visibleShape.m_numDirectionalLights = m_numWorldDirectionalLights;
+    visibleShape.m_lightingBuffer = lightingBuffer;
+
+    return NovaErrNone;
 }
 
 }; // namespace
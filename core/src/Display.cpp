@@ -96,6 +96,22 @@ NOVA_EXPORT uint_32 ConvertColor( uint_32 color, NovaPixelFormat fromFormat,
 {
     int_32 red, green, blue;
     SplitColor( fromFormat, color, red, green, blue );
+
+    // rescale the components to the range of the target format
+    int_32 fromRed = 0, fromGreen = 0, fromBlue = 0;
+    int_32 toRed = 0, toGreen = 0, toBlue = 0;
+    GetColorLimits( fromFormat, fromRed, fromGreen, fromBlue );
+    GetColorLimits( toFormat, toRed, toGreen, toBlue );
+    if ( (fromRed <= 0) || (fromGreen <= 0) || (fromBlue <= 0) )
+    {
+	// bad pixel format
+	return 0;
+    }
+
+    red = (red * toRed + (fromRed >> 1)) / fromRed;
+    green = (green * toGreen + (fromGreen >> 1)) / fromGreen;
+    blue = (blue * toBlue + (fromBlue >> 1)) / fromBlue;
+
     return CreateColor( toFormat, red, green, blue );
 }
 
@@ -164,4 +180,51 @@ NOVA_EXPORT void ScaleColor( NovaPixelFormat pixelFormat,
     if ( blue > blueLimit ) blue = blueLimit;
 }
 
+NOVA_EXPORT void GetModulateMasks( NovaPixelFormat pixelFormat, 
+				   ModulateMasks& masks )
+{
+    // the red component is moved to bit 16 at the lowest, leaving 8 bits
+    // above the blue component of any format
+    switch ( pixelFormat )
+    {
+    case PixelFormat888:
+	masks.m_redMask = 0xff0000;
+	masks.m_greenMask = 0x00ff00;
+	masks.m_blueMask = 0x0000ff;
+	masks.m_redShift = 0;
+	break;
+    case PixelFormat444:
+	masks.m_redMask = 0xf00;
+	masks.m_greenMask = 0x0f0;
+	masks.m_blueMask = 0x00f;
+	masks.m_redShift = 8;
+	break;
+    case PixelFormat565:
+	masks.m_redMask = 0xf800;
+	masks.m_greenMask = 0x07e0;
+	masks.m_blueMask = 0x001f;
+	masks.m_redShift = 5;
+	break;
+    case PixelFormat555:
+	masks.m_redMask = 0x7c00;
+	masks.m_greenMask = 0x03e0;
+	masks.m_blueMask = 0x001f;
+	masks.m_redShift = 6;
+	break;
+    case PixelFormat666:
+	masks.m_redMask = 0x3f000;
+	masks.m_greenMask = 0x00fc0;
+	masks.m_blueMask = 0x0003f;
+	masks.m_redShift = 4;
+	break;
+    case PixelFormatUndefined:
+    default: // bad pixel format
+	masks.m_redMask = 0;
+	masks.m_greenMask = 0;
+	masks.m_blueMask = 0;
+	masks.m_redShift = 0;
+	break;
+    };
+}
+
 }; // namespace
@@ -0,0 +1,153 @@
+/*
+ *  $Id$
+ *
+ *  Nova 3D Engine - A portable object oriented, scene graph based, 
+ *  lightweight real-time 3D software rendering framework. 
+ *  Copyright (C) 2001-2009 Matti Dahlbom
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Contact: Matti Dahlbom <matti at 777-team dot org>
+ */
+
+
+#include <stdlib.h>
+
+#include "FrameArena.h"
+#include "novalogging.h"
+
+namespace nova3d {
+
+NOVA_EXPORT FrameArena::FrameArena( size_t initialSize )
+    : m_block( NULL ),
+      m_previousUsed( 0 ),
+      m_capacity( 0 ),
+      m_highWaterMark( 0 ),
+      m_initialSize( initialSize )
+{
+}
+
+NOVA_EXPORT FrameArena::~FrameArena()
+{
+    LOG_DEBUG_F("FrameArena::~FrameArena() high water mark = %u bytes", 
+		(uint_32)m_highWaterMark);
+    FreeBlocks();
+}
+
+FrameArena::Block* FrameArena::NewBlock( size_t size )
+{
+    Block* block = (Block*)malloc( HeaderSize() + size );
+    if ( block == NULL )
+    {
+	return NULL;
+    }
+
+    block->m_next = NULL;
+    block->m_size = size;
+    block->m_used = 0;
+    m_capacity += size;
+
+    return block;
+}
+
+void FrameArena::FreeBlocks()
+{
+    while ( m_block != NULL )
+    {
+	Block* next = m_block->m_next;
+	free( m_block );
+	m_block = next;
+    }
+
+    m_capacity = 0;
+    m_previousUsed = 0;
+}
+
+NOVA_EXPORT void* FrameArena::Allocate( size_t size )
+{
+    size = (size + FrameArenaAlignment - 1) & ~(FrameArenaAlignment - 1);
+
+    if ( (m_block == NULL) || ((m_block->m_size - m_block->m_used) < size) )
+    {
+	// chain in a new block at least as large as everything so far so 
+	// that the number of blocks per frame stays logarithmic
+	size_t blockSize = (m_capacity > m_initialSize) ? 
+	    m_capacity : m_initialSize;
+	if ( blockSize < size )
+	{
+	    blockSize = size;
+	}
+
+	Block* block = NewBlock( blockSize );
+	if ( block == NULL )
+	{
+	    return NULL;
+	}
+
+	if ( m_block != NULL )
+	{
+	    m_previousUsed += m_block->m_used;
+	}
+	block->m_next = m_block;
+	m_block = block;
+    }
+
+    void* p = BlockData( m_block ) + m_block->m_used;
+    m_block->m_used += size;
+
+    size_t used = m_previousUsed + m_block->m_used;
+    if ( used > m_highWaterMark )
+    {
+	m_highWaterMark = used;
+    }
+
+    return p;
+}
+
+NOVA_EXPORT void FrameArena::Trim( const void* end )
+{
+    if ( m_block == NULL )
+    {
+	return;
+    }
+
+    uint_8* data = BlockData( m_block );
+    const uint_8* p = (const uint_8*)end;
+    if ( (p >= data) && (p <= (data + m_block->m_used)) )
+    {
+	size_t used = p - data;
+	m_block->m_used = 
+	    (used + FrameArenaAlignment - 1) & ~(FrameArenaAlignment - 1);
+    }
+}
+
+NOVA_EXPORT void FrameArena::Reset()
+{
+    if ( (m_block != NULL) && (m_block->m_next != NULL) )
+    {
+	// the last frame did not fit in one block; replace the chain with
+	// a single block large enough for the largest frame so far
+	FreeBlocks();
+	m_block = NewBlock( m_highWaterMark );
+    }
+
+    if ( m_block != NULL )
+    {
+	m_block->m_used = 0;
+    }
+    m_previousUsed = 0;
+}
+
+}; // namespace
@@ -22,13 +22,21 @@
  * Contact: Matti Dahlbom <matti at 777-team dot org>
  */
 
+#include <math.h>
+
 #include "Frustum.h"
 
 namespace nova3d {
 
+// a triangle clipped against the five frustum planes has at most 8 vertices
+const int MaxClippedVertices = 8;
+
 Frustum::Frustum()
     {
-    //##TODO##
+    // allocate the clipping work lists up front so that clipping never 
+    // reallocates during rendering
+    m_vertexList1.Reserve( MaxClippedVertices );
+    m_vertexList2.Reserve( MaxClippedVertices );
     }
 
 Frustum::~Frustum()
@@ -39,13 +47,82 @@ Frustum::~Frustum()
 void Frustum::Calculate( real_64 fov, const RenderingCanvas& canvas, 
                          int_32 nearClipZ )
     {
-    //##TODO##
+    // the planes are set up in camera space with their normals pointing 
+    // out of the frustum. the side planes go through the origin and the 
+    // edges of the canvas at the depth where the projection is 1:1.
+    real_64 tangent = tan( (M_PI * (fov / 2.0)) / 180.0 );
+    real_64 halfWidth = tangent;
+    real_64 halfHeight = tangent * canvas.m_height / canvas.m_width;
+
+    Vector origin;
+    Vector unitX( 1.0, 0.0, 0.0 );
+    Vector unitY( 0.0, 1.0, 0.0 );
+
+    m_rightPlane.Calculate( origin, unitY, Vector( halfWidth, 0.0, 1.0 ) );
+    m_leftPlane.Calculate( origin, Vector( -halfWidth, 0.0, 1.0 ), unitY );
+    m_topPlane.Calculate( origin, Vector( 0.0, halfHeight, 1.0 ), unitX );
+    m_bottomPlane.Calculate( origin, unitX, 
+                             Vector( 0.0, -halfHeight, 1.0 ) );
+
+    Vector nearOrigin, nearX, nearY;
+    nearOrigin.SetFixed( 0, 0, nearClipZ );
+    nearX.SetFixed( FixedPointOne, 0, nearClipZ );
+    nearY.SetFixed( 0, FixedPointOne, nearClipZ );
+    m_nearPlane.Calculate( nearOrigin, nearY, nearX );
     }
 
 int_32 Frustum::EvaluateClipping( const BoundingSphere& aBoundingSphere )
     {
-    //##TODO##
-    return 0;
+    int_32 maskBits = 0;
+    EvalPlane( maskBits, FrustumNearClipMask, m_nearPlane, aBoundingSphere );
+    EvalPlane( maskBits, FrustumRightClipMask, m_rightPlane, 
+               aBoundingSphere );
+    EvalPlane( maskBits, FrustumTopClipMask, m_topPlane, aBoundingSphere );
+    EvalPlane( maskBits, FrustumLeftClipMask, m_leftPlane, aBoundingSphere );
+    EvalPlane( maskBits, FrustumBottomClipMask, m_bottomPlane, 
+               aBoundingSphere );
+
+    return maskBits;
+    }
+
+int_32 Frustum::EvaluateClipping( const BoundingBox& boundingBox )
+    {
+    const PlaneEquation* planes[] = 
+        { &m_nearPlane, &m_rightPlane, &m_topPlane, &m_leftPlane, 
+          &m_bottomPlane };
+    const int_32 planeMasks[] = 
+        { FrustumNearClipMask, FrustumRightClipMask, FrustumTopClipMask, 
+          FrustumLeftClipMask, FrustumBottomClipMask };
+
+    int_32 min[3], max[3];
+    boundingBox.m_min.GetFixed( min[0], min[1], min[2] );
+    boundingBox.m_max.GetFixed( max[0], max[1], max[2] );
+
+    int_32 maskBits = 0;
+    for ( int i = 0; i < 5; i++ )
+        {
+        // the corners nearest to and farthest along the plane normal
+        int_32 n[3];
+        planes[i]->GetNormal().GetFixed( n[0], n[1], n[2] );
+        Vector nearCorner, farCorner;
+        nearCorner.SetFixed( (n[0] >= 0) ? min[0] : max[0], 
+                             (n[1] >= 0) ? min[1] : max[1], 
+                             (n[2] >= 0) ? min[2] : max[2] );
+        farCorner.SetFixed( (n[0] >= 0) ? max[0] : min[0], 
+                            (n[1] >= 0) ? max[1] : min[1], 
+                            (n[2] >= 0) ? max[2] : min[2] );
+
+        if ( planes[i]->DistanceFromPlaneFixed( nearCorner ) > 0 )
+            {
+            maskBits |= FrustumOutsideMask;
+            }
+        else if ( planes[i]->DistanceFromPlaneFixed( farCorner ) > 0 )
+            {
+            maskBits |= planeMasks[i];
+            }
+        }
+
+    return maskBits;
     }
 
 void Frustum::ClipTextured( int_32 clipPlanes, List<ScreenVertex>& vertexList,  
@@ -61,7 +138,17 @@ void Frustum::EvalPlane( int_32& maskBits,
                          const PlaneEquation& plane,
                          const BoundingSphere& boundingSphere )
     {
-    //##TODO##
+    int_32 distance = plane.DistanceFromPlaneFixed( boundingSphere.m_location );
+    if ( distance > boundingSphere.m_radius )
+        {
+        // completely outside this plane
+        maskBits |= FrustumOutsideMask;
+        }
+    else if ( distance > -boundingSphere.m_radius )
+        {
+        // intersects the plane
+        maskBits |= planeMask;
+        }
     }
 
 void Frustum::ClipLineAgainstPlane( const PlaneEquation& plane,
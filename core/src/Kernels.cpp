@@ -0,0 +1,340 @@
+/*
+ *  $Id$
+ *
+ *  Nova 3D Engine - A portable object oriented, scene graph based, 
+ *  lightweight real-time 3D software rendering framework. 
+ *  Copyright (C) 2001-2009 Matti Dahlbom
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Contact: Matti Dahlbom <matti at 777-team dot org>
+ */
+
+
+#include "Kernels.h"
+#include "Display.h"
+#include "Shape.h"
+#include "NovaErrors.h"
+#include "novalogging.h"
+
+namespace nova3d {
+
+// the kernels handle arrays of vectors as packed x, y, z triplets
+typedef char VectorIsPacked[(sizeof(Vector) == 3 * sizeof(int_32)) ? 1 : -1];
+
+// the selected kernels; m_transformVectors is NULL until selected
+static KernelTable kernelTable;
+
+// multiplies two fixed point values; unlike FixedLargeMul() this does 
+// not check for overflow, so that all the levels behave alike
+inline int_32 KernelMul( int_32 a, int_32 b )
+{
+    return (int_32)(((int_64)a * (int_64)b) >> FixedPointPrec);
+}
+
+void TransformVectorsScalar( const Matrix& matrix, 
+                             const Vector* src, Vector* dst, 
+                             const uint_32* vertexInfos, int count,
+                             bool translate )
+{
+    const int_32* m = matrix.GetFixedData();
+    const int_32* s = (const int_32*)src;
+    int_32* d = (int_32*)dst;
+    int_32 tx = translate ? m[3] : 0;
+    int_32 ty = translate ? m[MatrixDim + 3] : 0;
+    int_32 tz = translate ? m[2 * MatrixDim + 3] : 0;
+
+    for ( int i = 0; i < count; i++, s += 3, d += 3 )
+    {
+        if ( (vertexInfos != NULL) && 
+             ((vertexInfos[i] & VertexInfoVisible) == 0) )
+        {
+            continue;
+        }
+
+        int_32 x = s[0];
+        int_32 y = s[1];
+        int_32 z = s[2];
+        d[0] = KernelMul( m[0], x ) + KernelMul( m[1], y ) + 
+            KernelMul( m[2], z ) + tx;
+        d[1] = KernelMul( m[4], x ) + KernelMul( m[5], y ) + 
+            KernelMul( m[6], z ) + ty;
+        d[2] = KernelMul( m[8], x ) + KernelMul( m[9], y ) + 
+            KernelMul( m[10], z ) + tz;
+    }
+}
+
+void GouraudSpan888Scalar( uint_32* dst, int count,
+                           int_32 red, int_32 green, int_32 blue,
+                           int_32 redSlope, int_32 greenSlope, 
+                           int_32 blueSlope )
+{
+    for ( int i = 0; i < count; i++ )
+    {
+        *dst++ = PIXEL_888( (red >> FixedPointPrec), 
+                            (green >> FixedPointPrec), 
+                            (blue >> FixedPointPrec) );
+        red += redSlope;
+        green += greenSlope;
+        blue += blueSlope;
+    }
+}
+
+void PointLightScalar( const Vector& lightPos, 
+                       const Vector* coords, const Vector* normals,
+                       const uint_32* vertexIndices, 
+                       const uint_32* normalIndices, int count,
+                       int_32* intensities, int_32* distances )
+{
+    int_32 lx = lightPos.GetFixedX();
+    int_32 ly = lightPos.GetFixedY();
+    int_32 lz = lightPos.GetFixedZ();
+
+    for ( int i = 0; i < count; i++ )
+    {
+        const int_32* vertex = (const int_32*)(coords + vertexIndices[i]);
+        const int_32* normal = (const int_32*)(normals + normalIndices[i]);
+
+        // vector from the vertex to the light
+        int_32 x = lx - vertex[0];
+        int_32 y = ly - vertex[1];
+        int_32 z = lz - vertex[2];
+
+        // after the square root the fraction has only half the precision
+        uint_32 lengthSquared = (uint_32)(KernelMul( x, x ) + 
+                                          KernelMul( y, y ) + 
+                                          KernelMul( z, z ));
+        int_32 length = (int_32)::FastSqrt( lengthSquared );
+        distances[i] = length << (FixedPointPrec / 2);
+
+        int_32 dotProd = KernelMul( x, normal[0] ) + 
+            KernelMul( y, normal[1] ) + KernelMul( z, normal[2] );
+
+        // divide the dot product by the length to get the cosine
+        int_32 intensity = 0;
+        if ( length != 0 )
+        {
+            intensity = (dotProd / length) << (FixedPointPrec / 2);
+        }
+        intensities[i] = (intensity > 0) ? intensity : 0;
+    }
+}
+
+void DirectionalLightScalar( const Vector& towardsLight, 
+                             const Vector* normals,
+                             const uint_32* normalIndices, 
+                             int count, int_32* intensities )
+{
+    int_32 lx = towardsLight.GetFixedX();
+    int_32 ly = towardsLight.GetFixedY();
+    int_32 lz = towardsLight.GetFixedZ();
+
+    for ( int i = 0; i < count; i++ )
+    {
+        const int_32* normal = (const int_32*)(normals + normalIndices[i]);
+
+        // both are unit vectors so the dot product is the cosine
+        int_32 intensity = KernelMul( lx, normal[0] ) + 
+            KernelMul( ly, normal[1] ) + KernelMul( lz, normal[2] );
+        intensities[i] = (intensity > 0) ? intensity : 0;
+    }
+}
+
+void TriangleSetupScalar( TriangleSetupBatch& batch, int begin, int end )
+{
+    for ( int i = begin; i < end; i++ )
+    {
+	int mipLevel = batch.m_mipLevel[i];
+	for ( int vertex = 0; vertex < 3; vertex++ )
+	{
+	    int_32 z = (int_32)(MaxUint32 / (uint_32)batch.m_z[vertex][i]);
+	    batch.m_z[vertex][i] = z;
+	    batch.m_u[vertex][i] = KernelMul( batch.m_u[vertex][i], z ) >> 
+		mipLevel;
+	    batch.m_v[vertex][i] = KernelMul( batch.m_v[vertex][i], z ) >> 
+		mipLevel;
+	}
+
+	// the same double precision arithmetic as in 
+	// CalculatePolygonGradients(), which the vector levels also follow
+	real_64 dy13 = (real_64)(batch.m_y[0][i] - batch.m_y[2][i]);
+	real_64 dy23 = (real_64)(batch.m_y[1][i] - batch.m_y[2][i]);
+	real_64 product = 
+	    ((real_64)(batch.m_x[0][i] - batch.m_x[2][i]) * dy23) - 
+	    ((real_64)(batch.m_x[1][i] - batch.m_x[2][i]) * dy13);
+	real_64 inverse = 1.0 / (product / 65536.0);
+
+	batch.m_dudx[i] = (int_32)
+	    ((((real_64)(batch.m_u[0][i] - batch.m_u[2][i]) * dy23) - 
+	      ((real_64)(batch.m_u[1][i] - batch.m_u[2][i]) * dy13)) * 
+	     inverse);
+	batch.m_dvdx[i] = (int_32)
+	    ((((real_64)(batch.m_v[0][i] - batch.m_v[2][i]) * dy23) - 
+	      ((real_64)(batch.m_v[1][i] - batch.m_v[2][i]) * dy13)) * 
+	     inverse);
+	batch.m_dzdx[i] = (int_32)
+	    ((((real_64)(batch.m_z[0][i] - batch.m_z[2][i]) * dy23) - 
+	      ((real_64)(batch.m_z[1][i] - batch.m_z[2][i]) * dy13)) * 
+	     inverse);
+	batch.m_didx[i] = (int_32)
+	    ((((real_64)(batch.m_intensity[0][i] - 
+			 batch.m_intensity[2][i]) * dy23) - 
+	      ((real_64)(batch.m_intensity[1][i] - 
+			 batch.m_intensity[2][i]) * dy13)) * 
+	     inverse);
+
+	// edge heights are positive as the vertices are ordered by y
+	uint_32 heights[3] = 
+	    { (uint_32)(batch.m_y[2][i] - batch.m_y[0][i]), 
+	      (uint_32)(batch.m_y[1][i] - batch.m_y[0][i]), 
+	      (uint_32)(batch.m_y[2][i] - batch.m_y[1][i]) };
+	for ( int edge = 0; edge < 3; edge++ )
+	{
+	    batch.m_inverseHeights[edge][i] = (heights[edge] != 0) ? 
+		(int_32)(MaxUint32 / heights[edge]) : 0;
+	}
+    }
+}
+
+void BlockCoverageScalar( const int_32* edgeValues, 
+			  const int_32* edgeStepsX, 
+			  const int_32* edgeStepsY, 
+			  uint_8* rowMasks )
+{
+    int_32 rowValues[3] = { edgeValues[0], edgeValues[1], edgeValues[2] };
+    for ( int row = 0; row < HalfSpaceBlockSize; row++ )
+    {
+	int_32 value1 = rowValues[0];
+	int_32 value2 = rowValues[1];
+	int_32 value3 = rowValues[2];
+	uint_32 mask = 0;
+	for ( int column = 0; column < HalfSpaceBlockSize; column++ )
+	{
+	    // the values are all non-negative only if their or is
+	    if ( (value1 | value2 | value3) >= 0 )
+	    {
+		mask |= (1 << column);
+	    }
+	    value1 += edgeStepsX[0];
+	    value2 += edgeStepsX[1];
+	    value3 += edgeStepsX[2];
+	}
+	rowMasks[row] = (uint_8)mask;
+
+	for ( int edge = 0; edge < 3; edge++ )
+	{
+	    rowValues[edge] += edgeStepsY[edge];
+	}
+    }
+}
+
+bool GetScalarKernels( KernelTable& table )
+{
+    table.m_level = CpuLevelScalar;
+    table.m_transformVectors = TransformVectorsScalar;
+    table.m_gouraudSpan888 = GouraudSpan888Scalar;
+    table.m_pointLight = PointLightScalar;
+    table.m_directionalLight = DirectionalLightScalar;
+    table.m_triangleSetup = TriangleSetupScalar;
+    table.m_blockCoverage = BlockCoverageScalar;
+
+    return true;
+}
+
+// fills the table with the kernels of the given level; levels that were 
+// not built in inherit the kernels of the level below
+static bool GetKernelsForLevel( CpuLevel level, KernelTable& table )
+{
+    GetScalarKernels( table );
+    bool built = true;
+    if ( level >= CpuLevelSse2 )
+    {
+        built = GetSse2Kernels( table );
+    }
+    if ( level >= CpuLevelSse41 )
+    {
+        built = GetSse41Kernels( table );
+    }
+    if ( level >= CpuLevelAvx2 )
+    {
+        built = GetAvx2Kernels( table );
+    }
+    if ( level >= CpuLevelAvx512 )
+    {
+        built = GetAvx512Kernels( table );
+    }
+
+    return built;
+}
+
+// selects the highest supported level, or the requested one if lower
+static void SelectDefaultKernels()
+{
+    CpuLevel level = DetectCpuLevel();
+    CpuLevel requested = GetRequestedCpuLevel();
+    if ( requested < level )
+    {
+        level = requested;
+    }
+    GetKernelsForLevel( level, kernelTable );
+
+    LOG_DEBUG_F( "GetKernels(): using %s kernels", 
+                 GetCpuLevelName( kernelTable.m_level ) );
+}
+
+// selects the kernels when the library is loaded, before main() and any
+// job system thread; the kernels are read from the worker threads, so 
+// they must not be selected lazily on first use
+class KernelSelector
+{
+ public:
+    KernelSelector()
+    {
+        if ( kernelTable.m_transformVectors == NULL )
+        {
+            SelectDefaultKernels();
+        }
+    }
+};
+
+static KernelSelector kernelSelector;
+
+NOVA_EXPORT const KernelTable& GetKernels()
+{
+    if ( kernelTable.m_transformVectors == NULL )
+    {
+        // only reached from the static constructors of other files, 
+        // which run on a single thread
+        SelectDefaultKernels();
+    }
+
+    return kernelTable;
+}
+
+NOVA_EXPORT int SelectKernels( CpuLevel level )
+{
+    KernelTable table;
+    if ( (level >= CpuLevelCount) || (level > DetectCpuLevel()) || 
+         !GetKernelsForLevel( level, table ) )
+    {
+        return NovaErrNotFound;
+    }
+
+    kernelTable = table;
+
+    return NovaErrNone;
+}
+
+}; // namespace
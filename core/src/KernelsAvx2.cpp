@@ -0,0 +1,483 @@
+/*
+ *  $Id$
+ *
+ *  Nova 3D Engine - A portable object oriented, scene graph based, 
+ *  lightweight real-time 3D software rendering framework. 
+ *  Copyright (C) 2001-2009 Matti Dahlbom
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Contact: Matti Dahlbom <matti at 777-team dot org>
+ */
+
+
+#include "Kernels.h"
+
+#if defined(__i386__) || defined(__x86_64__)
+
+#include <immintrin.h>
+
+// the kernels are compiled for AVX2 whatever the build flags are; they are
+// only called when the processor supports it
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+namespace nova3d {
+
+// multiplies the fixed point values lane by lane
+static inline AVX2_TARGET __m256i FixedMul( __m256i a, __m256i b )
+{
+    __m256i even = _mm256_srli_epi64( _mm256_mul_epi32( a, b ), 
+				      FixedPointPrec );
+    __m256i odd = _mm256_slli_epi64( 
+	_mm256_mul_epi32( _mm256_srli_epi64( a, 32 ), 
+			  _mm256_srli_epi64( b, 32 ) ), 
+	32 - FixedPointPrec );
+
+    return _mm256_blend_epi32( even, odd, 0xaa );
+}
+
+// calculates a * x + b * y + c * z in fixed point
+static inline AVX2_TARGET __m256i FixedTripleMul( __m256i a, __m256i x, 
+						  __m256i b, __m256i y,
+						  __m256i c, __m256i z )
+{
+    return _mm256_add_epi32( _mm256_add_epi32( FixedMul( a, x ), 
+					       FixedMul( b, y ) ),
+			     FixedMul( c, z ) );
+}
+
+// converts unsigned values to doubles
+static inline AVX2_TARGET __m256d UnsignedToDouble( __m128i value )
+{
+    __m256d result = _mm256_cvtepi32_pd( value );
+    __m256d wrapped = _mm256_cmp_pd( result, _mm256_setzero_pd(), 
+				     _CMP_LT_OQ );
+
+    return _mm256_add_pd( result, _mm256_and_pd( 
+	wrapped, _mm256_set1_pd( 4294967296.0 ) ) );
+}
+
+// joins two halves into one register
+static inline AVX2_TARGET __m256i Join( __m128i low, __m128i high )
+{
+    return _mm256_inserti128_si256( _mm256_castsi128_si256( low ), 
+				    high, 1 );
+}
+
+// square roots of unsigned values rounded down. The double precision
+// root is correctly rounded, so the result equals FastSqrt().
+static inline AVX2_TARGET __m256i SqrtUnsigned( __m256i value )
+{
+    __m128i low = _mm256_cvttpd_epi32( _mm256_sqrt_pd( 
+	UnsignedToDouble( _mm256_castsi256_si128( value ) ) ) );
+    __m128i high = _mm256_cvttpd_epi32( _mm256_sqrt_pd( 
+	UnsignedToDouble( _mm256_extracti128_si256( value, 1 ) ) ) );
+
+    return Join( low, high );
+}
+
+// divides signed values truncating toward zero like the integer division;
+// exact since the quotient of 32 bit values is correctly rounded. Lanes 
+// with a zero divisor give zero.
+static inline AVX2_TARGET __m256i Divide( __m256i a, __m256i b )
+{
+    __m128i low = _mm256_cvttpd_epi32( _mm256_div_pd( 
+	_mm256_cvtepi32_pd( _mm256_castsi256_si128( a ) ), 
+	_mm256_cvtepi32_pd( _mm256_castsi256_si128( b ) ) ) );
+    __m128i high = _mm256_cvttpd_epi32( _mm256_div_pd( 
+	_mm256_cvtepi32_pd( _mm256_extracti128_si256( a, 1 ) ), 
+	_mm256_cvtepi32_pd( _mm256_extracti128_si256( b, 1 ) ) ) );
+    __m256i zeroDivisor = _mm256_cmpeq_epi32( b, _mm256_setzero_si256() );
+
+    return _mm256_andnot_si256( zeroDivisor, Join( low, high ) );
+}
+
+// loads the x, y and z components of the vectors at the given indices
+static inline AVX2_TARGET void Gather( const Vector* vectors, 
+				       __m256i indices, __m256i& x, 
+				       __m256i& y, __m256i& z )
+{
+    const int* base = (const int*)vectors;
+    __m256i offsets = _mm256_add_epi32( indices, 
+					_mm256_add_epi32( indices, indices ) );
+    x = _mm256_i32gather_epi32( base, offsets, 4 );
+    y = _mm256_i32gather_epi32( base + 1, offsets, 4 );
+    z = _mm256_i32gather_epi32( base + 2, offsets, 4 );
+}
+
+static AVX2_TARGET void TransformVectorsAvx2( const Matrix& matrix, 
+					      const Vector* src, Vector* dst,
+					      const uint_32* vertexInfos, 
+					      int count, bool translate )
+{
+    const int_32* m = matrix.GetFixedData();
+    __m256i m00 = _mm256_set1_epi32( m[0] );
+    __m256i m01 = _mm256_set1_epi32( m[1] );
+    __m256i m02 = _mm256_set1_epi32( m[2] );
+    __m256i m10 = _mm256_set1_epi32( m[4] );
+    __m256i m11 = _mm256_set1_epi32( m[5] );
+    __m256i m12 = _mm256_set1_epi32( m[6] );
+    __m256i m20 = _mm256_set1_epi32( m[8] );
+    __m256i m21 = _mm256_set1_epi32( m[9] );
+    __m256i m22 = _mm256_set1_epi32( m[10] );
+    __m256i tx = _mm256_set1_epi32( translate ? m[3] : 0 );
+    __m256i ty = _mm256_set1_epi32( translate ? m[7] : 0 );
+    __m256i tz = _mm256_set1_epi32( translate ? m[11] : 0 );
+    __m256i indices = _mm256_setr_epi32( 0, 1, 2, 3, 4, 5, 6, 7 );
+
+    int_32 x[8], y[8], z[8];
+    int i = 0;
+    for ( ; (i + 8) <= count; i += 8 )
+    {
+	if ( !AnyVisible( (vertexInfos != NULL) ? (vertexInfos + i) : NULL, 
+			  8 ) )
+	{
+	    continue;
+	}
+
+	__m256i sx, sy, sz;
+	Gather( src + i, indices, sx, sy, sz );
+
+	_mm256_storeu_si256( (__m256i*)x, _mm256_add_epi32( 
+	    FixedTripleMul( m00, sx, m01, sy, m02, sz ), tx ) );
+	_mm256_storeu_si256( (__m256i*)y, _mm256_add_epi32( 
+	    FixedTripleMul( m10, sx, m11, sy, m12, sz ), ty ) );
+	_mm256_storeu_si256( (__m256i*)z, _mm256_add_epi32( 
+	    FixedTripleMul( m20, sx, m21, sy, m22, sz ), tz ) );
+
+	StoreVisibleVectors( dst + i, x, y, z, 
+			     (vertexInfos != NULL) ? (vertexInfos + i) : NULL,
+			     8 );
+    }
+
+    TransformVectorsScalar( matrix, src + i, dst + i, 
+			    (vertexInfos != NULL) ? (vertexInfos + i) : NULL,
+			    count - i, translate );
+}
+
+static AVX2_TARGET void GouraudSpan888Avx2( uint_32* dst, int count,
+					    int_32 red, int_32 green, 
+					    int_32 blue, int_32 redSlope, 
+					    int_32 greenSlope, 
+					    int_32 blueSlope )
+{
+    __m256i steps = _mm256_setr_epi32( 0, 1, 2, 3, 4, 5, 6, 7 );
+    __m256i r = _mm256_add_epi32( _mm256_set1_epi32( red ), 
+	_mm256_mullo_epi32( _mm256_set1_epi32( redSlope ), steps ) );
+    __m256i g = _mm256_add_epi32( _mm256_set1_epi32( green ), 
+	_mm256_mullo_epi32( _mm256_set1_epi32( greenSlope ), steps ) );
+    __m256i b = _mm256_add_epi32( _mm256_set1_epi32( blue ), 
+	_mm256_mullo_epi32( _mm256_set1_epi32( blueSlope ), steps ) );
+    __m256i rStep = _mm256_set1_epi32( 8 * redSlope );
+    __m256i gStep = _mm256_set1_epi32( 8 * greenSlope );
+    __m256i bStep = _mm256_set1_epi32( 8 * blueSlope );
+
+    // the integer parts of the components are moved to their places in 
+    // the pixel
+    __m256i rMask = _mm256_set1_epi32( 0xff0000 );
+    __m256i gMask = _mm256_set1_epi32( 0x00ff00 );
+    __m256i bMask = _mm256_set1_epi32( 0x0000ff );
+
+    int i = 0;
+    for ( ; (i + 8) <= count; i += 8 )
+    {
+	__m256i color = _mm256_or_si256( 
+	    _mm256_and_si256( r, rMask ), 
+	    _mm256_or_si256( 
+		_mm256_and_si256( _mm256_srli_epi32( g, 8 ), gMask ),
+		_mm256_and_si256( _mm256_srli_epi32( b, 16 ), bMask ) ) );
+	_mm256_storeu_si256( (__m256i*)(dst + i), color );
+
+	r = _mm256_add_epi32( r, rStep );
+	g = _mm256_add_epi32( g, gStep );
+	b = _mm256_add_epi32( b, bStep );
+    }
+
+    GouraudSpan888Scalar( dst + i, count - i, 
+			  _mm256_extract_epi32( r, 0 ), 
+			  _mm256_extract_epi32( g, 0 ), 
+			  _mm256_extract_epi32( b, 0 ), 
+			  redSlope, greenSlope, blueSlope );
+}
+
+static AVX2_TARGET void PointLightAvx2( const Vector& lightPos, 
+					const Vector* coords, 
+					const Vector* normals,
+					const uint_32* vertexIndices, 
+					const uint_32* normalIndices, 
+					int count, int_32* intensities, 
+					int_32* distances )
+{
+    __m256i lx = _mm256_set1_epi32( lightPos.GetFixedX() );
+    __m256i ly = _mm256_set1_epi32( lightPos.GetFixedY() );
+    __m256i lz = _mm256_set1_epi32( lightPos.GetFixedZ() );
+    __m256i zero = _mm256_setzero_si256();
+
+    int i = 0;
+    for ( ; (i + 8) <= count; i += 8 )
+    {
+	__m256i vx, vy, vz, nx, ny, nz;
+	Gather( coords, 
+		_mm256_loadu_si256( (const __m256i*)(vertexIndices + i) ), 
+		vx, vy, vz );
+	Gather( normals, 
+		_mm256_loadu_si256( (const __m256i*)(normalIndices + i) ), 
+		nx, ny, nz );
+
+	// vectors from the vertices to the light
+	__m256i x = _mm256_sub_epi32( lx, vx );
+	__m256i y = _mm256_sub_epi32( ly, vy );
+	__m256i z = _mm256_sub_epi32( lz, vz );
+
+	__m256i length = SqrtUnsigned( FixedTripleMul( x, x, y, y, z, z ) );
+	_mm256_storeu_si256( (__m256i*)(distances + i), 
+			     _mm256_slli_epi32( length, FixedPointPrec / 2 ) );
+
+	__m256i dotProd = FixedTripleMul( x, nx, y, ny, z, nz );
+	__m256i intensity = _mm256_slli_epi32( Divide( dotProd, length ), 
+					       FixedPointPrec / 2 );
+	_mm256_storeu_si256( (__m256i*)(intensities + i), 
+			     _mm256_max_epi32( intensity, zero ) );
+    }
+
+    PointLightScalar( lightPos, coords, normals, vertexIndices + i, 
+		      normalIndices + i, count - i, intensities + i, 
+		      distances + i );
+}
+
+static AVX2_TARGET void DirectionalLightAvx2( const Vector& towardsLight, 
+					      const Vector* normals,
+					      const uint_32* normalIndices, 
+					      int count, int_32* intensities )
+{
+    __m256i lx = _mm256_set1_epi32( towardsLight.GetFixedX() );
+    __m256i ly = _mm256_set1_epi32( towardsLight.GetFixedY() );
+    __m256i lz = _mm256_set1_epi32( towardsLight.GetFixedZ() );
+    __m256i zero = _mm256_setzero_si256();
+
+    int i = 0;
+    for ( ; (i + 8) <= count; i += 8 )
+    {
+	__m256i nx, ny, nz;
+	Gather( normals, 
+		_mm256_loadu_si256( (const __m256i*)(normalIndices + i) ), 
+		nx, ny, nz );
+
+	__m256i intensity = FixedTripleMul( lx, nx, ly, ny, lz, nz );
+	_mm256_storeu_si256( (__m256i*)(intensities + i), 
+			     _mm256_max_epi32( intensity, zero ) );
+    }
+
+    DirectionalLightScalar( towardsLight, normals, normalIndices + i, 
+			    count - i, intensities + i );
+}
+
+// converts the differences of the signed values to doubles
+static inline AVX2_TARGET __m256d Difference( const int_32* a, 
+					      const int_32* b )
+{
+    return _mm256_cvtepi32_pd( 
+	_mm_sub_epi32( _mm_loadu_si128( (const __m128i*)a ), 
+		       _mm_loadu_si128( (const __m128i*)b ) ) );
+}
+
+// stores a*dy23 - b*dy13 scaled by the inverse, truncated to integers
+static inline AVX2_TARGET void StoreGradient( int_32* dst, 
+					      __m256d a, __m256d b, 
+					      __m256d dy23, __m256d dy13, 
+					      __m256d inverse )
+{
+    __m256d gradient = _mm256_sub_pd( _mm256_mul_pd( a, dy23 ), 
+				      _mm256_mul_pd( b, dy13 ) );
+    _mm_storeu_si128( (__m128i*)dst, 
+		      _mm256_cvttpd_epi32( _mm256_mul_pd( gradient, 
+							  inverse ) ) );
+}
+
+// stores MaxUint32 / height for the unsigned heights; 0 for the heights 
+// of 0
+static inline AVX2_TARGET void StoreInverseHeight( int_32* dst, 
+						   const int_32* y1, 
+						   const int_32* y2 )
+{
+    __m128i height = _mm_sub_epi32( _mm_loadu_si128( (const __m128i*)y2 ), 
+				    _mm_loadu_si128( (const __m128i*)y1 ) );
+
+    // the quotient of two integers below 2^32 is never rounded up to the
+    // next integer, so truncating it gives the integer division
+    __m256d value = _mm256_cvtepi32_pd( height );
+    value = _mm256_add_pd( 
+	value, _mm256_and_pd( _mm256_cmp_pd( value, _mm256_setzero_pd(), 
+					     _CMP_LT_OQ ),
+			      _mm256_set1_pd( 4294967296.0 ) ) );
+    __m128i inverse = _mm256_cvttpd_epi32( 
+	_mm256_div_pd( _mm256_set1_pd( 4294967295.0 ), value ) );
+
+    // only the height of 1 gives a quotient that does not fit in the 
+    // signed conversion; as an int_32 it wraps to -1
+    inverse = _mm_or_si128( inverse, 
+			    _mm_cmpeq_epi32( height, _mm_set1_epi32( 1 ) ) );
+    inverse = _mm_andnot_si128( _mm_cmpeq_epi32( height, 
+						 _mm_setzero_si128() ), 
+				inverse );
+    _mm_storeu_si128( (__m128i*)dst, inverse );
+}
+
+// replaces z, u and v of a vertex of four triangles with 1/z, u/z and 
+// v/z as CalculateInverses() does; scale is 2^-(16 + mip level)
+static inline AVX2_TARGET void StoreInverses( int_32* z, int_32* u, 
+					      int_32* v, __m256d scale )
+{
+    // z is at least 1.0, so the quotient fits in the signed conversion and
+    // is never rounded up to the next integer
+    __m128i inverse = _mm256_cvttpd_epi32( 
+	_mm256_div_pd( _mm256_set1_pd( 4294967295.0 ), 
+		       _mm256_cvtepi32_pd( 
+			   _mm_loadu_si128( (const __m128i*)z ) ) ) );
+    _mm_storeu_si128( (__m128i*)z, inverse );
+
+    // the products are exact in double precision; scaling them by a power
+    // of two and rounding down gives the fixed point product shifted right
+    __m256d factor = _mm256_mul_pd( _mm256_cvtepi32_pd( inverse ), scale );
+    _mm_storeu_si128( (__m128i*)u, _mm256_cvttpd_epi32( _mm256_floor_pd( 
+	_mm256_mul_pd( _mm256_cvtepi32_pd( 
+			   _mm_loadu_si128( (const __m128i*)u ) ), 
+		       factor ) ) ) );
+    _mm_storeu_si128( (__m128i*)v, _mm256_cvttpd_epi32( _mm256_floor_pd( 
+	_mm256_mul_pd( _mm256_cvtepi32_pd( 
+			   _mm_loadu_si128( (const __m128i*)v ) ), 
+		       factor ) ) ) );
+}
+
+static AVX2_TARGET void TriangleSetupAvx2( TriangleSetupBatch& batch, 
+					   int begin, int end )
+{
+    int i = begin;
+    for ( ; (i + 4) <= end; i += 4 )
+    {
+	// build 2^-(16 + mip level) from its exponent
+	__m256i mipLevel = _mm256_cvtepi32_epi64( 
+	    _mm_loadu_si128( (const __m128i*)(batch.m_mipLevel + i) ) );
+	__m256d scale = _mm256_castsi256_pd( _mm256_slli_epi64( 
+	    _mm256_sub_epi64( _mm256_set1_epi64x( 1023 - FixedPointPrec ), 
+			      mipLevel ), 52 ) );
+	for ( int vertex = 0; vertex < 3; vertex++ )
+	{
+	    StoreInverses( batch.m_z[vertex] + i, batch.m_u[vertex] + i, 
+			   batch.m_v[vertex] + i, scale );
+	}
+
+	__m256d dy13 = Difference( batch.m_y[0] + i, batch.m_y[2] + i );
+	__m256d dy23 = Difference( batch.m_y[1] + i, batch.m_y[2] + i );
+	__m256d product = _mm256_sub_pd( 
+	    _mm256_mul_pd( Difference( batch.m_x[0] + i, batch.m_x[2] + i ), 
+			   dy23 ),
+	    _mm256_mul_pd( Difference( batch.m_x[1] + i, batch.m_x[2] + i ), 
+			   dy13 ) );
+	__m256d inverse = 
+	    _mm256_div_pd( _mm256_set1_pd( 1.0 ), 
+			   _mm256_div_pd( product, 
+					  _mm256_set1_pd( 65536.0 ) ) );
+
+	StoreGradient( batch.m_dudx + i, 
+		       Difference( batch.m_u[0] + i, batch.m_u[2] + i ), 
+		       Difference( batch.m_u[1] + i, batch.m_u[2] + i ), 
+		       dy23, dy13, inverse );
+	StoreGradient( batch.m_dvdx + i, 
+		       Difference( batch.m_v[0] + i, batch.m_v[2] + i ), 
+		       Difference( batch.m_v[1] + i, batch.m_v[2] + i ), 
+		       dy23, dy13, inverse );
+	StoreGradient( batch.m_dzdx + i, 
+		       Difference( batch.m_z[0] + i, batch.m_z[2] + i ), 
+		       Difference( batch.m_z[1] + i, batch.m_z[2] + i ), 
+		       dy23, dy13, inverse );
+	StoreGradient( batch.m_didx + i, 
+		       Difference( batch.m_intensity[0] + i, 
+				   batch.m_intensity[2] + i ), 
+		       Difference( batch.m_intensity[1] + i, 
+				   batch.m_intensity[2] + i ), 
+		       dy23, dy13, inverse );
+
+	StoreInverseHeight( batch.m_inverseHeights[0] + i, 
+			    batch.m_y[0] + i, batch.m_y[2] + i );
+	StoreInverseHeight( batch.m_inverseHeights[1] + i, 
+			    batch.m_y[0] + i, batch.m_y[1] + i );
+	StoreInverseHeight( batch.m_inverseHeights[2] + i, 
+			    batch.m_y[1] + i, batch.m_y[2] + i );
+    }
+
+    TriangleSetupScalar( batch, i, end );
+}
+
+static AVX2_TARGET void BlockCoverageAvx2( const int_32* edgeValues, 
+					   const int_32* edgeStepsX, 
+					   const int_32* edgeStepsY, 
+					   uint_8* rowMasks )
+{
+    // one row of the block per vector
+    const __m256i columns = _mm256_setr_epi32( 0, 1, 2, 3, 4, 5, 6, 7 );
+    __m256i values[3], stepsY[3];
+    for ( int edge = 0; edge < 3; edge++ )
+    {
+	values[edge] = _mm256_add_epi32( 
+	    _mm256_set1_epi32( edgeValues[edge] ), 
+	    _mm256_mullo_epi32( _mm256_set1_epi32( edgeStepsX[edge] ), 
+				columns ) );
+	stepsY[edge] = _mm256_set1_epi32( edgeStepsY[edge] );
+    }
+
+    for ( int row = 0; row < HalfSpaceBlockSize; row++ )
+    {
+	// the sign of the or of the values is set where any of them is 
+	// negative
+	__m256i signs = _mm256_or_si256( 
+	    _mm256_or_si256( values[0], values[1] ), values[2] );
+	rowMasks[row] = 
+	    (uint_8)~_mm256_movemask_ps( _mm256_castsi256_ps( signs ) );
+
+	for ( int edge = 0; edge < 3; edge++ )
+	{
+	    values[edge] = _mm256_add_epi32( values[edge], stepsY[edge] );
+	}
+    }
+}
+
+bool GetAvx2Kernels( KernelTable& table )
+{
+    table.m_level = CpuLevelAvx2;
+    table.m_transformVectors = TransformVectorsAvx2;
+    table.m_gouraudSpan888 = GouraudSpan888Avx2;
+    table.m_pointLight = PointLightAvx2;
+    table.m_directionalLight = DirectionalLightAvx2;
+    table.m_triangleSetup = TriangleSetupAvx2;
+    table.m_blockCoverage = BlockCoverageAvx2;
+
+    return true;
+}
+
+}; // namespace
+
+#else
+
+namespace nova3d {
+
+bool GetAvx2Kernels( KernelTable& /*table*/ )
+{
+    return false;
+}
+
+}; // namespace
+
+#endif
@@ -0,0 +1,304 @@
+/*
+ *  $Id$
+ *
+ *  Nova 3D Engine - A portable object oriented, scene graph based, 
+ *  lightweight real-time 3D software rendering framework. 
+ *  Copyright (C) 2001-2009 Matti Dahlbom
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Contact: Matti Dahlbom <matti at 777-team dot org>
+ */
+
+
+#include "Kernels.h"
+
+#if defined(__i386__) || defined(__x86_64__)
+
+#include <immintrin.h>
+
+// the kernels are compiled for AVX-512 whatever the build flags are; they
+// are only called when the processor supports it
+#define AVX512_TARGET __attribute__((target("avx512f")))
+
+namespace nova3d {
+
+// multiplies the fixed point values lane by lane
+static inline AVX512_TARGET __m512i FixedMul( __m512i a, __m512i b )
+{
+    __m512i even = _mm512_srli_epi64( _mm512_mul_epi32( a, b ), 
+				      FixedPointPrec );
+    __m512i odd = _mm512_slli_epi64( 
+	_mm512_mul_epi32( _mm512_srli_epi64( a, 32 ), 
+			  _mm512_srli_epi64( b, 32 ) ), 
+	32 - FixedPointPrec );
+
+    return _mm512_mask_blend_epi32( 0xaaaa, even, odd );
+}
+
+// calculates a * x + b * y + c * z in fixed point
+static inline AVX512_TARGET __m512i FixedTripleMul( __m512i a, __m512i x, 
+						    __m512i b, __m512i y,
+						    __m512i c, __m512i z )
+{
+    return _mm512_add_epi32( _mm512_add_epi32( FixedMul( a, x ), 
+					       FixedMul( b, y ) ),
+			     FixedMul( c, z ) );
+}
+
+// joins two halves into one register
+static inline AVX512_TARGET __m512i Join( __m256i low, __m256i high )
+{
+    return _mm512_inserti64x4( _mm512_castsi256_si512( low ), high, 1 );
+}
+
+// square roots of unsigned values rounded down. The double precision
+// root is correctly rounded, so the result equals FastSqrt().
+static inline AVX512_TARGET __m512i SqrtUnsigned( __m512i value )
+{
+    __m256i low = _mm512_cvttpd_epi32( _mm512_sqrt_pd( 
+	_mm512_cvtepu32_pd( _mm512_castsi512_si256( value ) ) ) );
+    __m256i high = _mm512_cvttpd_epi32( _mm512_sqrt_pd( 
+	_mm512_cvtepu32_pd( _mm512_extracti64x4_epi64( value, 1 ) ) ) );
+
+    return Join( low, high );
+}
+
+// divides signed values truncating toward zero like the integer division;
+// exact since the quotient of 32 bit values is correctly rounded. Lanes 
+// with a zero divisor give zero.
+static inline AVX512_TARGET __m512i Divide( __m512i a, __m512i b )
+{
+    __m256i low = _mm512_cvttpd_epi32( _mm512_div_pd( 
+	_mm512_cvtepi32_pd( _mm512_castsi512_si256( a ) ), 
+	_mm512_cvtepi32_pd( _mm512_castsi512_si256( b ) ) ) );
+    __m256i high = _mm512_cvttpd_epi32( _mm512_div_pd( 
+	_mm512_cvtepi32_pd( _mm512_extracti64x4_epi64( a, 1 ) ), 
+	_mm512_cvtepi32_pd( _mm512_extracti64x4_epi64( b, 1 ) ) ) );
+    __mmask16 nonZeroDivisor = 
+	_mm512_cmpneq_epi32_mask( b, _mm512_setzero_si512() );
+
+    return _mm512_maskz_mov_epi32( nonZeroDivisor, Join( low, high ) );
+}
+
+// loads the x, y and z components of the vectors at the given indices
+static inline AVX512_TARGET void Gather( const Vector* vectors, 
+					 __m512i indices, __m512i& x, 
+					 __m512i& y, __m512i& z )
+{
+    const int* base = (const int*)vectors;
+    __m512i offsets = _mm512_add_epi32( indices, 
+					_mm512_add_epi32( indices, indices ) );
+    x = _mm512_i32gather_epi32( offsets, base, 4 );
+    y = _mm512_i32gather_epi32( offsets, base + 1, 4 );
+    z = _mm512_i32gather_epi32( offsets, base + 2, 4 );
+}
+
+static AVX512_TARGET void TransformVectorsAvx512( const Matrix& matrix, 
+						  const Vector* src, 
+						  Vector* dst,
+						  const uint_32* vertexInfos, 
+						  int count, bool translate )
+{
+    const int_32* m = matrix.GetFixedData();
+    __m512i m00 = _mm512_set1_epi32( m[0] );
+    __m512i m01 = _mm512_set1_epi32( m[1] );
+    __m512i m02 = _mm512_set1_epi32( m[2] );
+    __m512i m10 = _mm512_set1_epi32( m[4] );
+    __m512i m11 = _mm512_set1_epi32( m[5] );
+    __m512i m12 = _mm512_set1_epi32( m[6] );
+    __m512i m20 = _mm512_set1_epi32( m[8] );
+    __m512i m21 = _mm512_set1_epi32( m[9] );
+    __m512i m22 = _mm512_set1_epi32( m[10] );
+    __m512i tx = _mm512_set1_epi32( translate ? m[3] : 0 );
+    __m512i ty = _mm512_set1_epi32( translate ? m[7] : 0 );
+    __m512i tz = _mm512_set1_epi32( translate ? m[11] : 0 );
+    __m512i indices = _mm512_setr_epi32( 0, 1, 2, 3, 4, 5, 6, 7, 
+					 8, 9, 10, 11, 12, 13, 14, 15 );
+
+    int_32 x[16], y[16], z[16];
+    int i = 0;
+    for ( ; (i + 16) <= count; i += 16 )
+    {
+	if ( !AnyVisible( (vertexInfos != NULL) ? (vertexInfos + i) : NULL, 
+			  16 ) )
+	{
+	    continue;
+	}
+
+	__m512i sx, sy, sz;
+	Gather( src + i, indices, sx, sy, sz );
+
+	_mm512_storeu_si512( x, _mm512_add_epi32( 
+	    FixedTripleMul( m00, sx, m01, sy, m02, sz ), tx ) );
+	_mm512_storeu_si512( y, _mm512_add_epi32( 
+	    FixedTripleMul( m10, sx, m11, sy, m12, sz ), ty ) );
+	_mm512_storeu_si512( z, _mm512_add_epi32( 
+	    FixedTripleMul( m20, sx, m21, sy, m22, sz ), tz ) );
+
+	StoreVisibleVectors( dst + i, x, y, z, 
+			     (vertexInfos != NULL) ? (vertexInfos + i) : NULL,
+			     16 );
+    }
+
+    TransformVectorsScalar( matrix, src + i, dst + i, 
+			    (vertexInfos != NULL) ? (vertexInfos + i) : NULL,
+			    count - i, translate );
+}
+
+static AVX512_TARGET void GouraudSpan888Avx512( uint_32* dst, int count,
+						int_32 red, int_32 green, 
+						int_32 blue, int_32 redSlope, 
+						int_32 greenSlope, 
+						int_32 blueSlope )
+{
+    __m512i steps = _mm512_setr_epi32( 0, 1, 2, 3, 4, 5, 6, 7, 
+				       8, 9, 10, 11, 12, 13, 14, 15 );
+    __m512i r = _mm512_add_epi32( _mm512_set1_epi32( red ), 
+	_mm512_mullo_epi32( _mm512_set1_epi32( redSlope ), steps ) );
+    __m512i g = _mm512_add_epi32( _mm512_set1_epi32( green ), 
+	_mm512_mullo_epi32( _mm512_set1_epi32( greenSlope ), steps ) );
+    __m512i b = _mm512_add_epi32( _mm512_set1_epi32( blue ), 
+	_mm512_mullo_epi32( _mm512_set1_epi32( blueSlope ), steps ) );
+    __m512i rStep = _mm512_set1_epi32( 16 * redSlope );
+    __m512i gStep = _mm512_set1_epi32( 16 * greenSlope );
+    __m512i bStep = _mm512_set1_epi32( 16 * blueSlope );
+
+    // the integer parts of the components are moved to their places in 
+    // the pixel
+    __m512i rMask = _mm512_set1_epi32( 0xff0000 );
+    __m512i gMask = _mm512_set1_epi32( 0x00ff00 );
+    __m512i bMask = _mm512_set1_epi32( 0x0000ff );
+
+    int i = 0;
+    for ( ; (i + 16) <= count; i += 16 )
+    {
+	__m512i color = _mm512_or_si512( 
+	    _mm512_and_si512( r, rMask ), 
+	    _mm512_or_si512( 
+		_mm512_and_si512( _mm512_srli_epi32( g, 8 ), gMask ),
+		_mm512_and_si512( _mm512_srli_epi32( b, 16 ), bMask ) ) );
+	_mm512_storeu_si512( dst + i, color );
+
+	r = _mm512_add_epi32( r, rStep );
+	g = _mm512_add_epi32( g, gStep );
+	b = _mm512_add_epi32( b, bStep );
+    }
+
+    GouraudSpan888Scalar( dst + i, count - i, 
+			  _mm_cvtsi128_si32( _mm512_castsi512_si128( r ) ), 
+			  _mm_cvtsi128_si32( _mm512_castsi512_si128( g ) ), 
+			  _mm_cvtsi128_si32( _mm512_castsi512_si128( b ) ), 
+			  redSlope, greenSlope, blueSlope );
+}
+
+static AVX512_TARGET void PointLightAvx512( const Vector& lightPos, 
+					    const Vector* coords, 
+					    const Vector* normals,
+					    const uint_32* vertexIndices, 
+					    const uint_32* normalIndices, 
+					    int count, int_32* intensities, 
+					    int_32* distances )
+{
+    __m512i lx = _mm512_set1_epi32( lightPos.GetFixedX() );
+    __m512i ly = _mm512_set1_epi32( lightPos.GetFixedY() );
+    __m512i lz = _mm512_set1_epi32( lightPos.GetFixedZ() );
+    __m512i zero = _mm512_setzero_si512();
+
+    int i = 0;
+    for ( ; (i + 16) <= count; i += 16 )
+    {
+	__m512i vx, vy, vz, nx, ny, nz;
+	Gather( coords, _mm512_loadu_si512( vertexIndices + i ), 
+		vx, vy, vz );
+	Gather( normals, _mm512_loadu_si512( normalIndices + i ), 
+		nx, ny, nz );
+
+	// vectors from the vertices to the light
+	__m512i x = _mm512_sub_epi32( lx, vx );
+	__m512i y = _mm512_sub_epi32( ly, vy );
+	__m512i z = _mm512_sub_epi32( lz, vz );
+
+	__m512i length = SqrtUnsigned( FixedTripleMul( x, x, y, y, z, z ) );
+	_mm512_storeu_si512( distances + i, 
+			     _mm512_slli_epi32( length, FixedPointPrec / 2 ) );
+
+	__m512i dotProd = FixedTripleMul( x, nx, y, ny, z, nz );
+	__m512i intensity = _mm512_slli_epi32( Divide( dotProd, length ), 
+					       FixedPointPrec / 2 );
+	_mm512_storeu_si512( intensities + i, 
+			     _mm512_max_epi32( intensity, zero ) );
+    }
+
+    PointLightScalar( lightPos, coords, normals, vertexIndices + i, 
+		      normalIndices + i, count - i, intensities + i, 
+		      distances + i );
+}
+
+static AVX512_TARGET void DirectionalLightAvx512( 
+    const Vector& towardsLight, const Vector* normals, 
+    const uint_32* normalIndices, int count, int_32* intensities )
+{
+    __m512i lx = _mm512_set1_epi32( towardsLight.GetFixedX() );
+    __m512i ly = _mm512_set1_epi32( towardsLight.GetFixedY() );
+    __m512i lz = _mm512_set1_epi32( towardsLight.GetFixedZ() );
+    __m512i zero = _mm512_setzero_si512();
+
+    int i = 0;
+    for ( ; (i + 16) <= count; i += 16 )
+    {
+	__m512i nx, ny, nz;
+	Gather( normals, _mm512_loadu_si512( normalIndices + i ), 
+		nx, ny, nz );
+
+	__m512i intensity = FixedTripleMul( lx, nx, ly, ny, lz, nz );
+	_mm512_storeu_si512( intensities + i, 
+			     _mm512_max_epi32( intensity, zero ) );
+    }
+
+    DirectionalLightScalar( towardsLight, normals, normalIndices + i, 
+			    count - i, intensities + i );
+}
+
+bool GetAvx512Kernels( KernelTable& table )
+{
+    table.m_level = CpuLevelAvx512;
+    table.m_transformVectors = TransformVectorsAvx512;
+    table.m_gouraudSpan888 = GouraudSpan888Avx512;
+    table.m_pointLight = PointLightAvx512;
+    table.m_directionalLight = DirectionalLightAvx512;
+
+    // the triangle setup stays at AVX2; with AVX-512 enabled the compiler
+    // fuses its multiplies and subtractions, which rounds differently from
+    // the other levels. the block coverage stays at AVX2 too, as a row 
+    // of a block fills its eight lanes
+
+    return true;
+}
+
+}; // namespace
+
+#else
+
+namespace nova3d {
+
+bool GetAvx512Kernels( KernelTable& /*table*/ )
+{
+    return false;
+}
+
+}; // namespace
+
+#endif
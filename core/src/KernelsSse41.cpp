@@ -0,0 +1,296 @@
+/*
+ *  $Id$
+ *
+ *  Nova 3D Engine - A portable object oriented, scene graph based, 
+ *  lightweight real-time 3D software rendering framework. 
+ *  Copyright (C) 2001-2009 Matti Dahlbom
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Contact: Matti Dahlbom <matti at 777-team dot org>
+ */
+
+
+#include "Kernels.h"
+
+#if defined(__i386__) || defined(__x86_64__)
+
+#include <smmintrin.h>
+
+// the kernels are compiled for SSE4.1 whatever the build flags are; they 
+// are only called when the processor supports it
+#define SSE41_TARGET __attribute__((target("sse4.1")))
+
+namespace nova3d {
+
+// multiplies the fixed point values lane by lane
+static inline SSE41_TARGET __m128i FixedMul( __m128i a, __m128i b )
+{
+    __m128i even = _mm_srli_epi64( _mm_mul_epi32( a, b ), FixedPointPrec );
+    __m128i odd = _mm_slli_epi64( _mm_mul_epi32( _mm_srli_epi64( a, 32 ), 
+						 _mm_srli_epi64( b, 32 ) ), 
+				  32 - FixedPointPrec );
+
+    return _mm_blend_epi16( even, odd, 0xcc );
+}
+
+// calculates a * x + b * y + c * z in fixed point
+static inline SSE41_TARGET __m128i FixedTripleMul( __m128i a, __m128i x, 
+						   __m128i b, __m128i y,
+						   __m128i c, __m128i z )
+{
+    return _mm_add_epi32( _mm_add_epi32( FixedMul( a, x ), 
+					 FixedMul( b, y ) ),
+			  FixedMul( c, z ) );
+}
+
+// converts the unsigned values in lanes 0 and 1 to doubles
+static inline SSE41_TARGET __m128d UnsignedToDouble( __m128i value )
+{
+    __m128d result = _mm_cvtepi32_pd( value );
+    __m128d wrapped = _mm_cmplt_pd( result, _mm_setzero_pd() );
+
+    return _mm_add_pd( result, 
+		       _mm_and_pd( wrapped, _mm_set1_pd( 4294967296.0 ) ) );
+}
+
+// square roots of unsigned values rounded down. The double precision
+// root is correctly rounded, so the result equals FastSqrt().
+static inline SSE41_TARGET __m128i SqrtUnsigned( __m128i value )
+{
+    __m128i low = 
+	_mm_cvttpd_epi32( _mm_sqrt_pd( UnsignedToDouble( value ) ) );
+    __m128i high = _mm_cvttpd_epi32( _mm_sqrt_pd( 
+	UnsignedToDouble( _mm_shuffle_epi32( value, 0xee ) ) ) );
+
+    return _mm_unpacklo_epi64( low, high );
+}
+
+// divides signed values truncating toward zero like the integer division;
+// exact since the quotient of 32 bit values is correctly rounded. Lanes 
+// with a zero divisor give zero.
+static inline SSE41_TARGET __m128i Divide( __m128i a, __m128i b )
+{
+    __m128i low = _mm_cvttpd_epi32( 
+	_mm_div_pd( _mm_cvtepi32_pd( a ), _mm_cvtepi32_pd( b ) ) );
+    __m128i high = _mm_cvttpd_epi32( 
+	_mm_div_pd( _mm_cvtepi32_pd( _mm_shuffle_epi32( a, 0xee ) ), 
+		    _mm_cvtepi32_pd( _mm_shuffle_epi32( b, 0xee ) ) ) );
+    __m128i zeroDivisor = _mm_cmpeq_epi32( b, _mm_setzero_si128() );
+
+    return _mm_andnot_si128( zeroDivisor, _mm_unpacklo_epi64( low, high ) );
+}
+
+static SSE41_TARGET void TransformVectorsSse41( const Matrix& matrix, 
+						const Vector* src, Vector* dst,
+						const uint_32* vertexInfos,
+						int count, bool translate )
+{
+    const int_32* m = matrix.GetFixedData();
+    __m128i m00 = _mm_set1_epi32( m[0] );
+    __m128i m01 = _mm_set1_epi32( m[1] );
+    __m128i m02 = _mm_set1_epi32( m[2] );
+    __m128i m10 = _mm_set1_epi32( m[4] );
+    __m128i m11 = _mm_set1_epi32( m[5] );
+    __m128i m12 = _mm_set1_epi32( m[6] );
+    __m128i m20 = _mm_set1_epi32( m[8] );
+    __m128i m21 = _mm_set1_epi32( m[9] );
+    __m128i m22 = _mm_set1_epi32( m[10] );
+    __m128i tx = _mm_set1_epi32( translate ? m[3] : 0 );
+    __m128i ty = _mm_set1_epi32( translate ? m[7] : 0 );
+    __m128i tz = _mm_set1_epi32( translate ? m[11] : 0 );
+
+    int_32 x[4], y[4], z[4];
+    int i = 0;
+    for ( ; (i + 4) <= count; i += 4 )
+    {
+	if ( !AnyVisible( (vertexInfos != NULL) ? (vertexInfos + i) : NULL, 
+			  4 ) )
+	{
+	    continue;
+	}
+
+	const int_32* s = (const int_32*)(src + i);
+	__m128i sx = _mm_set_epi32( s[9], s[6], s[3], s[0] );
+	__m128i sy = _mm_set_epi32( s[10], s[7], s[4], s[1] );
+	__m128i sz = _mm_set_epi32( s[11], s[8], s[5], s[2] );
+
+	_mm_storeu_si128( (__m128i*)x, _mm_add_epi32( 
+	    FixedTripleMul( m00, sx, m01, sy, m02, sz ), tx ) );
+	_mm_storeu_si128( (__m128i*)y, _mm_add_epi32( 
+	    FixedTripleMul( m10, sx, m11, sy, m12, sz ), ty ) );
+	_mm_storeu_si128( (__m128i*)z, _mm_add_epi32( 
+	    FixedTripleMul( m20, sx, m21, sy, m22, sz ), tz ) );
+
+	StoreVisibleVectors( dst + i, x, y, z, 
+			     (vertexInfos != NULL) ? (vertexInfos + i) : NULL,
+			     4 );
+    }
+
+    TransformVectorsScalar( matrix, src + i, dst + i, 
+			    (vertexInfos != NULL) ? (vertexInfos + i) : NULL,
+			    count - i, translate );
+}
+
+static SSE41_TARGET void GouraudSpan888Sse41( uint_32* dst, int count,
+					      int_32 red, int_32 green,
+					      int_32 blue, int_32 redSlope,
+					      int_32 greenSlope,
+					      int_32 blueSlope )
+{
+    __m128i r = _mm_set_epi32( red + 3 * redSlope, red + 2 * redSlope, 
+			       red + redSlope, red );
+    __m128i g = _mm_set_epi32( green + 3 * greenSlope, 
+			       green + 2 * greenSlope, 
+			       green + greenSlope, green );
+    __m128i b = _mm_set_epi32( blue + 3 * blueSlope, blue + 2 * blueSlope, 
+			       blue + blueSlope, blue );
+    __m128i rStep = _mm_set1_epi32( 4 * redSlope );
+    __m128i gStep = _mm_set1_epi32( 4 * greenSlope );
+    __m128i bStep = _mm_set1_epi32( 4 * blueSlope );
+
+    // the integer parts of the components are moved to their places in 
+    // the pixel
+    __m128i rMask = _mm_set1_epi32( 0xff0000 );
+    __m128i gMask = _mm_set1_epi32( 0x00ff00 );
+    __m128i bMask = _mm_set1_epi32( 0x0000ff );
+
+    int i = 0;
+    for ( ; (i + 4) <= count; i += 4 )
+    {
+	__m128i color = _mm_or_si128( 
+	    _mm_and_si128( r, rMask ), 
+	    _mm_or_si128( _mm_and_si128( _mm_srli_epi32( g, 8 ), gMask ),
+			  _mm_and_si128( _mm_srli_epi32( b, 16 ), bMask ) ) );
+	_mm_storeu_si128( (__m128i*)(dst + i), color );
+
+	r = _mm_add_epi32( r, rStep );
+	g = _mm_add_epi32( g, gStep );
+	b = _mm_add_epi32( b, bStep );
+    }
+
+    GouraudSpan888Scalar( dst + i, count - i, _mm_cvtsi128_si32( r ), 
+			  _mm_cvtsi128_si32( g ), _mm_cvtsi128_si32( b ), 
+			  redSlope, greenSlope, blueSlope );
+}
+
+static SSE41_TARGET void PointLightSse41( const Vector& lightPos, 
+					  const Vector* coords,
+					  const Vector* normals,
+					  const uint_32* vertexIndices,
+					  const uint_32* normalIndices,
+					  int count, int_32* intensities,
+					  int_32* distances )
+{
+    __m128i lx = _mm_set1_epi32( lightPos.GetFixedX() );
+    __m128i ly = _mm_set1_epi32( lightPos.GetFixedY() );
+    __m128i lz = _mm_set1_epi32( lightPos.GetFixedZ() );
+    __m128i zero = _mm_setzero_si128();
+
+    int i = 0;
+    for ( ; (i + 4) <= count; i += 4 )
+    {
+	const int_32* v0 = (const int_32*)(coords + vertexIndices[i]);
+	const int_32* v1 = (const int_32*)(coords + vertexIndices[i + 1]);
+	const int_32* v2 = (const int_32*)(coords + vertexIndices[i + 2]);
+	const int_32* v3 = (const int_32*)(coords + vertexIndices[i + 3]);
+	const int_32* n0 = (const int_32*)(normals + normalIndices[i]);
+	const int_32* n1 = (const int_32*)(normals + normalIndices[i + 1]);
+	const int_32* n2 = (const int_32*)(normals + normalIndices[i + 2]);
+	const int_32* n3 = (const int_32*)(normals + normalIndices[i + 3]);
+
+	// vectors from the vertices to the light
+	__m128i x = _mm_sub_epi32( lx, 
+	    _mm_set_epi32( v3[0], v2[0], v1[0], v0[0] ) );
+	__m128i y = _mm_sub_epi32( ly, 
+	    _mm_set_epi32( v3[1], v2[1], v1[1], v0[1] ) );
+	__m128i z = _mm_sub_epi32( lz, 
+	    _mm_set_epi32( v3[2], v2[2], v1[2], v0[2] ) );
+	__m128i nx = _mm_set_epi32( n3[0], n2[0], n1[0], n0[0] );
+	__m128i ny = _mm_set_epi32( n3[1], n2[1], n1[1], n0[1] );
+	__m128i nz = _mm_set_epi32( n3[2], n2[2], n1[2], n0[2] );
+
+	__m128i length = SqrtUnsigned( FixedTripleMul( x, x, y, y, z, z ) );
+	_mm_storeu_si128( (__m128i*)(distances + i), 
+			  _mm_slli_epi32( length, FixedPointPrec / 2 ) );
+
+	__m128i dotProd = FixedTripleMul( x, nx, y, ny, z, nz );
+	__m128i intensity = _mm_slli_epi32( Divide( dotProd, length ), 
+					    FixedPointPrec / 2 );
+	intensity = _mm_max_epi32( intensity, zero );
+	_mm_storeu_si128( (__m128i*)(intensities + i), intensity );
+    }
+
+    PointLightScalar( lightPos, coords, normals, vertexIndices + i, 
+		      normalIndices + i, count - i, intensities + i, 
+		      distances + i );
+}
+
+static SSE41_TARGET void DirectionalLightSse41( const Vector& towardsLight, 
+						const Vector* normals,
+						const uint_32* normalIndices,
+						int count, 
+						int_32* intensities )
+{
+    __m128i lx = _mm_set1_epi32( towardsLight.GetFixedX() );
+    __m128i ly = _mm_set1_epi32( towardsLight.GetFixedY() );
+    __m128i lz = _mm_set1_epi32( towardsLight.GetFixedZ() );
+    __m128i zero = _mm_setzero_si128();
+
+    int i = 0;
+    for ( ; (i + 4) <= count; i += 4 )
+    {
+	const int_32* n0 = (const int_32*)(normals + normalIndices[i]);
+	const int_32* n1 = (const int_32*)(normals + normalIndices[i + 1]);
+	const int_32* n2 = (const int_32*)(normals + normalIndices[i + 2]);
+	const int_32* n3 = (const int_32*)(normals + normalIndices[i + 3]);
+	__m128i nx = _mm_set_epi32( n3[0], n2[0], n1[0], n0[0] );
+	__m128i ny = _mm_set_epi32( n3[1], n2[1], n1[1], n0[1] );
+	__m128i nz = _mm_set_epi32( n3[2], n2[2], n1[2], n0[2] );
+
+	__m128i intensity = FixedTripleMul( lx, nx, ly, ny, lz, nz );
+	_mm_storeu_si128( (__m128i*)(intensities + i), 
+			  _mm_max_epi32( intensity, zero ) );
+    }
+
+    DirectionalLightScalar( towardsLight, normals, normalIndices + i, 
+			    count - i, intensities + i );
+}
+
+bool GetSse41Kernels( KernelTable& table )
+{
+    table.m_level = CpuLevelSse41;
+    table.m_transformVectors = TransformVectorsSse41;
+    table.m_gouraudSpan888 = GouraudSpan888Sse41;
+    table.m_pointLight = PointLightSse41;
+    table.m_directionalLight = DirectionalLightSse41;
+
+    return true;
+}
+
+}; // namespace
+
+#else
+
+namespace nova3d {
+
+bool GetSse41Kernels( KernelTable& /*table*/ )
+{
+    return false;
+}
+
+}; // namespace
+
+#endif
@@ -22,6 +22,8 @@
  * Contact: Matti Dahlbom <matti at 777-team dot org>
  */
 
+#include <math.h>
+
 #include "Lights.h"
 #include "NovaErrors.h"
 
@@ -67,10 +69,12 @@ NOVA_EXPORT AmbientLight::~AmbientLight()
 NOVA_EXPORT PointLight::PointLight()
     : Light( Light::TypePoint ), 
       m_isAttenuated( true ), 
+      m_version( 0 ),
       m_att0( 0 ), 
       m_att1( 0 ),
       m_att2( FixedPointOne )
 {
+    UpdateAttenuationTable();
 }
 
 NOVA_EXPORT PointLight::~PointLight()
@@ -88,8 +92,109 @@ NOVA_EXPORT int PointLight::SetAttenuation( real_64 att0, real_64 att1,
     m_att0 = ::RealToFixed( att0 );
     m_att1 = ::RealToFixed( att1 );
     m_att2 = ::RealToFixed( att2 );
+    UpdateAttenuationTable();
+    m_version++;
     
     return NovaErrNone;
 }
 
+void PointLight::UpdateAttenuationTable()
+{
+    real_64 att0 = ::FixedToReal( m_att0 );
+    real_64 att1 = ::FixedToReal( m_att1 );
+    real_64 att2 = ::FixedToReal( m_att2 );
+
+    // solve att0 + att1*d + att2*d^2 = 1/PointLightCutoff for the distance
+    // where the light stops having an effect
+    real_64 maxRadius = ::FixedToReal( PointLightUnbounded );
+    real_64 limit = (1.0 / PointLightCutoff) - att0;
+    real_64 radius = maxRadius;
+    if ( limit <= 0.0 )
+    {
+        radius = 0.0;
+    }
+    else if ( att2 > 0.0 )
+    {
+        radius = (sqrt( att1 * att1 + 4.0 * att2 * limit ) - att1) / 
+            (2.0 * att2);
+    }
+    else if ( att1 > 0.0 )
+    {
+        radius = limit / att1;
+    }
+
+    if ( radius > maxRadius )
+    {
+        radius = maxRadius;
+    }
+    m_radius = ::RealToFixed( radius );
+
+    // a light reaching nowhere gets a scale that leaves every distance 
+    // past the end of the table
+    real_64 scale = PointLightTableSize / radius;
+    m_tableScale = ((radius > 0.0) && (scale < maxRadius)) ? 
+        ::RealToFixed( scale ) : PointLightUnbounded;
+
+    for ( int i = 0; i <= PointLightTableSize; i++ )
+    {
+        real_64 d = (radius * i) / PointLightTableSize;
+        real_64 denominator = att0 + att1 * d + att2 * d * d;
+        real_64 att = 1.0;
+        if ( denominator > 1.0 )
+        {
+            att = 1.0 / denominator;
+        }
+        m_attenuationTable[i] = ::RealToFixed( att );
+    }
+}
+
+NOVA_EXPORT bool PointLight::Reaches( const Vector& lightPosition, 
+                                      const BoundingSphere& sphere ) const
+{
+    if ( !m_isAttenuated || (m_radius == PointLightUnbounded) || 
+         (sphere.m_radius < 0) )
+    {
+        return true;
+    }
+
+    // compare the squared distances in floating point; the fixed point 
+    // squares would overflow for far away shapes
+    real_64 dx = lightPosition.GetRealX() - sphere.m_location.GetRealX();
+    real_64 dy = lightPosition.GetRealY() - sphere.m_location.GetRealY();
+    real_64 dz = lightPosition.GetRealZ() - sphere.m_location.GetRealZ();
+    real_64 reach = ::FixedToReal( m_radius ) + 
+        ::FixedToReal( sphere.m_radius );
+
+    return ((dx * dx + dy * dy + dz * dz) <= (reach * reach));
+}
+
+//////////////////////////////////////////////
+// implementation of DirectionalLight
+//////////////////////////////////////////////
+
+NOVA_EXPORT DirectionalLight::DirectionalLight()
+    : Light( Light::TypeDirectional ), 
+      m_direction( 0.0, -1.0, 0.0 )
+{
+}
+
+NOVA_EXPORT DirectionalLight::~DirectionalLight()
+{
+}
+
+NOVA_EXPORT int DirectionalLight::SetDirection( const Vector& direction )
+{
+    real_64 length = direction.LengthReal();
+    if ( length <= 0.0 )
+    {
+        return NovaErrInvalidArgument;
+    }
+
+    m_direction.SetReal( direction.GetRealX() / length, 
+                         direction.GetRealY() / length, 
+                         direction.GetRealZ() / length );
+
+    return NovaErrNone;
+}
+
 }; // namespace
@@ -365,10 +365,47 @@ void ShapeNode::TransformByCamera( const Matrix& inverseCameraMatrix )
     m_objectMatrix.MultiplyAndSet( m_objectMatrix, inverseCameraMatrix );
 }
 
-void ShapeNode::GetBoundingSphere( BoundingSphere& boundingSphere )
+void ShapeNode::GetBoundingSphere( BoundingSphere& boundingSphere ) const
 {
-    m_objectMatrix.GetTranslation( boundingSphere.m_location );
-    boundingSphere.m_radius = m_shape.GetBoundingSphereRadius();
+    // the transformations do not scale so the radius stays the same
+    const BoundingSphere& sphere = m_shape.GetBoundingSphere();
+    boundingSphere.m_location.TransformAndSet( m_objectMatrix, 
+                                               sphere.m_location );
+    boundingSphere.m_radius = sphere.m_radius;
+}
+
+void ShapeNode::GetBoundingBox( BoundingBox& boundingBox ) const
+{
+    const BoundingBox& box = m_shape.GetBoundingBox();
+    int_32 min[3], max[3];
+    box.m_min.GetFixed( min[0], min[1], min[2] );
+    box.m_max.GetFixed( max[0], max[1], max[2] );
+
+    // transform the 8 corners and enclose them
+    for ( int i = 0; i < 8; i++ )
+    {
+        Vector corner;
+        corner.SetFixed( (i & 1) ? max[0] : min[0], 
+                         (i & 2) ? max[1] : min[1], 
+                         (i & 4) ? max[2] : min[2] );
+        corner.TransformAndSet( m_objectMatrix, corner );
+
+        if ( i == 0 )
+        {
+            boundingBox.m_min.Set( corner );
+            boundingBox.m_max.Set( corner );
+            continue;
+        }
+
+        int_32 x, y, z, minX, minY, minZ, maxX, maxY, maxZ;
+        corner.GetFixed( x, y, z );
+        boundingBox.m_min.GetFixed( minX, minY, minZ );
+        boundingBox.m_max.GetFixed( maxX, maxY, maxZ );
+        boundingBox.m_min.SetFixed( MIN( x, minX ), MIN( y, minY ), 
+                                    MIN( z, minZ ) );
+        boundingBox.m_max.SetFixed( MAX( x, maxX ), MAX( y, maxY ), 
+                                    MAX( z, maxZ ) );
+    }
 }
 
 //////////////////////////////////////////////
@@ -418,27 +455,39 @@ NOVA_EXPORT LightNode::~LightNode()
 {
 }
 
-void LightNode::TransformBySceneGraph()
+void LightNode::CalculateWorldPosition( Vector& position )
 {
-    if ( m_light.GetType() == Light::TypeAmbient ) 
+    // only light sources with a position have one in world space
+    if ( m_light.GetType() != Light::TypePoint )
     {
-        // ambient light has no position/orientation
+        position.SetFixed( 0, 0, 0 );
         return;
     }
 
-    // only done for light sources with position
-    if ( m_light.GetType() == Light::TypePoint )
+    const PointLight& pointLight = static_cast<const PointLight&>(m_light);
+
+    // the light is placed like the shapes: its position is transformed 
+    // by the combined transformations above the node
+    Matrix lightMatrix;
+    TransformMatrixBySceneGraph( &lightMatrix );
+    position.TransformAndSet( lightMatrix, pointLight.GetPosition() );
+}
+
+void LightNode::CalculateWorldDirection( Vector& direction )
+{
+    if ( m_light.GetType() != Light::TypeDirectional )
     {
-        PointLight& pointLight = static_cast<PointLight&>(m_light);
-        
-        TransformMatrixBySceneGraph( &m_lightMatrix );
-    
-        // get the transformed light position and update it to the light object
-        Vector pos; 
-        m_lightMatrix.GetTranslation( pos );
-        pos.RotateAndSet( m_lightMatrix, pos );
-        pointLight.GetPosition().Set( pos );
+        direction.SetFixed( 0, 0, 0 );
+        return;
     }
+
+    const DirectionalLight& directionalLight = 
+        static_cast<const DirectionalLight&>(m_light);
+
+    // only the rotations above the node turn the light
+    Matrix lightMatrix;
+    TransformMatrixBySceneGraph( &lightMatrix );
+    direction.RotateAndSet( lightMatrix, directionalLight.GetDirection() );
 }
 
 }; // namespace
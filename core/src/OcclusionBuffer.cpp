@@ -0,0 +1,308 @@
+/*
+ *  $Id$
+ *
+ *  Nova 3D Engine - A portable object oriented, scene graph based, 
+ *  lightweight real-time 3D software rendering framework. 
+ *  Copyright (C) 2001-2009 Matti Dahlbom
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Contact: Matti Dahlbom <matti at 777-team dot org>
+ */
+
+#include <math.h>
+
+#include "OcclusionBuffer.h"
+#include "FixedPoint.h"
+#include "NovaErrors.h"
+
+namespace nova3d {
+
+// depth of a cell not covered by any occluder
+const int_32 OcclusionEmptyDepth = 0x7fffffff;
+
+// an edge of an occluder polygon as a*x + b*y + c, positive inside
+struct OccluderEdge
+{
+    real_64 m_a;
+    real_64 m_b;
+    real_64 m_c;
+};
+
+static inline bool IsInside( const OccluderEdge* edges, real_64 x, real_64 y )
+{
+    for ( int i = 0; i < 3; i++ )
+    {
+	if ( ((edges[i].m_a * x) + (edges[i].m_b * y) + edges[i].m_c) < 0.0 )
+	{
+	    return false;
+	}
+    }
+
+    return true;
+}
+
+OcclusionBuffer::OcclusionBuffer()
+    : m_numLevels( 0 ),
+      m_left( 0 ),
+      m_top( 0 ),
+      m_right( 0 ),
+      m_bottom( 0 ),
+      m_centerX( 0 ),
+      m_centerY( 0 ),
+      m_perspectiveFactor( 0 )
+{
+}
+
+OcclusionBuffer::~OcclusionBuffer()
+{
+    // the levels are owned by the frame arena
+}
+
+int OcclusionBuffer::Clear( const RenderingCanvas& canvas, 
+			    int_32 perspectiveFactor, 
+			    FrameArena& frameArena )
+{
+    m_left = canvas.m_left;
+    m_top = canvas.m_top;
+    m_right = canvas.m_right;
+    m_bottom = canvas.m_bottom;
+    m_centerX = canvas.m_centerX;
+    m_centerY = canvas.m_centerY;
+    m_perspectiveFactor = perspectiveFactor;
+
+    // halve the levels down to a single cell
+    int width = (m_right - m_left + OcclusionCellSize) / OcclusionCellSize;
+    int height = (m_bottom - m_top + OcclusionCellSize) / OcclusionCellSize;
+    m_numLevels = 0;
+    while ( m_numLevels < OcclusionMaxLevels )
+    {
+	Level& level = m_levels[m_numLevels++];
+	level.m_width = width;
+	level.m_height = height;
+	level.m_depths = frameArena.AllocateArray<int_32>( width * height );
+	if ( level.m_depths == NULL )
+	{
+	    m_numLevels = 0;
+	    return NovaErrNoMemory;
+	}
+
+	if ( (width == 1) && (height == 1) )
+	{
+	    break;
+	}
+	width = (width + 1) / 2;
+	height = (height + 1) / 2;
+    }
+
+    const Level& finest = m_levels[0];
+    for ( int i = 0; i < (finest.m_width * finest.m_height); i++ )
+    {
+	finest.m_depths[i] = OcclusionEmptyDepth;
+    }
+
+    return NovaErrNone;
+}
+
+void OcclusionBuffer::AddOccluder( const ScreenPolygon& polygon )
+{
+    const ScreenVertex* vertices[3] = 
+	{ &polygon.m_v1, &polygon.m_v2, &polygon.m_v3 };
+    real_64 x[3], y[3], w[3];
+    for ( int i = 0; i < 3; i++ )
+    {
+	x[i] = vertices[i]->m_x / 65536.0;
+	y[i] = vertices[i]->m_y / 65536.0;
+	w[i] = 65536.0 / vertices[i]->m_z;
+    }
+
+    real_64 dx1 = x[1] - x[0];
+    real_64 dy1 = y[1] - y[0];
+    real_64 dx2 = x[2] - x[0];
+    real_64 dy2 = y[2] - y[0];
+    real_64 area = (dx1 * dy2) - (dy1 * dx2);
+    if ( area == 0.0 )
+    {
+	return;
+    }
+
+    // 1/z is linear on the screen
+    real_64 dwdx = (((w[1] - w[0]) * dy2) - ((w[2] - w[0]) * dy1)) / area;
+    real_64 dwdy = (((w[2] - w[0]) * dx1) - ((w[1] - w[0]) * dx2)) / area;
+
+    real_64 sign = (area > 0.0) ? 1.0 : -1.0;
+    OccluderEdge edges[3];
+    for ( int i = 0; i < 3; i++ )
+    {
+	int j = (i + 1) % 3;
+	real_64 dx = x[j] - x[i];
+	real_64 dy = y[j] - y[i];
+	edges[i].m_a = -dy * sign;
+	edges[i].m_b = dx * sign;
+	edges[i].m_c = ((dy * x[i]) - (dx * y[i])) * sign;
+    }
+
+    // only the cells entirely within the bounding box can be covered
+    const Level& finest = m_levels[0];
+    real_64 min_x = MIN( MIN( x[0], x[1] ), x[2] ) - m_left;
+    real_64 max_x = MAX( MAX( x[0], x[1] ), x[2] ) - m_left;
+    real_64 min_y = MIN( MIN( y[0], y[1] ), y[2] ) - m_top;
+    real_64 max_y = MAX( MAX( y[0], y[1] ), y[2] ) - m_top;
+    int first_x = MAX( (int)ceil( min_x / OcclusionCellSize ), 0 );
+    int last_x = MIN( (int)floor( max_x / OcclusionCellSize ) - 1, 
+		      finest.m_width - 1 );
+    int first_y = MAX( (int)ceil( min_y / OcclusionCellSize ), 0 );
+    int last_y = MIN( (int)floor( max_y / OcclusionCellSize ) - 1, 
+		      finest.m_height - 1 );
+
+    // the smallest 1/z of a cell is at one of its corners
+    real_64 corner_dw = MIN( dwdx * OcclusionCellSize, 0.0 ) + 
+	MIN( dwdy * OcclusionCellSize, 0.0 );
+
+    for ( int cell_y = first_y; cell_y <= last_y; cell_y++ )
+    {
+	real_64 top = m_top + (cell_y * OcclusionCellSize);
+	real_64 bottom = top + OcclusionCellSize;
+	int_32* depth = finest.m_depths + (cell_y * finest.m_width) + first_x;
+	for ( int cell_x = first_x; cell_x <= last_x; cell_x++, depth++ )
+	{
+	    // the polygon is convex, so it covers the cell if it covers 
+	    // all of its corners
+	    real_64 left = m_left + (cell_x * OcclusionCellSize);
+	    real_64 right = left + OcclusionCellSize;
+	    if ( !IsInside( edges, left, top ) || 
+		 !IsInside( edges, right, top ) || 
+		 !IsInside( edges, left, bottom ) || 
+		 !IsInside( edges, right, bottom ) )
+	    {
+		continue;
+	    }
+
+	    real_64 min_w = w[0] + (dwdx * (left - x[0])) + 
+		(dwdy * (top - y[0])) + corner_dw;
+	    if ( min_w <= 0.0 )
+	    {
+		continue;
+	    }
+	    real_64 farthest = 65536.0 / min_w;
+	    if ( farthest < *depth )
+	    {
+		*depth = (int_32)farthest + 1;
+	    }
+	}
+    }
+}
+
+void OcclusionBuffer::BuildPyramid()
+{
+    for ( int i = 1; i < m_numLevels; i++ )
+    {
+	const Level& finer = m_levels[i - 1];
+	const Level& level = m_levels[i];
+	int_32* depth = level.m_depths;
+	for ( int y = 0; y < level.m_height; y++ )
+	{
+	    const int_32* row1 = finer.m_depths + (2 * y * finer.m_width);
+	    const int_32* row2 = ((2 * y + 1) < finer.m_height) ? 
+		(row1 + finer.m_width) : row1;
+	    for ( int x = 0; x < level.m_width; x++ )
+	    {
+		int x1 = 2 * x;
+		int x2 = MIN( x1 + 1, finer.m_width - 1 );
+		*depth++ = MAX( MAX( row1[x1], row1[x2] ), 
+				MAX( row2[x1], row2[x2] ) );
+	    }
+	}
+    }
+}
+
+bool OcclusionBuffer::IsOccluded( const BoundingSphere& boundingSphere ) 
+    const
+{
+    int_32 nearest = boundingSphere.m_location.GetFixedZ() - 
+	boundingSphere.m_radius;
+    if ( (m_numLevels == 0) || (nearest <= 0) )
+    {
+	return false;
+    }
+
+    // bound the projection of the sphere. the extent towards either side
+    // is largest where the sphere is nearest if it is on the other side 
+    // of the view axis, farthest otherwise
+    real_64 radius = boundingSphere.m_radius / 65536.0;
+    real_64 center_x = boundingSphere.m_location.GetRealX();
+    real_64 center_y = boundingSphere.m_location.GetRealY();
+    real_64 near_z = boundingSphere.m_location.GetRealZ() - radius;
+    real_64 far_z = boundingSphere.m_location.GetRealZ() + radius;
+    real_64 max_x = center_x + radius;
+    real_64 min_x = center_x - radius;
+    real_64 max_y = center_y + radius;
+    real_64 min_y = center_y - radius;
+    max_x /= (max_x >= 0.0) ? near_z : far_z;
+    min_x /= (min_x <= 0.0) ? near_z : far_z;
+    max_y /= (max_y >= 0.0) ? near_z : far_z;
+    min_y /= (min_y <= 0.0) ? near_z : far_z;
+
+    real_64 left = m_centerX + (m_perspectiveFactor * min_x);
+    real_64 right = m_centerX + (m_perspectiveFactor * max_x);
+    real_64 top = m_centerY - (m_perspectiveFactor * max_y);
+    real_64 bottom = m_centerY - (m_perspectiveFactor * min_y);
+    if ( (right < m_left) || (left > m_right) || 
+	 (bottom < m_top) || (top > m_bottom) )
+    {
+	return false;
+    }
+
+    // the part outside the canvas is not drawn
+    const Level& finest = m_levels[0];
+    int first_x = (int)((MAX( left, (real_64)m_left ) - m_left) / 
+			OcclusionCellSize);
+    int last_x = MIN( (int)((MIN( right, (real_64)m_right ) - m_left) / 
+			    OcclusionCellSize), finest.m_width - 1 );
+    int first_y = (int)((MAX( top, (real_64)m_top ) - m_top) / 
+			OcclusionCellSize);
+    int last_y = MIN( (int)((MIN( bottom, (real_64)m_bottom ) - m_top) / 
+			    OcclusionCellSize), finest.m_height - 1 );
+
+    // go up the pyramid until the projection spans at most two cells
+    // both ways
+    int level_index = 0;
+    while ( (((last_x - first_x) > 1) || ((last_y - first_y) > 1)) && 
+	    (level_index < (m_numLevels - 1)) )
+    {
+	first_x >>= 1;
+	last_x >>= 1;
+	first_y >>= 1;
+	last_y >>= 1;
+	level_index++;
+    }
+
+    const Level& level = m_levels[level_index];
+    for ( int y = first_y; y <= last_y; y++ )
+    {
+	const int_32* depth = level.m_depths + (y * level.m_width);
+	for ( int x = first_x; x <= last_x; x++ )
+	{
+	    if ( depth[x] >= nearest )
+	    {
+		return false;
+	    }
+	}
+    }
+
+    return true;
+}
+
+}; // namespace
@@ -28,18 +28,106 @@
 #include "Texture.h"
 #include "novalogging.h"
 
-#define MIN(a,b) ((a)<(b) ? (a) : (b))
-
 namespace nova3d {
 
+// subpixel precision of the half-space edge functions. with 4 bits the 
+// edge function steps over a block fit in 32 bits for any vertex 
+// coordinates
+const int_32 HalfSpaceSubpixelBits = 4;
+
 Renderer::Renderer( RenderingCanvas& canvas )
-    : m_canvas( canvas )
+    : m_canvas( canvas ),
+      m_kernels( GetKernels() ),
+      m_rasterizer( RasterizerScanline )
 {
     for ( int i = 1; i <= 65535; i++ ) 
     {
         uint_32 result = MaxUint32 / i;
         m_fixedDivLookup[i] = (int_32)result;
     }
+
+    // the covered pixels of a row of a block are contiguous, so a row 
+    // mask translates to a span. the empty span of 0 is inverted beyond 
+    // any canvas so that it never widens the span of its row
+    m_maskSpanLeft[0] = 0x7fff;
+    m_maskSpanRight[0] = -0x7fff;
+    for ( int mask = 1; mask < 256; mask++ ) 
+    {
+	int left = 0;
+	while ( (mask & (1 << left)) == 0 )
+	{
+	    left++;
+	}
+	int right = HalfSpaceBlockSize;
+	while ( (mask & (1 << (right - 1))) == 0 )
+	{
+	    right--;
+	}
+	m_maskSpanLeft[mask] = (int_16)left;
+	m_maskSpanRight[mask] = (int_16)right;
+    }
+}
+
+void Renderer::SetupTriangles( const ScreenPolygonKey* faces, int count )
+{
+    ScreenPolygon* batchFaces[TriangleSetupBatch::MaxTriangles];
+    TriangleSetupBatch& batch = m_setupBatch;
+    count = MIN( count, TriangleSetupBatch::MaxTriangles );
+
+    // gather the textured polygons; the gradients and edge inverses stay
+    // in the batch for drawing, indexed by the order of the polygons
+    int numBatched = 0;
+    for ( int i = 0; i < count; i++ )
+    {
+	ScreenPolygon* face = faces[i].m_polygon;
+	if ( face->m_texture == NULL )
+	{
+	    continue;
+	}
+
+	// select the mip level by the polygon's size on screen 
+	int mipLevel = 
+	    nova3d::SelectMipLevel( *face, 
+				    face->m_texture->GetNumMipLevels() );
+	face->m_mipLevel = (uint_16)mipLevel;
+	batch.m_mipLevel[numBatched] = mipLevel;
+
+	// order the vertices by y for the setup and the drawing
+	ScreenVertex *vertex1, *vertex2, *vertex3;
+	nova3d::SelectVertexOrder( face, &vertex1, &vertex2, &vertex3 );
+	ScreenVertex ordered[3] = { *vertex1, *vertex2, *vertex3 };
+	face->m_v1 = ordered[0];
+	face->m_v2 = ordered[1];
+	face->m_v3 = ordered[2];
+
+	for ( int j = 0; j < 3; j++ )
+	{
+	    const ScreenVertex& vertex = ordered[j];
+	    batch.m_x[j][numBatched] = vertex.m_x;
+	    batch.m_y[j][numBatched] = vertex.m_y;
+	    batch.m_z[j][numBatched] = vertex.m_z;
+	    batch.m_u[j][numBatched] = vertex.m_textureCoordinates.m_u;
+	    batch.m_v[j][numBatched] = vertex.m_textureCoordinates.m_v;
+	    batch.m_intensity[j][numBatched] = 
+		vertex.m_textureCoordinates.m_intensity;
+	}
+	batchFaces[numBatched++] = face;
+    }
+
+    m_kernels.m_triangleSetup( batch, 0, numBatched );
+
+    // the spans interpolate the perspective correct values
+    for ( int j = 0; j < numBatched; j++ )
+    {
+	ScreenPolygon* face = batchFaces[j];
+	ScreenVertex* vertices[3] = { &face->m_v1, &face->m_v2, &face->m_v3 };
+	for ( int k = 0; k < 3; k++ )
+	{
+	    vertices[k]->m_z = batch.m_z[k][j];
+	    vertices[k]->m_textureCoordinates.m_u = batch.m_u[k][j];
+	    vertices[k]->m_textureCoordinates.m_v = batch.m_v[k][j];
+	}
+    }
 }
 
 inline int_32 Renderer::DivLookup( int_32 fixedDivider )
@@ -107,28 +195,79 @@ inline void Renderer::DrawGouraudSpan( int_32 x1, int_32 x2,
 	right = (m_canvas.m_right - 1);
     }
 
+    FillGouraudSpan( basePtr + left, right - left, red1, green1, blue1, 
+		     red_slope, green_slope, blue_slope );
+}
+
+inline void Renderer::DrawUnclippedGouraudSpan( int_32 x1, int_32 x2, 
+						int_32 red1, int_32 green1, 
+						int_32 blue1, 
+						int_32 red2, int_32 green2, 
+						int_32 blue2, 
+						uint_32* basePtr )
+{
+    // check that the span endpoints are ordered x1 < x2. if not, swap values
+    if ( x1 > x2 ) 
+    {
+        ::Swap32( x1, x2 );
+        ::Swap32( red1, red2 );
+        ::Swap32( green1, green2 );
+        ::Swap32( blue1, blue2 );
+    }
+
+    // check for <1-length span
+    if ( (x2 - x1) < FixedPointOne ) 
+    {
+	return;
+    }
+
+    // the polygon is inside the canvas so the span needs no clipping
+    int_32 left = ::CeilFixed( x1 );
+    int_32 right = ::CeilFixed( x2 );
+    int_32 inv_len = (int_32)(MaxUint32 / (uint_32)(x2 - x1));
+    FillGouraudSpan( basePtr + left, right - left, red1, green1, blue1, 
+		     ::FixedLargeMul( (red2 - red1), inv_len ), 
+		     ::FixedLargeMul( (green2 - green1), inv_len ), 
+		     ::FixedLargeMul( (blue2 - blue1), inv_len ) );
+}
+
+inline void Renderer::FillGouraudSpan( uint_32* ptr, int_32 len, 
+				       int_32 red, int_32 green, int_32 blue, 
+				       int_32 redSlope, int_32 greenSlope, 
+				       int_32 blueSlope )
+{
     //##TODO## well now. this wont work for <4byte pixel formats
     // due to the wide pointer.. now what
     // -> need to make another loop for lower modes with 16bit ptr
 
-    int_32 len = right - left;
-    uint_32* ptr = basePtr + left;
+    if ( m_canvas.m_pixelFormat == PixelFormat888 )
+    {
+	m_kernels.m_gouraudSpan888( ptr, len, red, green, blue, 
+				    redSlope, greenSlope, blueSlope );
+	return;
+    }
 
     // draw all pixels in span.
     for( int_32 i = 0; i < len; i++ ) 
     {
 	*ptr++ = nova3d::CreateColor( m_canvas.m_pixelFormat, 
-				      (red1 >> FixedPointPrec), 
-				      (green1 >> FixedPointPrec),
-				      (blue1 >> FixedPointPrec) );
-        red1 += red_slope;
-        green1 += green_slope;
-        blue1 += blue_slope;
+				      (red >> FixedPointPrec), 
+				      (green >> FixedPointPrec),
+				      (blue >> FixedPointPrec) );
+        red += redSlope;
+        green += greenSlope;
+        blue += blueSlope;
     }
 }
 
 void Renderer::DrawTriangle( ScreenPolygon* face )
 {
+    if ( m_rasterizer == RasterizerHalfSpace ) 
+    {
+	DrawHalfSpaceTriangle( face );
+	return;
+    }
+
     ScreenVertex *vertex1, *vertex2, *vertex3;
 
     // sort vertices in y direction so that v1 < v2 < v3
@@ -144,7 +283,9 @@ void Renderer::DrawTriangle( ScreenPolygon* face )
 	return;
     }
 
-    // setup
+    // setup; polygons inside the canvas need no clipping at all
+    bool inside_canvas = 
+	(face->m_polygonFlags & ScreenPolygonInsideCanvas) != 0;
     int_32 topmost_y = m_canvas.m_top;
     int_32 lowest_y = MIN( y3, m_canvas.m_bottom ) - 1;
     int_32 cur_y = y1;
@@ -214,7 +355,12 @@ void Renderer::DrawTriangle( ScreenPolygon* face )
 		::FixedLargeMul( (vertex3->m_color.m_blue - blue1), inv_len );
         }
 
-        if ( cur_y >= topmost_y ) 
+        if ( inside_canvas ) 
+	{
+            DrawUnclippedGouraudSpan( x1, x2, red1, green1, blue1, 
+                                      red2, green2, blue2, base_p );
+        }
+        else if ( cur_y >= topmost_y ) 
 	{
             DrawGouraudSpan( x1, x2, red1, green1, blue1, 
                              red2, green2, blue2, base_p );
@@ -239,14 +385,8 @@ inline void Renderer::DrawTexturedSpan( int_32 leftX, int_32 rightX,
 					int_32 leftZ,
 					int_32 dudx, int_32 dvdx, int_32 dzdx,
 					uint_32 scanlinePtr, 
-					Texture* texture )
+					Texture* texture, int mipLevel )
 {
-    uint_8* tex_data = texture->GetData();
-    uint_32* tex_palette = texture->GetPalette();
-    uint_32 u_mask = texture->GetUMask();
-    uint_32 v_mask = texture->GetVMask();
-    int_32 texshift = texture->GetShift();
-
     // ceil() span endpoint Xs to integers
     int_32 left = ::CeilFixed( leftX );
     int_32 right = ::CeilFixed( rightX );
@@ -268,7 +408,8 @@ inline void Renderer::DrawTexturedSpan( int_32 leftX, int_32 rightX,
     // calculate span length
     int_32 len = right - left + 1;
 
-    //##TODO## remove all this 2d clipping crap when frustum clipping is done
+    // only polygons crossing the canvas edges are clipped here; the ones
+    // inside the canvas are drawn with the unclipped span functions
 
     // clip to the left side of the rendering canvas
     if ( left < m_canvas.m_left ) 
@@ -298,38 +439,117 @@ inline void Renderer::DrawTexturedSpan( int_32 leftX, int_32 rightX,
 
     //##TODO## 2-byte pixel mode support
 
-    // calculate the address to start writing from
-    uint_32* p = (uint_32*)scanlinePtr + left;
+    FillTexturedSpan( (uint_32*)scanlinePtr + left, len, 
+		      leftU, leftV, leftZ, dudx, dvdx, dzdx, 
+		      texture, mipLevel );
+}
 
-    while( len > 0 ) 
+inline void Renderer::DrawUnclippedTexturedSpan( int_32 leftX, int_32 rightX, 
+						 int_32 leftU, int_32 leftV, 
+						 int_32 leftZ,
+						 int_32 dudx, int_32 dvdx, 
+						 int_32 dzdx,
+						 uint_32 scanlinePtr, 
+						 Texture* texture, 
+						 int mipLevel )
+{
+    // ceil() span endpoint Xs to integers; the polygon is inside the 
+    // canvas so the span needs no clipping
+    int_32 left = ::CeilFixed( leftX );
+    int_32 len = ::CeilFixed( rightX ) - left + 1;
+    if ( len <= 0 ) 
     {
-	int_64 real_z = DivLookup( leftZ );
-	int_32 real_u = (int_32)( ((int_64)leftU * real_z) >> 32);
-	int_32 real_v = (int_32)( ((int_64)leftV * real_z) >> 32);
+	return;
+    }
+
+    // apply subtexel accuracy
+    int_32 prestep = (left << FixedPointPrec) - leftX;
+    leftU += ::FixedLargeMul( prestep, dudx );
+    leftV += ::FixedLargeMul( prestep, dvdx );
+    leftZ += ::FixedLargeMul( prestep, dzdx );
 
-        uint_8 value = tex_data[(real_u & u_mask) + 
-				(((real_v & v_mask) << texshift))];
-        uint_32 color = tex_palette[value];
-        *p++ = color;
+    FillTexturedSpan( (uint_32*)scanlinePtr + left, len, 
+		      leftU, leftV, leftZ, dudx, dvdx, dzdx, 
+		      texture, mipLevel );
+}
 
-        leftU += dudx;
-        leftV += dvdx;
-        leftZ += dzdx;
-        len--;
+inline void Renderer::FillTexturedSpan( uint_32* p, int_32 len, 
+					int_32 u, int_32 v, int_32 z,
+					int_32 dudx, int_32 dvdx, int_32 dzdx,
+					Texture* texture, int mipLevel )
+{
+    const Texture::MipLevel& level = texture->GetMipLevel( mipLevel );
+    uint_8* tex_data = level.m_data;
+    uint_32* tex_palette = texture->GetPalette();
+    uint_32 u_mask = level.m_umask;
+    uint_32 v_mask = level.m_vmask;
+    int_32 texshift = level.m_shift;
+
+    if ( level.m_uOffsets == NULL ) 
+    {
+	// linear layout
+	while( len > 0 ) 
+	{
+	    int_64 real_z = DivLookup( z );
+	    int_32 real_u = (int_32)( ((int_64)u * real_z) >> 32);
+	    int_32 real_v = (int_32)( ((int_64)v * real_z) >> 32);
+
+	    uint_8 value = tex_data[(real_u & u_mask) + 
+				    (((real_v & v_mask) << texshift))];
+	    uint_32 color = tex_palette[value];
+	    *p++ = color;
+
+	    u += dudx;
+	    v += dvdx;
+	    z += dzdx;
+	    len--;
+	}
+    }
+    else
+    {
+	// swizzled layout; the texel offset is the sum of the u and v offsets
+	const uint_32* u_offsets = level.m_uOffsets;
+	const uint_32* v_offsets = level.m_vOffsets;
+
+	while( len > 0 ) 
+	{
+	    int_64 real_z = DivLookup( z );
+	    int_32 real_u = (int_32)( ((int_64)u * real_z) >> 32);
+	    int_32 real_v = (int_32)( ((int_64)v * real_z) >> 32);
+
+	    uint_8 value = tex_data[u_offsets[real_u & u_mask] + 
+				    v_offsets[real_v & v_mask]];
+	    uint_32 color = tex_palette[value];
+	    *p++ = color;
+
+	    u += dudx;
+	    v += dvdx;
+	    z += dzdx;
+	    len--;
+	}
     }
 }
 
-void Renderer::DrawTexturedTriangle( ScreenPolygon* face )
+void Renderer::DrawTexturedTriangle( ScreenPolygon* face, int setupIndex )
 {
-    ScreenVertex *vertex1, *vertex2, *vertex3;
+    if ( m_rasterizer == RasterizerHalfSpace ) 
+    {
+	DrawHalfSpaceTexturedTriangle( face );
+	return;
+    }
 
-    // sort vertices in y direction so that vertex1 < vertex2 < vertex3
-    nova3d::SelectVertexOrder( face, &vertex1, &vertex2, &vertex3 );
+    // the triangle setup has sorted the vertices in y direction so that 
+    // vertex1 < vertex2 < vertex3
+    ScreenVertex* vertex1 = &face->m_v1;
+    ScreenVertex* vertex2 = &face->m_v2;
+    ScreenVertex* vertex3 = &face->m_v3;
 
-    // calculate dudx, dvdx, dzdx (constant through whole polygon)
-    int_32 dudx, dvdx, dzdx, didx = -1;
-    nova3d::CalculatePolygonGradients( *vertex1, *vertex2, *vertex3, 
-				       dudx, dvdx, dzdx, didx );
+    // dudx, dvdx, dzdx (constant through whole polygon) come from the 
+    // triangle setup
+    const TriangleSetupBatch& setup = m_setupBatch;
+    int_32 dudx = setup.m_dudx[setupIndex];
+    int_32 dvdx = setup.m_dvdx[setupIndex];
+    int_32 dzdx = setup.m_dzdx[setupIndex];
 
     // get the vertex y coordinates by ceil()ing from the accurate values
     int_32 y1 = ::CeilFixed( vertex1->m_y );
@@ -338,7 +558,8 @@ void Renderer::DrawTexturedTriangle( ScreenPolygon* face )
     
     // calculate gradients for v1-v3 (constant for whole scan) and check 
     // whether the long edge (v1-v3) is "on left" 
-    int_32 long_inv_len, long_x = 0, long_dxdy = 0;
+    int_32 long_inv_len = setup.m_inverseHeights[0][setupIndex];
+    int_32 long_x = 0, long_dxdy = 0;
     bool long_on_left = nova3d::IsLongOnLeft( *vertex1, *vertex2, *vertex3, 
 					      long_inv_len, long_x, long_dxdy );
 
@@ -380,8 +601,7 @@ void Renderer::DrawTexturedTriangle( ScreenPolygon* face )
         if ( y2 > y1 ) 
 	{
             // calculate 'left' values for v1-v2
-            int_32 inv_len = (int_32)(MaxUint32 / 
-				      (uint_32)(vertex2->m_y - vertex1->m_y));
+            int_32 inv_len = setup.m_inverseHeights[1][setupIndex];
             left_dxdy = ::FixedLargeMul( (vertex2->m_x - left_x), inv_len );
             left_dudy = ::FixedLargeMul( (vertex2->m_textureCoordinates.m_u - 
 					  left_u), inv_len );
@@ -399,7 +619,9 @@ void Renderer::DrawTexturedTriangle( ScreenPolygon* face )
     left_z += ::FixedLargeMul( prestep, left_dzdy );
     right_x += ::FixedLargeMul( prestep, right_dxdy );
 
-    // setup for drawing
+    // setup for drawing; polygons inside the canvas need no clipping
+    bool inside_canvas = 
+	(face->m_polygonFlags & ScreenPolygonInsideCanvas) != 0;
     int_32 lowest_y = MIN( y3, m_canvas.m_bottom ) - 1;
     uint_32 scanline_ptr = (uint_32)((uint_32)m_canvas.m_bufferPtr + 
 				     y1 * m_canvas.m_bytesPerScanline);
@@ -438,8 +660,7 @@ void Renderer::DrawTexturedTriangle( ScreenPolygon* face )
 	    else 
 	    {
                 // update left side stuff for v2-v3
-                int_32 inv_len = (int_32)(MaxUint32 / (uint_32)(vertex3->m_y - 
-								vertex2->m_y));
+                int_32 inv_len = setup.m_inverseHeights[2][setupIndex];
                 left_x = vertex2->m_x;
                 left_u = vertex2->m_textureCoordinates.m_u;
                 left_v = vertex2->m_textureCoordinates.m_v;
@@ -461,11 +682,20 @@ void Renderer::DrawTexturedTriangle( ScreenPolygon* face )
             }
         }
 
-        if ( cur_y >= m_canvas.m_top ) 
+        if ( inside_canvas ) 
+	{
+            DrawUnclippedTexturedSpan( left_x, right_x, 
+				       left_u, left_v, left_z, 
+				       dudx, dvdx, dzdx, 
+				       scanline_ptr, face->m_texture, 
+				       face->m_mipLevel );
+        }
+        else if ( cur_y >= m_canvas.m_top ) 
 	{
             DrawTexturedSpan( left_x, right_x, left_u, left_v, left_z, 
 			      dudx, dvdx, dzdx, 
-                              scanline_ptr, face->m_texture );
+                              scanline_ptr, face->m_texture, 
+                              face->m_mipLevel );
         }
 
         // increment values for next scanline
@@ -486,14 +716,9 @@ inline void Renderer::DrawLightedTexturedSpan( int_32 leftX, int_32 rightX,
 					       int_32 dudx, int_32 dvdx, 
 					       int_32 dzdx, int_32 didx, 
 					       uint_32 scanlinePtr, 
-					       Texture* texture )
+					       Texture* texture, 
+					       int mipLevel )
 {
-    uint_8* tex_data = texture->GetData();
-    uint_32* tex_palettes = texture->GetPalette();
-    uint_32 u_mask = texture->GetUMask();
-    uint_32 v_mask = texture->GetVMask();
-    int_32 texshift = texture->GetShift();
-
     // ceil() span endpoint Xs to integers
     int_32 left = ::CeilFixed( leftX );
     int_32 right = ::CeilFixed( rightX );
@@ -515,7 +740,8 @@ inline void Renderer::DrawLightedTexturedSpan( int_32 leftX, int_32 rightX,
     // calculate span length
     int_32 len = right - left + 1;
 
-    //##TODO## remove all this 2d clipping crap when frustum clipping is done
+    // only polygons crossing the canvas edges are clipped here; the ones
+    // inside the canvas are drawn with the unclipped span functions
 
     // clip to the left side of the rendering canvas
     if ( left < m_canvas.m_left ) 
@@ -546,42 +772,188 @@ inline void Renderer::DrawLightedTexturedSpan( int_32 leftX, int_32 rightX,
 
     //##TODO## 2-byte pixel mode support
 
-    // calculate the address to start writing from
-    uint_32* p = (uint_32*)scanlinePtr + left;
+    FillLightedTexturedSpan( (uint_32*)scanlinePtr + left, len, 
+			     leftU, leftV, leftZ, intensityLeft, 
+			     dudx, dvdx, dzdx, didx, texture, mipLevel );
+}
 
-    while( len > 0 ) 
+inline void Renderer::DrawUnclippedLightedTexturedSpan( int_32 leftX, 
+							int_32 rightX, 
+							int_32 leftU, 
+							int_32 leftV, 
+							int_32 leftZ,
+							int_32 intensityLeft, 
+							int_32 dudx, 
+							int_32 dvdx, 
+							int_32 dzdx, 
+							int_32 didx, 
+							uint_32 scanlinePtr, 
+							Texture* texture, 
+							int mipLevel )
+{
+    // ceil() span endpoint Xs to integers; the polygon is inside the 
+    // canvas so the span needs no clipping
+    int_32 left = ::CeilFixed( leftX );
+    int_32 len = ::CeilFixed( rightX ) - left + 1;
+    if ( len <= 0 ) 
     {
-	int_64 real_z = DivLookup( leftZ );
-	int_32 real_u = (int_32)( ((int_64)leftU * real_z) >> 32);
-	int_32 real_v = (int_32)( ((int_64)leftV * real_z) >> 32);
+	return;
+    }
 
-        uint_8 value = tex_data[(real_u & u_mask) + 
-				(((real_v & v_mask) << texshift))];
-	uint_32* palette = 
-	    tex_palettes + (intensityLeft >> FixedPointPrec) * 
-	    Texture::NumPaletteEntries;
-        uint_32 color = palette[value];
-        *p++ = color;
+    // apply subtexel accuracy
+    int_32 prestep = (left << FixedPointPrec) - leftX;
+    leftU += ::FixedLargeMul( prestep, dudx );
+    leftV += ::FixedLargeMul( prestep, dvdx );
+    leftZ += ::FixedLargeMul( prestep, dzdx );
+
+    FillLightedTexturedSpan( (uint_32*)scanlinePtr + left, len, 
+			     leftU, leftV, leftZ, intensityLeft, 
+			     dudx, dvdx, dzdx, didx, texture, mipLevel );
+}
 
-        leftU += dudx;
-        leftV += dvdx;
-        leftZ += dzdx;
-	intensityLeft += didx;
-        len--;
+inline void Renderer::FillLightedTexturedSpan( uint_32* p, int_32 len, 
+					       int_32 u, int_32 v, int_32 z,
+					       int_32 intensity, 
+					       int_32 dudx, int_32 dvdx, 
+					       int_32 dzdx, int_32 didx, 
+					       Texture* texture, int mipLevel )
+{
+    const Texture::MipLevel& level = texture->GetMipLevel( mipLevel );
+    uint_8* tex_data = level.m_data;
+    uint_32* tex_palettes = texture->GetPalette();
+    uint_32 u_mask = level.m_umask;
+    uint_32 v_mask = level.m_vmask;
+    int_32 texshift = level.m_shift;
+
+    if ( texture->GetLightingMode() == Texture::ELightingModulate ) 
+    {
+	// single palette; the color is multiplied by the intensity
+	ModulateMasks masks;
+	nova3d::GetModulateMasks( texture->GetPixelFormat(), masks );
+
+	if ( level.m_uOffsets == NULL ) 
+	{
+	    // linear layout
+	    while( len > 0 ) 
+	    {
+		int_64 real_z = DivLookup( z );
+		int_32 real_u = (int_32)( ((int_64)u * real_z) >> 32);
+		int_32 real_v = (int_32)( ((int_64)v * real_z) >> 32);
+
+		uint_8 value = tex_data[(real_u & u_mask) + 
+					(((real_v & v_mask) << texshift))];
+		*p++ = nova3d::ModulateColor( tex_palettes[value], 
+					      intensity >> FixedPointPrec,
+					      masks );
+
+		u += dudx;
+		v += dvdx;
+		z += dzdx;
+		intensity += didx;
+		len--;
+	    }
+	}
+	else
+	{
+	    // swizzled layout
+	    const uint_32* u_offsets = level.m_uOffsets;
+	    const uint_32* v_offsets = level.m_vOffsets;
+
+	    while( len > 0 ) 
+	    {
+		int_64 real_z = DivLookup( z );
+		int_32 real_u = (int_32)( ((int_64)u * real_z) >> 32);
+		int_32 real_v = (int_32)( ((int_64)v * real_z) >> 32);
+
+		uint_8 value = tex_data[u_offsets[real_u & u_mask] + 
+					v_offsets[real_v & v_mask]];
+		*p++ = nova3d::ModulateColor( tex_palettes[value], 
+					      intensity >> FixedPointPrec,
+					      masks );
+
+		u += dudx;
+		v += dvdx;
+		z += dzdx;
+		intensity += didx;
+		len--;
+	    }
+	}
+    }
+    else if ( level.m_uOffsets == NULL ) 
+    {
+	// linear layout
+	while( len > 0 ) 
+	{
+	    int_64 real_z = DivLookup( z );
+	    int_32 real_u = (int_32)( ((int_64)u * real_z) >> 32);
+	    int_32 real_v = (int_32)( ((int_64)v * real_z) >> 32);
+
+	    uint_8 value = tex_data[(real_u & u_mask) + 
+				    (((real_v & v_mask) << texshift))];
+	    uint_32* palette = 
+		tex_palettes + (intensity >> FixedPointPrec) * 
+		Texture::NumPaletteEntries;
+	    uint_32 color = palette[value];
+	    *p++ = color;
+
+	    u += dudx;
+	    v += dvdx;
+	    z += dzdx;
+	    intensity += didx;
+	    len--;
+	}
+    }
+    else
+    {
+	// swizzled layout; the texel offset is the sum of the u and v offsets
+	const uint_32* u_offsets = level.m_uOffsets;
+	const uint_32* v_offsets = level.m_vOffsets;
+
+	while( len > 0 ) 
+	{
+	    int_64 real_z = DivLookup( z );
+	    int_32 real_u = (int_32)( ((int_64)u * real_z) >> 32);
+	    int_32 real_v = (int_32)( ((int_64)v * real_z) >> 32);
+
+	    uint_8 value = tex_data[u_offsets[real_u & u_mask] + 
+				    v_offsets[real_v & v_mask]];
+	    uint_32* palette = 
+		tex_palettes + (intensity >> FixedPointPrec) * 
+		Texture::NumPaletteEntries;
+	    uint_32 color = palette[value];
+	    *p++ = color;
+
+	    u += dudx;
+	    v += dvdx;
+	    z += dzdx;
+	    intensity += didx;
+	    len--;
+	}
     }
 }
 
-void Renderer::DrawLightedTexturedTriangle( ScreenPolygon* face )
+void Renderer::DrawLightedTexturedTriangle( ScreenPolygon* face, 
+					    int setupIndex )
 {
-    ScreenVertex *vertex1, *vertex2, *vertex3;
+    if ( m_rasterizer == RasterizerHalfSpace ) 
+    {
+	DrawHalfSpaceLightedTexturedTriangle( face );
+	return;
+    }
 
-    // sort vertices in y direction so that vertex1 < vertex2 < vertex3
-    nova3d::SelectVertexOrder( face, &vertex1, &vertex2, &vertex3 );
+    // the triangle setup has sorted the vertices in y direction so that 
+    // vertex1 < vertex2 < vertex3
+    ScreenVertex* vertex1 = &face->m_v1;
+    ScreenVertex* vertex2 = &face->m_v2;
+    ScreenVertex* vertex3 = &face->m_v3;
 
-    // calculate dudx, dvdx, dzdx (constant through whole polygon)
-    int_32 dudx, dvdx, dzdx, didx = 0;
-    nova3d::CalculatePolygonGradients( *vertex1, *vertex2, *vertex3, 
-				       dudx, dvdx, dzdx, didx );
+    // dudx, dvdx, dzdx, didx (constant through whole polygon) come from 
+    // the triangle setup
+    const TriangleSetupBatch& setup = m_setupBatch;
+    int_32 dudx = setup.m_dudx[setupIndex];
+    int_32 dvdx = setup.m_dvdx[setupIndex];
+    int_32 dzdx = setup.m_dzdx[setupIndex];
+    int_32 didx = setup.m_didx[setupIndex];
 
     // get the vertex y coordinates by ceil()ing from the accurate values
     int_32 y1 = ::CeilFixed( vertex1->m_y );
@@ -590,7 +962,8 @@ void Renderer::DrawLightedTexturedTriangle( ScreenPolygon* face )
     
     // calculate gradients for v1-v3 (constant for whole scan) and check 
     // whether the long edge (v1-v3) is "on left" 
-    int_32 long_inv_len, long_x, long_dxdy;
+    int_32 long_inv_len = setup.m_inverseHeights[0][setupIndex];
+    int_32 long_x, long_dxdy;
     bool long_on_left = nova3d::IsLongOnLeft( *vertex1, *vertex2, *vertex3, 
 					      long_inv_len, long_x, long_dxdy );
 
@@ -602,7 +975,7 @@ void Renderer::DrawLightedTexturedTriangle( ScreenPolygon* face )
     int_32 left_intensity = vertex1->m_textureCoordinates.m_intensity;
 
     int_32 left_dxdy, left_dudy, left_dvdy, left_dzdy, left_didy;
-    int_32 right_x, right_dxdy;
+    int_32 right_x = 0, right_dxdy = 0;
 
     if ( long_on_left ) 
     {
@@ -636,8 +1009,7 @@ void Renderer::DrawLightedTexturedTriangle( ScreenPolygon* face )
         if ( y2 > y1 ) 
 	{
             // calculate 'left' values for v1-v2
-            int_32 inv_len = (int_32)(MaxUint32 / 
-				      (uint_32)(vertex2->m_y - vertex1->m_y));
+            int_32 inv_len = setup.m_inverseHeights[1][setupIndex];
             left_dxdy = ::FixedLargeMul( (vertex2->m_x - left_x), inv_len );
             left_dudy = ::FixedLargeMul( (vertex2->m_textureCoordinates.m_u - 
 					  left_u), inv_len );
@@ -659,7 +1031,9 @@ void Renderer::DrawLightedTexturedTriangle( ScreenPolygon* face )
     left_intensity += ::FixedLargeMul( prestep, left_didy );
     right_x += ::FixedLargeMul( prestep, right_dxdy );
 
-    // setup for drawing
+    // setup for drawing; polygons inside the canvas need no clipping
+    bool inside_canvas = 
+	(face->m_polygonFlags & ScreenPolygonInsideCanvas) != 0;
     int_32 lowest_y = MIN( y3, m_canvas.m_bottom ) - 1;
     uint_32 scanline_ptr = (uint_32)((uint_32)m_canvas.m_bufferPtr + 
 				     y1 * m_canvas.m_bytesPerScanline);
@@ -698,8 +1072,7 @@ void Renderer::DrawLightedTexturedTriangle( ScreenPolygon* face )
 	    else 
 	    {
                 // update left side stuff for v2-v3
-                int_32 inv_len = (int_32)(MaxUint32 / (uint_32)(vertex3->m_y - 
-								vertex2->m_y));
+                int_32 inv_len = setup.m_inverseHeights[2][setupIndex];
                 left_x = vertex2->m_x;
                 left_u = vertex2->m_textureCoordinates.m_u;
                 left_v = vertex2->m_textureCoordinates.m_v;
@@ -726,12 +1099,22 @@ void Renderer::DrawLightedTexturedTriangle( ScreenPolygon* face )
             }
         }
 
-        if ( cur_y >= m_canvas.m_top ) 
+        if ( inside_canvas ) 
+	{
+            DrawUnclippedLightedTexturedSpan( left_x, right_x, 
+					      left_u, left_v, left_z, 
+					      left_intensity, 
+					      dudx, dvdx, dzdx, didx, 
+					      scanline_ptr, face->m_texture, 
+					      face->m_mipLevel );
+        }
+        else if ( cur_y >= m_canvas.m_top ) 
 	{
             DrawLightedTexturedSpan( left_x, right_x, left_u, left_v, left_z, 
 				     left_intensity, 
 				     dudx, dvdx, dzdx, didx, 
-				     scanline_ptr, face->m_texture );
+				     scanline_ptr, face->m_texture, 
+				     face->m_mipLevel );
         }
 
         // increment values for next scanline
@@ -746,4 +1129,381 @@ void Renderer::DrawLightedTexturedTriangle( ScreenPolygon* face )
     }
 }
 
+inline int_32 Renderer::PlaneValue( const HalfSpacePlane& plane, 
+				    int_32 x, int_32 y )
+{
+    return plane.m_origin + plane.m_dx * x + plane.m_dy * y;
+}
+
+bool Renderer::SetupHalfSpace( const ScreenPolygon* face, 
+			       HalfSpaceTriangle& triangle )
+{
+    const ScreenVertex* vertices[3] = 
+	{ &face->m_v1, &face->m_v2, &face->m_v3 };
+
+    // clip the pixel bounds of the triangle to the canvas. the pixels are
+    // sampled at their integer coordinates
+    int_32 min_x = MIN( MIN( face->m_v1.m_x, face->m_v2.m_x ), 
+			face->m_v3.m_x );
+    int_32 max_x = MAX( MAX( face->m_v1.m_x, face->m_v2.m_x ), 
+			face->m_v3.m_x );
+    int_32 min_y = MIN( MIN( face->m_v1.m_y, face->m_v2.m_y ), 
+			face->m_v3.m_y );
+    int_32 max_y = MAX( MAX( face->m_v1.m_y, face->m_v2.m_y ), 
+			face->m_v3.m_y );
+    triangle.m_left = MAX( ::CeilFixed( min_x ), m_canvas.m_left );
+    triangle.m_right = MIN( ::FloorFixed( max_x ), m_canvas.m_right - 1 );
+    triangle.m_top = MAX( ::CeilFixed( min_y ), m_canvas.m_top );
+    triangle.m_bottom = MIN( ::FloorFixed( max_y ), m_canvas.m_bottom - 1 );
+    if ( (triangle.m_left > triangle.m_right) || 
+	 (triangle.m_top > triangle.m_bottom) )
+    {
+	return false;
+    }
+
+    // vertex positions with HalfSpaceSubpixelBits of subpixel precision
+    int_32 shift = FixedPointPrec - HalfSpaceSubpixelBits;
+    int_32 x[3], y[3];
+    for ( int i = 0; i < 3; i++ )
+    {
+	x[i] = vertices[i]->m_x >> shift;
+	y[i] = vertices[i]->m_y >> shift;
+    }
+
+    int_64 area = ((int_64)(x[1] - x[0]) * (y[2] - y[0])) - 
+	((int_64)(y[1] - y[0]) * (x[2] - x[0]));
+    if ( area == 0 )
+    {
+	return false;
+    }
+
+    // wind the edges so that the edge functions are positive inside
+    int order[3] = { 0, 1, 2 };
+    if ( area < 0 )
+    {
+	order[1] = 2;
+	order[2] = 1;
+    }
+
+    int_32 origin_x = triangle.m_left << HalfSpaceSubpixelBits;
+    int_32 origin_y = triangle.m_top << HalfSpaceSubpixelBits;
+    for ( int edge = 0; edge < 3; edge++ )
+    {
+	int a = order[edge];
+	int b = order[(edge + 1) % 3];
+	int_32 dx = x[b] - x[a];
+	int_32 dy = y[b] - y[a];
+
+	// E(p) = dx * (p.y - a.y) - dy * (p.x - a.x)
+	int_64 value = ((int_64)dx * (origin_y - y[a])) - 
+	    ((int_64)dy * (origin_x - x[a]));
+
+	// a pixel exactly on an edge is drawn only for a right edge or a 
+	// flat bottom edge, so the triangles sharing an edge draw its pixels
+	// once. the scanline path rounds differently (see Rasterizer)
+	if ( !((dy > 0) || ((dy == 0) && (dx < 0))) )
+	{
+	    value--;
+	}
+
+	triangle.m_edgeValues[edge] = value;
+	triangle.m_edgeStepsX[edge] = -dy << HalfSpaceSubpixelBits;
+	triangle.m_edgeStepsY[edge] = dx << HalfSpaceSubpixelBits;
+    }
+
+    // the attribute planes are calculated at full precision
+    triangle.m_dx13 = (real_64)(face->m_v1.m_x - face->m_v3.m_x);
+    triangle.m_dx23 = (real_64)(face->m_v2.m_x - face->m_v3.m_x);
+    triangle.m_dy13 = (real_64)(face->m_v1.m_y - face->m_v3.m_y);
+    triangle.m_dy23 = (real_64)(face->m_v2.m_y - face->m_v3.m_y);
+    real_64 product = (triangle.m_dx13 * triangle.m_dy23) - 
+	(triangle.m_dx23 * triangle.m_dy13);
+    if ( product == 0.0 )
+    {
+	return false;
+    }
+    triangle.m_inverseArea = 65536.0 / product;
+    triangle.m_originX = triangle.m_left - (face->m_v3.m_x / 65536.0);
+    triangle.m_originY = triangle.m_top - (face->m_v3.m_y / 65536.0);
+
+    return true;
+}
+
+void Renderer::SetupPlane( const HalfSpaceTriangle& triangle, 
+			   int_32 value1, int_32 value2, int_32 value3, 
+			   HalfSpacePlane& plane )
+{
+    real_64 delta13 = (real_64)(value1 - value3);
+    real_64 delta23 = (real_64)(value2 - value3);
+    real_64 dx = ((delta13 * triangle.m_dy23) - 
+		  (delta23 * triangle.m_dy13)) * triangle.m_inverseArea;
+    real_64 dy = ((delta23 * triangle.m_dx13) - 
+		  (delta13 * triangle.m_dx23)) * triangle.m_inverseArea;
+
+    plane.m_dx = (int_32)dx;
+    plane.m_dy = (int_32)dy;
+    plane.m_origin = (int_32)(value3 + (dx * triangle.m_originX) + 
+			      (dy * triangle.m_originY));
+}
+
+int Renderer::ScanHalfSpaceBlockRow( const HalfSpaceTriangle& triangle, 
+				     int_32 y, int_32* spanLeft, 
+				     int_32* spanRight )
+{
+    int rows = MIN( HalfSpaceBlockSize, triangle.m_bottom - y + 1 );
+    for ( int row = 0; row < rows; row++ )
+    {
+	spanLeft[row] = triangle.m_right + 1;
+	spanRight[row] = triangle.m_left;
+    }
+
+    // edge values at the first block of the row, and their smallest and 
+    // largest offsets within a block
+    int_64 values[3];
+    int_32 min_offset[3], max_offset[3];
+    for ( int edge = 0; edge < 3; edge++ )
+    {
+	values[edge] = triangle.m_edgeValues[edge] + 
+	    (int_64)(y - triangle.m_top) * triangle.m_edgeStepsY[edge];
+	int_32 x_offset = 
+	    triangle.m_edgeStepsX[edge] * (HalfSpaceBlockSize - 1);
+	int_32 y_offset = 
+	    triangle.m_edgeStepsY[edge] * (HalfSpaceBlockSize - 1);
+	min_offset[edge] = MIN( x_offset, 0 ) + MIN( y_offset, 0 );
+	max_offset[edge] = MAX( x_offset, 0 ) + MAX( y_offset, 0 );
+    }
+
+    // the fully covered blocks are contiguous too, and are merged into 
+    // the spans only after the row
+    bool found = false;
+    int_32 full_left = triangle.m_right + 1;
+    int_32 full_right = triangle.m_left;
+    for ( int_32 x = triangle.m_left; x <= triangle.m_right; 
+	  x += HalfSpaceBlockSize )
+    {
+	bool outside = false;
+	bool inside = true;
+	for ( int edge = 0; edge < 3; edge++ )
+	{
+	    outside |= (values[edge] + max_offset[edge]) < 0;
+	    inside &= (values[edge] + min_offset[edge]) >= 0;
+	}
+
+	if ( outside ) 
+	{
+	    // the blocks not outside of any edge are contiguous as the 
+	    // triangle is convex; the rest of the row is outside
+	    if ( found )
+	    {
+		break;
+	    }
+	}
+	else if ( inside ) 
+	{
+	    // fully covered; no need to test the pixels
+	    found = true;
+	    full_left = MIN( full_left, x );
+	    full_right = x + HalfSpaceBlockSize;
+	}
+	else 
+	{
+	    // partially covered; the edges the block is inside of are 
+	    // passed as always covered, which keeps the others' values 
+	    // within 32 bits
+	    found = true;
+	    int_32 block_values[3], steps_x[3], steps_y[3];
+	    for ( int edge = 0; edge < 3; edge++ )
+	    {
+		bool inside_edge = (values[edge] + min_offset[edge]) >= 0;
+		block_values[edge] = inside_edge ? 0 : (int_32)values[edge];
+		steps_x[edge] = inside_edge ? 0 : triangle.m_edgeStepsX[edge];
+		steps_y[edge] = inside_edge ? 0 : triangle.m_edgeStepsY[edge];
+	    }
+
+	    uint_8 masks[HalfSpaceBlockSize];
+	    m_kernels.m_blockCoverage( block_values, steps_x, steps_y, masks );
+
+	    for ( int row = 0; row < rows; row++ )
+	    {
+		spanLeft[row] = MIN( spanLeft[row], 
+				     x + m_maskSpanLeft[masks[row]] );
+		spanRight[row] = MAX( spanRight[row], 
+				      x + m_maskSpanRight[masks[row]] );
+	    }
+	}
+
+	for ( int edge = 0; edge < 3; edge++ )
+	{
+	    values[edge] += 
+		(int_64)triangle.m_edgeStepsX[edge] * HalfSpaceBlockSize;
+	}
+    }
+
+    // the last block may reach past the bounds
+    for ( int row = 0; row < rows; row++ )
+    {
+	spanLeft[row] = MIN( spanLeft[row], full_left );
+	spanRight[row] = MIN( MAX( spanRight[row], full_right ), 
+			      triangle.m_right + 1 );
+    }
+
+    return rows;
+}
+
+void Renderer::DrawHalfSpaceTriangle( ScreenPolygon* face )
+{
+    HalfSpaceTriangle triangle;
+    if ( !SetupHalfSpace( face, triangle ) )
+    {
+	return;
+    }
+
+    HalfSpacePlane red, green, blue;
+    SetupPlane( triangle, face->m_v1.m_color.m_red, 
+		face->m_v2.m_color.m_red, face->m_v3.m_color.m_red, red );
+    SetupPlane( triangle, face->m_v1.m_color.m_green, 
+		face->m_v2.m_color.m_green, face->m_v3.m_color.m_green, 
+		green );
+    SetupPlane( triangle, face->m_v1.m_color.m_blue, 
+		face->m_v2.m_color.m_blue, face->m_v3.m_color.m_blue, blue );
+
+    int_32 span_left[HalfSpaceBlockSize], span_right[HalfSpaceBlockSize];
+    for ( int_32 y = triangle.m_top; y <= triangle.m_bottom; 
+	  y += HalfSpaceBlockSize )
+    {
+	int rows = ScanHalfSpaceBlockRow( triangle, y, span_left, span_right );
+	uint_8* scanline_p = (uint_8*)m_canvas.m_bufferPtr + 
+	    y * m_canvas.m_bytesPerScanline;
+	for ( int row = 0; row < rows; row++ )
+	{
+	    int_32 len = span_right[row] - span_left[row];
+	    if ( len > 0 )
+	    {
+		int_32 plane_x = span_left[row] - triangle.m_left;
+		int_32 plane_y = y + row - triangle.m_top;
+		uint_32* span_p = (uint_32*)scanline_p + span_left[row];
+		FillGouraudSpan( span_p, len, 
+				 PlaneValue( red, plane_x, plane_y ), 
+				 PlaneValue( green, plane_x, plane_y ), 
+				 PlaneValue( blue, plane_x, plane_y ), 
+				 red.m_dx, green.m_dx, blue.m_dx );
+	    }
+	    scanline_p += m_canvas.m_bytesPerScanline;
+	}
+    }
+}
+
+void Renderer::DrawHalfSpaceTexturedTriangle( ScreenPolygon* face )
+{
+    HalfSpaceTriangle triangle;
+    if ( !SetupHalfSpace( face, triangle ) )
+    {
+	return;
+    }
+
+    // the triangle setup has replaced u, v and z with u/z, v/z and 1/z
+    HalfSpacePlane u, v, z;
+    SetupPlane( triangle, face->m_v1.m_textureCoordinates.m_u, 
+		face->m_v2.m_textureCoordinates.m_u, 
+		face->m_v3.m_textureCoordinates.m_u, u );
+    SetupPlane( triangle, face->m_v1.m_textureCoordinates.m_v, 
+		face->m_v2.m_textureCoordinates.m_v, 
+		face->m_v3.m_textureCoordinates.m_v, v );
+    SetupPlane( triangle, face->m_v1.m_z, face->m_v2.m_z, face->m_v3.m_z, 
+		z );
+
+    int_32 span_left[HalfSpaceBlockSize], span_right[HalfSpaceBlockSize];
+    for ( int_32 y = triangle.m_top; y <= triangle.m_bottom; 
+	  y += HalfSpaceBlockSize )
+    {
+	int rows = ScanHalfSpaceBlockRow( triangle, y, span_left, span_right );
+	uint_8* scanline_p = (uint_8*)m_canvas.m_bufferPtr + 
+	    y * m_canvas.m_bytesPerScanline;
+	for ( int row = 0; row < rows; row++ )
+	{
+	    int_32 len = span_right[row] - span_left[row];
+	    if ( len > 0 )
+	    {
+		int_32 plane_x = span_left[row] - triangle.m_left;
+		int_32 plane_y = y + row - triangle.m_top;
+		uint_32* span_p = (uint_32*)scanline_p + span_left[row];
+		FillTexturedSpan( span_p, len, 
+				  PlaneValue( u, plane_x, plane_y ), 
+				  PlaneValue( v, plane_x, plane_y ), 
+				  PlaneValue( z, plane_x, plane_y ), 
+				  u.m_dx, v.m_dx, z.m_dx, 
+				  face->m_texture, face->m_mipLevel );
+	    }
+	    scanline_p += m_canvas.m_bytesPerScanline;
+	}
+    }
+}
+
+void Renderer::DrawHalfSpaceLightedTexturedTriangle( ScreenPolygon* face )
+{
+    HalfSpaceTriangle triangle;
+    if ( !SetupHalfSpace( face, triangle ) )
+    {
+	return;
+    }
+
+    // the triangle setup has replaced u, v and z with u/z, v/z and 1/z
+    HalfSpacePlane u, v, z, intensity;
+    SetupPlane( triangle, face->m_v1.m_textureCoordinates.m_u, 
+		face->m_v2.m_textureCoordinates.m_u, 
+		face->m_v3.m_textureCoordinates.m_u, u );
+    SetupPlane( triangle, face->m_v1.m_textureCoordinates.m_v, 
+		face->m_v2.m_textureCoordinates.m_v, 
+		face->m_v3.m_textureCoordinates.m_v, v );
+    SetupPlane( triangle, face->m_v1.m_z, face->m_v2.m_z, face->m_v3.m_z, 
+		z );
+    SetupPlane( triangle, face->m_v1.m_textureCoordinates.m_intensity, 
+		face->m_v2.m_textureCoordinates.m_intensity, 
+		face->m_v3.m_textureCoordinates.m_intensity, intensity );
+
+    // the plane may extrapolate the intensity past the palette range at
+    // the pixels just outside of the vertices
+    int_32 max_intensity = 
+	(face->m_texture->GetLightingMode() == Texture::ELightingModulate) ? 
+	(MaxModulateIntensity << FixedPointPrec) : 
+	((face->m_texture->GetNumPalettes() - 1) << FixedPointPrec);
+
+    int_32 span_left[HalfSpaceBlockSize], span_right[HalfSpaceBlockSize];
+    for ( int_32 y = triangle.m_top; y <= triangle.m_bottom; 
+	  y += HalfSpaceBlockSize )
+    {
+	int rows = ScanHalfSpaceBlockRow( triangle, y, span_left, span_right );
+	uint_8* scanline_p = (uint_8*)m_canvas.m_bufferPtr + 
+	    y * m_canvas.m_bytesPerScanline;
+	for ( int row = 0; row < rows; row++ )
+	{
+	    int_32 len = span_right[row] - span_left[row];
+	    if ( len > 0 )
+	    {
+		int_32 plane_x = span_left[row] - triangle.m_left;
+		int_32 plane_y = y + row - triangle.m_top;
+		int_32 start = PlaneValue( intensity, plane_x, plane_y );
+		int_32 end = start + intensity.m_dx * (len - 1);
+		int_32 didx = intensity.m_dx;
+		if ( (start < 0) || (start > max_intensity) || 
+		     (end < 0) || (end > max_intensity) )
+		{
+		    start = MIN( MAX( start, 0 ), max_intensity );
+		    end = MIN( MAX( end, 0 ), max_intensity );
+		    didx = (len > 1) ? ((end - start) / (len - 1)) : 0;
+		}
+
+		uint_32* span_p = (uint_32*)scanline_p + span_left[row];
+		FillLightedTexturedSpan( span_p, len, 
+					 PlaneValue( u, plane_x, plane_y ), 
+					 PlaneValue( v, plane_x, plane_y ), 
+					 PlaneValue( z, plane_x, plane_y ), 
+					 start, u.m_dx, v.m_dx, z.m_dx, didx, 
+					 face->m_texture, face->m_mipLevel );
+	    }
+	    scanline_p += m_canvas.m_bytesPerScanline;
+	}
+    }
+}
+
 }; // namespace
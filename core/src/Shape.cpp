@@ -23,7 +23,11 @@
  */
 
 //#include <string.h>
+#include <stdlib.h>
+#include <math.h>
 
+#include "AlignedMemory.h"
+#include "Kernels.h"
 #include "Lights.h"
 #include "Shape.h"
 #include "Node.h"
@@ -45,15 +49,29 @@ NOVA_EXPORT Shape::Shape( NovaPixelFormat pixelFormat )
       m_numVertexNormals( 0 ),
       m_vertexNormals( NULL ),
       m_transformedVertexNormals( NULL ),
+      m_normalInfos( NULL ),
+      m_hasVisibleEnvMapping( false ),
       m_vertexNormalIndices( NULL ),
       m_isIlluminated( false ), 
       m_lightingIntensities( NULL ),
-      m_distanceCache( NULL ), 
+      m_isPrelit( false ),
+      m_isOccluder( false ),
       m_planeEquations( NULL ),
       m_polygonInfos( NULL ),
       m_vertexInfos( NULL ), 
-      m_boundingSphereRadius( -1 )
+      m_numLitVertices( 0 ),
+      m_litVertexIndices( NULL ),
+      m_litNormalIndices( NULL ),
+      m_cornerLitVertices( NULL ),
+      m_lightingCoverage( LightingNone ),
+      m_lightingAmbient( 0 ),
+      m_geometryBlock( NULL ),
+      m_normalBlock( NULL ),
+      m_litVertexBlock( NULL ),
+      m_textureBlock( NULL ),
+      m_externalData( false )
 {
+    m_boundingSphere.m_radius = -1;
 }
 
 NOVA_EXPORT Shape::~Shape()
@@ -66,222 +84,310 @@ void Shape::DeallocateAll()
     m_numCoordinates = 0;
     m_numPolygons = 0;
     
-    free( m_coordinates );
-    free( m_transformedCoordinates );
-    free( m_vertices );
-    free( m_vertexColors );
-    free( m_textures );
-    free( m_textureCoordinates );
-    free( m_vertexNormals );
-    free( m_transformedVertexNormals );
-    free( m_vertexNormalIndices );
-    free( m_lightingIntensities );
-    free( m_distanceCache );
-    free( m_planeEquations );
-    free( m_polygonInfos );
-    free( m_vertexInfos );
+    // all the owned arrays live in the blocks
+    AlignedFree( m_geometryBlock );
+    AlignedFree( m_normalBlock );
+    AlignedFree( m_litVertexBlock );
+    AlignedFree( m_textureBlock );
+    m_geometryBlock = NULL;
+    m_normalBlock = NULL;
+    m_litVertexBlock = NULL;
+    m_textureBlock = NULL;
+
+    m_coordinates = NULL;
+    m_vertices = NULL;
+    m_vertexColors = NULL;
+    m_textureCoordinates = NULL;
+    m_vertexNormals = NULL;
+    m_vertexNormalIndices = NULL;
+    m_planeEquations = NULL;
+    m_transformedCoordinates = NULL;
+    m_textures = NULL;
+    m_transformedVertexNormals = NULL;
+    m_normalInfos = NULL;
+    m_hasVisibleEnvMapping = false;
+    m_lightingIntensities = NULL;
+    m_polygonInfos = NULL;
+    m_vertexInfos = NULL;
+    m_numVertexNormals = 0;
+    m_numLitVertices = 0;
+    m_litVertexIndices = NULL;
+    m_litNormalIndices = NULL;
+    m_cornerLitVertices = NULL;
+    m_lightingCoverage = LightingNone;
+    m_isPrelit = false;
+    m_externalData = false;
 }
 
-NOVA_EXPORT int Shape::CreateGeometry( int numCoordinates, int numPolygons,
-                                       real_64* coordinates, uint_32* vertices )
+/**
+ * Reserves a cache line aligned array of arraySize bytes at the end of a 
+ * block being laid out and returns its offset in the block.
+ */
+static size_t ReserveArray( size_t& blockSize, size_t arraySize )
 {
-    LOG_DEBUG_F("Shape::CreateGeometry() #coords = %d, #polys = %d",
-		numCoordinates, numPolygons);
+    size_t offset = blockSize;
+    blockSize += AlignSize( arraySize );
+    return offset;
+}
 
-    m_numCoordinates = numCoordinates;
-    m_numPolygons = numPolygons;
-    
-    int ret = AllocateVertexList();
-    if ( ret != NovaErrNone )
+NOVA_EXPORT int Shape::CreateFromExternalData( const ShapeData& data )
+{
+    LOG_DEBUG_F("Shape::CreateFromExternalData() #coords = %d, #polys = %d",
+		data.m_numCoordinates, data.m_numPolygons);
+
+    if ( (m_vertices != NULL) || (m_coordinates != NULL) )
     {
-        DeallocateAll();
-        return ret;
+	return NovaErrAlreadyInitialized;
     }
-    
-    ret = AllocateColorList();
-    if ( ret != NovaErrNone )
+
+    if ( (data.m_coordinates == NULL) || (data.m_vertices == NULL) || 
+	 (data.m_planeEquations == NULL) )
     {
-        DeallocateAll();
-        return ret;
+	return NovaErrInvalidArgument;
     }
 
-    ret = AllocateCoordinateList();
-    if ( ret != NovaErrNone )
+    m_numCoordinates = data.m_numCoordinates;
+    m_numPolygons = data.m_numPolygons;
+    m_externalData = true;
+
+    // the geometry is used in place
+    m_coordinates = const_cast<Vector*>( data.m_coordinates );
+    m_vertices = const_cast<uint_32*>( data.m_vertices );
+    m_planeEquations = const_cast<PlaneEquation*>( data.m_planeEquations );
+    m_vertexColors = const_cast<uint_32*>( data.m_vertexColors );
+    m_textureCoordinates = const_cast<int_32*>( data.m_textureCoordinates );
+    if ( data.m_vertexNormals != NULL )
     {
-        DeallocateAll();
-        return ret;
+	m_numVertexNormals = data.m_numVertexNormals;
+	m_vertexNormals = const_cast<Vector*>( data.m_vertexNormals );
+	m_vertexNormalIndices = 
+	    const_cast<uint_32*>( data.m_vertexNormalIndices );
     }
+    m_boundingSphere = data.m_boundingSphere;
+    m_boundingBox = data.m_boundingBox;
 
-    ret = AllocateLightingIntensities();
+    // allocate the buffers that are written to every frame
+    int ret = AllocateFrameBuffers();
+    if ( ret == NovaErrNone )
+    {
+	ret = CreateLitVertices();
+    }
     if ( ret != NovaErrNone )
     {
-        DeallocateAll();
-        return ret;
+	DeallocateAll();
+	return ret;
     }
 
-    // initialize the coordinate list (vectors) from the data
-    const real_64 *coordinate = coordinates; 
-    for ( int i = 0; i < m_numCoordinates; i++ ) 
+    if ( data.m_polygonInfos != NULL )
     {
-        real_64 x = *coordinate++;
-        real_64 y = *coordinate++;
-        real_64 z = *coordinate++;
-        
-        (m_coordinates + i)->SetReal( x, y, z );
+	memcpy( m_polygonInfos, data.m_polygonInfos, 
+		m_numPolygons * sizeof(uint_32) );
     }
-    
-    // copy the polygon vertex list
-    memcpy( m_vertices, vertices, 3 * m_numPolygons * sizeof(uint_32) );
-    
-    // the shape receives no lighting by default
-    SetIlluminated( false );
 
-    // calculate plane equations for all polygons
-    for ( int i = 0; i < m_numPolygons; i++ )
+    SetIlluminated( data.m_isIlluminated );
+
+    if ( data.m_lightingIntensities != NULL )
     {
-        CalculatePlaneEquation( i );
+	SetPrelitIntensities( data.m_lightingIntensities );
     }
-    
+
     return NovaErrNone;
 }
 
-// NOTE: CreateGeometry() handles the cleanup if this method returns with error
-int Shape::AllocateVertexList()
+NOVA_EXPORT int Shape::CreateGeometry( int numCoordinates, int numPolygons,
+                                       real_64* coordinates, uint_32* vertices )
 {
-    if ( m_vertices != NULL )
-    {
-        return NovaErrAlreadyInitialized;
-    }
-    
-    // allocate polygon list
-    size_t size = 3 * m_numPolygons * sizeof(uint_32);
-    m_vertices = (uint_32*)malloc( size );
-    if ( m_vertices == NULL )
-    {
-        return NovaErrNoMemory;
-    }
-    memset( m_vertices, 0, size ); 
+    LOG_DEBUG_F("Shape::CreateGeometry() #coords = %d, #polys = %d",
+		numCoordinates, numPolygons);
 
-    // allocate polygon flag list
-    m_polygonInfos = (uint_32*)malloc( m_numPolygons * sizeof(uint_32) );
-    if ( m_polygonInfos == NULL )
+    int ret = AllocateGeometry( numCoordinates, numPolygons );
+    if ( ret != NovaErrNone )
     {
-        return NovaErrNoMemory;
+        return ret;
     }
-    memset( m_polygonInfos, 0, m_numPolygons * sizeof(uint_32) );
-
-    // allocate plane equation list
-    m_planeEquations = 
-        (PlaneEquation*)malloc( m_numPolygons * sizeof(PlaneEquation) );
-    if ( m_planeEquations == NULL )
+    
+    // initialize the coordinate list (vectors) from the data
+    const real_64 *coordinate = coordinates; 
+    for ( int i = 0; i < m_numCoordinates; i++ ) 
     {
-        return NovaErrNoMemory;
+        real_64 x = *coordinate++;
+        real_64 y = *coordinate++;
+        real_64 z = *coordinate++;
+        
+        (m_coordinates + i)->SetReal( x, y, z );
     }
-    memset( m_planeEquations, 0, m_numPolygons * sizeof(PlaneEquation) );
     
+    InitializePolygons( vertices );
+
     return NovaErrNone;
 }
 
-// NOTE: CreateGeometry() handles the cleanup if this method returns with error
-int Shape::AllocateColorList()
+NOVA_EXPORT int Shape::CreateGeometry( int numCoordinates, int numPolygons,
+                                       const Vector* coordinates, 
+                                       const uint_32* vertices )
 {
-    if ( m_vertexColors != NULL )
+    LOG_DEBUG_F("Shape::CreateGeometry() #coords = %d, #polys = %d",
+		numCoordinates, numPolygons);
+
+    int ret = AllocateGeometry( numCoordinates, numPolygons );
+    if ( ret != NovaErrNone )
     {
-        return NovaErrAlreadyInitialized;
+        return ret;
     }
 
-    int numColors = m_numPolygons * 3;
-    m_vertexColors = (uint_32*)malloc( numColors * sizeof(uint_32) );
+    memcpy( m_coordinates, coordinates, m_numCoordinates * sizeof(Vector) );
+    InitializePolygons( vertices );
 
-    return (m_vertexColors == NULL) ? NovaErrNoMemory : NovaErrNone;
+    return NovaErrNone;
 }
 
-// NOTE: CreateGeometry() handles the cleanup if this method returns with error
-int Shape::AllocateCoordinateList()
+int Shape::AllocateGeometry( int numCoordinates, int numPolygons )
 {
-    if ( m_coordinates != NULL )
+    if ( (m_vertices != NULL) || (m_coordinates != NULL) )
     {
         return NovaErrAlreadyInitialized;
     }
-    
-    // allocate coordinate list + transformed coordinate list
-    m_coordinates = (Vector*)malloc( m_numCoordinates * sizeof(Vector) );
-    if ( m_coordinates == NULL )
-    {
-        return NovaErrNoMemory;
-    }
-    m_transformedCoordinates = 
-	(Vector*)malloc( m_numCoordinates * sizeof(Vector) );
-    if ( m_transformedCoordinates == NULL )
+
+    // lay the arrays out in the order they are accessed every frame: 
+    // BackfaceCull() walks the plane equations, polygon infos and polygon
+    // vertices marking the vertex infos, TransformAll() transforms the 
+    // visible coordinates and ProcessPolygonList() reads the transformed
+    // coordinates with the vertex colors and lighting intensities.
+    size_t size = 0;
+    size_t planeEquations = 
+	ReserveArray( size, numPolygons * sizeof(PlaneEquation) );
+    size_t polygonInfos = ReserveArray( size, numPolygons * sizeof(uint_32) );
+    size_t vertices = ReserveArray( size, 3 * numPolygons * sizeof(uint_32) );
+    size_t vertexInfos = 
+	ReserveArray( size, numCoordinates * sizeof(uint_32) );
+    size_t coordinates = ReserveArray( size, numCoordinates * sizeof(Vector) );
+    size_t transformedCoordinates = 
+	ReserveArray( size, numCoordinates * sizeof(Vector) );
+    size_t vertexColors = 
+	ReserveArray( size, 3 * numPolygons * sizeof(uint_32) );
+    size_t lightingIntensities = 
+	ReserveArray( size, 3 * numPolygons * sizeof(int_32) );
+
+    uint_8* block = (uint_8*)AlignedMalloc( size );
+    if ( block == NULL )
     {
         return NovaErrNoMemory;
     }
-    memset( m_coordinates, 0, m_numCoordinates * sizeof(Vector) );
-    memset( m_transformedCoordinates, 0, m_numCoordinates * sizeof(Vector) );
+    memset( block, 0, size );
+
+    m_geometryBlock = block;
+    m_numCoordinates = numCoordinates;
+    m_numPolygons = numPolygons;
+    m_planeEquations = (PlaneEquation*)(block + planeEquations);
+    m_polygonInfos = (uint_32*)(block + polygonInfos);
+    m_vertices = (uint_32*)(block + vertices);
+    m_vertexInfos = (uint_32*)(block + vertexInfos);
+    m_coordinates = (Vector*)(block + coordinates);
+    m_transformedCoordinates = (Vector*)(block + transformedCoordinates);
+    m_vertexColors = (uint_32*)(block + vertexColors);
+    m_lightingIntensities = (int_32*)(block + lightingIntensities);
 
-    // allocate vertex info for each vertex
-    m_vertexInfos = (uint_32*)malloc( m_numCoordinates * sizeof(uint_32) );
-    if ( m_vertexInfos == NULL )
+    return NovaErrNone;
+}
+
+int Shape::AllocateFrameBuffers()
+{
+    // external data provides the geometry; only the buffers written to 
+    // every frame are allocated, in the same order as in AllocateGeometry()
+    size_t size = 0;
+    size_t polygonInfos = ReserveArray( size, m_numPolygons * sizeof(uint_32) );
+    size_t vertexInfos = 
+	ReserveArray( size, m_numCoordinates * sizeof(uint_32) );
+    size_t transformedCoordinates = 
+	ReserveArray( size, m_numCoordinates * sizeof(Vector) );
+    size_t lightingIntensities = 
+	ReserveArray( size, 3 * m_numPolygons * sizeof(int_32) );
+    size_t transformedVertexNormals = 
+	ReserveArray( size, m_numVertexNormals * sizeof(Vector) );
+    size_t normalInfos = 
+	ReserveArray( size, m_numVertexNormals * sizeof(uint_32) );
+
+    uint_8* block = (uint_8*)AlignedMalloc( size );
+    if ( block == NULL )
     {
         return NovaErrNoMemory;
     }
-    memset( m_vertexInfos, 0, m_numCoordinates * sizeof(uint_32) );
-
-    // allocate distance cache for lighting
-    m_distanceCache = (int_32*)malloc( m_numCoordinates * sizeof(int_32) );
-    if ( m_distanceCache == NULL )
+    memset( block, 0, size );
+
+    m_geometryBlock = block;
+    m_polygonInfos = (uint_32*)(block + polygonInfos);
+    m_vertexInfos = (uint_32*)(block + vertexInfos);
+    m_transformedCoordinates = (Vector*)(block + transformedCoordinates);
+    m_lightingIntensities = (int_32*)(block + lightingIntensities);
+    if ( m_vertexNormals != NULL )
     {
-        return NovaErrNoMemory;
+        m_transformedVertexNormals = 
+	    (Vector*)(block + transformedVertexNormals);
+        m_normalInfos = (uint_32*)(block + normalInfos);
     }
-    memset( m_distanceCache, 0, m_numCoordinates * sizeof(int_32) );
 
     return NovaErrNone;
 }
 
-// NOTE: CreateGeometry() handles the cleanup if this method returns with error
-int Shape::AllocateLightingIntensities()
+void Shape::InitializePolygons( const uint_32* vertices )
 {
-    if ( m_lightingIntensities != NULL )
+    // copy the polygon vertex list
+    memcpy( m_vertices, vertices, 3 * m_numPolygons * sizeof(uint_32) );
+    
+    // the shape receives no lighting by default
+    SetIlluminated( false );
+
+    // calculate plane equations for all polygons
+    for ( int i = 0; i < m_numPolygons; i++ )
     {
-        return NovaErrAlreadyInitialized;
+        CalculatePlaneEquation( i );
     }
-    
-    size_t size = 3 * m_numPolygons * sizeof(int);
-    m_lightingIntensities = (int*)malloc( size );
-    return (m_lightingIntensities == NULL) ? NovaErrNoMemory : NovaErrNone;
+
+    CalculateBoundingVolumes();
 }
 
-int Shape::AllocateTextureList()
+int Shape::AllocateTextureBlock()
 {
     if ( m_textures != NULL )
     {
         return NovaErrAlreadyInitialized;
     }
-    
-    m_textures = (Texture**)malloc( m_numPolygons * sizeof(Texture*) );
-    return (m_textures == NULL) ? NovaErrNoMemory : NovaErrNone;
-}
 
-int Shape::AllocateTextureCoordinateList()
-{
-    if ( m_textureCoordinates != NULL )
+    // the textures and the texture coordinates are allocated together; 
+    // external data may already provide the coordinates
+    size_t size = 0;
+    size_t textures = ReserveArray( size, m_numPolygons * sizeof(Texture*) );
+    size_t textureCoordinates = 0;
+    if ( m_textureCoordinates == NULL )
     {
-        return NovaErrAlreadyInitialized;
+        textureCoordinates = 
+	    ReserveArray( size, 6 * m_numPolygons * sizeof(int_32) );
     }
 
-    size_t size = 6 * m_numPolygons * sizeof(int);
-    m_textureCoordinates = (int*)malloc( size );
-    if ( m_textureCoordinates == NULL )
+    uint_8* block = (uint_8*)AlignedMalloc( size );
+    if ( block == NULL )
     {
         return NovaErrNoMemory;
     }
-    memset( m_textureCoordinates, 0, size );
+    memset( block, 0, size );
+
+    m_textureBlock = block;
+    m_textures = (Texture**)(block + textures);
+    if ( m_textureCoordinates == NULL )
+    {
+        m_textureCoordinates = (int_32*)(block + textureCoordinates);
+    }
     
     return NovaErrNone;
 }
 
 NOVA_EXPORT int Shape::SetVertexColors( const uint_32* colors )
 {
+    if ( m_externalData )
+    {
+        return NovaErrAlreadyInitialized;
+    }
+
     if ( m_vertexColors == NULL )
     {
         return NovaErrNotInitialized;
@@ -308,7 +414,7 @@ NOVA_EXPORT int Shape::SetTexture( int polygonIndex, Texture* texture )
     
     if ( m_textures == NULL )
     {
-        int ret = AllocateTextureList();
+        int ret = AllocateTextureBlock();
         if ( ret != NovaErrNone )
 	{
             return ret;
@@ -335,9 +441,14 @@ NOVA_EXPORT int Shape::SetTexture( Texture* texture )
 
 NOVA_EXPORT int Shape::SetTextureCoordinates( const int_32* coordinates )
 {
+    if ( m_externalData )
+    {
+        return NovaErrAlreadyInitialized;
+    }
+
     if ( m_textureCoordinates == NULL )
     {
-        int ret = AllocateTextureCoordinateList();
+        int ret = AllocateTextureBlock();
         if ( ret != NovaErrNone )
 	{
             return ret;
@@ -356,9 +467,14 @@ NOVA_EXPORT int Shape::SetTextureCoordinates( int polygonIndex,
                                               int u1, int v1, 
                                               int u2, int v2 )
 {
+    if ( m_externalData )
+    {
+        return NovaErrAlreadyInitialized;
+    }
+
     if ( m_textureCoordinates == NULL )
     {
-        int ret = AllocateTextureCoordinateList();
+        int ret = AllocateTextureBlock();
         if ( ret != NovaErrNone )
 	{
             return ret;
@@ -379,18 +495,114 @@ NOVA_EXPORT int Shape::SetTextureCoordinates( int polygonIndex,
 
 void Shape::DeallocateVertexNormals()
 {
-    free( m_vertexNormals );
+    AlignedFree( m_normalBlock );
+    AlignedFree( m_litVertexBlock );
+    m_normalBlock = NULL;
+    m_litVertexBlock = NULL;
     m_vertexNormals = NULL;
-    free( m_transformedVertexNormals );
     m_transformedVertexNormals = NULL;
-    free( m_vertexNormalIndices );
+    m_normalInfos = NULL;
+    m_hasVisibleEnvMapping = false;
     m_vertexNormalIndices = NULL;
+    m_numLitVertices = 0;
+    m_litVertexIndices = NULL;
+    m_litNormalIndices = NULL;
+    m_cornerLitVertices = NULL;
+}
+
+int Shape::CreateLitVertices()
+{
+    if ( m_vertexNormals == NULL )
+    {
+        return NovaErrNone;
+    }
+
+    // the pairs found so far are chained by their vertex; a vertex seldom
+    // has more than a few distinct normals so the chains stay short
+    int numCorners = 3 * m_numPolygons;
+    int_32* firstPair = (int_32*)malloc( m_numCoordinates * sizeof(int_32) );
+    int_32* nextPair = (int_32*)malloc( numCorners * sizeof(int_32) );
+    uint_32* pairNormals = (uint_32*)malloc( numCorners * sizeof(uint_32) );
+    uint_32* pairVertices = (uint_32*)malloc( numCorners * sizeof(uint_32) );
+    uint_32* cornerPairs = (uint_32*)malloc( numCorners * sizeof(uint_32) );
+    if ( (firstPair == NULL) || (nextPair == NULL) || (pairNormals == NULL) ||
+         (pairVertices == NULL) || (cornerPairs == NULL) )
+    {
+        free( firstPair );
+        free( nextPair );
+        free( pairNormals );
+        free( pairVertices );
+        free( cornerPairs );
+        return NovaErrNoMemory;
+    }
+    memset( firstPair, 0xff, m_numCoordinates * sizeof(int_32) );
+
+    int numPairs = 0;
+    for ( int i = 0; i < numCorners; i++ )
+    {
+        uint_32 vertex = m_vertices[i];
+        uint_32 normal = m_vertexNormalIndices[i];
+
+        int_32 pair = firstPair[vertex];
+        while ( (pair >= 0) && (pairNormals[pair] != normal) )
+        {
+            pair = nextPair[pair];
+        }
+
+        if ( pair < 0 )
+        {
+            pair = numPairs++;
+            pairVertices[pair] = vertex;
+            pairNormals[pair] = normal;
+            nextPair[pair] = firstPair[vertex];
+            firstPair[vertex] = pair;
+        }
+        cornerPairs[i] = pair;
+    }
+
+    size_t size = 0;
+    size_t litVertexIndices = ReserveArray( size, numPairs * sizeof(uint_32) );
+    size_t litNormalIndices = ReserveArray( size, numPairs * sizeof(uint_32) );
+    size_t cornerLitVertices = 
+        ReserveArray( size, numCorners * sizeof(uint_32) );
+
+    int ret = NovaErrNoMemory;
+    uint_8* block = (uint_8*)AlignedMalloc( size );
+    if ( block != NULL )
+    {
+        AlignedFree( m_litVertexBlock );
+        m_litVertexBlock = block;
+        m_numLitVertices = numPairs;
+        m_litVertexIndices = (uint_32*)(block + litVertexIndices);
+        m_litNormalIndices = (uint_32*)(block + litNormalIndices);
+        m_cornerLitVertices = (uint_32*)(block + cornerLitVertices);
+        m_lightingCoverage = LightingNone;
+
+        memcpy( m_litVertexIndices, pairVertices, numPairs * sizeof(uint_32) );
+        memcpy( m_litNormalIndices, pairNormals, numPairs * sizeof(uint_32) );
+        memcpy( m_cornerLitVertices, cornerPairs, 
+                numCorners * sizeof(uint_32) );
+        ret = NovaErrNone;
+    }
+
+    free( firstPair );
+    free( nextPair );
+    free( pairNormals );
+    free( pairVertices );
+    free( cornerPairs );
+
+    return ret;
 }
 
 NOVA_EXPORT int Shape::SetVertexNormals( int numNormals, 
                                          Vector* normalList, 
                                          uint_32* indices )
 {
+    if ( m_externalData )
+    {
+        return NovaErrAlreadyInitialized;
+    }
+
     // deallocate existing lists
     DeallocateVertexNormals();
     
@@ -399,35 +611,49 @@ NOVA_EXPORT int Shape::SetVertexNormals( int numNormals,
     
     // allocate space for new lists
     size_t sizeNormals = numNormals * sizeof(Vector);
-    m_vertexNormals = (Vector*)malloc( sizeNormals );
-    if ( m_vertexNormals == NULL )
-    {
-        DeallocateVertexNormals();
-        return NovaErrNoMemory;
-    }
-    m_transformedVertexNormals = (Vector*)malloc( sizeNormals );
-    if ( m_transformedVertexNormals == NULL )
-    {
-        DeallocateVertexNormals();
-        return NovaErrNoMemory;
-    }
     size_t sizeIndices = m_numPolygons * 3 * sizeof(uint_32);
-    m_vertexNormalIndices = (uint_32*)malloc( sizeIndices );
-    if ( m_vertexNormalIndices == NULL )
+    size_t size = 0;
+    size_t normals = ReserveArray( size, sizeNormals );
+    size_t transformedNormals = ReserveArray( size, sizeNormals );
+    size_t normalInfos = 
+	ReserveArray( size, numNormals * sizeof(uint_32) );
+    size_t normalIndices = ReserveArray( size, sizeIndices );
+
+    uint_8* block = (uint_8*)AlignedMalloc( size );
+    if ( block == NULL )
     {
-        DeallocateVertexNormals();
+        m_numVertexNormals = 0;
         return NovaErrNoMemory;
     }
+
+    m_normalBlock = block;
+    m_vertexNormals = (Vector*)(block + normals);
+    m_transformedVertexNormals = (Vector*)(block + transformedNormals);
+    m_normalInfos = (uint_32*)(block + normalInfos);
+    m_vertexNormalIndices = (uint_32*)(block + normalIndices);
+    memset( m_normalInfos, 0, numNormals * sizeof(uint_32) );
     
     // copy data
     memcpy( m_vertexNormals, normalList, sizeNormals );
     memcpy( m_vertexNormalIndices, indices, sizeIndices );
     
-    return NovaErrNone;
+    int ret = CreateLitVertices();
+    if ( ret != NovaErrNone )
+    {
+        DeallocateVertexNormals();
+        m_numVertexNormals = 0;
+    }
+
+    return ret;
 }
 
 NOVA_EXPORT void Shape::AlignOnXZPlane()
 {
+    if ( m_externalData )
+    {
+        return;
+    }
+
     // find the smallest Y value
     Vector* v = m_coordinates;
     int_32 smallestY = (v++)->GetFixedY();
@@ -446,14 +672,21 @@ NOVA_EXPORT void Shape::AlignOnXZPlane()
     Vector sub;
     sub.SetFixed( 0, smallestY, 0 );
 
-    for ( int i = 1; i < m_numCoordinates; i++ ) 
+    for ( int i = 0; i < m_numCoordinates; i++ ) 
     {
         (v++)->Substract( sub );
     }    
+
+    CoordinatesMoved();
 } 
 
 NOVA_EXPORT void Shape::Center()
 {
+    if ( m_externalData )
+    {
+        return;
+    }
+
     // find the smallest and largest x,y,z values
     Vector* v = m_coordinates;
     int_32 smallestX = v->GetFixedX();
@@ -485,10 +718,23 @@ NOVA_EXPORT void Shape::Center()
                   (smallestY + largestY) / 2,
                   (smallestZ + largestZ) / 2 );
     v = m_coordinates;
-    for ( int i = 1; i < m_numCoordinates; i++ ) 
+    for ( int i = 0; i < m_numCoordinates; i++ ) 
     {
         (v++)->Substract( sub );
     }    
+
+    CoordinatesMoved();
+}
+
+void Shape::CoordinatesMoved()
+{
+    // the plane equations and bounding volumes depend on the coordinates
+    for ( int i = 0; i < m_numPolygons; i++ )
+    {
+        CalculatePlaneEquation( i );
+    }
+
+    CalculateBoundingVolumes();
 }
 
 NOVA_EXPORT int Shape::SetEnvironmentMapped( int polygonIndex, bool mapped )
@@ -562,6 +808,7 @@ NOVA_EXPORT void Shape::SetIlluminated( bool isIlluminated )
     LOG_DEBUG_F("Shape::SetIlluminated() = %d", isIlluminated);
 
     m_isIlluminated = isIlluminated;
+    m_lightingCoverage = LightingNone;
 
     uint_32* pi = m_polygonInfos;
     for ( int i = 0; i < m_numPolygons; i++ )
@@ -577,31 +824,211 @@ NOVA_EXPORT void Shape::SetIlluminated( bool isIlluminated )
     }
 }
 
-NOVA_EXPORT void Shape::CalculateBoundingSphereRadius()
+NOVA_EXPORT int Shape::BakeLighting( 
+    const AmbientLight& ambientLight, 
+    const PointLightInstance* lights, int numLights,
+    const DirectionalLightInstance* directionalLights, 
+    int numDirectionalLights )
 {
-    // the bounding sphere radius is the largest distance of a 
-    // vertex coordinate from the object space origin
-    Vector* v = m_coordinates;
-    int_32 maxlen = 0;
+    if ( m_lightingIntensities == NULL )
+    {
+        return NovaErrNotInitialized;
+    }
+    if ( m_vertexNormals == NULL )
+    {
+        return NovaErrNoVertexNormals;
+    }
+
+    int_32* lightingBuffer = 
+        (int_32*)malloc( GetLightingBufferSize() * sizeof(int_32) );
+    if ( lightingBuffer == NULL )
+    {
+        return NovaErrNoMemory;
+    }
+
+    // light every polygon regardless of the visibility
+    SetIlluminated( true );
+    CalculateLighting( ambientLight.IntensityFixed(), lights, numLights, 
+                       directionalLights, numDirectionalLights, 
+                       lightingBuffer, true );
+    m_isPrelit = true;
+    free( lightingBuffer );
+
+    return NovaErrNone;
+}
+
+NOVA_EXPORT int Shape::SetPrelitIntensities( const int_32* intensities )
+{
+    if ( intensities == NULL )
+    {
+        return NovaErrInvalidArgument;
+    }
+    if ( m_lightingIntensities == NULL )
+    {
+        return NovaErrNotInitialized;
+    }
+
+    SetIlluminated( true );
+    memcpy( m_lightingIntensities, intensities, 
+            3 * m_numPolygons * sizeof(int_32) );
+    m_isPrelit = true;
+
+    return NovaErrNone;
+}
 
+NOVA_EXPORT void Shape::ClearPrelit()
+{
+    m_isPrelit = false;
+    m_lightingCoverage = LightingNone;
+}
+
+NOVA_EXPORT void Shape::SetOccluder( bool isOccluder )
+{
+    m_isOccluder = isOccluder;
+}
+
+NOVA_EXPORT void Shape::CalculateBoundingVolumes()
+{
+    // the lighting depends on the coordinates as well
+    m_lightingCoverage = LightingNone;
+
+    if ( m_numCoordinates == 0 )
+    {
+        m_boundingSphere.m_radius = -1;
+        return;
+    }
+
+    // find the bounding box and the extreme coordinates along each axis
+    const Vector* v = m_coordinates;
+    int_32 min[3], max[3];
+    int minIndex[3] = { 0, 0, 0 };
+    int maxIndex[3] = { 0, 0, 0 };
+    v->GetFixed( min[0], min[1], min[2] );
+    v->GetFixed( max[0], max[1], max[2] );
+
+    for ( int i = 1; i < m_numCoordinates; i++ ) 
+    {
+        int_32 c[3];
+        (++v)->GetFixed( c[0], c[1], c[2] );
+
+        for ( int j = 0; j < 3; j++ )
+        {
+            if ( c[j] < min[j] )
+            {
+                min[j] = c[j];
+                minIndex[j] = i;
+            }
+            else if ( c[j] > max[j] )
+            {
+                max[j] = c[j];
+                maxIndex[j] = i;
+            }
+        }
+    }
+
+    m_boundingBox.m_min.SetFixed( min[0], min[1], min[2] );
+    m_boundingBox.m_max.SetFixed( max[0], max[1], max[2] );
+
+    // Ritter's bounding sphere: start from the most distant pair of the 
+    // extreme coordinates and grow the sphere to include every coordinate.
+    // the calculations are done on the fixed point values in real_64 to
+    // avoid overflows.
+    real_64 center[3], radius = -1.0;
+    for ( int j = 0; j < 3; j++ )
+    {
+        int_32 a[3], b[3];
+        m_coordinates[minIndex[j]].GetFixed( a[0], a[1], a[2] );
+        m_coordinates[maxIndex[j]].GetFixed( b[0], b[1], b[2] );
+
+        real_64 dx = (real_64)b[0] - a[0];
+        real_64 dy = (real_64)b[1] - a[1];
+        real_64 dz = (real_64)b[2] - a[2];
+        real_64 r = sqrt( dx * dx + dy * dy + dz * dz ) / 2.0;
+        if ( r > radius )
+        {
+            radius = r;
+            center[0] = ((real_64)a[0] + b[0]) / 2.0;
+            center[1] = ((real_64)a[1] + b[1]) / 2.0;
+            center[2] = ((real_64)a[2] + b[2]) / 2.0;
+        }
+    }
+
+    real_64 radiusSquared = radius * radius;
+    v = m_coordinates;
+    for ( int i = 0; i < m_numCoordinates; i++ ) 
+    {
+        int_32 c[3];
+        (v++)->GetFixed( c[0], c[1], c[2] );
+
+        real_64 dx = c[0] - center[0];
+        real_64 dy = c[1] - center[1];
+        real_64 dz = c[2] - center[2];
+        real_64 distanceSquared = dx * dx + dy * dy + dz * dz;
+        if ( distanceSquared > radiusSquared )
+        {
+            // move the center towards the coordinate, just enough to 
+            // include it
+            real_64 distance = sqrt( distanceSquared );
+            real_64 newRadius = (radius + distance) / 2.0;
+            real_64 k = (newRadius - radius) / distance;
+            center[0] += dx * k;
+            center[1] += dy * k;
+            center[2] += dz * k;
+            radius = newRadius;
+            radiusSquared = radius * radius;
+        }
+    }
+
+    // Ritter's sphere can be up to some 20% too large; use the sphere 
+    // around the bounding box center instead when that is tighter
+    real_64 boxCenter[3];
+    real_64 boxRadiusSquared = 0.0;
+    for ( int j = 0; j < 3; j++ )
+    {
+        boxCenter[j] = ((real_64)min[j] + max[j]) / 2.0;
+    }
+    v = m_coordinates;
     for ( int i = 0; i < m_numCoordinates; i++ ) 
     {
-        int_32 len = v->LengthFixed();
-        maxlen = MAX( maxlen, len );
+        int_32 c[3];
+        (v++)->GetFixed( c[0], c[1], c[2] );
+
+        real_64 dx = c[0] - boxCenter[0];
+        real_64 dy = c[1] - boxCenter[1];
+        real_64 dz = c[2] - boxCenter[2];
+        boxRadiusSquared = 
+            MAX( boxRadiusSquared, (dx * dx + dy * dy + dz * dz) );
+    }
+    if ( boxRadiusSquared < radiusSquared )
+    {
+        memcpy( center, boxCenter, sizeof(center) );
+        radius = sqrt( boxRadiusSquared );
     }
 
-    m_boundingSphereRadius = maxlen;
+    // round the center to the nearest and the radius up, leaving room 
+    // for the rounding of the center
+    m_boundingSphere.m_location.SetFixed( (int_32)floor( center[0] + 0.5 ), 
+                                          (int_32)floor( center[1] + 0.5 ), 
+                                          (int_32)floor( center[2] + 0.5 ) );
+    m_boundingSphere.m_radius = (int_32)ceil( radius ) + 1;
 }
 
 void Shape::BackfaceCull( const Vector& cameraObjectSpacePosition )
 {
-    // clear the vertex info for every vertex
+    // clear the vertex info for every vertex, and the normal info if the
+    // previous frame marked any normals
     memset( m_vertexInfos, 0, m_numCoordinates * sizeof(uint_32) );
+    if ( m_hasVisibleEnvMapping )
+    {
+        memset( m_normalInfos, 0, m_numVertexNormals * sizeof(uint_32) );
+    }
+    bool markNormals = (m_normalInfos != NULL);
 
     // determine the visibility of each face
     uint_32* polygonInfo = m_polygonInfos;
     PlaneEquation* planeEquation = m_planeEquations;
     uint_32* vertexIndex = m_vertices;
+    uint_32 visibleFlags = 0;
     
     for ( int i = 0; i < m_numPolygons; i++, polygonInfo++, planeEquation++ ) 
     {
@@ -611,9 +1038,21 @@ void Shape::BackfaceCull( const Vector& cameraObjectSpacePosition )
             // plane facing the camera position; mark it and all 3 vertices 
             // belonging to it visible
             *polygonInfo |= PolygonInfoVisible;
+            visibleFlags |= *polygonInfo;
             *(m_vertexInfos + *vertexIndex++) |= VertexInfoVisible;
             *(m_vertexInfos + *vertexIndex++) |= VertexInfoVisible;
             *(m_vertexInfos + *vertexIndex++) |= VertexInfoVisible;
+
+            // environment mapping reads the camera space normals of the
+            // polygon's corners
+            if ( markNormals && 
+                 ((*polygonInfo & PolygonInfoEnvMapped) != 0) )
+            {
+                const uint_32* normalIndex = m_vertexNormalIndices + (i * 3);
+                m_normalInfos[normalIndex[0]] |= VertexInfoVisible;
+                m_normalInfos[normalIndex[1]] |= VertexInfoVisible;
+                m_normalInfos[normalIndex[2]] |= VertexInfoVisible;
+            }
 	} 
         else 
 	{
@@ -622,17 +1061,131 @@ void Shape::BackfaceCull( const Vector& cameraObjectSpacePosition )
             vertexIndex += 3;
 	}
     }
+
+    // only environment mapping needs the normals in camera space
+    m_hasVisibleEnvMapping = 
+        ((visibleFlags & PolygonInfoEnvMapped) != 0) && markNormals;
+}
+
+bool Shape::IsLightingUnchanged( 
+    int_32 ambientIntensity, 
+    const PointLightInstance* lights, int numLights,
+    const DirectionalLightInstance* directionalLights, 
+    int numDirectionalLights ) const
+{
+    if ( (m_lightingCoverage == LightingNone) || 
+         (ambientIntensity != m_lightingAmbient) ||
+         ((numLights + numDirectionalLights) != m_lightingStates.Count()) )
+    {
+        return false;
+    }
+
+    // the lights are compared in object space, which covers both the 
+    // lights and the shape moving
+    const LightingState* state = m_lightingStates.Begin();
+    for ( int i = 0; i < numLights; i++, state++ )
+    {
+        const PointLightInstance& light = lights[i];
+        if ( (state->m_light != light.m_light) || 
+             (state->m_version != light.m_light->GetVersion()) ||
+             !(state->m_position == light.m_position) )
+        {
+            return false;
+        }
+    }
+    for ( int i = 0; i < numDirectionalLights; i++, state++ )
+    {
+        const DirectionalLightInstance& light = directionalLights[i];
+        if ( (state->m_light != light.m_light) || 
+             !(state->m_position == light.m_direction) )
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int Shape::StoreLightingState( 
+    int_32 ambientIntensity, 
+    const PointLightInstance* lights, int numLights,
+    const DirectionalLightInstance* directionalLights, 
+    int numDirectionalLights )
+{
+    m_lightingAmbient = ambientIntensity;
+    m_lightingStates.Reset();
+    int ret = m_lightingStates.Reserve( numLights + numDirectionalLights );
+    for ( int i = 0; (i < numLights) && (ret == NovaErrNone); i++ )
+    {
+        LightingState state;
+        state.m_light = lights[i].m_light;
+        state.m_version = lights[i].m_light->GetVersion();
+        state.m_position.Set( lights[i].m_position );
+        ret = m_lightingStates.Append( state );
+    }
+    for ( int i = 0; (i < numDirectionalLights) && (ret == NovaErrNone); 
+          i++ )
+    {
+        // a directional light has nothing else that could change
+        LightingState state;
+        state.m_light = directionalLights[i].m_light;
+        state.m_version = 0;
+        state.m_position.Set( directionalLights[i].m_direction );
+        ret = m_lightingStates.Append( state );
+    }
+
+    return ret;
 }
 
 void Shape::ApplyLighting( const AmbientLight& ambientLight, 
-                           const List<LightNode*>& lightNodeList )
+                           const PointLightInstance* lights, int numLights,
+                           const DirectionalLightInstance* directionalLights,
+                           int numDirectionalLights, int_32* lightingBuffer )
 {
-    // vector pointing to the point light source from a vertex
-    Vector toLight; 
-    
     // get ambient light intensity for the scene
     int ambientIntensity = ambientLight.IntensityFixed();
 
+    // the intensities are kept while the lighting stays the same. the 
+    // first time it does, all the polygons are lit so that the intensities
+    // can be reused whichever polygons are visible.
+    LightingCoverage coverage = LightingVisible;
+    bool stored = true;
+    if ( IsLightingUnchanged( ambientIntensity, lights, numLights, 
+                              directionalLights, numDirectionalLights ) )
+    {
+        if ( m_lightingCoverage == LightingAll )
+        {
+            return;
+        }
+        coverage = LightingAll;
+    }
+    else
+    {
+        stored = (StoreLightingState( ambientIntensity, lights, numLights, 
+                                      directionalLights, 
+                                      numDirectionalLights ) == 
+                  NovaErrNone);
+    }
+
+    // with only the ambient light every polygon is covered at once
+    if ( (m_cornerLitVertices == NULL) || 
+         ((numLights + numDirectionalLights) == 0) )
+    {
+        coverage = LightingAll;
+    }
+    m_lightingCoverage = stored ? coverage : LightingNone;
+
+    CalculateLighting( ambientIntensity, lights, numLights, 
+                       directionalLights, numDirectionalLights, 
+                       lightingBuffer, (coverage == LightingAll) );
+}
+
+void Shape::CalculateLighting( 
+    int_32 ambientIntensity, 
+    const PointLightInstance* lights, int numLights,
+    const DirectionalLightInstance* directionalLights, 
+    int numDirectionalLights, int_32* lightingBuffer, bool allPolygons )
+{
     // initialize each vertex's lighting intensity to the ambient intensity
     int numIntensities = 3 * m_numPolygons;
     int* intensity = m_lightingIntensities;
@@ -641,142 +1194,160 @@ void Shape::ApplyLighting( const AmbientLight& ambientLight,
         *intensity++ = ambientIntensity;
     }
 
-    // process each point light
-    for ( int i = 0; i < lightNodeList.Count(); i++ ) 
+    // without vertex normals or lights in range only the ambient light 
+    // applies
+    if ( (m_cornerLitVertices == NULL) || 
+         ((numLights + numDirectionalLights) == 0) )
     {
-        LightNode* lightNode;
-        if ( lightNodeList.Get( i, lightNode ) != NovaErrNone )
-	{
-	    continue;
-	}
+        return;
+    }
 
-	if ( lightNode->GetLight().GetType() != Light::TypePoint )
+    // the polygons to light must have all the bits of the mask set
+    uint_32 visibleMask = allPolygons ? 0 : PolygonInfoVisible;
+
+    // carve the scratch arrays out of the buffer
+    uint_32* slots = (uint_32*)lightingBuffer;
+    uint_32* vertexIndices = slots + m_numLitVertices;
+    uint_32* normalIndices = vertexIndices + m_numLitVertices;
+    int_32* intensities = (int_32*)(normalIndices + m_numLitVertices);
+    int_32* distances = intensities + m_numLitVertices;
+
+    // gather the lit vertices of the polygons to light into a dense list 
+    // so that the lights are evaluated once per lit vertex. slots maps 
+    // each lit vertex to its place in the list.
+    memset( slots, 0xff, m_numLitVertices * sizeof(uint_32) );
+    int numVisible = 0;
+    const uint_32* cornerLitVertex = m_cornerLitVertices;
+    for ( int i = 0; i < m_numPolygons; i++, cornerLitVertex += 3 ) 
+    {
+        if ( (m_polygonInfos[i] & visibleMask) != visibleMask )
+        {
+            continue;
+        }
+
+        for ( int k = 0; k < 3; k++ )
+        {
+            uint_32 litVertex = cornerLitVertex[k];
+            if ( slots[litVertex] == MaxUint32 )
+            {
+                slots[litVertex] = numVisible;
+                vertexIndices[numVisible] = m_litVertexIndices[litVertex];
+                normalIndices[numVisible] = m_litNormalIndices[litVertex];
+                numVisible++;
+            }
+        }
+    }
+
+    if ( numVisible == 0 )
+    {
+        return;
+    }
+
+    const KernelTable& kernels = GetKernels();
+
+    // process each point light
+    const PointLightInstance* lightEnd = lights + numLights;
+    for ( const PointLightInstance* light = lights; light != lightEnd; 
+          light++ ) 
+    {
+        const PointLight& pointLight = *light->m_light;
+
+        // the light position in the shape's object space
+        const Vector& lightObjectSpacePos = light->m_position;
+
+        // calculate the point light intensity at each visible lit vertex 
+        // as the cosine of the angle between the vertex normal and the 
+        // vector from the vertex to the light source
+        kernels.m_pointLight( lightObjectSpacePos, 
+                              m_coordinates, m_vertexNormals, 
+                              vertexIndices, normalIndices, numVisible, 
+                              intensities, distances );
+
+        // if the light has attenuation turned on, apply it based on 
+        // the distance
+        if ( pointLight.IsAttenuated() ) 
 	{
-	    continue;
+            for ( int i = 0; i < numVisible; i++ )
+            {
+                int_32 attenuation = 
+                    pointLight.CalculateAttenuationFactor( distances[i] );
+                intensities[i] = ::FixedLargeMul( intensities[i], 
+                                                  attenuation );
+            }
 	}
 
-        PointLight& pointLight = (PointLight&)lightNode->GetLight();
+        AddLightToCorners( intensities, slots, lightObjectSpacePos, false, 
+                           visibleMask );
+    }
 
-        // we use a buffer to cache distances between the light 
-        // source and each vertex to avoid calculating
-        // them more than once. 
-	// let's initialize the distance cache entries to 0.
-        memset( m_distanceCache, 0, m_numCoordinates * sizeof(int_32) );
+    // process each directional light; the intensity only depends on the
+    // vertex normal
+    for ( int i = 0; i < numDirectionalLights; i++ )
+    {
+        Vector towardsLight( directionalLights[i].m_direction );
+        towardsLight.Inverse();
 
-        // extract the light position in the shape's object space
-        const Vector& lightObjectSpacePos = pointLight.GetPosition();
+        kernels.m_directionalLight( towardsLight, m_vertexNormals, 
+                                    normalIndices, numVisible, 
+                                    intensities );
 
-        const uint_32* vertexIndex = m_vertices;
-        const uint_32* normalIndex = m_vertexNormalIndices;
-        const uint_32* polygonInfo = m_polygonInfos;
-        PlaneEquation* planeEquation = m_planeEquations;
-        intensity = m_lightingIntensities;
+        AddLightToCorners( intensities, slots, towardsLight, true, 
+                           visibleMask );
+    }
+}
 
-        // process each polygon in the shape
-        for ( int j = 0; j < m_numPolygons; j++, planeEquation++ ) 
-	{
-            uint_32 info = *polygonInfo++;
-
-            // check that the both the camera AND the light source "see" 
-            // the polygon, ie. the polygon must be facing the camera and light 
-            // source to receive lighting
-            if ( ((info & PolygonInfoVisible) == 0) ||
-                 (planeEquation->IsOutside( lightObjectSpacePos )) ) 
-	    {
-                // polygon is not visible for the current camera and/or light; 
-                // skip its lighting
-                vertexIndex += 3;
-                normalIndex += 3;
-                intensity += 3;
-                continue;
-	    }
-
-            // process each vertex in polygon
-            for ( int k = 0; k < 3; k++ ) 
-	    {
-                // get current vertex coordinate
-                int vertIndex = *vertexIndex++;
-                const Vector* vertex = (m_coordinates + vertIndex);
-
-                // get normal for this vertex
-                const Vector* normal = (m_vertexNormals + *normalIndex++);
-
-                // form the vector vertex -> light source
-                toLight.SubstractAndSet( lightObjectSpacePos, *vertex );
-
-                // check the cache for if the distance is already calculated
-                int_32 distance = m_distanceCache[vertIndex];
-                if ( distance == 0 ) 
-		{
-                    // cache entry not found. calculate and store in cache
-                    distance = toLight.LengthFixed();
-                    m_distanceCache[vertIndex] = distance;
-		};
-
-                // calculate the point light intensity as a function of the 
-                // cosine of the angle between the vertex normal and the vector 
-                // from the vertex to the light source
-                int_32 dotProd = toLight.DotProductFixed( *normal );
-                int_32 tmpIntensity = 0;
-
-                // divide dot product by the distance (toLight length) to get 
-                // cosine
-                dotProd = (dotProd / (distance >> (FixedPointPrec/2))) << 
-		    (FixedPointPrec/2);
-
-                // only add if cosine > 0 (hence the angle < 90)
-                if ( dotProd > 0 ) 
-		{
-                    tmpIntensity = dotProd;
-		}
-                
-                // if the light has attenuation turned on, apply it based on 
-                // the distance
-                if ( pointLight.IsAttenuated() ) 
-		{
-                    int_32 attenuation = 
-                        pointLight.CalculateAttenuationFactor( distance );
-                    tmpIntensity = ::FixedLargeMul( tmpIntensity, attenuation );
-		}
-
-                // add this light's effect on the total intensity 
-		// for this vertex
-                *intensity++ += tmpIntensity;
-	    }
-	}
+void Shape::AddLightToCorners( const int_32* intensities, 
+                               const uint_32* slots, const Vector& lightPos,
+                               bool isDirectional, uint_32 visibleMask )
+{
+    const uint_32* polygonInfo = m_polygonInfos;
+    const PlaneEquation* planeEquation = m_planeEquations;
+    const uint_32* cornerLitVertex = m_cornerLitVertices;
+    int_32* intensity = m_lightingIntensities;
+
+    // add the light's effect to the corners of each polygon
+    for ( int j = 0; j < m_numPolygons; j++, planeEquation++, 
+              cornerLitVertex += 3, intensity += 3 ) 
+    {
+        // check that the both the camera AND the light source "see" 
+        // the polygon, ie. the polygon must be facing the camera and light 
+        // source to receive lighting. a directional light is outside 
+        // the polygons whose normal points towards it.
+        if ( (*polygonInfo++ & visibleMask) != visibleMask )
+        {
+            continue;
+        }
+        if ( isDirectional ? 
+             (planeEquation->GetNormal().DotProductFixed( lightPos ) > 0) :
+             planeEquation->IsOutside( lightPos ) ) 
+        {
+            continue;
+        }
+
+        intensity[0] += intensities[slots[cornerLitVertex[0]]];
+        intensity[1] += intensities[slots[cornerLitVertex[1]]];
+        intensity[2] += intensities[slots[cornerLitVertex[2]]];
     }
 }
 
 void Shape::TransformAll( const Matrix& transform )
 {
+    const KernelTable& kernels = GetKernels();
+
     // transform all the visible vertices (decided in BackfaceCull())
     // with the given transform
-    Vector* srcCoord = m_coordinates;
-    Vector* dstCoord = m_transformedCoordinates;
-    uint_32* vertexInfo = m_vertexInfos;
+    kernels.m_transformVectors( transform, m_coordinates, 
+                                m_transformedCoordinates, m_vertexInfos, 
+                                m_numCoordinates, true );
 
-    for ( int i = 0; i < m_numCoordinates; i++ ) 
+    // rotate the normals of the visible environment mapped polygons; 
+    // nothing else reads the transformed normals
+    if ( m_hasVisibleEnvMapping ) 
     {
-        if ( (*vertexInfo++ & VertexInfoVisible) != 0 ) 
-	{
-            dstCoord->TransformAndSet( transform, *srcCoord );
-	}
-        dstCoord++;
-        srcCoord++;
-    }
-
-    // if vertex normals exist, transform them as well.
-    if ( m_vertexNormals != NULL ) 
-    {
-        Vector* srcVector = m_vertexNormals;
-        Vector* dstVector = m_transformedVertexNormals;
-
-        for ( int i = 0; i < m_numVertexNormals; i++ ) 
-	{
-            dstVector->RotateAndSet( transform, *srcVector );
-            dstVector++;
-            srcVector++;
-	}
+        kernels.m_transformVectors( transform, m_vertexNormals, 
+                                    m_transformedVertexNormals, 
+                                    m_normalInfos, m_numVertexNormals, 
+                                    false );
     }
 }
 
@@ -45,19 +45,28 @@ NOVA_EXPORT Texture::Texture()
       m_numPalettes( 0 ), 
       m_numPalettesShift( 0 ),
       m_palette( NULL ),
-      m_data( NULL )      
+      m_lightingMode( ELightingPalettes ),
+      m_data( NULL ),
+      m_numMipLevels( 0 ),
+      m_mipData( NULL ),
+      m_layout( ELayoutLinear ),
+      m_offsetData( NULL ),
+      m_externalData( false )
 {
 }
 
 NOVA_EXPORT Texture::~Texture()
 {
-    free( m_palette );
-    free( m_data );
+    if ( !m_externalData )
+    {
+        free( m_palette );
+        free( m_data );
+    }
+    free( m_mipData );
+    free( m_offsetData );
 }
 
-NOVA_EXPORT int Texture::Create( NovaPixelFormat pixelFormat, 
-                                 int width, int height,
-                                 uint_32* palette, uint_8* data )
+int Texture::SetDimensions( int width, int height, MemoryLayout layout )
 {
     if ( (width > MaxTextureSide) || (height > MaxTextureSide) )
     {
@@ -68,7 +77,7 @@ NOVA_EXPORT int Texture::Create( NovaPixelFormat pixelFormat,
     m_vmask = 0xffffffffu;
     
     // find out the u mask
-    for ( int i = 0; i < MaxTextureSidePower; i++ )
+    for ( int i = 0; i <= MaxTextureSidePower; i++ )
     {
         if ( (1 << i) == width )
 	{
@@ -79,7 +88,7 @@ NOVA_EXPORT int Texture::Create( NovaPixelFormat pixelFormat,
     }
 
     // find out the v mask
-    for ( int i = 0; i < MaxTextureSidePower; i++ )
+    for ( int i = 0; i <= MaxTextureSidePower; i++ )
     {
         if ( (1 << i) == height )
 	{
@@ -94,6 +103,67 @@ NOVA_EXPORT int Texture::Create( NovaPixelFormat pixelFormat,
 	m_vmask = 0xffffffffu;
 	return NovaErrTextureDimensionInvalid;
     }
+
+    // the swizzled layouts also require the height to be a power of 2
+    if ( (layout != ELayoutLinear) && (m_vmask == 0xffffffffu) )
+    {
+	return NovaErrTextureDimensionInvalid;
+    }
+
+    m_width = width;
+    m_height = height;
+    m_layout = layout;
+
+    return NovaErrNone;
+}
+
+void Texture::SetupMipLevels( int numLevels, uint_8* mipData )
+{
+    m_numMipLevels = numLevels;
+    m_mipLevels[0].m_data = m_data;
+    m_mipLevels[0].m_width = m_width;
+    m_mipLevels[0].m_height = m_height;
+    m_mipLevels[0].m_shift = m_shift;
+    m_mipLevels[0].m_umask = m_umask;
+    m_mipLevels[0].m_vmask = m_vmask;
+
+    // the rest of the levels follow each other in mipData
+    uint_8* levelData = mipData;
+
+    for ( int level = 1; level < numLevels; level++ )
+    {
+        const MipLevel& src = m_mipLevels[level - 1];
+        MipLevel& dst = m_mipLevels[level];
+
+        dst.m_data = levelData;
+        dst.m_width = MAX( (src.m_width >> 1), 1 );
+        dst.m_height = MAX( (src.m_height >> 1), 1 );
+        dst.m_shift = (src.m_shift > 0) ? (src.m_shift - 1) : 0;
+        dst.m_umask = dst.m_width - 1;
+        dst.m_vmask = dst.m_height - 1;
+
+        levelData += dst.m_width * dst.m_height;
+    }
+}
+
+NOVA_EXPORT int Texture::Create( NovaPixelFormat pixelFormat, 
+                                 int width, int height,
+                                 uint_32* palette, uint_8* data,
+                                 MemoryLayout layout )
+{
+    if ( m_externalData )
+    {
+        // the data is not owned by the texture
+        m_palette = NULL;
+        m_data = NULL;
+        m_externalData = false;
+    }
+
+    int err = SetDimensions( width, height, layout );
+    if ( err != NovaErrNone )
+    {
+        return err;
+    }
     
     // make a copy of the palette 
     free( m_palette );
@@ -113,19 +183,377 @@ NOVA_EXPORT int Texture::Create( NovaPixelFormat pixelFormat,
     {
 	return NovaErrNoMemory;
     }
-    memcpy( m_data, data, width * height * sizeof(uint_8) );
 
     // set up texture properties. the texture initially has a single palette.
     m_numPalettes = 1;
+    m_lightingMode = ELightingPalettes;
     m_pixelFormat = pixelFormat;
-    m_width = width;
-    m_height = height;
+
+    // the texture itself is the only level until CreateMipmaps() is called
+    free( m_mipData );
+    m_mipData = NULL;
+    SetupMipLevels( 1, NULL );
+
+    err = CreateOffsetTables( 1 );
+    if ( err != NovaErrNone ) 
+    {
+	return err;
+    }
+
+    // copy the data, reordering it to the memory layout if needed
+    if ( m_layout == ELayoutLinear ) 
+    {
+	memcpy( m_data, data, width * height * sizeof(uint_8) );
+    }
+    else
+    {
+	for ( int v = 0; v < height; v++ )
+	{
+	    for ( int u = 0; u < width; u++ )
+	    {
+		m_data[GetTexelOffset( m_mipLevels[0], u, v )] = *data++;
+	    }
+	}
+    }
     
     return NovaErrNone;
 }
 
+int Texture::CreateOffsetTables( int numLevels )
+{
+    free( m_offsetData );
+    m_offsetData = NULL;
+
+    for ( int level = 0; level < numLevels; level++ ) 
+    {
+        m_mipLevels[level].m_uOffsets = NULL;
+        m_mipLevels[level].m_vOffsets = NULL;
+    }
+
+    if ( m_layout == ELayoutLinear ) 
+    {
+        // the linear layout is addressed with shifts and masks
+        return NovaErrNone;
+    }
+
+    // all the tables are allocated in one block
+    size_t size = 0;
+    for ( int level = 0; level < numLevels; level++ ) 
+    {
+        size += (m_mipLevels[level].m_width + m_mipLevels[level].m_height) * 
+            sizeof(uint_32);
+    }
+
+    m_offsetData = (uint_32*)malloc( size );
+    if ( m_offsetData == NULL ) 
+    {
+        return NovaErrNoMemory;
+    }
+
+    uint_32* table = m_offsetData;
+
+    for ( int level = 0; level < numLevels; level++ ) 
+    {
+        MipLevel& mip = m_mipLevels[level];
+        int width = mip.m_width;
+        int height = mip.m_height;
+
+        mip.m_uOffsets = table;
+        table += width;
+        mip.m_vOffsets = table;
+        table += height;
+
+        if ( m_layout == ELayoutTiled ) 
+        {
+            // tiles are stored row by row, the texels inside each tile 
+            // likewise. textures smaller than a tile use narrower tiles.
+            int tileWidth = MIN( (1 << TileSidePower), width );
+            int tileHeight = MIN( (1 << TileSidePower), height );
+
+            for ( int u = 0; u < width; u++ ) 
+            {
+                mip.m_uOffsets[u] = (u / tileWidth) * tileWidth * tileHeight +
+                    (u % tileWidth);
+            }
+            for ( int v = 0; v < height; v++ ) 
+            {
+                mip.m_vOffsets[v] = (v / tileHeight) * width * tileHeight + 
+                    (v % tileHeight) * tileWidth;
+            }
+        }
+        else
+        {
+            // Z-order: the u and v bits are interleaved (u in the even, 
+            // v in the odd bits) for as many bits as the smaller side 
+            // has; the rest of the bits of the larger side go on top
+            int widthBits = mip.m_shift;
+            int heightBits = 0;
+            while ( (1 << heightBits) < height ) 
+            {
+                heightBits++;
+            }
+            int commonBits = MIN( widthBits, heightBits );
+
+            for ( int u = 0; u < width; u++ ) 
+            {
+                uint_32 offset = 0;
+                for ( int bit = 0; bit < widthBits; bit++ ) 
+                {
+                    if ( u & (1 << bit) ) 
+                    {
+                        offset |= 1 << ((bit < commonBits) ? 
+                                        (bit << 1) : (bit + commonBits));
+                    }
+                }
+                mip.m_uOffsets[u] = offset;
+            }
+            for ( int v = 0; v < height; v++ ) 
+            {
+                uint_32 offset = 0;
+                for ( int bit = 0; bit < heightBits; bit++ ) 
+                {
+                    if ( v & (1 << bit) ) 
+                    {
+                        offset |= 1 << ((bit < commonBits) ? 
+                                        ((bit << 1) + 1) : (bit + commonBits));
+                    }
+                }
+                mip.m_vOffsets[v] = offset;
+            }
+        }
+    }
+
+    return NovaErrNone;
+}
+
+// selects the one of the 4 texels (palette indices) whose color is the 
+// closest to the average color of all of them
+uint_8 SelectRepresentativeTexel( NovaPixelFormat pixelFormat, 
+                                  const uint_32* palette, 
+                                  const uint_8* texels )
+{
+    int_32 red[4], green[4], blue[4];
+    int_32 avgRed = 0, avgGreen = 0, avgBlue = 0;
+
+    for ( int i = 0; i < 4; i++ )
+    {
+        nova3d::SplitColor( pixelFormat, palette[texels[i]], 
+                            red[i], green[i], blue[i] );
+        avgRed += red[i];
+        avgGreen += green[i];
+        avgBlue += blue[i];
+    }
+
+    // keep the average at 2 bits of extra precision instead of dividing
+    uint_8 selected = texels[0];
+    uint_32 minDiff = MaxUint32;
+
+    for ( int i = 0; i < 4; i++ )
+    {
+        int_32 dr = (red[i] << 2) - avgRed;
+        int_32 dg = (green[i] << 2) - avgGreen;
+        int_32 db = (blue[i] << 2) - avgBlue;
+        uint_32 diff = (uint_32)(dr * dr + dg * dg + db * db);
+        if ( diff < minDiff )
+        {
+            minDiff = diff;
+            selected = texels[i];
+        }
+    }
+
+    return selected;
+}
+
+int Texture::CountMipLevels( size_t& mipDataSize ) const
+{
+    int numLevels = 1;
+    int width = m_width;
+    int height = m_height;
+    mipDataSize = 0;
+
+    while ( ((width > 1) || (height > 1)) && (numLevels < MaxMipLevels) )
+    {
+        width = MAX( (width >> 1), 1 );
+        height = MAX( (height >> 1), 1 );
+        mipDataSize += width * height * sizeof(uint_8);
+        numLevels++;
+    }
+
+    return numLevels;
+}
+
+NOVA_EXPORT int Texture::CreateMipmaps()
+{
+    if ( m_data == NULL )
+    {
+        return NovaErrNotInitialized;
+    }
+
+    if ( m_externalData )
+    {
+        // the chain comes with the external data
+        return NovaErrAlreadyInitialized;
+    }
+
+    // both dimensions must be powers of 2 for the levels to be addressable
+    // with shifts and masks
+    if ( (m_umask == 0xffffffffu) || (m_vmask == 0xffffffffu) )
+    {
+        return NovaErrTextureDimensionInvalid;
+    }
+
+    // count the levels and the amount of memory they need
+    size_t size = 0;
+    int numLevels = CountMipLevels( size );
+
+    free( m_mipData );
+    m_mipData = NULL;
+    m_numMipLevels = 1;
+
+    if ( numLevels == 1 )
+    {
+        // 1x1 texture; nothing to do
+        return NovaErrNone;
+    }
+
+    m_mipData = (uint_8*)malloc( size );
+    if ( m_mipData == NULL )
+    {
+        return NovaErrNoMemory;
+    }
+
+    // set up the level dimensions first as the offset tables of all 
+    // the levels are created at once
+    SetupMipLevels( numLevels, m_mipData );
+
+    int err = CreateOffsetTables( numLevels );
+    if ( err != NovaErrNone ) 
+    {
+        free( m_mipData );
+        m_mipData = NULL;
+        SetupMipLevels( 1, NULL );
+        CreateOffsetTables( 1 );
+        return err;
+    }
+
+    // the selection is done using the last palette, which is the one 
+    // with the most lighting when CreateLinearPalettes() has been called
+    const uint_32* palette = 
+        m_palette + (m_numPalettes - 1) * NumPaletteEntries;
+
+    for ( int level = 1; level < numLevels; level++ )
+    {
+        const MipLevel& src = m_mipLevels[level - 1];
+        const MipLevel& dst = m_mipLevels[level];
+
+        // a source dimension of 1 is not reduced any further
+        int stepU = (src.m_width > 1) ? 1 : 0;
+        int stepV = (src.m_height > 1) ? 1 : 0;
+        uint_8 texels[4];
+
+        for ( int v = 0; v < dst.m_height; v++ )
+        {
+            int srcV = v << stepV;
+
+            for ( int u = 0; u < dst.m_width; u++ )
+            {
+                int srcU = u << stepU;
+                texels[0] = src.m_data[GetTexelOffset( src, srcU, srcV )];
+                texels[1] = 
+                    src.m_data[GetTexelOffset( src, srcU + stepU, srcV )];
+                texels[2] = 
+                    src.m_data[GetTexelOffset( src, srcU, srcV + stepV )];
+                texels[3] = 
+                    src.m_data[GetTexelOffset( src, srcU + stepU, 
+                                               srcV + stepV )];
+
+                dst.m_data[GetTexelOffset( dst, u, v )] = 
+                    SelectRepresentativeTexel( m_pixelFormat, palette, 
+                                               texels );
+            }
+        }
+    }
+
+    return NovaErrNone;
+}
+
+NOVA_EXPORT int Texture::CreateFromExternalData( NovaPixelFormat pixelFormat,
+                                                 int width, int height,
+                                                 MemoryLayout layout,
+                                                 LightingMode lightingMode,
+                                                 int numPalettes,
+                                                 const uint_32* palettes,
+                                                 int numMipLevels,
+                                                 const uint_8* data,
+                                                 uint_32 dataSize )
+{
+    if ( m_data != NULL )
+    {
+        return NovaErrAlreadyInitialized;
+    }
+
+    int err = SetDimensions( width, height, layout );
+    if ( err != NovaErrNone )
+    {
+        return err;
+    }
+
+    // a mip chain requires power of 2 dimensions
+    size_t mipDataSize = 0;
+    if ( (numMipLevels < 1) || 
+         ((numMipLevels > 1) && (m_vmask == 0xffffffffu)) ||
+         (numMipLevels > CountMipLevels( mipDataSize )) )
+    {
+        return NovaErrInvalidArgument;
+    }
+
+    // the palette count must be one of those CreateLinearPalettes() makes
+    m_numPalettesShift = 0;
+    while ( (1 << m_numPalettesShift) < numPalettes )
+    {
+        m_numPalettesShift++;
+    }
+    if ( ((1 << m_numPalettesShift) != numPalettes) || 
+         (m_numPalettesShift > 8) || 
+         ((lightingMode == ELightingModulate) && (numPalettes != 1)) )
+    {
+        return NovaErrInvalidArgument;
+    }
+    if ( lightingMode == ELightingModulate )
+    {
+        m_numPalettesShift = 8;
+    }
+
+    m_pixelFormat = pixelFormat;
+    m_lightingMode = lightingMode;
+    m_numPalettes = numPalettes;
+
+    // the data is used in place; it is never written to
+    m_externalData = true;
+    m_palette = const_cast<uint_32*>( palettes );
+    m_data = const_cast<uint_8*>( data );
+    SetupMipLevels( numMipLevels, m_data + m_width * m_height );
+
+    const MipLevel& last = m_mipLevels[numMipLevels - 1];
+    if ( (last.m_data + last.m_width * last.m_height) > (data + dataSize) )
+    {
+        m_palette = NULL;
+        m_data = NULL;
+        m_externalData = false;
+        return NovaErrOutOfBounds;
+    }
+
+    return CreateOffsetTables( numMipLevels );
+}
+
 NOVA_EXPORT int Texture::CreateLinearPalettes( real_64 gain )
 {
+    if ( m_externalData )
+    {
+        // the palette cannot be replaced
+        return NovaErrAlreadyInitialized;
+    }
+
     int fixedGain = ::RealToFixed( gain );
    
     // decide the number of palettes based on the pixel format
@@ -170,7 +598,7 @@ NOVA_EXPORT int Texture::CreateLinearPalettes( real_64 gain )
     uint_32* newColor = newPalettes;    
     int red, green, blue;
 
-    for ( int i = 0; i < m_numPalettes; i++ ) 
+    for ( int i = 0; i < numPalettes; i++ ) 
     {
 	uint_32* oldColor = m_palette;
 
@@ -191,13 +619,37 @@ NOVA_EXPORT int Texture::CreateLinearPalettes( real_64 gain )
     // deallocate old palette and apply the new one
     free( m_palette );
     m_palette = newPalettes;
+    m_numPalettes = numPalettes;
+    m_lightingMode = ELightingPalettes;
+
+    return NovaErrNone;
+}
+
+NOVA_EXPORT int Texture::CreateModulatedLighting()
+{
+    if ( m_palette == NULL )
+    {
+	return NovaErrNotInitialized;
+    }
+
+    if ( m_numPalettes > 1 )
+    {
+	// the original palette is no longer available
+	return NovaErrAlreadyInitialized;
+    }
+
+    // intensities are scaled to 0..MaxModulateIntensity
+    m_lightingMode = ELightingModulate;
+    m_numPalettesShift = 8;
 
     return NovaErrNone;
 }
 
 void Texture::ScaleIntensity( int_32& intensity ) const
 {
-    int_32 maxIntensityFixed = (m_numPalettes - 1) << FixedPointPrec;
+    int_32 maxIntensityFixed = (m_lightingMode == ELightingModulate) ? 
+	(MaxModulateIntensity << FixedPointPrec) : 
+	((m_numPalettes - 1) << FixedPointPrec);
     intensity <<= m_numPalettesShift;
     if ( intensity > maxIntensityFixed ) 
     {
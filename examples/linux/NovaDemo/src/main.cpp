@@ -29,6 +29,7 @@
 
 #include "TextureFactory.h"
 #include "Normalizer.h"
+#include "JobSystem.h"
 
 using namespace nova3d;
 
@@ -402,6 +403,9 @@ int NovaDemo::RenderLoop()
 
 int main(int argc, char** argv) 
 {
+    // share the work of the engine among all the processors
+    JobSystem::Instance().Start();
+
     NovaDemo demo;
     //return demo.RenderLoop();
     return demo.OpenGLLoop();    
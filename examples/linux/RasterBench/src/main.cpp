@@ -0,0 +1,314 @@
+/*
+ *  $Id$
+ *
+ *  Nova 3D Engine - A portable object oriented, scene graph based, 
+ *  lightweight real-time 3D software rendering framework. 
+ *  Copyright (C) 2001-2009 Matti Dahlbom
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Contact: Matti Dahlbom <matti at 777-team dot org>
+ */
+
+
+// Benchmarks the scanline and half-space rasterizers of the Renderer 
+// against each other on random triangles of different sizes. The 
+// triangles are drawn straight with the Renderer, without the camera's
+// transformation and sorting, so that only the triangle setup and the 
+// rasterization are timed.
+//
+// Usage: rasterbench [repeats]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "Renderer.h"
+#include "Texture.h"
+#include "TextureFactory.h"
+#include "NovaErrors.h"
+
+using namespace nova3d;
+
+// canvas constants
+const int CanvasWidth = 640;
+const int CanvasHeight = 480;
+
+// triangles are kept this far from the canvas edges so that they all get
+// the unclipped scanline spans
+const int CanvasMargin = 8;
+
+// pixels to draw per triangle size and shading, roughly
+const int PixelsPerRun = 4000000;
+
+/** A triangle size class: the vertices lie within a square of this size */
+struct SizeClass
+{
+    const char* m_name;
+    int m_size;
+};
+
+const SizeClass SizeClasses[] = 
+{
+    { "tiny", 3 },
+    { "small", 10 },
+    { "medium", 40 },
+    { "large", 160 }
+};
+const int NumSizeClasses = sizeof(SizeClasses) / sizeof(SizeClasses[0]);
+
+enum Shading
+{
+    ShadingGouraud,
+    ShadingTextured,
+    ShadingLightedTextured
+};
+const char* ShadingNames[] = { "gouraud", "textured", "lighted" };
+const int NumShadings = 3;
+
+// xorshift generator so that every run draws the same triangles
+static uint_32 randomState = 2463534242u;
+
+static uint_32 Random( uint_32 range )
+{
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState % range;
+}
+
+static real_64 Now()
+{
+    struct timespec time;
+    clock_gettime( CLOCK_MONOTONIC, &time );
+    return (time.tv_sec * 1e9) + time.tv_nsec;
+}
+
+static Texture* CreateTexture()
+{
+    // a checkerboard with color gradients
+    const int size = 64;
+    uint_8* pixels = (uint_8*)malloc( size * size * 3 );
+    for ( int y = 0; y < size; y++ )
+    {
+	for ( int x = 0; x < size; x++ )
+	{
+	    uint_8* pixel = pixels + ((y * size) + x) * 3;
+	    pixel[0] = (uint_8)(x * 4);
+	    pixel[1] = (uint_8)(y * 4);
+	    pixel[2] = ((x ^ y) & 8) ? 255 : 40;
+	}
+    }
+
+    TextureFactory factory;
+    Texture* texture = NULL;
+    int ret = factory.CreateTexture( PixelFormat888, size, size, pixels, 
+				     texture );
+    free( pixels );
+    if ( ret != NovaErrNone )
+    {
+	return NULL;
+    }
+    texture->CreateLinearPalettes();
+
+    return texture;
+}
+
+static void CreateTriangles( ScreenPolygon* faces, int count, int size, 
+			     Shading shading, Texture* texture )
+{
+    int_32 max_intensity = (texture->GetNumPalettes() - 1) << FixedPointPrec;
+    memset( faces, 0, count * sizeof(ScreenPolygon) );
+
+    for ( int i = 0; i < count; i++ )
+    {
+	ScreenPolygon* face = faces + i;
+	int_32 x = CanvasMargin + Random( CanvasWidth - size - 
+					  (2 * CanvasMargin) );
+	int_32 y = CanvasMargin + Random( CanvasHeight - size - 
+					  (2 * CanvasMargin) );
+	// a flat intensity, as the slopes of a sliver may take a per vertex
+	// intensity past the palettes
+	int_32 intensity = Random( max_intensity + 1 );
+	ScreenVertex* vertices[3] = { &face->m_v1, &face->m_v2, &face->m_v3 };
+	for ( int j = 0; j < 3; j++ )
+	{
+	    // the positions are snapped to 1/16 pixels, which keeps the 
+	    // slopes of the slivers within the fixed point range
+	    ScreenVertex* vertex = vertices[j];
+	    vertex->m_x = ((x << FixedPointPrec) + 
+			   Random( size << FixedPointPrec )) & ~0xfff;
+	    vertex->m_y = ((y << FixedPointPrec) + 
+			   Random( size << FixedPointPrec )) & ~0xfff;
+	    vertex->m_z = FixedPointOne + Random( 8 << FixedPointPrec );
+	    if ( shading == ShadingGouraud )
+	    {
+		vertex->m_color.m_red = Random( 256 ) << FixedPointPrec;
+		vertex->m_color.m_green = Random( 256 ) << FixedPointPrec;
+		vertex->m_color.m_blue = Random( 256 ) << FixedPointPrec;
+	    }
+	    else
+	    {
+		vertex->m_textureCoordinates.m_u = Random( 64 << FixedPointPrec );
+		vertex->m_textureCoordinates.m_v = Random( 64 << FixedPointPrec );
+		vertex->m_textureCoordinates.m_intensity = intensity;
+	    }
+	}
+
+	// the collinear triangles would have been culled before drawing
+	int_64 area = 
+	    ((int_64)(face->m_v2.m_x - face->m_v1.m_x) * 
+	     (face->m_v3.m_y - face->m_v1.m_y)) - 
+	    ((int_64)(face->m_v2.m_y - face->m_v1.m_y) * 
+	     (face->m_v3.m_x - face->m_v1.m_x));
+	if ( area == 0 )
+	{
+	    i--;
+	    continue;
+	}
+
+	face->m_polygonFlags = ScreenPolygonInsideCanvas;
+	if ( shading != ShadingGouraud )
+	{
+	    face->m_texture = texture;
+	}
+    }
+}
+
+// sets up and draws the triangles a batch at a time, like the camera
+static void DrawTriangles( Renderer& renderer, ScreenPolygon* faces, 
+			   const ScreenPolygonKey* keys, int count, 
+			   Shading shading )
+{
+    const int batchSize = TriangleSetupBatch::MaxTriangles;
+    for ( int i = 0; i < count; i += batchSize )
+    {
+	int end = MIN( i + batchSize, count );
+	renderer.SetupTriangles( keys + i, end - i );
+
+	// all the triangles of a run share the shading, so the index in the
+	// batch is the index among the textured triangles
+	for ( int j = i; j < end; j++ )
+	{
+	    switch ( shading )
+	    {
+	    case ShadingGouraud:
+		renderer.DrawTriangle( faces + j );
+		break;
+	    case ShadingTextured:
+		renderer.DrawTexturedTriangle( faces + j, j - i );
+		break;
+	    case ShadingLightedTextured:
+		renderer.DrawLightedTexturedTriangle( faces + j, j - i );
+		break;
+	    }
+	}
+    }
+}
+
+int main( int argc, char** argv )
+{
+    int repeats = (argc > 1) ? atoi( argv[1] ) : 5;
+
+    RenderingCanvas canvas;
+    memset( &canvas, 0, sizeof(canvas) );
+    canvas.m_width = CanvasWidth;
+    canvas.m_height = CanvasHeight;
+    canvas.m_left = 0;
+    canvas.m_right = CanvasWidth - 1;
+    canvas.m_top = 0;
+    canvas.m_bottom = CanvasHeight - 1;
+    canvas.m_centerX = CanvasWidth / 2;
+    canvas.m_centerY = CanvasHeight / 2;
+    canvas.m_pixelFormat = PixelFormat888;
+    canvas.m_bytesPerScanline = CanvasWidth * 4;
+    canvas.m_bufferPtr = malloc( CanvasWidth * CanvasHeight * 4 );
+
+    Texture* texture = CreateTexture();
+    if ( (canvas.m_bufferPtr == NULL) || (texture == NULL) )
+    {
+	printf( "initialization failed\n" );
+	return 1;
+    }
+
+    Renderer* renderer = new Renderer( canvas );
+
+    printf( "%-8s %-10s %10s %16s %18s %8s\n", "size", "shading", 
+	    "triangles", "scanline ns/tri", "half-space ns/tri", "speedup" );
+
+    for ( int i = 0; i < NumSizeClasses; i++ )
+    {
+	const SizeClass& size_class = SizeClasses[i];
+	int count = PixelsPerRun / (size_class.m_size * size_class.m_size);
+	if ( count < 1000 )
+	{
+	    count = 1000;
+	}
+	ScreenPolygon* faces = 
+	    (ScreenPolygon*)malloc( count * sizeof(ScreenPolygon) );
+	ScreenPolygon* sources = 
+	    (ScreenPolygon*)malloc( count * sizeof(ScreenPolygon) );
+	ScreenPolygonKey* keys = 
+	    (ScreenPolygonKey*)malloc( count * sizeof(ScreenPolygonKey) );
+	for ( int j = 0; j < count; j++ )
+	{
+	    keys[j].m_polygon = faces + j;
+	}
+
+	for ( int shading = 0; shading < NumShadings; shading++ )
+	{
+	    CreateTriangles( sources, count, size_class.m_size, 
+			     (Shading)shading, texture );
+
+	    real_64 best[2];
+	    Renderer::Rasterizer rasterizers[2] = 
+		{ Renderer::RasterizerScanline, 
+		  Renderer::RasterizerHalfSpace };
+	    for ( int r = 0; r < 2; r++ )
+	    {
+		renderer->SetRasterizer( rasterizers[r] );
+		best[r] = 0.0;
+		for ( int repeat = 0; repeat < repeats; repeat++ )
+		{
+		    // the setup replaces the values of the textured faces
+		    memcpy( faces, sources, count * sizeof(ScreenPolygon) );
+		    real_64 start = Now();
+		    DrawTriangles( *renderer, faces, keys, count, 
+				   (Shading)shading );
+		    real_64 elapsed = (Now() - start) / count;
+		    if ( (repeat == 0) || (elapsed < best[r]) )
+		    {
+			best[r] = elapsed;
+		    }
+		}
+	    }
+
+	    printf( "%-8s %-10s %10d %16.1f %18.1f %7.2fx\n", 
+		    size_class.m_name, ShadingNames[shading], count, 
+		    best[0], best[1], best[0] / best[1] );
+	}
+
+	free( keys );
+	free( sources );
+	free( faces );
+    }
+
+    delete renderer;
+    delete texture;
+    free( canvas.m_bufferPtr );
+
+    return 0;
+}
@@ -0,0 +1,59 @@
+/*
+ *  $Id$
+ *
+ *  Nova 3D Engine - A portable object oriented, scene graph based, 
+ *  lightweight real-time 3D software rendering framework. 
+ *  Copyright (C) 2001-2009 Matti Dahlbom
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Contact: Matti Dahlbom <matti at 777-team dot org>
+ */
+
+
+#ifndef __NOVATESTS_H
+#define __NOVATESTS_H
+
+// FILE INFO
+// This file declares the test suites of the engine tests and the checks
+// they use.
+
+#include <stdio.h>
+
+// number of failed checks so far
+extern int g_numFailures;
+
+/**
+ * Checks a condition; a failing check is reported with its location and
+ * counted, and the test goes on.
+ */
+#define CHECK( condition ) \
+    do \
+    { \
+	if ( !(condition) ) \
+	{ \
+	    printf( "%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+		    #condition ); \
+	    g_numFailures++; \
+	} \
+    } while ( 0 )
+
+// the test suites
+void RunModulateTests();
+void RunAssetLoaderTests();
+void RunMeshImporterTests();
+void RunCoverageTests();
+
+#endif
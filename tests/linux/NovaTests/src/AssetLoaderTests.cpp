@@ -0,0 +1,160 @@
+/*
+ *  $Id$
+ *
+ *  Nova 3D Engine - A portable object oriented, scene graph based, 
+ *  lightweight real-time 3D software rendering framework. 
+ *  Copyright (C) 2001-2009 Matti Dahlbom
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Contact: Matti Dahlbom <matti at 777-team dot org>
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "NovaTests.h"
+#include "AssetFormat.h"
+#include "AssetLoader.h"
+#include "AssetWriter.h"
+#include "Normalizer.h"
+#include "NovaErrors.h"
+#include "Torus.h"
+
+using namespace nova3d;
+
+// the asset file written and corrupted by the tests
+static const char* AssetFileName = "novatests.n3d";
+
+// reads the whole asset file; the caller frees the data
+static uint_8* ReadAsset( long& size )
+{
+    FILE* file = fopen( AssetFileName, "rb" );
+    if ( file == NULL )
+    {
+	return NULL;
+    }
+    fseek( file, 0, SEEK_END );
+    size = ftell( file );
+    fseek( file, 0, SEEK_SET );
+    uint_8* data = (uint_8*)malloc( size );
+    if ( (data != NULL) && (fread( data, 1, size, file ) != (size_t)size) )
+    {
+	free( data );
+	data = NULL;
+    }
+    fclose( file );
+
+    return data;
+}
+
+static void WriteAsset( const uint_8* data, long size )
+{
+    FILE* file = fopen( AssetFileName, "wb" );
+    if ( file != NULL )
+    {
+	fwrite( data, 1, size, file );
+	fclose( file );
+    }
+}
+
+// returns the first shape chunk of the asset data
+static AssetShapeChunk* FindShapeChunk( uint_8* data )
+{
+    const AssetFileHeader* header = (const AssetFileHeader*)data;
+    const AssetChunkEntry* entries = 
+	(const AssetChunkEntry*)(data + sizeof(AssetFileHeader));
+    for ( uint_32 i = 0; i < header->m_numChunks; i++ )
+    {
+	if ( entries[i].m_type == AssetChunkShape )
+	{
+	    return (AssetShapeChunk*)(data + entries[i].m_offset);
+	}
+    }
+
+    return NULL;
+}
+
+// stores a value to an index array of the written asset, loads the asset
+// and returns the result
+static int LoadWithIndex( const uint_8* original, long size, 
+			  bool normalIndex, uint_32 value )
+{
+    uint_8* data = (uint_8*)malloc( size );
+    memcpy( data, original, size );
+    AssetShapeChunk* chunk = FindShapeChunk( data );
+    uint_32 offset = normalIndex ? 
+	chunk->m_vertexNormalIndicesOffset : chunk->m_verticesOffset;
+    ((uint_32*)(data + offset))[7] = value;
+    WriteAsset( data, size );
+    free( data );
+
+    AssetLoader loader;
+    return loader.Load( AssetFileName );
+}
+
+void RunAssetLoaderTests()
+{
+    Torus torus( PixelFormat888, 1.0, 0.4, 12, 8 );
+    Normalizer::CreateVertexNormals( torus );
+
+    AssetWriter writer;
+    CHECK( writer.AddShape( &torus ) == NovaErrNone );
+    CHECK( writer.Write( AssetFileName ) == NovaErrNone );
+
+    long size = 0;
+    uint_8* original = ReadAsset( size );
+    CHECK( original != NULL );
+    if ( original == NULL )
+    {
+	return;
+    }
+    AssetShapeChunk* chunk = FindShapeChunk( original );
+    CHECK( (chunk != NULL) && (chunk->m_vertexNormalsOffset != 0) );
+    if ( chunk == NULL )
+    {
+	free( original );
+	return;
+    }
+    uint_32 numCoordinates = chunk->m_numCoordinates;
+    uint_32 numVertexNormals = chunk->m_numVertexNormals;
+
+    // the last valid indices load
+    CHECK( LoadWithIndex( original, size, false, numCoordinates - 1 ) == 
+	   NovaErrNone );
+    CHECK( LoadWithIndex( original, size, true, numVertexNormals - 1 ) == 
+	   NovaErrNone );
+
+    // the indices past the arrays are rejected
+    CHECK( LoadWithIndex( original, size, false, numCoordinates ) == 
+	   NovaErrInvalidFormat );
+    CHECK( LoadWithIndex( original, size, false, 0xffffffff ) == 
+	   NovaErrInvalidFormat );
+    CHECK( LoadWithIndex( original, size, true, numVertexNormals ) == 
+	   NovaErrInvalidFormat );
+
+    // a polygon count beyond the index arrays is rejected
+    uint_8* data = (uint_8*)malloc( size );
+    memcpy( data, original, size );
+    FindShapeChunk( data )->m_numPolygons = 0x7fffffff;
+    WriteAsset( data, size );
+    free( data );
+    AssetLoader loader;
+    CHECK( loader.Load( AssetFileName ) == NovaErrInvalidFormat );
+
+    free( original );
+    remove( AssetFileName );
+}
@@ -0,0 +1,210 @@
+/*
+ *  $Id$
+ *
+ *  Nova 3D Engine - A portable object oriented, scene graph based, 
+ *  lightweight real-time 3D software rendering framework. 
+ *  Copyright (C) 2001-2009 Matti Dahlbom
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Contact: Matti Dahlbom <matti at 777-team dot org>
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "NovaTests.h"
+#include "Renderer.h"
+
+using namespace nova3d;
+
+// size of the test canvas
+static const int CanvasSize = 64;
+
+// a triangle in pixels, drawn at 1/16 pixel precision
+struct TestTriangle
+{
+    real_64 m_x[3];
+    real_64 m_y[3];
+};
+
+// draws a triangle with the half-space rasterizer into a cleared canvas
+static void DrawHalfSpace( Renderer& renderer, RenderingCanvas& canvas, 
+			   const TestTriangle& triangle )
+{
+    memset( canvas.m_bufferPtr, 0, CanvasSize * CanvasSize * 4 );
+
+    ScreenPolygon face;
+    memset( &face, 0, sizeof(face) );
+    ScreenVertex* vertices[3] = { &face.m_v1, &face.m_v2, &face.m_v3 };
+    for ( int i = 0; i < 3; i++ )
+    {
+	vertices[i]->m_x = (int_32)(triangle.m_x[i] * 65536.0);
+	vertices[i]->m_y = (int_32)(triangle.m_y[i] * 65536.0);
+	vertices[i]->m_z = FixedPointOne;
+	vertices[i]->m_color.m_red = 255 << FixedPointPrec;
+	vertices[i]->m_color.m_green = 255 << FixedPointPrec;
+	vertices[i]->m_color.m_blue = 255 << FixedPointPrec;
+    }
+    renderer.DrawTriangle( &face );
+}
+
+// whether the documented rule covers the pixel: its position is inside 
+// the triangle, or on a right edge or a flat bottom edge
+static bool IsCovered( const TestTriangle& triangle, int x, int y )
+{
+    // with y growing downwards, a positive area winds clockwise on the
+    // screen; a right edge then goes down and a bottom edge goes left
+    int_64 vx[3], vy[3];
+    for ( int i = 0; i < 3; i++ )
+    {
+	vx[i] = (int_64)(triangle.m_x[i] * 16.0);
+	vy[i] = (int_64)(triangle.m_y[i] * 16.0);
+    }
+    int_64 area = ((vx[1] - vx[0]) * (vy[2] - vy[0])) - 
+	((vy[1] - vy[0]) * (vx[2] - vx[0]));
+    if ( area == 0 )
+    {
+	return false;
+    }
+
+    for ( int i = 0; i < 3; i++ )
+    {
+	int a = (area > 0) ? i : ((3 - i) % 3);
+	int b = (area > 0) ? ((i + 1) % 3) : ((5 - i) % 3);
+	int_64 dx = vx[b] - vx[a];
+	int_64 dy = vy[b] - vy[a];
+	int_64 side = (dx * ((y * 16) - vy[a])) - (dy * ((x * 16) - vx[a]));
+	if ( (side < 0) || 
+	     ((side == 0) && !((dy > 0) || ((dy == 0) && (dx < 0)))) )
+	{
+	    return false;
+	}
+    }
+
+    return true;
+}
+
+// compares the drawn pixels of a triangle to the documented rule
+static void TestTriangleCoverage( Renderer& renderer, 
+				  RenderingCanvas& canvas, 
+				  const TestTriangle& triangle )
+{
+    DrawHalfSpace( renderer, canvas, triangle );
+    const uint_32* pixels = (const uint_32*)canvas.m_bufferPtr;
+    int mismatches = 0;
+    for ( int y = 0; y < CanvasSize; y++ )
+    {
+	for ( int x = 0; x < CanvasSize; x++ )
+	{
+	    if ( (pixels[(y * CanvasSize) + x] != 0) != 
+		 IsCovered( triangle, x, y ) )
+	    {
+		mismatches++;
+	    }
+	}
+    }
+    CHECK( mismatches == 0 );
+}
+
+// draws the two halves of a square and checks that every pixel of the 
+// square is drawn exactly once
+static void TestSharedEdge( Renderer& renderer, RenderingCanvas& canvas, 
+			    const TestTriangle& first, 
+			    const TestTriangle& second, 
+			    int left, int top, int size )
+{
+    int counts[CanvasSize * CanvasSize];
+    memset( counts, 0, sizeof(counts) );
+    const TestTriangle* triangles[2] = { &first, &second };
+    for ( int i = 0; i < 2; i++ )
+    {
+	DrawHalfSpace( renderer, canvas, *triangles[i] );
+	const uint_32* pixels = (const uint_32*)canvas.m_bufferPtr;
+	for ( int p = 0; p < (CanvasSize * CanvasSize); p++ )
+	{
+	    counts[p] += (pixels[p] != 0) ? 1 : 0;
+	}
+    }
+
+    // the right and bottom sides of the square are drawn
+    int mismatches = 0;
+    for ( int y = 0; y < CanvasSize; y++ )
+    {
+	for ( int x = 0; x < CanvasSize; x++ )
+	{
+	    bool inside = (x > left) && (x <= (left + size)) && 
+		(y > top) && (y <= (top + size));
+	    if ( counts[(y * CanvasSize) + x] != (inside ? 1 : 0) )
+	    {
+		mismatches++;
+	    }
+	}
+    }
+    CHECK( mismatches == 0 );
+}
+
+void RunCoverageTests()
+{
+    void* buffer = malloc( CanvasSize * CanvasSize * 4 );
+    CHECK( buffer != NULL );
+    if ( buffer == NULL )
+    {
+	return;
+    }
+
+    RenderingCanvas canvas;
+    memset( &canvas, 0, sizeof(canvas) );
+    canvas.m_right = CanvasSize;
+    canvas.m_bottom = CanvasSize;
+    canvas.m_width = CanvasSize;
+    canvas.m_height = CanvasSize;
+    canvas.m_centerX = CanvasSize / 2;
+    canvas.m_centerY = CanvasSize / 2;
+    canvas.m_pixelFormat = PixelFormat888;
+    canvas.m_bytesPerScanline = CanvasSize * 4;
+    canvas.m_bufferPtr = buffer;
+
+    Renderer* renderer = new Renderer( canvas );
+    renderer->SetRasterizer( Renderer::RasterizerHalfSpace );
+
+    // a 20x20 square split along either diagonal
+    TestTriangle upperLeft = { { 10, 30, 10 }, { 10, 10, 30 } };
+    TestTriangle lowerRight = { { 30, 30, 10 }, { 10, 30, 30 } };
+    TestSharedEdge( *renderer, canvas, upperLeft, lowerRight, 10, 10, 20 );
+    TestTriangle upperRight = { { 10, 30, 30 }, { 10, 10, 30 } };
+    TestTriangle lowerLeft = { { 10, 30, 10 }, { 10, 30, 30 } };
+    TestSharedEdge( *renderer, canvas, upperRight, lowerLeft, 10, 10, 20 );
+
+    // integer, subpixel and sliver triangles in both windings
+    const TestTriangle triangles[] = 
+	{
+	    { { 10, 30, 10 }, { 10, 10, 30 } },
+	    { { 5, 50, 22 }, { 8, 19, 47 } },
+	    { { 5, 22, 50 }, { 8, 47, 19 } },
+	    { { 3.25, 41.5625, 17.875 }, { 6.6875, 12.125, 50.4375 } },
+	    { { 2.5, 60.0625, 31.3125 }, { 30.125, 33.5, 31.9375 } },
+	    { { 12.0, 13.5, 40.0 }, { 2.0, 2.0625, 61.0 } }
+	};
+    int numTriangles = sizeof(triangles) / sizeof(triangles[0]);
+    for ( int i = 0; i < numTriangles; i++ )
+    {
+	TestTriangleCoverage( *renderer, canvas, triangles[i] );
+    }
+
+    delete renderer;
+    free( buffer );
+}
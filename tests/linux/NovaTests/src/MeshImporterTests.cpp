@@ -0,0 +1,76 @@
+/*
+ *  $Id$
+ *
+ *  Nova 3D Engine - A portable object oriented, scene graph based, 
+ *  lightweight real-time 3D software rendering framework. 
+ *  Copyright (C) 2001-2009 Matti Dahlbom
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Contact: Matti Dahlbom <matti at 777-team dot org>
+ */
+
+
+#include <stdio.h>
+
+#include "NovaTests.h"
+#include "MeshImporter.h"
+#include "NovaErrors.h"
+#include "Shape.h"
+
+using namespace nova3d;
+
+// the mesh file written by the tests
+static const char* ObjFileName = "novatests.obj";
+
+void RunMeshImporterTests()
+{
+    // a triangle with a half intensity red, a half intensity green and a 
+    // full intensity blue corner
+    FILE* file = fopen( ObjFileName, "wb" );
+    CHECK( file != NULL );
+    if ( file == NULL )
+    {
+	return;
+    }
+    fprintf( file, 
+	     "v 0 0 0 0.5 0 0\n"
+	     "v 1 0 0 0 0.5 0\n"
+	     "v 0 1 0 0 0 1\n"
+	     "f 1 2 3\n" );
+    fclose( file );
+
+    MeshImporter importer;
+    Shape* shape = NULL;
+    CHECK( importer.CreateShape( PixelFormat565, ObjFileName, shape ) == 
+	   NovaErrNone );
+    CHECK( shape != NULL );
+    if ( shape != NULL )
+    {
+	// the components are scaled to 5 and 6 bits, not masked
+	const uint_32* colors = shape->GetVertexColors();
+	CHECK( shape->GetNumPolygons() == 1 );
+	CHECK( colors != NULL );
+	if ( colors != NULL )
+	{
+	    CHECK( colors[0] == PIXEL_565( 16, 0, 0 ) );
+	    CHECK( colors[1] == PIXEL_565( 0, 32, 0 ) );
+	    CHECK( colors[2] == PIXEL_565( 0, 0, 31 ) );
+	}
+	delete shape;
+    }
+
+    remove( ObjFileName );
+}
@@ -0,0 +1,73 @@
+/*
+ *  $Id$
+ *
+ *  Nova 3D Engine - A portable object oriented, scene graph based, 
+ *  lightweight real-time 3D software rendering framework. 
+ *  Copyright (C) 2001-2009 Matti Dahlbom
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Contact: Matti Dahlbom <matti at 777-team dot org>
+ */
+
+
+#include "NovaTests.h"
+#include "Display.h"
+
+using namespace nova3d;
+
+// modulates each pure component of a format by every intensity and 
+// checks the result against the component scaled on its own
+static void TestModulateFormat( NovaPixelFormat pixelFormat )
+{
+    ModulateMasks masks;
+    GetModulateMasks( pixelFormat, masks );
+    const uint_32 components[3] = 
+	{ masks.m_redMask, masks.m_greenMask, masks.m_blueMask };
+    uint_32 white = masks.m_redMask | masks.m_greenMask | masks.m_blueMask;
+
+    for ( uint_32 intensity = 0; intensity <= MaxModulateIntensity; 
+	  intensity++ )
+    {
+	uint_32 expected_white = 0;
+	for ( int i = 0; i < 3; i++ )
+	{
+	    uint_32 mask = components[i];
+	    int_32 position = 0;
+	    while ( ((mask >> position) & 1) == 0 )
+	    {
+		position++;
+	    }
+	    uint_32 maximum = mask >> position;
+	    uint_32 expected = ((maximum * intensity) >> 8) << position;
+	    expected_white |= expected;
+
+	    uint_32 result = ModulateColor( mask, intensity, masks );
+	    CHECK( (result & ~mask) == 0 );
+	    CHECK( result == expected );
+	}
+
+	CHECK( ModulateColor( white, intensity, masks ) == expected_white );
+    }
+}
+
+void RunModulateTests()
+{
+    TestModulateFormat( PixelFormat888 );
+    TestModulateFormat( PixelFormat444 );
+    TestModulateFormat( PixelFormat565 );
+    TestModulateFormat( PixelFormat555 );
+    TestModulateFormat( PixelFormat666 );
+}
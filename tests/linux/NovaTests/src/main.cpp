@@ -0,0 +1,53 @@
+/*
+ *  $Id$
+ *
+ *  Nova 3D Engine - A portable object oriented, scene graph based, 
+ *  lightweight real-time 3D software rendering framework. 
+ *  Copyright (C) 2001-2009 Matti Dahlbom
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Contact: Matti Dahlbom <matti at 777-team dot org>
+ */
+
+
+// FILE INFO
+// Runs the tests of the engine. The exit code is the number of failed 
+// checks, so 0 means success.
+//
+// Usage: novatests
+
+#include "NovaTests.h"
+
+int g_numFailures = 0;
+
+int main( int argc, char** argv )
+{
+    RunModulateTests();
+    RunAssetLoaderTests();
+    RunMeshImporterTests();
+    RunCoverageTests();
+
+    if ( g_numFailures > 0 )
+    {
+	printf( "%d checks failed\n", g_numFailures );
+    }
+    else
+    {
+	printf( "all checks passed\n" );
+    }
+
+    return g_numFailures;
+}
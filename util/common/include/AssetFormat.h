@@ -0,0 +1,130 @@
+/*
+ *  $Id$
+ *
+ *  Nova 3D Engine - A portable object oriented, scene graph based, 
+ *  lightweight real-time 3D software rendering framework. 
+ *  Copyright (C) 2001-2009 Matti Dahlbom
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Contact: Matti Dahlbom <matti at 777-team dot org>
+ */
+
+#ifndef __ASSETFORMAT_H
+#define __ASSETFORMAT_H
+
+// FILE INFO
+// This file describes the binary asset file format, which stores 
+// preprocessed shapes and textures in the form they are used in at run 
+// time, so that they can be used directly from a memory mapped file.
+//
+// The file starts with an AssetFileHeader, followed by a directory of 
+// AssetChunkEntry structures, one per chunk. Every chunk starts with a 
+// chunk type specific header and is followed by the arrays the header 
+// refers to. All offsets are from the start of the file and every chunk 
+// and array starts at an AssetAlignment boundary. An offset of 0 denotes 
+// a missing optional array.
+//
+// All values are in the native byte order of the platform the file was 
+// written on; a file with a mismatching byte order is rejected by the
+// magic number check.
+
+#include "NovaTypes.h"
+
+namespace nova3d {
+
+// magic number; "N3DA" in a little endian file
+const uint_32 AssetMagic = 0x4144334e;
+
+// format version. must be increased whenever the layout changes.
+const uint_32 AssetVersion = 2;
+
+// alignment of the chunks and arrays in the file
+const uint_32 AssetAlignment = 16;
+
+// chunk types
+const uint_32 AssetChunkTexture = 1;
+const uint_32 AssetChunkShape = 2;
+
+// shape flags
+const uint_32 AssetShapeIlluminated = 0x0001;
+const uint_32 AssetShapePrelit = 0x0002;
+
+struct AssetFileHeader
+{
+    uint_32 m_magic;
+    uint_32 m_version;
+    uint_32 m_numChunks;
+    uint_32 m_reserved;
+};
+
+struct AssetChunkEntry
+{
+    uint_32 m_type;
+    uint_32 m_offset;
+    uint_32 m_size;
+    uint_32 m_reserved;
+};
+
+// texture chunk. the data holds all the mip levels one after another.
+struct AssetTextureChunk
+{
+    uint_32 m_pixelFormat;
+    uint_32 m_width;
+    uint_32 m_height;
+    uint_32 m_layout;
+    uint_32 m_lightingMode;
+    uint_32 m_numPalettes;
+    uint_32 m_numMipLevels;
+    uint_32 m_paletteOffset;
+    uint_32 m_dataOffset;
+    uint_32 m_dataSize;
+    uint_32 m_reserved[2];
+};
+
+// shape chunk. the arrays are laid out as in the Shape members; the
+// texture indices (one per polygon, -1 for none) refer to the texture
+// chunks in the order they appear in the file. the baked lighting 
+// intensities (3 per polygon) are present only for prelit shapes.
+struct AssetShapeChunk
+{
+    uint_32 m_pixelFormat;
+    uint_32 m_flags;
+    uint_32 m_numCoordinates;
+    uint_32 m_numPolygons;
+    uint_32 m_numVertexNormals;
+    int_32 m_boundingSphere[4]; // center x, y, z and radius
+    int_32 m_boundingBox[6]; // min x, y, z and max x, y, z
+    uint_32 m_coordinatesOffset;
+    uint_32 m_verticesOffset;
+    uint_32 m_planeEquationsOffset;
+    uint_32 m_polygonInfosOffset;
+    uint_32 m_vertexColorsOffset;
+    uint_32 m_textureCoordinatesOffset;
+    uint_32 m_vertexNormalsOffset;
+    uint_32 m_vertexNormalIndicesOffset;
+    uint_32 m_textureIndicesOffset;
+    uint_32 m_lightingIntensitiesOffset;
+};
+
+/** Rounds a size or an offset up to the asset alignment. */
+inline uint_32 AssetAlign( uint_32 value )
+{
+    return (value + (AssetAlignment - 1)) & ~(AssetAlignment - 1);
+}
+
+}; // namespace
+
+#endif
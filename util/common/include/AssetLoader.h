@@ -0,0 +1,114 @@
+/*
+ *  $Id$
+ *
+ *  Nova 3D Engine - A portable object oriented, scene graph based, 
+ *  lightweight real-time 3D software rendering framework. 
+ *  Copyright (C) 2001-2009 Matti Dahlbom
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Contact: Matti Dahlbom <matti at 777-team dot org>
+ */
+
+#ifndef __ASSETLOADER_H
+#define __ASSETLOADER_H
+
+#include "NovaTypes.h"
+#include "List.h"
+#include "MappedFile.h"
+#include "Texture.h"
+#include "Shape.h"
+#include "AssetFormat.h"
+
+namespace nova3d {
+
+/**
+ * Loads the shapes and textures from a binary asset file written by 
+ * AssetWriter. The file is memory mapped and the geometry, the palettes 
+ * and the texels are used directly from the mapping; only the per-frame 
+ * buffers of the shapes are allocated.<p />
+ *
+ * The file structure, the array sizes, the polygon counts and all the 
+ * indices (vertex, vertex normal and texture indices) are validated. The
+ * other array contents, such as the coordinates, plane equations, colors,
+ * texture coordinates, lighting intensities and texels, are trusted.<p />
+ *
+ * The loader owns the loaded objects and the mapping, and must outlive
+ * any use of them.<p />
+ *
+ * @author Matti Dahlbom
+ * @version $Revision$
+ */
+class AssetLoader
+{
+ public: // Constructors and destructor
+    NOVA_IMPORT AssetLoader();
+    NOVA_IMPORT ~AssetLoader();
+
+ public: // New methods (Public API)
+    /**
+     * Loads the given asset file.<p />
+     *
+     * @return Nova error code or NovaErrNone if successful
+     */
+    NOVA_IMPORT int Load( const char* fileName );
+
+    /** Deletes the loaded objects and releases the file. */
+    NOVA_IMPORT void Unload();
+
+    /** Returns the number of loaded textures. */
+    inline int GetNumTextures() const;
+
+    /** Returns the number of loaded shapes. */
+    inline int GetNumShapes() const;
+
+    /** Returns a loaded texture or NULL if the index is out of bounds. */
+    NOVA_IMPORT Texture* GetTexture( int index ) const;
+
+    /** Returns a loaded shape or NULL if the index is out of bounds. */
+    NOVA_IMPORT Shape* GetShape( int index ) const;
+
+ private: // New methods
+    int LoadTexture( const AssetChunkEntry& entry );
+    int LoadShape( const AssetChunkEntry& entry );
+    bool CheckRange( uint_32 offset, uint_64 size, bool optional ) const;
+
+    /** Checks that all the given indices are less than limit. */
+    static bool CheckIndices( const uint_32* indices, uint_64 count, 
+			      uint_32 limit );
+
+ private: // Data
+    MappedFile m_file;
+    List<Texture*> m_textures;
+    List<Shape*> m_shapes;
+};
+
+///////////////////////////////////////////////////
+// inline method definitions
+///////////////////////////////////////////////////
+
+int AssetLoader::GetNumTextures() const
+{
+    return m_textures.Count();
+}
+
+int AssetLoader::GetNumShapes() const
+{
+    return m_shapes.Count();
+}
+
+}; // namespace
+
+#endif
@@ -0,0 +1,93 @@
+/*
+ *  $Id$
+ *
+ *  Nova 3D Engine - A portable object oriented, scene graph based, 
+ *  lightweight real-time 3D software rendering framework. 
+ *  Copyright (C) 2001-2009 Matti Dahlbom
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Contact: Matti Dahlbom <matti at 777-team dot org>
+ */
+
+#ifndef __ASSETWRITER_H
+#define __ASSETWRITER_H
+
+#include "NovaTypes.h"
+#include "List.h"
+#include "Texture.h"
+#include "Shape.h"
+
+namespace nova3d {
+
+/**
+ * Writes shapes and textures into a binary asset file (see AssetFormat.h)
+ * in their preprocessed form: fixed point coordinates, plane equations,
+ * vertex normals, indexed texels with the palettes and the mip chain. 
+ * This is meant to be run offline; the file is loaded with 
+ * AssetLoader.<p />
+ *
+ * @author Matti Dahlbom
+ * @version $Revision$
+ */
+class AssetWriter
+{
+ public: // Constructors and destructor
+    NOVA_IMPORT AssetWriter();
+    NOVA_IMPORT ~AssetWriter();
+
+ public: // New methods (Public API)
+    /** 
+     * Adds a texture to be written. The caller retains the ownership of 
+     * the texture and it must stay valid until <code>Write()</code> has
+     * been called.
+     */
+    NOVA_IMPORT int AddTexture( const Texture* texture );
+
+    /** 
+     * Adds a shape to be written. The textures of the shape must have been 
+     * added with <code>AddTexture()</code>. The caller retains the 
+     * ownership of the shape and it must stay valid until 
+     * <code>Write()</code> has been called.
+     */
+    NOVA_IMPORT int AddShape( const Shape* shape );
+
+    /**
+     * Writes all the added textures and shapes to the given file.<p />
+     *
+     * @return Nova error code or NovaErrNone if successful
+     */
+    NOVA_IMPORT int Write( const char* fileName );
+
+ private: // New methods
+    int Append( const void* data, uint_32 size );
+    int Pad();
+    int WriteTexture( const Texture& texture );
+    int WriteShape( const Shape& shape );
+    int FindTexture( const Texture* texture ) const;
+
+ private: // Data
+    List<const Texture*> m_textures;
+    List<const Shape*> m_shapes;
+
+    // the file is assembled in memory before writing
+    uint_8* m_buffer;
+    uint_32 m_size;
+    uint_32 m_maxSize;
+};
+
+}; // namespace
+
+#endif
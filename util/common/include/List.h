@@ -38,6 +38,10 @@ const int ListDefaultGranularity = 4;
 
 /**
  * A templated class to provide a minimalistic std::vector like behaviour.<p />
+ *
+ * The storage grows geometrically (doubling), so appending n elements costs 
+ * O(n) in total. The elements are stored contiguously and may be iterated
+ * without bounds checks through Begin() / End() or operator[].<p />
  * 
  * @author Matti Dahlbom
  * @version $Revision: 23 $
@@ -52,7 +56,19 @@ template <class T> class List
     /**
      * Appends a new entry in the end of this list.<p />
      */
-    int Append( T& t );
+    int Append( const T& t );
+
+    /**
+     * Appends <code>count</code> entries in the end of this list 
+     * with a single copy.<p />
+     */
+    int Append( const T* t, int count );
+
+    /**
+     * Makes sure the list can hold at least <code>count</code> elements 
+     * without reallocating. Does not change the element count.<p />
+     */
+    int Reserve( int count );
         
     /**
      * Removes an entry at a given index from this list.<p />
@@ -79,12 +95,38 @@ template <class T> class List
      * earlier call invalid.<p />
      */        
     int Get( int index, T*& t ) const;
+
+    /**
+     * Returns the entry at the given index without bounds checking.<p />
+     */
+    inline T& operator[]( int index );
+    inline const T& operator[]( int index ) const;
+
+    /**
+     * Returns a pointer to the first element of the contiguous element 
+     * storage. The pointer is invalidated by any call that adds elements
+     * to the list.<p />
+     */
+    inline T* Begin();
+    inline const T* Begin() const;
+
+    /**
+     * Returns a pointer to one past the last element of the list.<p />
+     */
+    inline T* End();
+    inline const T* End() const;
         
     /** 
-     * Resets the list, removing all the elements and reseting the maximum
-     * size to one times m_granularity.
+     * Resets the list, removing all the elements. The allocated storage
+     * is kept for reuse.
      */
     int Reset();
+
+ private: // New methods
+    /**
+     * Grows the storage to hold at least <code>minElements</code> elements.
+     */
+    int Grow( int minElements );
         
  private: // Data
     int m_numElements;
@@ -112,31 +154,93 @@ template <class T> List<T>::~List()
     }
 }
 
-template <class T> int List<T>::Append( T& t )
+template <class T> int List<T>::Grow( int minElements )
+{
+    // double the capacity, but at least by m_granularity
+    int maxElements = m_maxElements * 2;
+    if ( maxElements < (m_maxElements + m_granularity) )
+    {
+        maxElements = m_maxElements + m_granularity;
+    }
+    if ( maxElements < minElements )
+    {
+        maxElements = minElements;
+    }
+
+    void* p = realloc( (void*)m_data, sizeof(T) * maxElements );
+    if ( p == NULL )
+    {
+        // failed to allocate more memory
+        return NovaErrNoMemory;
+    }
+
+    m_data = (T*)p;
+    m_maxElements = maxElements;
+
+    return NovaErrNone;
+}
+
+template <class T> int List<T>::Append( const T& t )
 {
     // check if need to reallocate
     if ( m_numElements == m_maxElements )
     {
-        m_maxElements += m_granularity;
-	void* p = realloc( m_data, sizeof(T) * m_maxElements );
-	if ( p == NULL )
-	{
-	    // failed to allocate more memory
-	    return NovaErrNoMemory;
-	}
-	else
-	{
-	    m_data = (T*)p;
-	}
+        int ret = Grow( m_numElements + 1 );
+        if ( ret != NovaErrNone )
+        {
+            return ret;
+        }
     }
     
     // append the new element
-    memcpy( &(m_data[m_numElements]), &t, sizeof(T) );
+    memcpy( (void*)&(m_data[m_numElements]), (const void*)&t, sizeof(T) );
     m_numElements++;
     
     return NovaErrNone;
 }
 
+template <class T> int List<T>::Append( const T* t, int count )
+{
+    if ( count <= 0 )
+    {
+        return (count == 0) ? NovaErrNone : NovaErrInvalidArgument;
+    }
+
+    if ( (m_numElements + count) > m_maxElements )
+    {
+        int ret = Grow( m_numElements + count );
+        if ( ret != NovaErrNone )
+        {
+            return ret;
+        }
+    }
+
+    memcpy( (void*)&(m_data[m_numElements]), (const void*)t, 
+            sizeof(T) * count );
+    m_numElements += count;
+
+    return NovaErrNone;
+}
+
+template <class T> int List<T>::Reserve( int count )
+{
+    if ( count <= m_maxElements )
+    {
+        return NovaErrNone;
+    }
+
+    void* p = realloc( (void*)m_data, sizeof(T) * count );
+    if ( p == NULL )
+    {
+        return NovaErrNoMemory;
+    }
+
+    m_data = (T*)p;
+    m_maxElements = count;
+
+    return NovaErrNone;
+}
+
 template <class T> int List<T>::Remove( int index )
 {
     if ( (index < 0) || (index >= m_numElements) )
@@ -147,7 +251,7 @@ template <class T> int List<T>::Remove( int index )
     if ( index < (m_numElements - 1) )
     {
         // move the remaining entries up one slot
-        memmove( &m_data[index], &m_data[index + 1], 
+        memmove( (void*)&m_data[index], (const void*)&m_data[index + 1], 
                  sizeof(T) * (m_numElements - index - 1) );
     }
     
@@ -187,6 +291,36 @@ template <class T> int List<T>::Get( int index, T*& t ) const
     }    
 }
 
+template <class T> inline T& List<T>::operator[]( int index )
+{
+    return m_data[index];
+}
+
+template <class T> inline const T& List<T>::operator[]( int index ) const
+{
+    return m_data[index];
+}
+
+template <class T> inline T* List<T>::Begin()
+{
+    return m_data;
+}
+
+template <class T> inline const T* List<T>::Begin() const
+{
+    return m_data;
+}
+
+template <class T> inline T* List<T>::End()
+{
+    return m_data + m_numElements;
+}
+
+template <class T> inline const T* List<T>::End() const
+{
+    return m_data + m_numElements;
+}
+
 template <class T> int List<T>::Reset() 
 {
     m_numElements = 0;
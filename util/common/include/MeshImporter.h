@@ -0,0 +1,163 @@
+/*
+ *  $Id$
+ *
+ *  Nova 3D Engine - A portable object oriented, scene graph based, 
+ *  lightweight real-time 3D software rendering framework. 
+ *  Copyright (C) 2001-2009 Matti Dahlbom
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Contact: Matti Dahlbom <matti at 777-team dot org>
+ */
+
+#ifndef __MESHIMPORTER_H
+#define __MESHIMPORTER_H
+
+#include "NovaTypes.h"
+#include "List.h"
+#include "Display.h"
+#include "VectorMath.h"
+#include "VertexWelder.h"
+
+namespace nova3d {
+
+class Shape;
+class StreamReader;
+struct PlyElement;
+
+// granularity of the import lists; the meshes may be very large
+const int ImportListGranularity = 65536;
+
+/**
+ * Creates shapes from Wavefront OBJ and binary PLY mesh files.<p />
+ *
+ * The files are streamed through a fixed size buffer and parsed in a 
+ * single pass, so the file is never held in memory. The coordinates are 
+ * converted straight into fixed point and duplicate coordinates and 
+ * normals are welded as they are read. The index remapping, colors and 
+ * texture coordinates of the vertices in the file are kept until the 
+ * shape is built, so the memory used also grows with the number of 
+ * vertices in the file. Polygons with more than 3 vertices are split into
+ * triangle fans. If the file does not contain normals for every vertex, smooth 
+ * vertex normals are created from the polygons sharing each 
+ * coordinate.<p />
+ *
+ * The texture coordinates are scaled from [0,1] into texels with the
+ * texture size set with <code>SetTextureSize()</code>. The coordinates 
+ * must fit in the fixed point range after scaling with the factor set 
+ * with <code>SetScale()</code>.<p />
+ *
+ * The importer keeps its buffers for reuse between imports.<p />
+ *
+ * @author Matti Dahlbom
+ * @version $Revision$
+ */
+class MeshImporter
+{
+ public: // Constructors and destructor
+    NOVA_IMPORT MeshImporter();
+    NOVA_IMPORT ~MeshImporter();
+
+ public: // New methods (Public API)
+    /** Sets the scale factor for the coordinates. Default is 1.0. */
+    inline void SetScale( real_64 scale );
+
+    /** Sets the texture size in texels. Default is 256 x 256. */
+    inline void SetTextureSize( int width, int height );
+
+    /**
+     * Creates a shape from the given OBJ (.obj) or binary PLY (.ply) 
+     * file, selected by the file name extension.<p />
+     *
+     * @param pixelFormat pixel format of the shape
+     * @param fileName name of the file to import
+     * @param shape will be initialized to hold the shape object. The 
+     *              caller takes the ownership of the shape.
+     * @return Nova error code or NovaErrNone if successful
+     */
+    NOVA_IMPORT int CreateShape( NovaPixelFormat pixelFormat, 
+				 const char* fileName, Shape*& shape );
+
+    /** Creates a shape from the given Wavefront OBJ file. */
+    NOVA_IMPORT int CreateShapeFromObj( NovaPixelFormat pixelFormat, 
+					const char* fileName, Shape*& shape );
+
+    /** Creates a shape from the given binary PLY file. */
+    NOVA_IMPORT int CreateShapeFromPly( NovaPixelFormat pixelFormat, 
+					const char* fileName, Shape*& shape );
+
+ private: // New methods
+    void Reset();
+    int ParseObj( NovaPixelFormat pixelFormat, StreamReader& reader );
+    int ParseObjFace( const char* line );
+    int ParsePly( NovaPixelFormat pixelFormat, StreamReader& reader );
+    int ReadPlyVertices( NovaPixelFormat pixelFormat, StreamReader& reader,
+			 const PlyElement& element, bool swap );
+    int ReadPlyFaces( StreamReader& reader, const PlyElement& element, 
+		      bool swap );
+    int SkipPlyElement( StreamReader& reader, const PlyElement& element, 
+			bool swap );
+    int AddPosition( real_64 x, real_64 y, real_64 z, uint_32 color );
+    int AddNormal( real_64 x, real_64 y, real_64 z );
+    int AddTextureCoordinate( real_64 u, real_64 v );
+    int AddTriangle( const int_32* corner0, const int_32* corner1, 
+		     const int_32* corner2 );
+    int CreateSmoothNormals( Shape& shape );
+    int BuildShape( NovaPixelFormat pixelFormat, Shape*& shape );
+
+ private: // Data
+    real_64 m_scale;
+    int m_textureWidth;
+    int m_textureHeight;
+
+    // unique coordinates and normals of the shape
+    VertexWelder m_positions;
+    VertexWelder m_normals;
+
+    // attributes of the vertices in the file; the file's position and 
+    // normal indices are remapped to the welded ones 
+    List<uint_32> m_positionRemap;
+    List<uint_32> m_sourceColors;
+    List<int_32> m_sourceTextureCoordinates;
+    List<uint_32> m_normalRemap;
+
+    // the shape data; 3 vertices, colors and normal indices and 6 texture
+    // coordinates per polygon
+    List<uint_32> m_vertices;
+    List<uint_32> m_vertexColors;
+    List<int_32> m_textureCoordinates;
+    List<uint_32> m_normalIndices;
+    bool m_hasTextureCoordinates;
+    bool m_missingNormals;
+};
+
+///////////////////////////////////////////////////
+// inline method definitions
+///////////////////////////////////////////////////
+
+void MeshImporter::SetScale( real_64 scale )
+{
+    m_scale = scale;
+}
+
+void MeshImporter::SetTextureSize( int width, int height )
+{
+    m_textureWidth = width;
+    m_textureHeight = height;
+}
+
+}; // namespace
+
+#endif
@@ -26,22 +26,28 @@
 #define __NORMALIZER_H
 
 #include "NovaTypes.h"
-#include "List.h"
 
 namespace nova3d {
 
 class Shape;
 class Vector;
+class SmoothenVerticesBody;
 
 /**
  * Utility class for manipulating the vertex normals of a visual 
  * shape object.<p />
+ *
+ * The smoothing is done over a vertex to polygon corner adjacency built
+ * once per call, and identical normals are combined through a hash table,
+ * so the cost is linear in the number of polygons.<p />
  * 
  * @author Matti Dahlbom
  * @version $Revision$
  */
 class Normalizer 
 {
+    friend class SmoothenVerticesBody;
+
  public: // New methods (Public API)
     // angle value for always smoothening (combining vertice normals)
     static const real_64 AlwaysSmoothenAngle = 180.0;
@@ -73,7 +79,28 @@ class Normalizer
     NOVA_IMPORT static int CreateVertexNormals( Shape& shape );
 
  private: // New methods
-    static int SmoothenVertex( const List<uint_32>& vertexNormalIndices,
+    /** 
+     * Builds the adjacency of the vertices: the normal indices of the 
+     * polygon corners at vertex i are adjacency[offsets[i]] .. 
+     * adjacency[offsets[i + 1] - 1]. The caller must free the lists.
+     * <code>disjoint</code> tells whether each normal is referenced from
+     * the corners of a single vertex only, in which case the vertices
+     * can be smoothened in parallel.
+     */
+    static int BuildAdjacency( const Shape& shape, int numNormals,
+			       uint_32*& offsets, uint_32*& adjacency, 
+			       bool& disjoint );
+
+    /** 
+     * Smoothens the normals at the given range of vertices. The ranges 
+     * can be processed independently of each other.
+     */
+    static void SmoothenVertices( int firstVertex, int numVertices, 
+				  const uint_32* offsets, 
+				  const uint_32* adjacency, 
+				  Vector* normals, real_64 angle );
+
+    static int SmoothenVertex( const uint_32* normalIndices, int numIndices,
 			       Vector* normals, real_64 angle );
     
  private: // Constructor - prevent instantiation
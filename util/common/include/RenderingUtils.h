@@ -63,16 +63,34 @@ void CalculatePolygonGradients( const ScreenVertex& vertex1,
  * 
  * The method also writes back values used to calculate things for the long
  * edge so they need not be recalculated.
+ *
+ * @param longInvLen MaxUint32 / height of the long edge, as calculated 
+ *        by the triangle setup
  */
 bool IsLongOnLeft( const ScreenVertex& vertex1, 
 		   const ScreenVertex& vertex2, 
 		   const ScreenVertex& vertex3, 
-		   int& longInvLen, int& longX, int& longDxdy );
+		   int longInvLen, int& longX, int& longDxdy );
+
+/**
+ * Selects the mip level for a textured polygon by comparing the area
+ * the polygon covers in texture space to the area it covers on screen. 
+ * Each level down the chain quarters the texel area, so the level is 
+ * chosen to be the one where a texel maps to at least one pixel.<p />
+ *
+ * Must be called before CalculateInverses() for the polygon.
+ *
+ * @param face polygon with screen coordinates and texture coordinates
+ * @param numMipLevels number of mip levels in the polygon's texture
+ * @return the selected level, 0..numMipLevels-1
+ */
+int SelectMipLevel( const ScreenPolygon& face, int numMipLevels );
 
 /**
- * Calculates 1/z, u/z, v/z for a screen vertex.
+ * Calculates 1/z, u/z, v/z for a screen vertex. The texture coordinates
+ * are scaled down to the given mip level.
  */
-void CalculateInverses( ScreenVertex& vertex );
+void CalculateInverses( ScreenVertex& vertex, int mipLevel = 0 );
 
 }; // namespace
 
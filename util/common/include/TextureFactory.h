@@ -29,21 +29,45 @@
 
 namespace nova3d {
 
-// represents a color-frequency mapping for color reduction
+class PaletteLookupBody;
+class TextureDataBody;
+
+// represents a 555 color cell of the color histogram; the sums of the 
+// original 888 color components are kept for averaging
 struct ColorTableEntry
 {
-    uint_32 m_originalColor;
     uint_32 m_frequency;
+    uint_32 m_redSum;
+    uint_32 m_greenSum;
+    uint_32 m_blueSum;
+};
+
+// box in the 555 color space used by the median cut; the components
+// are indexed red, green, blue.
+struct ColorBox
+{
+    int m_min[3];
+    int m_max[3];
+    uint_32 m_population;
 };
 
 /**
  * Utility for creating textures.<p />
  *
+ * The colors of the image are reduced to the palette size with the median
+ * cut algorithm over a 555 color histogram. The pixels are then mapped to
+ * the palette through a lookup from the 555 color cell to the nearest 
+ * palette entry, so the cost of the mapping does not depend on the 
+ * palette size.<p />
+ *
  * @author Matti Dahlbom
  * @version $Revision$
  */
 class TextureFactory
 {
+    friend class PaletteLookupBody;
+    friend class TextureDataBody;
+
  public: // Constructors and destructor
     TextureFactory();
 
@@ -59,22 +83,36 @@ class TextureFactory
      * @param pixelData pointer to the texture image's data
      * @param texture will be initialized to hold the texture object. Must
      *                be null when calling this method.
+     * @param layout memory layout for the texture data
      * @return Nova error code or NovaErrNone if successful
      */
     NOVA_IMPORT int CreateTexture( NovaPixelFormat pixelFormat,
 				   int width, int height, 
-				   uint_8* pixelData, Texture*& texture );
+				   uint_8* pixelData, Texture*& texture,
+				   Texture::MemoryLayout layout = 
+				   Texture::ELayoutLinear );
 
  private: // New methods
     void PopulateColorTable( int numPixels, uint_8* data );
     int CountUniqueColors();
-    void SortColorTable( int left, int right );
-    void CreatePalette( NovaPixelFormat pixelFormat, 
-			uint_32* palette, int numColors );
-    void CreateData( NovaPixelFormat pixelFormat, 
-		     uint_8* data, uint_8* originalData,
-		     const uint_32* palette, int numPixels, 
-		     int numColors );
+    int CreatePalette( uint_32* palette, int numUniqueColors );
+    void ShrinkColorBox( ColorBox& box );
+    void SplitColorBox( ColorBox& box, ColorBox& newBox );
+    void CreatePaletteLookup( const uint_32* palette, int numColors );
+
+    /** 
+     * Finds the nearest palette entry for the given range of color table
+     * cells. The ranges can be processed independently of each other.
+     */
+    void MatchColors( int firstCell, int numCells, const int* red, 
+		      const int* green, const int* blue, int numColors );
+
+    /** 
+     * Maps the given rows of the image to the palette. The rows can be 
+     * processed independently of each other.
+     */
+    void CreateData( uint_8* data, uint_8* originalData, int width, 
+		     int firstRow, int numRows );
 
  private: // Data
     // size of color table (max amount of colors in 555 pixel format)
@@ -85,6 +123,10 @@ class TextureFactory
 
     // color frequency table
     ColorTableEntry m_colorTable[ColorTableSize];
+
+    // palette index of the nearest palette (888) color for each
+    // populated color table cell
+    uint_8 m_paletteLookup[ColorTableSize];
 };
 
 }; // namespace
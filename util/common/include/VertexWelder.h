@@ -0,0 +1,92 @@
+/*
+ *  $Id$
+ *
+ *  Nova 3D Engine - A portable object oriented, scene graph based, 
+ *  lightweight real-time 3D software rendering framework. 
+ *  Copyright (C) 2001-2009 Matti Dahlbom
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Contact: Matti Dahlbom <matti at 777-team dot org>
+ */
+
+#ifndef __VERTEXWELDER_H
+#define __VERTEXWELDER_H
+
+#include "NovaTypes.h"
+#include "VectorMath.h"
+
+namespace nova3d {
+
+/**
+ * Welds identical vertices (or normals) together using a hash table keyed 
+ * on the fixed point coordinates, so that each unique vertex is stored 
+ * only once.<p />
+ *
+ * @author Matti Dahlbom
+ * @version $Revision$
+ */
+class VertexWelder
+{
+ public: // Constructors and destructor
+    NOVA_IMPORT VertexWelder();
+    NOVA_IMPORT ~VertexWelder();
+
+ public: // New methods
+    /** 
+     * Adds a vertex, or finds an identical one that was added earlier, 
+     * and returns its index in <code>index</code>.
+     */
+    NOVA_IMPORT int Add( const Vector& vertex, uint_32& index );
+
+    /** Removes all the vertices. */
+    NOVA_IMPORT void Reset();
+
+    /** Returns the number of unique vertices. */
+    inline int Count() const;
+
+    /** Returns the unique vertices, or NULL if there are none. */
+    inline Vector* GetVertices() const;
+
+ private: // New methods
+    int GrowTable();
+
+ private: // Data
+    Vector* m_vertices;
+    int m_numVertices;
+    int m_maxVertices;
+
+    // open addressing hash table of vertex indices + 1; 0 marks a free slot
+    uint_32* m_table;
+    uint_32 m_tableSize;
+};
+
+///////////////////////////////////////////////////
+// inline method definitions
+///////////////////////////////////////////////////
+
+int VertexWelder::Count() const
+{
+    return m_numVertices;
+}
+
+Vector* VertexWelder::GetVertices() const
+{
+    return (m_numVertices > 0) ? m_vertices : NULL;
+}
+
+}; // namespace
+
+#endif
@@ -0,0 +1,332 @@
+/*
+ *  $Id$
+ *
+ *  Nova 3D Engine - A portable object oriented, scene graph based, 
+ *  lightweight real-time 3D software rendering framework. 
+ *  Copyright (C) 2001-2009 Matti Dahlbom
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Contact: Matti Dahlbom <matti at 777-team dot org>
+ */
+
+#include <string.h>
+
+#include "AssetLoader.h"
+#include "NovaErrors.h"
+#include "novalogging.h"
+
+namespace nova3d {
+
+NOVA_EXPORT AssetLoader::AssetLoader()
+{
+}
+
+NOVA_EXPORT AssetLoader::~AssetLoader()
+{
+    Unload();
+}
+
+NOVA_EXPORT void AssetLoader::Unload()
+{
+    // the shapes refer to the textures
+    Shape* shape = NULL;
+    while ( m_shapes.Get( 0, shape ) == NovaErrNone )
+    {
+	delete shape;
+	m_shapes.Remove( 0 );
+    }
+
+    Texture* texture = NULL;
+    while ( m_textures.Get( 0, texture ) == NovaErrNone )
+    {
+	delete texture;
+	m_textures.Remove( 0 );
+    }
+
+    m_file.Close();
+}
+
+NOVA_EXPORT Texture* AssetLoader::GetTexture( int index ) const
+{
+    Texture* texture = NULL;
+    m_textures.Get( index, texture );
+    return texture;
+}
+
+NOVA_EXPORT Shape* AssetLoader::GetShape( int index ) const
+{
+    Shape* shape = NULL;
+    m_shapes.Get( index, shape );
+    return shape;
+}
+
+bool AssetLoader::CheckRange( uint_32 offset, uint_64 size, 
+			      bool optional ) const
+{
+    if ( offset == 0 )
+    {
+	return optional;
+    }
+
+    return ( ((offset & (AssetAlignment - 1)) == 0) && 
+	     ((offset + size) <= m_file.GetSize()) );
+}
+
+bool AssetLoader::CheckIndices( const uint_32* indices, uint_64 count, 
+				uint_32 limit )
+{
+    for ( uint_64 i = 0; i < count; i++ )
+    {
+	if ( indices[i] >= limit )
+	{
+	    return false;
+	}
+    }
+
+    return true;
+}
+
+NOVA_EXPORT int AssetLoader::Load( const char* fileName )
+{
+    Unload();
+
+    int err = m_file.Open( fileName );
+    if ( err != NovaErrNone )
+    {
+	return err;
+    }
+
+    const uint_8* data = m_file.GetData();
+    const AssetFileHeader* header = (const AssetFileHeader*)data;
+    if ( (m_file.GetSize() < sizeof(AssetFileHeader)) || 
+	 (header->m_magic != AssetMagic) || 
+	 (header->m_version != AssetVersion) ||
+	 ((sizeof(AssetFileHeader) + (uint_64)header->m_numChunks * 
+	   sizeof(AssetChunkEntry)) > m_file.GetSize()) )
+    {
+	m_file.Close();
+	return NovaErrInvalidFormat;
+    }
+
+    const AssetChunkEntry* entries = 
+	(const AssetChunkEntry*)(data + sizeof(AssetFileHeader));
+    for ( uint_32 i = 0; (i < header->m_numChunks) && (err == NovaErrNone); 
+	  i++ )
+    {
+	if ( !CheckRange( entries[i].m_offset, entries[i].m_size, false ) )
+	{
+	    err = NovaErrInvalidFormat;
+	}
+	else if ( entries[i].m_type == AssetChunkTexture )
+	{
+	    err = LoadTexture( entries[i] );
+	}
+	else if ( entries[i].m_type == AssetChunkShape )
+	{
+	    err = LoadShape( entries[i] );
+	}
+	// unknown chunk types are skipped
+    }
+
+    if ( err != NovaErrNone )
+    {
+	Unload();
+    }
+
+    LOG_DEBUG_F("AssetLoader::Load(): err = %d, %d textures, %d shapes", 
+		err, m_textures.Count(), m_shapes.Count());
+
+    return err;
+}
+
+int AssetLoader::LoadTexture( const AssetChunkEntry& entry )
+{
+    if ( entry.m_size < sizeof(AssetTextureChunk) )
+    {
+	return NovaErrInvalidFormat;
+    }
+
+    const uint_8* data = m_file.GetData();
+    const AssetTextureChunk* chunk = 
+	(const AssetTextureChunk*)(data + entry.m_offset);
+    if ( !CheckRange( chunk->m_paletteOffset, (uint_64)chunk->m_numPalettes *
+		      Texture::NumPaletteEntries * sizeof(uint_32), false ) ||
+	 !CheckRange( chunk->m_dataOffset, chunk->m_dataSize, false ) )
+    {
+	return NovaErrInvalidFormat;
+    }
+
+    Texture* texture = new Texture();
+    if ( texture == NULL )
+    {
+	return NovaErrNoMemory;
+    }
+
+    int err = texture->CreateFromExternalData( 
+	(NovaPixelFormat)chunk->m_pixelFormat, 
+	chunk->m_width, chunk->m_height, 
+	(Texture::MemoryLayout)chunk->m_layout, 
+	(Texture::LightingMode)chunk->m_lightingMode, 
+	chunk->m_numPalettes, 
+	(const uint_32*)(data + chunk->m_paletteOffset), 
+	chunk->m_numMipLevels, 
+	data + chunk->m_dataOffset, chunk->m_dataSize );
+
+    if ( err == NovaErrNone )
+    {
+	err = m_textures.Append( texture );
+    }
+
+    if ( err != NovaErrNone )
+    {
+	delete texture;
+    }
+
+    return err;
+}
+
+int AssetLoader::LoadShape( const AssetChunkEntry& entry )
+{
+    if ( entry.m_size < sizeof(AssetShapeChunk) )
+    {
+	return NovaErrInvalidFormat;
+    }
+
+    const uint_8* data = m_file.GetData();
+    const AssetShapeChunk* chunk = 
+	(const AssetShapeChunk*)(data + entry.m_offset);
+    uint_64 numPolygons = chunk->m_numPolygons;
+    bool hasNormals = (chunk->m_vertexNormalsOffset != 0);
+
+    if ( !CheckRange( chunk->m_coordinatesOffset, 
+		      chunk->m_numCoordinates * (uint_64)sizeof(Vector), 
+		      false ) ||
+	 !CheckRange( chunk->m_verticesOffset, 
+		      numPolygons * 3 * sizeof(uint_32), false ) ||
+	 !CheckRange( chunk->m_planeEquationsOffset, 
+		      numPolygons * sizeof(PlaneEquation), false ) ||
+	 !CheckRange( chunk->m_polygonInfosOffset, 
+		      numPolygons * sizeof(uint_32), true ) ||
+	 !CheckRange( chunk->m_vertexColorsOffset, 
+		      numPolygons * 3 * sizeof(uint_32), true ) ||
+	 !CheckRange( chunk->m_textureCoordinatesOffset, 
+		      numPolygons * 6 * sizeof(int_32), true ) ||
+	 !CheckRange( chunk->m_vertexNormalsOffset, 
+		      chunk->m_numVertexNormals * (uint_64)sizeof(Vector), 
+		      true ) ||
+	 !CheckRange( chunk->m_vertexNormalIndicesOffset, 
+		      numPolygons * 3 * sizeof(uint_32), !hasNormals ) ||
+	 !CheckRange( chunk->m_textureIndicesOffset, 
+		      numPolygons * sizeof(int_32), true ) ||
+	 !CheckRange( chunk->m_lightingIntensitiesOffset, 
+		      numPolygons * 3 * sizeof(int_32), true ) )
+    {
+	return NovaErrInvalidFormat;
+    }
+
+    // the shape trusts its indices, so every one of them must be in range.
+    // the index arrays were checked above to hold 3 indices per polygon, 
+    // and the shape counts the indices with an int
+    if ( (numPolygons > (uint_64)(MaxInt32 / 3)) || 
+	 (chunk->m_numCoordinates > (uint_32)MaxInt32) || 
+	 (chunk->m_numVertexNormals > (uint_32)MaxInt32) || 
+	 !CheckIndices( (const uint_32*)(data + chunk->m_verticesOffset), 
+			numPolygons * 3, chunk->m_numCoordinates ) || 
+	 (hasNormals && 
+	  !CheckIndices( 
+	      (const uint_32*)(data + chunk->m_vertexNormalIndicesOffset), 
+	      numPolygons * 3, chunk->m_numVertexNormals )) )
+    {
+	return NovaErrInvalidFormat;
+    }
+
+    ShapeData shapeData;
+    shapeData.m_numCoordinates = chunk->m_numCoordinates;
+    shapeData.m_numPolygons = chunk->m_numPolygons;
+    shapeData.m_numVertexNormals = hasNormals ? chunk->m_numVertexNormals : 0;
+    shapeData.m_isIlluminated = 
+	((chunk->m_flags & AssetShapeIlluminated) != 0);
+    shapeData.m_boundingSphere.m_location.SetFixed( 
+	chunk->m_boundingSphere[0], chunk->m_boundingSphere[1], 
+	chunk->m_boundingSphere[2] );
+    shapeData.m_boundingSphere.m_radius = chunk->m_boundingSphere[3];
+    shapeData.m_boundingBox.m_min.SetFixed( chunk->m_boundingBox[0], 
+					    chunk->m_boundingBox[1], 
+					    chunk->m_boundingBox[2] );
+    shapeData.m_boundingBox.m_max.SetFixed( chunk->m_boundingBox[3], 
+					    chunk->m_boundingBox[4], 
+					    chunk->m_boundingBox[5] );
+
+#define ASSET_ARRAY(type, offset) \
+    ((offset) != 0) ? (const type*)(data + (offset)) : NULL
+
+    shapeData.m_coordinates = 
+	ASSET_ARRAY( Vector, chunk->m_coordinatesOffset );
+    shapeData.m_vertices = ASSET_ARRAY( uint_32, chunk->m_verticesOffset );
+    shapeData.m_planeEquations = 
+	ASSET_ARRAY( PlaneEquation, chunk->m_planeEquationsOffset );
+    shapeData.m_polygonInfos = 
+	ASSET_ARRAY( uint_32, chunk->m_polygonInfosOffset );
+    shapeData.m_vertexColors = 
+	ASSET_ARRAY( uint_32, chunk->m_vertexColorsOffset );
+    shapeData.m_textureCoordinates = 
+	ASSET_ARRAY( int_32, chunk->m_textureCoordinatesOffset );
+    shapeData.m_vertexNormals = 
+	ASSET_ARRAY( Vector, chunk->m_vertexNormalsOffset );
+    shapeData.m_vertexNormalIndices = 
+	ASSET_ARRAY( uint_32, chunk->m_vertexNormalIndicesOffset );
+    const int_32* textureIndices = 
+	ASSET_ARRAY( int_32, chunk->m_textureIndicesOffset );
+    shapeData.m_lightingIntensities = 
+	((chunk->m_flags & AssetShapePrelit) != 0) ? 
+	ASSET_ARRAY( int_32, chunk->m_lightingIntensitiesOffset ) : NULL;
+
+#undef ASSET_ARRAY
+
+    Shape* shape = new Shape( (NovaPixelFormat)chunk->m_pixelFormat );
+    if ( shape == NULL )
+    {
+	return NovaErrNoMemory;
+    }
+
+    int err = shape->CreateFromExternalData( shapeData );
+
+    // the textures are referred to by their index in the file
+    for ( uint_32 i = 0; (textureIndices != NULL) && 
+	      (i < chunk->m_numPolygons) && (err == NovaErrNone); i++ )
+    {
+	if ( textureIndices[i] >= 0 )
+	{
+	    Texture* texture = GetTexture( textureIndices[i] );
+	    err = (texture != NULL) ? 
+		shape->SetTexture( i, texture ) : NovaErrInvalidFormat;
+	}
+    }
+
+    if ( err == NovaErrNone )
+    {
+	err = m_shapes.Append( shape );
+    }
+
+    if ( err != NovaErrNone )
+    {
+	delete shape;
+    }
+
+    return err;
+}
+
+}; // namespace
@@ -0,0 +1,375 @@
+/*
+ *  $Id$
+ *
+ *  Nova 3D Engine - A portable object oriented, scene graph based, 
+ *  lightweight real-time 3D software rendering framework. 
+ *  Copyright (C) 2001-2009 Matti Dahlbom
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Contact: Matti Dahlbom <matti at 777-team dot org>
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "AssetWriter.h"
+#include "AssetFormat.h"
+#include "NovaErrors.h"
+#include "novalogging.h"
+
+namespace nova3d {
+
+// the array types are stored as is; make sure they have the expected size
+typedef char AssetVectorSizeCheck[(sizeof(Vector) == 12) ? 1 : -1];
+typedef char AssetPlaneSizeCheck[(sizeof(PlaneEquation) == 16) ? 1 : -1];
+
+NOVA_EXPORT AssetWriter::AssetWriter()
+    : m_buffer( NULL ),
+      m_size( 0 ),
+      m_maxSize( 0 )
+{
+}
+
+NOVA_EXPORT AssetWriter::~AssetWriter()
+{
+    free( m_buffer );
+}
+
+NOVA_EXPORT int AssetWriter::AddTexture( const Texture* texture )
+{
+    if ( (texture == NULL) || (texture->GetData() == NULL) )
+    {
+	return NovaErrInvalidArgument;
+    }
+
+    return m_textures.Append( texture );
+}
+
+NOVA_EXPORT int AssetWriter::AddShape( const Shape* shape )
+{
+    if ( shape == NULL )
+    {
+	return NovaErrInvalidArgument;
+    }
+
+    // all the textures must be known so that they can be referred to
+    Texture** textures = shape->GetTextures();
+    if ( textures != NULL )
+    {
+	for ( int i = 0; i < shape->GetNumPolygons(); i++ )
+	{
+	    if ( (textures[i] != NULL) && (FindTexture( textures[i] ) < 0) )
+	    {
+		return NovaErrNotFound;
+	    }
+	}
+    }
+
+    return m_shapes.Append( shape );
+}
+
+int AssetWriter::FindTexture( const Texture* texture ) const
+{
+    for ( int i = 0; i < m_textures.Count(); i++ )
+    {
+	const Texture* t;
+	if ( (m_textures.Get( i, t ) == NovaErrNone) && (t == texture) )
+	{
+	    return i;
+	}
+    }
+
+    return -1;
+}
+
+int AssetWriter::Append( const void* data, uint_32 size )
+{
+    if ( (m_size + size) > m_maxSize )
+    {
+	// grow geometrically
+	uint_32 maxSize = MAX( (m_maxSize * 2), (m_size + size) );
+	void* p = realloc( m_buffer, maxSize );
+	if ( p == NULL )
+	{
+	    return NovaErrNoMemory;
+	}
+	m_buffer = (uint_8*)p;
+	m_maxSize = maxSize;
+    }
+
+    if ( data != NULL )
+    {
+	memcpy( m_buffer + m_size, data, size );
+    }
+    else
+    {
+	memset( m_buffer + m_size, 0, size );
+    }
+    m_size += size;
+
+    return NovaErrNone;
+}
+
+int AssetWriter::Pad()
+{
+    return Append( NULL, AssetAlign( m_size ) - m_size );
+}
+
+int AssetWriter::WriteTexture( const Texture& texture )
+{
+    AssetTextureChunk chunk;
+    memset( &chunk, 0, sizeof(chunk) );
+    chunk.m_pixelFormat = texture.GetPixelFormat();
+    chunk.m_width = texture.GetWidth();
+    chunk.m_height = texture.GetHeight();
+    chunk.m_layout = texture.GetMemoryLayout();
+    chunk.m_lightingMode = texture.GetLightingMode();
+    chunk.m_numPalettes = texture.GetNumPalettes();
+    chunk.m_numMipLevels = texture.GetNumMipLevels();
+
+    // the header is filled in once the offsets are known
+    uint_32 chunkOffset = m_size;
+    int err = Append( NULL, sizeof(chunk) );
+
+    if ( err == NovaErrNone )
+    {
+	err = Pad();
+	chunk.m_paletteOffset = m_size;
+    }
+    if ( err == NovaErrNone )
+    {
+	err = Append( texture.GetPalette(), chunk.m_numPalettes * 
+		      Texture::NumPaletteEntries * sizeof(uint_32) );
+    }
+    if ( err == NovaErrNone )
+    {
+	err = Pad();
+	chunk.m_dataOffset = m_size;
+    }
+
+    for ( int i = 0; (i < texture.GetNumMipLevels()) && (err == NovaErrNone); 
+	  i++ )
+    {
+	const Texture::MipLevel& level = texture.GetMipLevel( i );
+	err = Append( level.m_data, level.m_width * level.m_height );
+    }
+
+    if ( err == NovaErrNone )
+    {
+	chunk.m_dataSize = m_size - chunk.m_dataOffset;
+	memcpy( m_buffer + chunkOffset, &chunk, sizeof(chunk) );
+	err = Pad();
+    }
+
+    return err;
+}
+
+int AssetWriter::WriteShape( const Shape& shape )
+{
+    int_32 numPolygons = shape.GetNumPolygons();
+    int_32 numNormals = 0;
+    const Vector* normals = shape.GetVertexNormals( numNormals );
+    int_32 numCoordinates = 0;
+    const Vector* coordinates = shape.GetCoords( numCoordinates );
+
+    AssetShapeChunk chunk;
+    memset( &chunk, 0, sizeof(chunk) );
+    chunk.m_pixelFormat = shape.GetPixelFormat();
+    chunk.m_flags = shape.IsIlluminated() ? AssetShapeIlluminated : 0;
+    if ( shape.IsPrelit() )
+    {
+	chunk.m_flags |= AssetShapePrelit;
+    }
+    chunk.m_numCoordinates = numCoordinates;
+    chunk.m_numPolygons = numPolygons;
+    chunk.m_numVertexNormals = (normals != NULL) ? numNormals : 0;
+    const BoundingSphere& sphere = shape.GetBoundingSphere();
+    const BoundingBox& box = shape.GetBoundingBox();
+    sphere.m_location.GetFixed( chunk.m_boundingSphere[0], 
+				chunk.m_boundingSphere[1], 
+				chunk.m_boundingSphere[2] );
+    chunk.m_boundingSphere[3] = sphere.m_radius;
+    box.m_min.GetFixed( chunk.m_boundingBox[0], chunk.m_boundingBox[1], 
+			chunk.m_boundingBox[2] );
+    box.m_max.GetFixed( chunk.m_boundingBox[3], chunk.m_boundingBox[4], 
+			chunk.m_boundingBox[5] );
+
+    // the header is filled in once the offsets are known
+    uint_32 chunkOffset = m_size;
+    int err = Append( NULL, sizeof(chunk) );
+
+    // polygon infos without the per-frame visibility
+    uint_32* polygonInfos = 
+	(uint_32*)malloc( numPolygons * sizeof(uint_32) );
+    int_32* textureIndices = (int_32*)malloc( numPolygons * sizeof(int_32) );
+    if ( (polygonInfos == NULL) || (textureIndices == NULL) )
+    {
+	err = NovaErrNoMemory;
+    }
+    else
+    {
+	Texture** textures = shape.GetTextures();
+	for ( int i = 0; i < numPolygons; i++ )
+	{
+	    polygonInfos[i] = shape.GetPolygonInfo()[i] & ~PolygonInfoVisible;
+	    textureIndices[i] = 
+		(textures != NULL) ? FindTexture( textures[i] ) : -1;
+	}
+    }
+
+    // arrays and their offsets in the chunk header
+    const void* arrays[] = 
+	{
+	    coordinates,
+	    shape.GetPolygons( numPolygons ),
+	    shape.GetPlaneEquations(),
+	    polygonInfos,
+	    shape.GetVertexColors(),
+	    shape.GetTextureCoordinates(),
+	    normals,
+	    (normals != NULL) ? shape.GetVertexNormalIndices() : NULL,
+	    textureIndices,
+	    shape.IsPrelit() ? shape.GetLightingIntensities() : NULL
+	};
+    size_t sizes[] = 
+	{
+	    chunk.m_numCoordinates * sizeof(Vector),
+	    numPolygons * 3 * sizeof(uint_32),
+	    numPolygons * sizeof(PlaneEquation),
+	    numPolygons * sizeof(uint_32),
+	    numPolygons * 3 * sizeof(uint_32),
+	    numPolygons * 6 * sizeof(int_32),
+	    chunk.m_numVertexNormals * sizeof(Vector),
+	    numPolygons * 3 * sizeof(uint_32),
+	    numPolygons * sizeof(int_32),
+	    numPolygons * 3 * sizeof(int_32)
+	};
+    uint_32* offsets[] = 
+	{
+	    &chunk.m_coordinatesOffset,
+	    &chunk.m_verticesOffset,
+	    &chunk.m_planeEquationsOffset,
+	    &chunk.m_polygonInfosOffset,
+	    &chunk.m_vertexColorsOffset,
+	    &chunk.m_textureCoordinatesOffset,
+	    &chunk.m_vertexNormalsOffset,
+	    &chunk.m_vertexNormalIndicesOffset,
+	    &chunk.m_textureIndicesOffset,
+	    &chunk.m_lightingIntensitiesOffset
+	};
+
+    for ( uint_32 i = 0; 
+	  (i < sizeof(arrays) / sizeof(arrays[0])) && (err == NovaErrNone); 
+	  i++ )
+    {
+	if ( arrays[i] == NULL )
+	{
+	    // optional array not present
+	    continue;
+	}
+
+	err = Pad();
+	if ( err == NovaErrNone )
+	{
+	    *offsets[i] = m_size;
+	    err = Append( arrays[i], sizes[i] );
+	}
+    }
+
+    free( polygonInfos );
+    free( textureIndices );
+
+    if ( err == NovaErrNone )
+    {
+	memcpy( m_buffer + chunkOffset, &chunk, sizeof(chunk) );
+	err = Pad();
+    }
+
+    return err;
+}
+
+NOVA_EXPORT int AssetWriter::Write( const char* fileName )
+{
+    LOG_DEBUG_F("AssetWriter::Write(): %d textures, %d shapes", 
+		m_textures.Count(), m_shapes.Count());
+
+    m_size = 0;
+
+    AssetFileHeader header;
+    memset( &header, 0, sizeof(header) );
+    header.m_magic = AssetMagic;
+    header.m_version = AssetVersion;
+    header.m_numChunks = m_textures.Count() + m_shapes.Count();
+
+    // the directory is filled in as the chunks are written
+    int err = Append( &header, sizeof(header) );
+    if ( err == NovaErrNone )
+    {
+	err = Append( NULL, header.m_numChunks * sizeof(AssetChunkEntry) );
+    }
+    if ( err == NovaErrNone )
+    {
+	err = Pad();
+    }
+
+    // textures first so that the shapes can refer to them when loading
+    for ( uint_32 i = 0; (i < header.m_numChunks) && (err == NovaErrNone); 
+	  i++ )
+    {
+	AssetChunkEntry entry;
+	memset( &entry, 0, sizeof(entry) );
+	entry.m_offset = m_size;
+
+	int numTextures = m_textures.Count();
+	if ( (int)i < numTextures )
+	{
+	    const Texture* texture = NULL;
+	    m_textures.Get( i, texture );
+	    entry.m_type = AssetChunkTexture;
+	    err = WriteTexture( *texture );
+	}
+	else
+	{
+	    const Shape* shape = NULL;
+	    m_shapes.Get( i - numTextures, shape );
+	    entry.m_type = AssetChunkShape;
+	    err = WriteShape( *shape );
+	}
+
+	entry.m_size = m_size - entry.m_offset;
+	memcpy( m_buffer + sizeof(header) + i * sizeof(entry), 
+		&entry, sizeof(entry) );
+    }
+
+    if ( err != NovaErrNone )
+    {
+	return err;
+    }
+
+    FILE* file = fopen( fileName, "wb" );
+    if ( file == NULL )
+    {
+	return NovaErrNotFound;
+    }
+
+    size_t written = fwrite( m_buffer, 1, m_size, file );
+    fclose( file );
+
+    return (written == m_size) ? NovaErrNone : NovaErrUnderrun;
+}
+
+}; // namespace
@@ -0,0 +1,1312 @@
+/*
+ *  $Id$
+ *
+ *  Nova 3D Engine - A portable object oriented, scene graph based, 
+ *  lightweight real-time 3D software rendering framework. 
+ *  Copyright (C) 2001-2009 Matti Dahlbom
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Contact: Matti Dahlbom <matti at 777-team dot org>
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "MeshImporter.h"
+#include "Shape.h"
+#include "FixedPoint.h"
+#include "NovaErrors.h"
+#include "novalogging.h"
+
+namespace nova3d {
+
+// size of the file read buffer
+const uint_32 ImportBufferSize = 65536;
+
+// max number of vertices in a single polygon of the file
+const int MaxPolygonCorners = 1024;
+
+// max number of elements and properties per element in a PLY file
+const int MaxPlyElements = 8;
+const int MaxPlyProperties = 32;
+
+// indices of a polygon corner into the per-file attribute lists
+const int CornerPosition = 0;
+const int CornerTextureCoordinate = 1;
+const int CornerNormal = 2;
+
+/**
+ * Reads a file through a fixed size buffer, either line by line or as 
+ * binary data.<p />
+ */
+class StreamReader
+{
+ public: // Constructors and destructor
+    StreamReader();
+    ~StreamReader();
+
+ public: // New methods
+    int Open( const char* fileName );
+
+    /** 
+     * Returns the next line, NUL terminated and without the line feed. 
+     * Returns NovaErrUnderrun at the end of the file.
+     */
+    int ReadLine( char*& line );
+
+    /** Reads the given amount of binary data. */
+    int Read( void* data, uint_32 size );
+
+ private: // New methods
+    void Fill();
+
+ private: // Data
+    FILE* m_file;
+    char* m_buffer;
+    uint_32 m_position;
+    uint_32 m_end;
+};
+
+StreamReader::StreamReader()
+    : m_file( NULL ),
+      m_buffer( NULL ),
+      m_position( 0 ),
+      m_end( 0 )
+{
+}
+
+StreamReader::~StreamReader()
+{
+    if ( m_file != NULL )
+    {
+	fclose( m_file );
+    }
+    free( m_buffer );
+}
+
+int StreamReader::Open( const char* fileName )
+{
+    // room for the NUL terminator of the last line
+    m_buffer = (char*)malloc( ImportBufferSize + 1 );
+    if ( m_buffer == NULL )
+    {
+	return NovaErrNoMemory;
+    }
+
+    m_file = fopen( fileName, "rb" );
+    return (m_file != NULL) ? NovaErrNone : NovaErrNotFound;
+}
+
+void StreamReader::Fill()
+{
+    // move the unread data to the start of the buffer and fill the rest
+    uint_32 remaining = m_end - m_position;
+    memmove( m_buffer, m_buffer + m_position, remaining );
+    m_position = 0;
+    m_end = remaining + 
+	fread( m_buffer + remaining, 1, ImportBufferSize - remaining, m_file );
+}
+
+int StreamReader::ReadLine( char*& line )
+{
+    char* start = m_buffer + m_position;
+    char* end = (char*)memchr( start, '\n', m_end - m_position );
+    if ( end == NULL )
+    {
+	Fill();
+	start = m_buffer;
+	end = (char*)memchr( start, '\n', m_end );
+	if ( end == NULL )
+	{
+	    if ( m_end == ImportBufferSize )
+	    {
+		// the line does not fit in the buffer
+		return NovaErrOverflow;
+	    }
+	    if ( m_end == 0 )
+	    {
+		return NovaErrUnderrun;
+	    }
+
+	    // last line without a line feed
+	    end = m_buffer + m_end;
+	}
+    }
+
+    m_position = (end - m_buffer) + 1;
+    if ( m_position > m_end )
+    {
+	m_position = m_end;
+    }
+
+    // terminate, removing a possible carriage return
+    if ( (end > start) && (*(end - 1) == '\r') )
+    {
+	end--;
+    }
+    *end = '\0';
+    line = start;
+
+    return NovaErrNone;
+}
+
+int StreamReader::Read( void* data, uint_32 size )
+{
+    uint_8* dst = (uint_8*)data;
+    while ( size > 0 )
+    {
+	if ( m_position == m_end )
+	{
+	    Fill();
+	    if ( m_end == 0 )
+	    {
+		return NovaErrUnderrun;
+	    }
+	}
+
+	uint_32 count = MIN( size, (m_end - m_position) );
+	memcpy( dst, m_buffer + m_position, count );
+	m_position += count;
+	dst += count;
+	size -= count;
+    }
+
+    return NovaErrNone;
+}
+
+// skips spaces and tabs
+inline const char* SkipSpaces( const char* p )
+{
+    while ( (*p == ' ') || (*p == '\t') )
+    {
+	p++;
+    }
+    return p;
+}
+
+// parses an integer; returns NULL if there is none
+const char* ParseInt( const char* p, int_32& value )
+{
+    p = SkipSpaces( p );
+    bool negative = (*p == '-');
+    if ( (*p == '-') || (*p == '+') )
+    {
+	p++;
+    }
+
+    const char* start = p;
+    int_32 result = 0;
+    while ( (*p >= '0') && (*p <= '9') )
+    {
+	result = result * 10 + (*p++ - '0');
+    }
+    if ( p == start )
+    {
+	return NULL;
+    }
+
+    value = negative ? -result : result;
+    return p;
+}
+
+// parses a real number; returns NULL if there is none. considerably 
+// faster than strtod() which matters with large files.
+const char* ParseReal( const char* p, real_64& value )
+{
+    static const real_64 powersOf10[] = 
+	{ 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 
+	  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18 };
+    const int numPowers = sizeof(powersOf10) / sizeof(powersOf10[0]);
+
+    p = SkipSpaces( p );
+    bool negative = (*p == '-');
+    if ( (*p == '-') || (*p == '+') )
+    {
+	p++;
+    }
+
+    // collect up to 18 significant digits into an integer mantissa
+    uint_64 mantissa = 0;
+    int numDigits = 0;
+    int exponent = 0;
+    const char* start = p;
+    while ( (*p >= '0') && (*p <= '9') )
+    {
+	if ( numDigits < 18 )
+	{
+	    mantissa = mantissa * 10 + (*p - '0');
+	    numDigits += (mantissa != 0) ? 1 : 0;
+	}
+	else
+	{
+	    exponent++;
+	}
+	p++;
+    }
+    if ( *p == '.' )
+    {
+	p++;
+	while ( (*p >= '0') && (*p <= '9') )
+	{
+	    if ( numDigits < 18 )
+	    {
+		mantissa = mantissa * 10 + (*p - '0');
+		numDigits += (mantissa != 0) ? 1 : 0;
+		exponent--;
+	    }
+	    p++;
+	}
+    }
+    if ( (p == start) || ((p == (start + 1)) && (*start == '.')) )
+    {
+	return NULL;
+    }
+
+    if ( (*p == 'e') || (*p == 'E') )
+    {
+	int_32 e;
+	const char* q = ParseInt( p + 1, e );
+	if ( q != NULL )
+	{
+	    exponent += e;
+	    p = q;
+	}
+    }
+
+    real_64 result = (real_64)mantissa;
+    if ( exponent != 0 )
+    {
+	int absExponent = (exponent < 0) ? -exponent : exponent;
+	real_64 scale = (absExponent < numPowers) ? 
+	    powersOf10[absExponent] : pow( 10.0, absExponent );
+	result = (exponent < 0) ? (result / scale) : (result * scale);
+    }
+
+    value = negative ? -result : result;
+    return p;
+}
+
+// checks whether the line starts with the given keyword 
+inline bool IsKeyword( const char* line, const char* keyword, int length )
+{
+    return ( (strncmp( line, keyword, length ) == 0) && 
+	     ((line[length] == ' ') || (line[length] == '\t')) );
+}
+
+// resolves a 1-based, possibly negative (relative) OBJ index into a 
+// 0-based index; returns -1 if out of range
+inline int_32 ResolveObjIndex( int_32 index, int count )
+{
+    if ( index > 0 ) 
+    {
+	index--;
+    }
+    else
+    {
+	index += count;
+    }
+
+    return ((index >= 0) && (index < count)) ? index : -1;
+}
+
+// creates a color in the given pixel format out of [0,1] components. the
+// PIXEL_xxx macros mask the components instead of scaling them, so the 
+// color is created in 888 and converted.
+inline uint_32 ImportColor( NovaPixelFormat pixelFormat, 
+			    real_64 red, real_64 green, real_64 blue )
+{
+    real_64 components[3] = { red, green, blue };
+    int values[3];
+    for ( int i = 0; i < 3; i++ )
+    {
+	real_64 c = components[i] * 255.0 + 0.5;
+	values[i] = (c <= 0.0) ? 0 : ((c >= 255.0) ? 255 : (int)c);
+    }
+
+    return nova3d::ConvertColor( PIXEL_888( values[0], values[1], values[2] ),
+				 PixelFormat888, pixelFormat );
+}
+
+///////////////////////////////////////////////////
+// MeshImporter
+///////////////////////////////////////////////////
+
+NOVA_EXPORT MeshImporter::MeshImporter()
+    : m_scale( 1.0 ),
+      m_textureWidth( 256 ),
+      m_textureHeight( 256 ),
+      m_positionRemap( ImportListGranularity ),
+      m_sourceColors( ImportListGranularity ),
+      m_sourceTextureCoordinates( ImportListGranularity ),
+      m_normalRemap( ImportListGranularity ),
+      m_vertices( ImportListGranularity ),
+      m_vertexColors( ImportListGranularity ),
+      m_textureCoordinates( ImportListGranularity ),
+      m_normalIndices( ImportListGranularity ),
+      m_hasTextureCoordinates( false ),
+      m_missingNormals( false )
+{
+}
+
+NOVA_EXPORT MeshImporter::~MeshImporter()
+{
+}
+
+void MeshImporter::Reset()
+{
+    m_positions.Reset();
+    m_normals.Reset();
+    m_positionRemap.Reset();
+    m_sourceColors.Reset();
+    m_sourceTextureCoordinates.Reset();
+    m_normalRemap.Reset();
+    m_vertices.Reset();
+    m_vertexColors.Reset();
+    m_textureCoordinates.Reset();
+    m_normalIndices.Reset();
+    m_hasTextureCoordinates = false;
+    m_missingNormals = false;
+}
+
+NOVA_EXPORT int MeshImporter::CreateShape( NovaPixelFormat pixelFormat, 
+					   const char* fileName, 
+					   Shape*& shape )
+{
+    const char* extension = strrchr( fileName, '.' );
+    if ( extension != NULL )
+    {
+	if ( (strcmp( extension, ".obj" ) == 0) || 
+	     (strcmp( extension, ".OBJ" ) == 0) )
+	{
+	    return CreateShapeFromObj( pixelFormat, fileName, shape );
+	}
+	if ( (strcmp( extension, ".ply" ) == 0) || 
+	     (strcmp( extension, ".PLY" ) == 0) )
+	{
+	    return CreateShapeFromPly( pixelFormat, fileName, shape );
+	}
+    }
+
+    return NovaErrInvalidArgument;
+}
+
+NOVA_EXPORT int MeshImporter::CreateShapeFromObj( NovaPixelFormat pixelFormat,
+						  const char* fileName, 
+						  Shape*& shape )
+{
+    StreamReader reader;
+    int err = reader.Open( fileName );
+    if ( err == NovaErrNone )
+    {
+	Reset();
+	err = ParseObj( pixelFormat, reader );
+    }
+    if ( err == NovaErrNone )
+    {
+	err = BuildShape( pixelFormat, shape );
+    }
+
+    LOG_DEBUG_F("MeshImporter::CreateShapeFromObj() err = %d", err);
+
+    return err;
+}
+
+NOVA_EXPORT int MeshImporter::CreateShapeFromPly( NovaPixelFormat pixelFormat,
+						  const char* fileName, 
+						  Shape*& shape )
+{
+    StreamReader reader;
+    int err = reader.Open( fileName );
+    if ( err == NovaErrNone )
+    {
+	Reset();
+	err = ParsePly( pixelFormat, reader );
+    }
+    if ( err == NovaErrNone )
+    {
+	err = BuildShape( pixelFormat, shape );
+    }
+
+    LOG_DEBUG_F("MeshImporter::CreateShapeFromPly() err = %d", err);
+
+    return err;
+}
+
+int MeshImporter::AddPosition( real_64 x, real_64 y, real_64 z, 
+			       uint_32 color )
+{
+    Vector position;
+    position.SetFixed( ::RealToFixed( x * m_scale ), 
+		       ::RealToFixed( y * m_scale ), 
+		       ::RealToFixed( z * m_scale ) );
+
+    uint_32 index;
+    int err = m_positions.Add( position, index );
+    if ( err == NovaErrNone )
+    {
+	err = m_positionRemap.Append( index );
+    }
+    if ( err == NovaErrNone )
+    {
+	err = m_sourceColors.Append( color );
+    }
+
+    return err;
+}
+
+int MeshImporter::AddNormal( real_64 x, real_64 y, real_64 z )
+{
+    // the normals are stored normalized
+    real_64 length = sqrt( x * x + y * y + z * z );
+    if ( length > 0.0 )
+    {
+	x /= length;
+	y /= length;
+	z /= length;
+    }
+
+    Vector normal;
+    normal.SetFixed( ::RealToFixed( x ), ::RealToFixed( y ), 
+		     ::RealToFixed( z ) );
+
+    uint_32 index;
+    int err = m_normals.Add( normal, index );
+    if ( err == NovaErrNone )
+    {
+	err = m_normalRemap.Append( index );
+    }
+
+    return err;
+}
+
+int MeshImporter::AddTextureCoordinate( real_64 u, real_64 v )
+{
+    // the v axis points up in the files but down in the textures
+    int_32 tu = (int_32)(u * m_textureWidth);
+    int_32 tv = (int_32)((1.0 - v) * m_textureHeight);
+
+    int err = m_sourceTextureCoordinates.Append( tu );
+    if ( err == NovaErrNone )
+    {
+	err = m_sourceTextureCoordinates.Append( tv );
+    }
+
+    return err;
+}
+
+int MeshImporter::AddTriangle( const int_32* corner0, const int_32* corner1, 
+			       const int_32* corner2 )
+{
+    const int_32* corners[3] = { corner0, corner1, corner2 };
+
+    int err = NovaErrNone;
+    for ( int i = 0; (i < 3) && (err == NovaErrNone); i++ )
+    {
+	const int_32* corner = corners[i];
+
+	uint_32 vertex = 0;
+	uint_32 color = 0;
+	m_positionRemap.Get( corner[CornerPosition], vertex );
+	m_sourceColors.Get( corner[CornerPosition], color );
+	err = m_vertices.Append( vertex );
+	if ( err == NovaErrNone )
+	{
+	    err = m_vertexColors.Append( color );
+	}
+
+	int_32 u = 0;
+	int_32 v = 0;
+	if ( corner[CornerTextureCoordinate] >= 0 )
+	{
+	    m_sourceTextureCoordinates.Get( 
+		corner[CornerTextureCoordinate] * 2, u );
+	    m_sourceTextureCoordinates.Get( 
+		corner[CornerTextureCoordinate] * 2 + 1, v );
+	    m_hasTextureCoordinates = true;
+	}
+	if ( err == NovaErrNone )
+	{
+	    err = m_textureCoordinates.Append( u );
+	}
+	if ( err == NovaErrNone )
+	{
+	    err = m_textureCoordinates.Append( v );
+	}
+
+	uint_32 normalIndex = 0;
+	if ( corner[CornerNormal] >= 0 )
+	{
+	    m_normalRemap.Get( corner[CornerNormal], normalIndex );
+	}
+	else
+	{
+	    m_missingNormals = true;
+	}
+	if ( err == NovaErrNone )
+	{
+	    err = m_normalIndices.Append( normalIndex );
+	}
+    }
+
+    return err;
+}
+
+int MeshImporter::ParseObj( NovaPixelFormat pixelFormat, 
+			    StreamReader& reader )
+{
+    uint_32 white = ImportColor( pixelFormat, 1.0, 1.0, 1.0 );
+
+    int err = NovaErrNone;
+    char* line;
+    while ( (err == NovaErrNone) && 
+	    ((err = reader.ReadLine( line )) == NovaErrNone) )
+    {
+	const char* p = SkipSpaces( line );
+
+	if ( IsKeyword( p, "v", 1 ) )
+	{
+	    // coordinate, optionally followed by a color
+	    real_64 c[6];
+	    int n = 0;
+	    for ( p++; n < 6; n++ )
+	    {
+		p = ParseReal( p, c[n] );
+		if ( p == NULL )
+		{
+		    break;
+		}
+	    }
+	    if ( n < 3 )
+	    {
+		err = NovaErrInvalidFormat;
+	    }
+	    else
+	    {
+		uint_32 color = (n == 6) ? 
+		    ImportColor( pixelFormat, c[3], c[4], c[5] ) : white;
+		err = AddPosition( c[0], c[1], c[2], color );
+	    }
+	}
+	else if ( IsKeyword( p, "vt", 2 ) )
+	{
+	    real_64 u, v = 0.0;
+	    p = ParseReal( p + 2, u );
+	    if ( p == NULL )
+	    {
+		err = NovaErrInvalidFormat;
+	    }
+	    else
+	    {
+		ParseReal( p, v );
+		err = AddTextureCoordinate( u, v );
+	    }
+	}
+	else if ( IsKeyword( p, "vn", 2 ) )
+	{
+	    real_64 x, y, z;
+	    if ( ((p = ParseReal( p + 2, x )) == NULL) || 
+		 ((p = ParseReal( p, y )) == NULL) || 
+		 ((p = ParseReal( p, z )) == NULL) )
+	    {
+		err = NovaErrInvalidFormat;
+	    }
+	    else
+	    {
+		err = AddNormal( x, y, z );
+	    }
+	}
+	else if ( IsKeyword( p, "f", 1 ) )
+	{
+	    err = ParseObjFace( p + 1 );
+	}
+	// the other statements (groups, materials etc.) are ignored
+    }
+
+    return (err == NovaErrUnderrun) ? NovaErrNone : err;
+}
+
+int MeshImporter::ParseObjFace( const char* line )
+{
+    int numPositions = m_positionRemap.Count();
+    int numTextureCoordinates = m_sourceTextureCoordinates.Count() / 2;
+    int numNormals = m_normalRemap.Count();
+
+    // the polygon is split into a fan around its first corner
+    int_32 first[3];
+    int_32 previous[3];
+    int_32 corner[3];
+    int numCorners = 0;
+
+    const char* p = line;
+    int err = NovaErrNone;
+    while ( err == NovaErrNone )
+    {
+	// corner is of the form v, v/vt, v//vn or v/vt/vn
+	int_32 index;
+	p = ParseInt( p, index );
+	if ( p == NULL )
+	{
+	    break;
+	}
+	corner[CornerPosition] = ResolveObjIndex( index, numPositions );
+	corner[CornerTextureCoordinate] = -1;
+	corner[CornerNormal] = -1;
+
+	if ( *p == '/' )
+	{
+	    p++;
+	    if ( *p != '/' )
+	    {
+		p = ParseInt( p, index );
+		if ( p == NULL )
+		{
+		    return NovaErrInvalidFormat;
+		}
+		corner[CornerTextureCoordinate] = 
+		    ResolveObjIndex( index, numTextureCoordinates );
+		if ( corner[CornerTextureCoordinate] < 0 )
+		{
+		    return NovaErrInvalidFormat;
+		}
+	    }
+	    if ( *p == '/' )
+	    {
+		p = ParseInt( p + 1, index );
+		if ( p == NULL )
+		{
+		    return NovaErrInvalidFormat;
+		}
+		corner[CornerNormal] = ResolveObjIndex( index, numNormals );
+		if ( corner[CornerNormal] < 0 )
+		{
+		    return NovaErrInvalidFormat;
+		}
+	    }
+	}
+
+	if ( corner[CornerPosition] < 0 )
+	{
+	    return NovaErrInvalidFormat;
+	}
+
+	if ( numCorners == 0 )
+	{
+	    memcpy( first, corner, sizeof(corner) );
+	}
+	else if ( numCorners >= 2 )
+	{
+	    err = AddTriangle( first, previous, corner );
+	}
+	memcpy( previous, corner, sizeof(corner) );
+	numCorners++;
+    }
+
+    return (numCorners >= 3) ? err : NovaErrInvalidFormat;
+}
+
+///////////////////////////////////////////////////
+// PLY
+///////////////////////////////////////////////////
+
+// PLY property value types
+enum PlyType
+    {
+	PlyTypeNone, 
+	PlyTypeInt8, 
+	PlyTypeUint8, 
+	PlyTypeInt16, 
+	PlyTypeUint16, 
+	PlyTypeInt32, 
+	PlyTypeUint32, 
+	PlyTypeFloat32, 
+	PlyTypeFloat64
+    };
+
+// meaning of a PLY property
+enum PlyRole
+    {
+	PlyRoleIgnored, 
+	PlyRoleX, PlyRoleY, PlyRoleZ, 
+	PlyRoleNormalX, PlyRoleNormalY, PlyRoleNormalZ, 
+	PlyRoleU, PlyRoleV, 
+	PlyRoleRed, PlyRoleGreen, PlyRoleBlue,
+	PlyRoleVertexIndices, 
+	PlyNumRoles
+    };
+
+struct PlyProperty
+{
+    PlyType m_type;
+
+    // type of the item count for list properties, PlyTypeNone otherwise
+    PlyType m_countType;
+    PlyRole m_role;
+};
+
+struct PlyElement
+{
+    char m_name[32];
+    uint_32 m_count;
+    int m_numProperties;
+    PlyProperty m_properties[MaxPlyProperties];
+};
+
+// returns the size of a PLY value type in bytes
+inline int PlyTypeSize( PlyType type )
+{
+    static const int sizes[] = { 0, 1, 1, 2, 2, 4, 4, 4, 8 };
+    return sizes[type];
+}
+
+PlyType ParsePlyType( const char* name )
+{
+    static const char* names[] = 
+	{ "", "char", "uchar", "short", "ushort", "int", "uint", 
+	  "float", "double" };
+    static const char* sizedNames[] = 
+	{ "", "int8", "uint8", "int16", "uint16", "int32", "uint32", 
+	  "float32", "float64" };
+
+    for ( int i = PlyTypeInt8; i <= PlyTypeFloat64; i++ )
+    {
+	if ( (strcmp( name, names[i] ) == 0) || 
+	     (strcmp( name, sizedNames[i] ) == 0) )
+	{
+	    return (PlyType)i;
+	}
+    }
+
+    return PlyTypeNone;
+}
+
+PlyRole ParsePlyRole( const char* name )
+{
+    static const struct { const char* m_name; PlyRole m_role; } roles[] = 
+	{
+	    { "x", PlyRoleX }, { "y", PlyRoleY }, { "z", PlyRoleZ },
+	    { "nx", PlyRoleNormalX }, { "ny", PlyRoleNormalY }, 
+	    { "nz", PlyRoleNormalZ },
+	    { "u", PlyRoleU }, { "v", PlyRoleV }, 
+	    { "s", PlyRoleU }, { "t", PlyRoleV }, 
+	    { "texture_u", PlyRoleU }, { "texture_v", PlyRoleV }, 
+	    { "red", PlyRoleRed }, { "green", PlyRoleGreen }, 
+	    { "blue", PlyRoleBlue },
+	    { "vertex_indices", PlyRoleVertexIndices }, 
+	    { "vertex_index", PlyRoleVertexIndices }
+	};
+
+    for ( uint_32 i = 0; i < sizeof(roles) / sizeof(roles[0]); i++ )
+    {
+	if ( strcmp( name, roles[i].m_name ) == 0 )
+	{
+	    return roles[i].m_role;
+	}
+    }
+
+    return PlyRoleIgnored;
+}
+
+// decodes a PLY value, swapping the byte order if needed
+real_64 DecodePlyValue( const uint_8* data, PlyType type, bool swap )
+{
+    uint_8 bytes[8];
+    int size = PlyTypeSize( type );
+    for ( int i = 0; i < size; i++ )
+    {
+	bytes[i] = swap ? data[size - 1 - i] : data[i];
+    }
+
+    switch ( type )
+    {
+    case PlyTypeInt8: 
+	return (int_8)bytes[0];
+    case PlyTypeUint8: 
+	return bytes[0];
+    case PlyTypeInt16: 
+    {
+	short value;
+	memcpy( &value, bytes, sizeof(value) );
+	return value;
+    }
+    case PlyTypeUint16: 
+    {
+	unsigned short value;
+	memcpy( &value, bytes, sizeof(value) );
+	return value;
+    }
+    case PlyTypeInt32: 
+    {
+	int_32 value;
+	memcpy( &value, bytes, sizeof(value) );
+	return value;
+    }
+    case PlyTypeUint32: 
+    {
+	uint_32 value;
+	memcpy( &value, bytes, sizeof(value) );
+	return value;
+    }
+    case PlyTypeFloat32: 
+    {
+	float value;
+	memcpy( &value, bytes, sizeof(value) );
+	return value;
+    }
+    case PlyTypeFloat64: 
+    {
+	real_64 value;
+	memcpy( &value, bytes, sizeof(value) );
+	return value;
+    }
+    default:
+	return 0.0;
+    }
+}
+
+// reads the next whitespace separated word of a header line
+const char* ReadWord( const char* p, char* word, int maxLength )
+{
+    p = SkipSpaces( p );
+    int length = 0;
+    while ( (*p != '\0') && (*p != ' ') && (*p != '\t') )
+    {
+	if ( length < (maxLength - 1) )
+	{
+	    word[length++] = *p;
+	}
+	p++;
+    }
+    word[length] = '\0';
+
+    return p;
+}
+
+int MeshImporter::ParsePly( NovaPixelFormat pixelFormat, 
+			    StreamReader& reader )
+{
+    char* line;
+    if ( (reader.ReadLine( line ) != NovaErrNone) || 
+	 (strcmp( line, "ply" ) != 0) )
+    {
+	return NovaErrInvalidFormat;
+    }
+
+    // parse the header
+    PlyElement elements[MaxPlyElements];
+    int numElements = 0;
+    bool littleEndian = false;
+    bool hasFormat = false;
+    char word[32];
+
+    int err = NovaErrNone;
+    while ( (err = reader.ReadLine( line )) == NovaErrNone )
+    {
+	const char* p = ReadWord( line, word, sizeof(word) );
+	if ( strcmp( word, "end_header" ) == 0 )
+	{
+	    break;
+	}
+	else if ( strcmp( word, "format" ) == 0 )
+	{
+	    // ASCII PLY is not supported
+	    ReadWord( p, word, sizeof(word) );
+	    littleEndian = (strcmp( word, "binary_little_endian" ) == 0);
+	    hasFormat = littleEndian || 
+		(strcmp( word, "binary_big_endian" ) == 0);
+	}
+	else if ( strcmp( word, "element" ) == 0 )
+	{
+	    if ( numElements == MaxPlyElements )
+	    {
+		return NovaErrInvalidFormat;
+	    }
+	    PlyElement& element = elements[numElements++];
+	    p = ReadWord( p, element.m_name, sizeof(element.m_name) );
+	    int_32 count;
+	    if ( (ParseInt( p, count ) == NULL) || (count < 0) )
+	    {
+		return NovaErrInvalidFormat;
+	    }
+	    element.m_count = count;
+	    element.m_numProperties = 0;
+	}
+	else if ( strcmp( word, "property" ) == 0 )
+	{
+	    if ( (numElements == 0) || 
+		 (elements[numElements - 1].m_numProperties == 
+		  MaxPlyProperties) )
+	    {
+		return NovaErrInvalidFormat;
+	    }
+	    PlyElement& element = elements[numElements - 1];
+	    PlyProperty& property = 
+		element.m_properties[element.m_numProperties++];
+
+	    p = ReadWord( p, word, sizeof(word) );
+	    property.m_countType = PlyTypeNone;
+	    if ( strcmp( word, "list" ) == 0 )
+	    {
+		p = ReadWord( p, word, sizeof(word) );
+		property.m_countType = ParsePlyType( word );
+		p = ReadWord( p, word, sizeof(word) );
+		if ( property.m_countType == PlyTypeNone )
+		{
+		    return NovaErrInvalidFormat;
+		}
+	    }
+	    property.m_type = ParsePlyType( word );
+	    ReadWord( p, word, sizeof(word) );
+	    property.m_role = ParsePlyRole( word );
+	    if ( property.m_type == PlyTypeNone )
+	    {
+		return NovaErrInvalidFormat;
+	    }
+	}
+	// comments and obj_info are ignored
+    }
+
+    if ( (err != NovaErrNone) || !hasFormat )
+    {
+	return NovaErrInvalidFormat;
+    }
+
+    // swap the bytes if the file byte order differs from ours
+    uint_32 one = 1;
+    bool swap = (littleEndian != (*(uint_8*)&one == 1));
+
+    // the elements follow in the order they were declared
+    for ( int i = 0; (i < numElements) && (err == NovaErrNone); i++ )
+    {
+	if ( strcmp( elements[i].m_name, "vertex" ) == 0 )
+	{
+	    err = ReadPlyVertices( pixelFormat, reader, elements[i], swap );
+	}
+	else if ( strcmp( elements[i].m_name, "face" ) == 0 )
+	{
+	    err = ReadPlyFaces( reader, elements[i], swap );
+	}
+	else
+	{
+	    err = SkipPlyElement( reader, elements[i], swap );
+	}
+    }
+
+    return err;
+}
+
+int MeshImporter::ReadPlyVertices( NovaPixelFormat pixelFormat, 
+				   StreamReader& reader,
+				   const PlyElement& element, bool swap )
+{
+    bool hasRole[PlyNumRoles];
+    memset( hasRole, 0, sizeof(hasRole) );
+
+    // the vertices must have a fixed size
+    int vertexSize = 0;
+    for ( int i = 0; i < element.m_numProperties; i++ )
+    {
+	if ( element.m_properties[i].m_countType != PlyTypeNone )
+	{
+	    return NovaErrInvalidFormat;
+	}
+	vertexSize += PlyTypeSize( element.m_properties[i].m_type );
+	hasRole[element.m_properties[i].m_role] = true;
+    }
+
+    if ( !hasRole[PlyRoleX] || !hasRole[PlyRoleY] || !hasRole[PlyRoleZ] )
+    {
+	return NovaErrInvalidFormat;
+    }
+    bool hasNormal = hasRole[PlyRoleNormalX] && hasRole[PlyRoleNormalY] && 
+	hasRole[PlyRoleNormalZ];
+    bool hasTextureCoordinate = hasRole[PlyRoleU] && hasRole[PlyRoleV];
+
+    uint_8 vertex[MaxPlyProperties * 8];
+    uint_32 white = ImportColor( pixelFormat, 1.0, 1.0, 1.0 );
+
+    int err = NovaErrNone;
+    for ( uint_32 i = 0; (i < element.m_count) && (err == NovaErrNone); i++ )
+    {
+	err = reader.Read( vertex, vertexSize );
+	if ( err != NovaErrNone )
+	{
+	    break;
+	}
+
+	real_64 values[PlyNumRoles];
+	memset( values, 0, sizeof(values) );
+	values[PlyRoleRed] = values[PlyRoleGreen] = values[PlyRoleBlue] = 255;
+
+	const uint_8* p = vertex;
+	for ( int j = 0; j < element.m_numProperties; j++ )
+	{
+	    const PlyProperty& property = element.m_properties[j];
+	    values[property.m_role] = 
+		DecodePlyValue( p, property.m_type, swap );
+	    p += PlyTypeSize( property.m_type );
+	}
+
+	uint_32 color = white;
+	if ( hasRole[PlyRoleRed] )
+	{
+	    // float colors are in [0,1], integer ones in [0,255]
+	    real_64 scale = (values[PlyRoleRed] <= 1.0 && 
+			     values[PlyRoleGreen] <= 1.0 && 
+			     values[PlyRoleBlue] <= 1.0) ? 1.0 : (1.0 / 255.0);
+	    color = ImportColor( pixelFormat, values[PlyRoleRed] * scale, 
+				 values[PlyRoleGreen] * scale, 
+				 values[PlyRoleBlue] * scale );
+	}
+
+	err = AddPosition( values[PlyRoleX], values[PlyRoleY], 
+			   values[PlyRoleZ], color );
+	if ( (err == NovaErrNone) && hasNormal )
+	{
+	    err = AddNormal( values[PlyRoleNormalX], values[PlyRoleNormalY], 
+			     values[PlyRoleNormalZ] );
+	}
+	if ( (err == NovaErrNone) && hasTextureCoordinate )
+	{
+	    err = AddTextureCoordinate( values[PlyRoleU], values[PlyRoleV] );
+	}
+    }
+
+    return err;
+}
+
+int MeshImporter::ReadPlyFaces( StreamReader& reader, 
+				const PlyElement& element, bool swap )
+{
+    int numVertices = m_positionRemap.Count();
+    bool hasNormals = (m_normalRemap.Count() == numVertices);
+    bool hasTextureCoordinates = 
+	((m_sourceTextureCoordinates.Count() / 2) == numVertices);
+
+    uint_8 buffer[MaxPolygonCorners * 8];
+    int err = NovaErrNone;
+    for ( uint_32 i = 0; (i < element.m_count) && (err == NovaErrNone); i++ )
+    {
+	for ( int j = 0; (j < element.m_numProperties) && 
+		  (err == NovaErrNone); j++ )
+	{
+	    const PlyProperty& property = element.m_properties[j];
+	    int size = PlyTypeSize( property.m_type );
+
+	    // read the list item count, or 1 for a scalar
+	    int_32 count = 1;
+	    if ( property.m_countType != PlyTypeNone )
+	    {
+		err = reader.Read( buffer, PlyTypeSize( property.m_countType ) );
+		count = (int_32)DecodePlyValue( buffer, property.m_countType, 
+						swap );
+	    }
+	    if ( (count < 0) || (count > MaxPolygonCorners) )
+	    {
+		err = NovaErrInvalidFormat;
+	    }
+	    if ( err == NovaErrNone )
+	    {
+		err = reader.Read( buffer, count * size );
+	    }
+	    if ( (err != NovaErrNone) || 
+		 (property.m_role != PlyRoleVertexIndices) )
+	    {
+		continue;
+	    }
+
+	    // split the polygon into a fan around its first corner
+	    int_32 corners[MaxPolygonCorners][3];
+	    for ( int k = 0; (k < count) && (err == NovaErrNone); k++ )
+	    {
+		int_32 index = 
+		    (int_32)DecodePlyValue( buffer + k * size, 
+					    property.m_type, swap );
+		if ( (index < 0) || (index >= numVertices) )
+		{
+		    err = NovaErrInvalidFormat;
+		    break;
+		}
+		corners[k][CornerPosition] = index;
+		corners[k][CornerTextureCoordinate] = 
+		    hasTextureCoordinates ? index : -1;
+		corners[k][CornerNormal] = hasNormals ? index : -1;
+
+		if ( k >= 2 )
+		{
+		    err = AddTriangle( corners[0], corners[k - 1], corners[k] );
+		}
+	    }
+	}
+    }
+
+    return err;
+}
+
+int MeshImporter::SkipPlyElement( StreamReader& reader, 
+				  const PlyElement& element, bool swap )
+{
+    uint_8 buffer[MaxPolygonCorners * 8];
+    int err = NovaErrNone;
+    for ( uint_32 i = 0; (i < element.m_count) && (err == NovaErrNone); i++ )
+    {
+	for ( int j = 0; (j < element.m_numProperties) && 
+		  (err == NovaErrNone); j++ )
+	{
+	    const PlyProperty& property = element.m_properties[j];
+	    int_32 count = 1;
+	    if ( property.m_countType != PlyTypeNone )
+	    {
+		err = reader.Read( buffer, PlyTypeSize( property.m_countType ) );
+		count = (int_32)DecodePlyValue( buffer, property.m_countType, 
+						swap );
+	    }
+	    if ( (count < 0) || (count > MaxPolygonCorners) )
+	    {
+		err = NovaErrInvalidFormat;
+	    }
+	    if ( err == NovaErrNone )
+	    {
+		err = reader.Read( buffer, count * PlyTypeSize( property.m_type ) );
+	    }
+	}
+    }
+
+    return err;
+}
+
+///////////////////////////////////////////////////
+// Shape creation
+///////////////////////////////////////////////////
+
+int MeshImporter::CreateSmoothNormals( Shape& shape )
+{
+    // sum the normals of the polygons sharing each coordinate
+    int numCoordinates = shape.GetNumCoordinates();
+    int_64* sums = (int_64*)malloc( numCoordinates * 3 * sizeof(int_64) );
+    Vector* normals = (Vector*)malloc( numCoordinates * sizeof(Vector) );
+    if ( (sums == NULL) || (normals == NULL) )
+    {
+	free( sums );
+	free( normals );
+	return NovaErrNoMemory;
+    }
+    memset( sums, 0, numCoordinates * 3 * sizeof(int_64) );
+
+    int_32 numPolygons;
+    const uint_32* vertices = shape.GetPolygons( numPolygons );
+    const PlaneEquation* planeEquation = shape.GetPlaneEquations();
+    for ( int i = 0; i < numPolygons; i++ )
+    {
+	int_32 x, y, z;
+	planeEquation->GetNormal().GetFixed( x, y, z );
+	planeEquation++;
+
+	for ( int j = 0; j < 3; j++ )
+	{
+	    int_64* sum = sums + *vertices++ * 3;
+	    sum[0] += x;
+	    sum[1] += y;
+	    sum[2] += z;
+	}
+    }
+
+    for ( int i = 0; i < numCoordinates; i++ )
+    {
+	const int_64* sum = sums + i * 3;
+	real_64 length = sqrt( (real_64)sum[0] * sum[0] + 
+			       (real_64)sum[1] * sum[1] + 
+			       (real_64)sum[2] * sum[2] );
+	if ( length > 0.0 )
+	{
+	    real_64 scale = FixedPointOne / length;
+	    normals[i].SetFixed( (int_32)(sum[0] * scale), 
+				 (int_32)(sum[1] * scale), 
+				 (int_32)(sum[2] * scale) );
+	}
+	else
+	{
+	    normals[i].SetFixed( 0, FixedPointOne, 0 );
+	}
+    }
+    free( sums );
+
+    // the normal indices are the vertex indices
+    int err = shape.SetVertexNormals( numCoordinates, normals, 
+				      const_cast<uint_32*>( 
+					  shape.GetPolygons( numPolygons ) ) );
+    free( normals );
+
+    return err;
+}
+
+int MeshImporter::BuildShape( NovaPixelFormat pixelFormat, Shape*& shape )
+{
+    int numPolygons = m_vertices.Count() / 3;
+    if ( numPolygons == 0 )
+    {
+	return NovaErrInvalidFormat;
+    }
+
+    LOG_DEBUG_F("MeshImporter::BuildShape() #coords = %d, #polys = %d", 
+		m_positions.Count(), numPolygons);
+
+    const uint_32* vertices = m_vertices.Begin();
+    const uint_32* colors = m_vertexColors.Begin();
+    const int_32* textureCoordinates = m_textureCoordinates.Begin();
+    uint_32* normalIndices = m_normalIndices.Begin();
+
+    shape = new Shape( pixelFormat );
+    if ( shape == NULL )
+    {
+	return NovaErrNoMemory;
+    }
+
+    int err = shape->CreateGeometry( m_positions.Count(), numPolygons, 
+				     m_positions.GetVertices(), vertices );
+    if ( err == NovaErrNone )
+    {
+	err = shape->SetVertexColors( colors );
+    }
+    if ( (err == NovaErrNone) && m_hasTextureCoordinates )
+    {
+	err = shape->SetTextureCoordinates( textureCoordinates );
+    }
+    if ( err == NovaErrNone )
+    {
+	if ( m_missingNormals || (m_normals.Count() == 0) )
+	{
+	    err = CreateSmoothNormals( *shape );
+	}
+	else
+	{
+	    err = shape->SetVertexNormals( m_normals.Count(), 
+					   m_normals.GetVertices(), 
+					   normalIndices );
+	}
+    }
+
+    if ( err != NovaErrNone )
+    {
+	delete shape;
+	shape = NULL;
+    }
+
+    return err;
+}
+
+}; // namespace
@@ -23,37 +23,64 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
 #include "Normalizer.h"
 #include "VectorMath.h"
 #include "Shape.h"
+#include "VertexWelder.h"
 #include "NovaErrors.h"
+#include "JobSystem.h"
 #include "novalogging.h"
 
 namespace nova3d {
 
-int Normalizer::SmoothenVertex( const List<uint_32>& vertexNormalIndices,
+// number of vertices smoothened per job
+const int SmoothenGrainSize = 256;
+
+// smoothens ranges of vertices on the job system
+class SmoothenVerticesBody : public ParallelForBody
+{
+ public:
+    SmoothenVerticesBody( const uint_32* offsets, const uint_32* adjacency,
+			  Vector* normals, real_64 angle )
+	: m_offsets( offsets ),
+	  m_adjacency( adjacency ),
+	  m_normals( normals ),
+	  m_angle( angle )
+    {
+    }
+
+    void Execute( int begin, int end )
+    {
+	Normalizer::SmoothenVertices( begin, end - begin, m_offsets, 
+				      m_adjacency, m_normals, m_angle );
+    }
+
+ private:
+    const uint_32* m_offsets;
+    const uint_32* m_adjacency;
+    Vector* m_normals;
+    real_64 m_angle;
+};
+
+int Normalizer::SmoothenVertex( const uint_32* normalIndices, int numIndices,
 				Vector* normals, real_64 angle )
 {
     //##TODO## try to use int here not real
     //    real_64 x = 0.0, y = 0.0, z = 0.0;
     int_32 x = 0, y = 0, z = 0;
-    int numIndices = vertexNormalIndices.Count();
 
     for ( int i = 0; i < numIndices; i++ )
     {
-	uint_32 vertexNormalIndex;
-	if ( vertexNormalIndices.Get( i, vertexNormalIndex ) == NovaErrNone )
-	{
-	    Vector* normal = (normals + vertexNormalIndex);
-// 	    x += normal->GetRealX();
-// 	    y += normal->GetRealY();
-// 	    z += normal->GetRealZ();
-	    x += normal->GetFixedX();
-	    y += normal->GetFixedY();
-	    z += normal->GetFixedZ();
-	}
+	Vector* normal = (normals + normalIndices[i]);
+// 	x += normal->GetRealX();
+// 	y += normal->GetRealY();
+// 	z += normal->GetRealZ();
+	x += normal->GetFixedX();
+	y += normal->GetFixedY();
+	z += normal->GetFixedZ();
     }
 
     // create a vector out of an average of the normals at the vertex
@@ -79,73 +106,139 @@ int Normalizer::SmoothenVertex( const List<uint_32>& vertexNormalIndices,
     // angle will be "smoothed", ie. they will be assigned the avg. vector
     for ( int i = 0; i < numIndices; i++ )
     {
-	uint_32 vertexNormalIndex;
-	if ( vertexNormalIndices.Get( i, vertexNormalIndex ) == NovaErrNone )
-	{
-	    Vector* normal = (normals + vertexNormalIndex);
+	Vector* normal = (normals + normalIndices[i]);
 	    
-	    if ( normal->IsNull() || 
-		 (normal->AngleBetweenRadReal( avg ) <= angleInRadians) )
-	    {
-		normal->Set( avg );
-	    }
+	if ( normal->IsNull() || 
+	     (normal->AngleBetweenRadReal( avg ) <= angleInRadians) )
+	{
+	    normal->Set( avg );
 	}
     }
 
     return NovaErrNone;
 }
 
-NOVA_EXPORT int Normalizer::SmoothenVertexNormals( Shape& shape, real_64 angle )
+int Normalizer::BuildAdjacency( const Shape& shape, int numNormals,
+				uint_32*& offsets, uint_32*& adjacency, 
+				bool& disjoint )
 {
-    LOG_DEBUG("Normalizer::SmoothenVertexNormals()");
-
     int numCoordinates = shape.GetNumCoordinates();
     int numPolygons;
     const uint_32* vertices = shape.GetPolygons( numPolygons );
-    int numNormals;
-    Vector* normals = const_cast<Vector*>(shape.GetVertexNormals( numNormals ));
     const uint_32* normalIndices = shape.GetVertexNormalIndices();
+    int numCorners = numPolygons * 3;
 
-    List<uint_32> list( 10 );
+    offsets = (uint_32*)malloc( (numCoordinates + 1) * sizeof(uint_32) );
+    adjacency = (uint_32*)malloc( numCorners * sizeof(uint_32) );
+    if ( (offsets == NULL) || (adjacency == NULL) )
+    {
+	free( offsets );
+	free( adjacency );
+	return NovaErrNoMemory;
+    }
+
+    // count the corners at each vertex and turn the counts into offsets
+    memset( offsets, 0, (numCoordinates + 1) * sizeof(uint_32) );
+    for ( int i = 0; i < numCorners; i++ )
+    {
+	offsets[vertices[i] + 1]++;
+    }
+    for ( int i = 0; i < numCoordinates; i++ )
+    {
+	offsets[i + 1] += offsets[i];
+    }
 
-    // iterate over every vertex in the shape
-    for ( uint_32 i = 0; i < (uint_32)numCoordinates; i++ )
+    // place the normal indices, advancing each offset to the start of the 
+    // next vertex, then move the offsets back
+    for ( int i = 0; i < numCorners; i++ )
     {
-	const uint_32* vertex = vertices;
-	const uint_32* normalIndex = normalIndices;
+	adjacency[offsets[vertices[i]]++] = normalIndices[i];
+    }
+    for ( int i = numCoordinates; i > 0; i-- )
+    {
+	offsets[i] = offsets[i - 1];
+    }
+    offsets[0] = 0;
 
-	// iterate over every polygon in the shape and find those that share
-	// the current vertex
-	for ( int j = 0; j < numPolygons; j++ )
+    // record the vertex of each normal; a normal shared by the corners of
+    // two vertices would be written by two smoothening jobs
+    disjoint = false;
+    uint_32* owners = (uint_32*)malloc( numNormals * sizeof(uint_32) );
+    if ( owners != NULL )
+    {
+	memset( owners, 0xff, numNormals * sizeof(uint_32) );
+	disjoint = true;
+	for ( int i = 0; (i < numCoordinates) && disjoint; i++ )
 	{
-	    uint_32 v0 = *vertex++;
-	    uint_32 v1 = *vertex++;
-	    uint_32 v2 = *vertex++;
-	    uint_32 normalIndex0 = *normalIndex++;
-	    uint_32 normalIndex1 = *normalIndex++;
-	    uint_32 normalIndex2 = *normalIndex++;
-
-	    if ( v0 == i )
-	    {
-		list.Append( normalIndex0 );
-	    }
-	    else if ( v1 == i )
-	    {
-		list.Append( normalIndex1 );
-	    }
-	    else if ( v2 == i )
+	    for ( uint_32 j = offsets[i]; j < offsets[i + 1]; j++ )
 	    {
-		list.Append( normalIndex2 );
+		uint_32 normal = adjacency[j];
+		if ( (normal >= (uint_32)numNormals) || 
+		     ((owners[normal] != 0xffffffff) && 
+		      (owners[normal] != (uint_32)i)) )
+		{
+		    disjoint = false;
+		    break;
+		}
+		owners[normal] = i;
 	    }
 	}
+	free( owners );
+    }
+
+    return NovaErrNone;
+}
+
+void Normalizer::SmoothenVertices( int firstVertex, int numVertices, 
+				   const uint_32* offsets, 
+				   const uint_32* adjacency, 
+				   Vector* normals, real_64 angle )
+{
+    for ( int i = firstVertex; i < (firstVertex + numVertices); i++ )
+    {
+	SmoothenVertex( adjacency + offsets[i], offsets[i + 1] - offsets[i],
+			normals, angle );
+    }
+}
 
-	// smoothen the normals at the vertex in question
-	SmoothenVertex( list, normals, angle );
+NOVA_EXPORT int Normalizer::SmoothenVertexNormals( Shape& shape, real_64 angle )
+{
+    LOG_DEBUG("Normalizer::SmoothenVertexNormals()");
 
-	// reset the list
-	list.Reset();
+    int numNormals;
+    Vector* normals = const_cast<Vector*>(shape.GetVertexNormals( numNormals ));
+    if ( normals == NULL )
+    {
+	return NovaErrNoVertexNormals;
     }
 
+    uint_32* offsets;
+    uint_32* adjacency;
+    bool disjoint;
+    int ret = BuildAdjacency( shape, numNormals, offsets, adjacency, 
+			      disjoint );
+    if ( ret != NovaErrNone )
+    {
+	return ret;
+    }
+
+    // smoothen the normals at every vertex in the shape. When the vertices
+    // do not share any normals they can be smoothened in parallel.
+    if ( disjoint )
+    {
+	SmoothenVerticesBody body( offsets, adjacency, normals, angle );
+	JobSystem::Instance().ParallelFor( 0, shape.GetNumCoordinates(), 
+					   SmoothenGrainSize, body );
+    }
+    else
+    {
+	SmoothenVertices( 0, shape.GetNumCoordinates(), offsets, adjacency, 
+			  normals, angle );
+    }
+
+    free( offsets );
+    free( adjacency );
+
     return NovaErrNone;
 }
 
@@ -154,65 +247,41 @@ NOVA_EXPORT int Normalizer::OptimizeVertexNormals( Shape& shape )
     // get existing vertex normal information
     int numOldNormals;
     const Vector* oldNormals = shape.GetVertexNormals( numOldNormals );
+    if ( oldNormals == NULL )
+    {
+	return NovaErrNoVertexNormals;
+    }
     int numPolygons = shape.GetNumPolygons();
     int numIndices = numPolygons * 3;
 
-    // allocate memory for new vertex normal information
-    Vector* vertexNormals = (Vector*)malloc( numPolygons * sizeof(Vector) );
-    if ( vertexNormals == NULL )
-    {
-	return NovaErrNoMemory;
-    }
+    // allocate memory for new vertex normal indices
     uint_32* vertexNormalIndices = 
-	(uint_32*)malloc( numPolygons * 3 * sizeof(uint_32) );
+	(uint_32*)malloc( numIndices * sizeof(uint_32) );
     if ( vertexNormalIndices == NULL )
     {
-	free( vertexNormals );
 	return NovaErrNoMemory;
     }
 
-    //
+    // combine the identical normals through a hash table
+    VertexWelder welder;
     const uint_32* srcIndex = shape.GetVertexNormalIndices();
-    uint_32* destIndex = vertexNormalIndices;
-    int numNewNormals = 0;
-
-    for ( int i = 0; i < numIndices; i++ )
+    int ret = NovaErrNone;
+    for ( int i = 0; (i < numIndices) && (ret == NovaErrNone); i++ )
     {
-	const Vector* normal = (oldNormals + (*srcIndex++));
-	uint_32 newNormalIndex = 0;
-	bool found = false;
-
-	// try to look up the normal in the new normal list
-	for ( int j = 0; j < numNewNormals; j++ )
-	{
-	    if ( *normal == *(vertexNormals + j) )
-	    {
-		newNormalIndex = j;
-		found = true;
-		break;
-	    }
-	}
-
-	// if the normal wasnt found in the list, add it as a new entry
-	if ( !found )
-	{
-	    newNormalIndex = numNewNormals++;
-	    (vertexNormals + newNormalIndex)->Set( *normal );
-	}
-
-	// write new index information
-	*destIndex++ = newNormalIndex;
+	ret = welder.Add( oldNormals[*srcIndex++], vertexNormalIndices[i] );
     }
 
     LOG_DEBUG_F("Normalizer::OptimizeVertexNormals() optimized %d -> %d", 
-		numOldNormals, numNewNormals);
+		numOldNormals, welder.Count());
 
     // set the optimized vertex information to the shape
-    int ret = shape.SetVertexNormals( numNewNormals, vertexNormals, 
+    if ( ret == NovaErrNone )
+    {
+	ret = shape.SetVertexNormals( welder.Count(), welder.GetVertices(), 
 				      vertexNormalIndices );
+    }
     
     // clean up
-    free( vertexNormals );
     free( vertexNormalIndices );
 
     return ret;
@@ -94,13 +94,52 @@ void SelectVertexOrder( ScreenPolygon* face,
     }
 }
 
-void CalculateInverses( ScreenVertex& vertex )
+int SelectMipLevel( const ScreenPolygon& face, int numMipLevels )
+{
+    // twice the screen area of the polygon. both the screen and the 
+    // texture coordinates are in fixed point, so the areas compare as is.
+    int_64 pixelArea = 
+	((int_64)(face.m_v2.m_x - face.m_v1.m_x) * 
+	 (int_64)(face.m_v3.m_y - face.m_v1.m_y)) - 
+	((int_64)(face.m_v3.m_x - face.m_v1.m_x) * 
+	 (int_64)(face.m_v2.m_y - face.m_v1.m_y));
+    if ( pixelArea < 0 ) 
+    {
+	pixelArea = -pixelArea;
+    }
+
+    // twice the texture space area of the polygon
+    int_32 u1 = face.m_v1.m_textureCoordinates.m_u;
+    int_32 v1 = face.m_v1.m_textureCoordinates.m_v;
+    int_64 texelArea = 
+	((int_64)(face.m_v2.m_textureCoordinates.m_u - u1) * 
+	 (int_64)(face.m_v3.m_textureCoordinates.m_v - v1)) - 
+	((int_64)(face.m_v3.m_textureCoordinates.m_u - u1) * 
+	 (int_64)(face.m_v2.m_textureCoordinates.m_v - v1));
+    if ( texelArea < 0 ) 
+    {
+	texelArea = -texelArea;
+    }
+
+    int level = 0;
+    while ( (level < (numMipLevels - 1)) && 
+	    ((texelArea >> ((level + 1) << 1)) >= pixelArea) )
+    {
+	level++;
+    }
+
+    return level;
+}
+
+void CalculateInverses( ScreenVertex& vertex, int mipLevel )
 {
     vertex.m_z = (int_32)(MaxUint32 / (uint_32)vertex.m_z); 
     vertex.m_textureCoordinates.m_u = 
-	::FixedLargeMul( vertex.m_textureCoordinates.m_u, vertex.m_z );
+	::FixedLargeMul( vertex.m_textureCoordinates.m_u, vertex.m_z ) >> 
+	mipLevel;
     vertex.m_textureCoordinates.m_v = 
-	::FixedLargeMul( vertex.m_textureCoordinates.m_v, vertex.m_z );
+	::FixedLargeMul( vertex.m_textureCoordinates.m_v, vertex.m_z ) >> 
+	mipLevel;
 }
 
 void CalculatePolygonGradients( const ScreenVertex& vertex1, 
@@ -161,10 +200,9 @@ void CalculatePolygonGradients( const ScreenVertex& vertex1,
 bool IsLongOnLeft( const ScreenVertex& vertex1, 
 		   const ScreenVertex& vertex2, 
 		   const ScreenVertex& vertex3, 
-		   int& longInvLen, int& longX, int& longDxdy )
+		   int longInvLen, int& longX, int& longDxdy )
 {
     // setup
-    longInvLen = (int_32)(MaxUint32 / (uint_32)(vertex3.m_y - vertex1.m_y));
     longX = vertex1.m_x;
     longDxdy = ::FixedLargeMul( (vertex3.m_x - longX), longInvLen );
 
@@ -28,10 +28,72 @@
 #include "TextureFactory.h"
 #include "NovaErrors.h"
 #include "Display.h"
+#include "FixedPoint.h"
+#include "JobSystem.h"
 #include "novalogging.h"
 
 namespace nova3d {
 
+// number of color table cells matched to the palette per job
+const int MatchColorsGrainSize = 1024;
+
+// number of image rows mapped to the palette per job
+const int CreateDataGrainSize = 16;
+
+// matches ranges of color table cells to the palette on the job system
+class PaletteLookupBody : public ParallelForBody
+{
+ public:
+    PaletteLookupBody( TextureFactory& factory, const int* red, 
+		       const int* green, const int* blue, int numColors )
+	: m_factory( factory ),
+	  m_red( red ),
+	  m_green( green ),
+	  m_blue( blue ),
+	  m_numColors( numColors )
+    {
+    }
+
+    void Execute( int begin, int end )
+    {
+	m_factory.MatchColors( begin, end - begin, m_red, m_green, m_blue,
+			       m_numColors );
+    }
+
+ private:
+    TextureFactory& m_factory;
+    const int* m_red;
+    const int* m_green;
+    const int* m_blue;
+    int m_numColors;
+};
+
+// maps ranges of image rows to the palette on the job system
+class TextureDataBody : public ParallelForBody
+{
+ public:
+    TextureDataBody( TextureFactory& factory, uint_8* data, 
+		     uint_8* originalData, int width )
+	: m_factory( factory ),
+	  m_data( data ),
+	  m_originalData( originalData ),
+	  m_width( width )
+    {
+    }
+
+    void Execute( int begin, int end )
+    {
+	m_factory.CreateData( m_data, m_originalData, m_width, 
+			      begin, end - begin );
+    }
+
+ private:
+    TextureFactory& m_factory;
+    uint_8* m_data;
+    uint_8* m_originalData;
+    int m_width;
+};
+
 TextureFactory::TextureFactory()
 {
 }
@@ -46,6 +108,13 @@ uint_32 Read3byteColor( uint_8*& data )
     return (red << 16) + (green << 8) + blue;
 }
 
+// returns the 555 color table index of the given 888 color
+inline int ColorTableIndex( uint_32 color888 )
+{
+    return ((color888 >> 9) & 0x7c00) | ((color888 >> 6) & 0x03e0) | 
+	((color888 >> 3) & 0x001f);
+}
+
 void TextureFactory::PopulateColorTable( int numPixels, uint_8* data )
 {
     // clear the color table to all zeros
@@ -57,12 +126,11 @@ void TextureFactory::PopulateColorTable( int numPixels, uint_8* data )
     for ( int i = 0; i < numPixels; i++ )
     {
 	uint_32 color888 = Read3byteColor( color );
-	uint_32 color555 = nova3d::ConvertColor( color888, PixelFormat888, 
-						 PixelFormat555 );
-	ColorTableEntry* entry = 
-	    &(m_colorTable[color555 & ColorTableIndexMask]);
-	entry->m_originalColor = color888;
+	ColorTableEntry* entry = &(m_colorTable[ColorTableIndex( color888 )]);
 	entry->m_frequency++;
+	entry->m_redSum += (color888 >> 16) & 0xff;
+	entry->m_greenSum += (color888 >> 8) & 0xff;
+	entry->m_blueSum += color888 & 0xff;
     }
 }
 
@@ -80,121 +148,270 @@ int TextureFactory::CountUniqueColors()
     return uniqueColors;
 }
 
-void TextureFactory::SortColorTable( int left, int right )
+void TextureFactory::ShrinkColorBox( ColorBox& box )
 {
-    int qleft = left;
-    int qright = right;
-    uint_32 qpivot = m_colorTable[(qleft + qright) / 2].m_frequency;
+    int min[3] = { 31, 31, 31 };
+    int max[3] = { 0, 0, 0 };
+    box.m_population = 0;
 
-    do 
+    for ( int r = box.m_min[0]; r <= box.m_max[0]; r++ )
     {
-	while ( (m_colorTable[qleft].m_frequency > qpivot) && (qleft < right) )
+	for ( int g = box.m_min[1]; g <= box.m_max[1]; g++ )
 	{
-	    qleft++;
+	    const ColorTableEntry* entry = 
+		&(m_colorTable[(r << 10) | (g << 5) | box.m_min[2]]);
+
+	    for ( int b = box.m_min[2]; b <= box.m_max[2]; b++, entry++ )
+	    {
+		if ( entry->m_frequency > 0 )
+		{
+		    min[0] = MIN( min[0], r );
+		    min[1] = MIN( min[1], g );
+		    min[2] = MIN( min[2], b );
+		    max[0] = MAX( max[0], r );
+		    max[1] = MAX( max[1], g );
+		    max[2] = MAX( max[2], b );
+		    box.m_population += entry->m_frequency;
+		}
+	    }
 	}
-        
-	while ( (qpivot > m_colorTable[qright].m_frequency) && (qright > left) )
+    }
+
+    if ( box.m_population > 0 )
+    {
+	for ( int i = 0; i < 3; i++ )
 	{
-	    qright--;
+	    box.m_min[i] = min[i];
+	    box.m_max[i] = max[i];
 	}
-	
-	if ( qleft <= qright ) 
+    }
+}
+
+void TextureFactory::SplitColorBox( ColorBox& box, ColorBox& newBox )
+{
+    // split along the longest side of the box
+    int axis = 0;
+    for ( int i = 1; i < 3; i++ )
+    {
+	if ( (box.m_max[i] - box.m_min[i]) > 
+	     (box.m_max[axis] - box.m_min[axis]) )
 	{
-	    // swap elements 
-// 	    ScreenPolygon *tmp = *(m_visibleFaceList + qright);
-// 	    *(m_visibleFaceList + qright) = *(m_visibleFaceList + qleft);
-// 	    *(m_visibleFaceList + qleft) = tmp;
-	    uint_32 color = m_colorTable[qright].m_originalColor;
-	    uint_32 frequency = m_colorTable[qright].m_frequency;
-	    m_colorTable[qright].m_originalColor = 
-		m_colorTable[qleft].m_originalColor;
-	    m_colorTable[qright].m_frequency = 
-		m_colorTable[qleft].m_frequency;
-	    m_colorTable[qleft].m_originalColor = color;
-	    m_colorTable[qleft].m_frequency = frequency;
-	    qleft++;
-	    qright--;
+	    axis = i;
 	}
-    } while ( qleft <= qright );
-    
-    // recursively sort left side
-    if ( left < qright ) 
+    }
+
+    // build the population histogram along the axis
+    uint_32 histogram[32];
+    memset( histogram, 0, sizeof(histogram) );
+
+    for ( int r = box.m_min[0]; r <= box.m_max[0]; r++ )
     {
-	SortColorTable( left, qright );
+	for ( int g = box.m_min[1]; g <= box.m_max[1]; g++ )
+	{
+	    const ColorTableEntry* entry = 
+		&(m_colorTable[(r << 10) | (g << 5) | box.m_min[2]]);
+
+	    for ( int b = box.m_min[2]; b <= box.m_max[2]; b++, entry++ )
+	    {
+		int slice = (axis == 0) ? r : ((axis == 1) ? g : b);
+		histogram[slice] += entry->m_frequency;
+	    }
+	}
     }
 
-    // recursively sort right side
-    if ( qleft < right ) 
+    // find the median; both halves get at least one slice
+    int cut = box.m_min[axis];
+    uint_32 count = histogram[cut];
+    while ( (cut < (box.m_max[axis] - 1)) && 
+	    (count < (box.m_population >> 1)) )
     {
-	SortColorTable( qleft, right );
+	cut++;
+	count += histogram[cut];
     }
+
+    newBox = box;
+    box.m_max[axis] = cut;
+    newBox.m_min[axis] = cut + 1;
+
+    ShrinkColorBox( box );
+    ShrinkColorBox( newBox );
 }
 
-void TextureFactory::CreatePalette( NovaPixelFormat pixelFormat, 
-				    uint_32* palette, int numColors )
+int TextureFactory::CreatePalette( uint_32* palette, int numUniqueColors )
 {
-    int paletteIndex = 0;
+    int numColors = 0;
 
-    // create the palette out of the 'numColors' first entries with >0 freq
-    for ( int i = 0; (i < ColorTableSize) && (paletteIndex < numColors); i++ )
+    if ( numUniqueColors <= Texture::NumPaletteEntries )
     {
-	if ( m_colorTable[i].m_frequency > 0 )
+	// every color cell gets its own palette entry
+	for ( int i = 0; i < ColorTableSize; i++ )
+	{
+	    const ColorTableEntry& entry = m_colorTable[i];
+	    if ( entry.m_frequency > 0 )
+	    {
+		palette[numColors++] = 
+		    PIXEL_888( entry.m_redSum / entry.m_frequency,
+			       entry.m_greenSum / entry.m_frequency,
+			       entry.m_blueSum / entry.m_frequency );
+	    }
+	}
+
+	return numColors;
+    }
+
+    // median cut: keep splitting the most populated box until there are
+    // as many boxes as palette entries
+    ColorBox boxes[Texture::NumPaletteEntries];
+    int numBoxes = 1;
+    for ( int i = 0; i < 3; i++ )
+    {
+	boxes[0].m_min[i] = 0;
+	boxes[0].m_max[i] = 31;
+    }
+    ShrinkColorBox( boxes[0] );
+
+    while ( numBoxes < Texture::NumPaletteEntries )
+    {
+	int selected = -1;
+	uint_32 maxPopulation = 0;
+
+	for ( int i = 0; i < numBoxes; i++ )
 	{
-	    palette[paletteIndex++] = m_colorTable[i].m_originalColor;
+	    const ColorBox& box = boxes[i];
+	    bool splittable = (box.m_min[0] < box.m_max[0]) || 
+		(box.m_min[1] < box.m_max[1]) || 
+		(box.m_min[2] < box.m_max[2]);
+
+	    if ( splittable && (box.m_population > maxPopulation) )
+	    {
+		maxPopulation = box.m_population;
+		selected = i;
+	    }
 	}
+
+	if ( selected < 0 )
+	{
+	    // every box is a single color cell
+	    break;
+	}
+
+	SplitColorBox( boxes[selected], boxes[numBoxes++] );
     }
+
+    // the palette colors are the averages of the colors in the boxes
+    for ( int i = 0; i < numBoxes; i++ )
+    {
+	const ColorBox& box = boxes[i];
+	uint_32 redSum = 0, greenSum = 0, blueSum = 0;
+
+	for ( int r = box.m_min[0]; r <= box.m_max[0]; r++ )
+	{
+	    for ( int g = box.m_min[1]; g <= box.m_max[1]; g++ )
+	    {
+		const ColorTableEntry* entry = 
+		    &(m_colorTable[(r << 10) | (g << 5) | box.m_min[2]]);
+
+		for ( int b = box.m_min[2]; b <= box.m_max[2]; b++, entry++ )
+		{
+		    redSum += entry->m_redSum;
+		    greenSum += entry->m_greenSum;
+		    blueSum += entry->m_blueSum;
+		}
+	    }
+	}
+
+	palette[numColors++] = PIXEL_888( redSum / box.m_population,
+					  greenSum / box.m_population,
+					  blueSum / box.m_population );
+    }
+
+    return numColors;
 }
 
-void TextureFactory::CreateData( NovaPixelFormat pixelFormat, 
-				 uint_8* data, uint_8* originalData, 
-				 const uint_32* palette, 
-				 int numPixels, int numColors )
+void TextureFactory::CreatePaletteLookup( const uint_32* palette, 
+					  int numColors )
 {
-    uint_8* fromPixel = originalData;
-    uint_8* toPixel = data;
+    int red[Texture::NumPaletteEntries];
+    int green[Texture::NumPaletteEntries];
+    int blue[Texture::NumPaletteEntries];
 
-    // find closest match for every pixel from the given palette
-    for ( int i = 0; i < numPixels; i++ )
+    for ( int j = 0; j < numColors; j++ )
     {
-	uint_32 color = Read3byteColor( fromPixel );
-	
+	red[j] = (palette[j] >> 16) & 0xff;
+	green[j] = (palette[j] >> 8) & 0xff;
+	blue[j] = palette[j] & 0xff;
+    }
+
+    // find the closest palette entry for the average color of every 
+    // populated cell; the pixels only ever refer to populated cells
+    memset( m_paletteLookup, 0, sizeof(m_paletteLookup) );
+
+    PaletteLookupBody body( *this, red, green, blue, numColors );
+    JobSystem::Instance().ParallelFor( 0, ColorTableSize, 
+				       MatchColorsGrainSize, body );
+}
+
+void TextureFactory::MatchColors( int firstCell, int numCells, 
+				  const int* red, const int* green, 
+				  const int* blue, int numColors )
+{
+    for ( int i = firstCell; i < (firstCell + numCells); i++ )
+    {
+	const ColorTableEntry& entry = m_colorTable[i];
+	if ( entry.m_frequency == 0 )
+	{
+	    continue;
+	}
+
+	int red0 = entry.m_redSum / entry.m_frequency;
+	int green0 = entry.m_greenSum / entry.m_frequency;
+	int blue0 = entry.m_blueSum / entry.m_frequency;
+
 	int paletteIndex = 0;
 	uint_32 minDiff = MaxUint32;
 
-	int red0, green0, blue0;
-	nova3d::SplitColor( PixelFormat888, color, red0, green0, blue0 );
-
 	for ( int j = 0; j < numColors; j++ )
 	{
-	    int red1, green1, blue1;
-	    nova3d::SplitColor( pixelFormat, palette[j], red1, green1, blue1 );
-
-            uint_32 diff = 
-		((red0 - red1) * (red0 - red1)) + 
-		((green0 - green1) * (green0 - green1)) + 
-		((blue0 - blue1) * (blue0 - blue1));
+	    uint_32 diff = 
+		((red0 - red[j]) * (red0 - red[j])) + 
+		((green0 - green[j]) * (green0 - green[j])) + 
+		((blue0 - blue[j]) * (blue0 - blue[j]));
 
-            // check for exact match
-            if ( diff == 0 ) 
-	    {
-                paletteIndex = j;
-                break;
-            } 
-	    else if ( diff < minDiff ) 
+	    if ( diff < minDiff ) 
 	    {
-                paletteIndex = j;
-                minDiff = diff;
-            }                
+		paletteIndex = j;
+		minDiff = diff;
+		if ( diff == 0 )
+		{
+		    // exact match
+		    break;
+		}
+	    }
 	}
-	
-	*toPixel++ = (uint_8)paletteIndex;
+
+	m_paletteLookup[i] = (uint_8)paletteIndex;
+    }
+}
+
+void TextureFactory::CreateData( uint_8* data, uint_8* originalData, 
+				 int width, int firstRow, int numRows )
+{
+    uint_8* fromPixel = originalData + firstRow * width * 3;
+    uint_8* toPixel = data + firstRow * width;
+    int numPixels = numRows * width;
+
+    for ( int i = 0; i < numPixels; i++ )
+    {
+	uint_32 color = Read3byteColor( fromPixel );
+	*toPixel++ = m_paletteLookup[ColorTableIndex( color )];
     }
 }
 
 NOVA_EXPORT int TextureFactory::CreateTexture( NovaPixelFormat pixelFormat,
 					       int width, int height, 
 					       uint_8* pixelData, 
-					       Texture*& texture )
+					       Texture*& texture,
+					       Texture::MemoryLayout layout )
 {
     LOG_DEBUG_F("TextureFactory::CreateTexture(): %d x %d", width, height);
 
@@ -212,16 +429,11 @@ NOVA_EXPORT int TextureFactory::CreateTexture( NovaPixelFormat pixelFormat,
     LOG_DEBUG_F("TextureFactory::CreateTexture(): %d unique colors", 
 		numUniqueColors);
     
-    // see if we must reduce the color count
-    if ( numUniqueColors > Texture::NumPaletteEntries )
-    {
-	SortColorTable( 0, ColorTableSize - 1 );
-	numUniqueColors = Texture::NumPaletteEntries;
-    }
-
-    // create the palette
+    // create the palette, reducing the color count if needed, and
+    // the lookup from colors to the palette entries
     uint_32 palette[Texture::NumPaletteEntries];
-    CreatePalette( pixelFormat, palette, numUniqueColors );
+    int numColors = CreatePalette( palette, numUniqueColors );
+    CreatePaletteLookup( palette, numColors );
 
     // create the indexed texture bitmap data
     uint_8* data = (uint_8*)malloc( width * height * sizeof(uint_8) );
@@ -229,13 +441,21 @@ NOVA_EXPORT int TextureFactory::CreateTexture( NovaPixelFormat pixelFormat,
     {
 	return NovaErrNoMemory;
     }
-    CreateData( pixelFormat, data, pixelData, palette, 
-		width * height, numUniqueColors );
+    TextureDataBody body( *this, data, pixelData, width );
+    JobSystem::Instance().ParallelFor( 0, height, CreateDataGrainSize, 
+				       body );
+
+    // the palette was created in 888; convert it to the texture's format
+    for ( int i = 0; i < Texture::NumPaletteEntries; i++ )
+    {
+	palette[i] = (i < numColors) ? 
+	    nova3d::ConvertColor( palette[i], PixelFormat888, pixelFormat ) : 0;
+    }
 
     // create the texture
     texture = new Texture();
     int ret = texture->Create( pixelFormat, width, height, 
-			       palette, data );
+			       palette, data, layout );
 
     // cleanup
     free( data );
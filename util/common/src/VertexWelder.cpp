@@ -0,0 +1,136 @@
+/*
+ *  $Id$
+ *
+ *  Nova 3D Engine - A portable object oriented, scene graph based, 
+ *  lightweight real-time 3D software rendering framework. 
+ *  Copyright (C) 2001-2009 Matti Dahlbom
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Contact: Matti Dahlbom <matti at 777-team dot org>
+ */
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "VertexWelder.h"
+#include "NovaErrors.h"
+
+namespace nova3d {
+
+// hashes the fixed point coordinates of a vertex
+inline uint_32 HashVertex( const Vector& vertex )
+{
+    return ( ((uint_32)vertex.GetFixedX() * 73856093u) ^ 
+	     ((uint_32)vertex.GetFixedY() * 19349663u) ^ 
+	     ((uint_32)vertex.GetFixedZ() * 83492791u) );
+}
+
+NOVA_EXPORT VertexWelder::VertexWelder()
+    : m_vertices( NULL ),
+      m_numVertices( 0 ),
+      m_maxVertices( 0 ),
+      m_table( NULL ),
+      m_tableSize( 0 )
+{
+}
+
+NOVA_EXPORT VertexWelder::~VertexWelder()
+{
+    free( m_vertices );
+    free( m_table );
+}
+
+NOVA_EXPORT void VertexWelder::Reset()
+{
+    m_numVertices = 0;
+    if ( m_table != NULL )
+    {
+	memset( m_table, 0, m_tableSize * sizeof(uint_32) );
+    }
+}
+
+int VertexWelder::GrowTable()
+{
+    uint_32 tableSize = (m_tableSize == 0) ? 1024 : (m_tableSize * 2);
+    uint_32* table = (uint_32*)malloc( tableSize * sizeof(uint_32) );
+    if ( table == NULL )
+    {
+	return NovaErrNoMemory;
+    }
+    memset( table, 0, tableSize * sizeof(uint_32) );
+
+    // rehash the existing vertices
+    for ( int i = 0; i < m_numVertices; i++ )
+    {
+	uint_32 slot = HashVertex( m_vertices[i] ) & (tableSize - 1);
+	while ( table[slot] != 0 )
+	{
+	    slot = (slot + 1) & (tableSize - 1);
+	}
+	table[slot] = i + 1;
+    }
+
+    free( m_table );
+    m_table = table;
+    m_tableSize = tableSize;
+
+    return NovaErrNone;
+}
+
+NOVA_EXPORT int VertexWelder::Add( const Vector& vertex, uint_32& index )
+{
+    // keep the load factor at or below 1/2
+    if ( (uint_32)(m_numVertices * 2) >= m_tableSize )
+    {
+	int err = GrowTable();
+	if ( err != NovaErrNone )
+	{
+	    return err;
+	}
+    }
+
+    uint_32 slot = HashVertex( vertex ) & (m_tableSize - 1);
+    while ( m_table[slot] != 0 )
+    {
+	if ( m_vertices[m_table[slot] - 1] == vertex )
+	{
+	    index = m_table[slot] - 1;
+	    return NovaErrNone;
+	}
+	slot = (slot + 1) & (m_tableSize - 1);
+    }
+
+    if ( m_numVertices == m_maxVertices )
+    {
+	// grow geometrically
+	int maxVertices = (m_maxVertices == 0) ? 1024 : (m_maxVertices * 2);
+	void* p = realloc( (void*)m_vertices, maxVertices * sizeof(Vector) );
+	if ( p == NULL )
+	{
+	    return NovaErrNoMemory;
+	}
+	m_vertices = (Vector*)p;
+	m_maxVertices = maxVertices;
+    }
+
+    index = m_numVertices++;
+    m_vertices[index].Set( vertex );
+    m_table[slot] = index + 1;
+
+    return NovaErrNone;
+}
+
+}; // namespace